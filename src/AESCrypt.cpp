@@ -0,0 +1,359 @@
+/*
+    Copyright 2016-2022 melonDS team
+
+    This file is part of melonDS.
+
+    melonDS is free software: you can redistribute it and/or modify it under
+    the terms of the GNU General Public License as published by the Free
+    Software Foundation, either version 3 of the License, or (at your option)
+    any later version.
+
+    melonDS is distributed in the hope that it will be useful, but WITHOUT ANY
+    WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+    FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with melonDS. If not, see http://www.gnu.org/licenses/.
+*/
+
+#include <string.h>
+
+#include "AESCrypt.h"
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define HAVE_AESNI
+#include <immintrin.h>
+#endif
+
+// clang only has the crypto intrinsics if they're enabled for the whole file
+#if defined(__aarch64__) && (defined(__ARM_FEATURE_AES) || defined(__ARM_FEATURE_CRYPTO) || !defined(__clang__))
+#define HAVE_ARMV8_AES
+#include <arm_neon.h>
+#if defined(__ARM_FEATURE_AES) || defined(__ARM_FEATURE_CRYPTO)
+#define ARMV8_AES_ALWAYS
+#define ARMV8_AES_TARGET
+#else
+#define ARMV8_AES_TARGET __attribute__((target("+crypto")))
+#ifdef __linux__
+#include <sys/auxv.h>
+#include <asm/hwcap.h>
+#endif
+#endif
+#endif
+
+namespace AESCrypt
+{
+
+// the modes are all built out of these
+struct Backend
+{
+    const char* Name;
+    void (*EncryptBlock)(const AES_ctx* ctx, u8* block);
+    void (*CTRBlocks)(AES_ctx* ctx, u8* data, u32 numBlocks);
+    void (*MACBlocks)(const AES_ctx* ctx, const u8* data, u32 numBlocks, u8* mac);
+};
+
+
+void IncrementCounter(u8* ctr)
+{
+    for (int i = 15; i >= 0; i--)
+    {
+        if (++ctr[i] != 0)
+            break;
+    }
+}
+
+
+void Tiny_Encrypt(const AES_ctx* ctx, u8* block)
+{
+    AES_ECB_encrypt(ctx, block);
+}
+
+void Tiny_CTR(AES_ctx* ctx, u8* data, u32 numBlocks)
+{
+    AES_CTR_xcrypt_buffer(ctx, data, numBlocks * 16);
+}
+
+void Tiny_CBCMAC(const AES_ctx* ctx, const u8* data, u32 numBlocks, u8* mac)
+{
+    for (u32 i = 0; i < numBlocks; i++)
+    {
+        for (int j = 0; j < 16; j++) mac[j] ^= data[i*16 + j];
+        AES_ECB_encrypt(ctx, mac);
+    }
+}
+
+const Backend TinyBackend = {"tiny-AES", Tiny_Encrypt, Tiny_CTR, Tiny_CBCMAC};
+
+
+#ifdef HAVE_AESNI
+
+#define AESNI_TARGET __attribute__((target("aes,sse2")))
+
+AESNI_TARGET inline void AESNI_LoadKey(const AES_ctx* ctx, __m128i* rk)
+{
+    for (int i = 0; i < 11; i++)
+        rk[i] = _mm_loadu_si128((const __m128i*)&ctx->RoundKey[i*16]);
+}
+
+AESNI_TARGET inline __m128i AESNI_EncryptBlock(const __m128i* rk, __m128i block)
+{
+    block = _mm_xor_si128(block, rk[0]);
+    for (int i = 1; i < 10; i++)
+        block = _mm_aesenc_si128(block, rk[i]);
+    return _mm_aesenclast_si128(block, rk[10]);
+}
+
+AESNI_TARGET void AESNI_Encrypt(const AES_ctx* ctx, u8* block)
+{
+    __m128i rk[11];
+    AESNI_LoadKey(ctx, rk);
+
+    __m128i b = _mm_loadu_si128((const __m128i*)block);
+    _mm_storeu_si128((__m128i*)block, AESNI_EncryptBlock(rk, b));
+}
+
+AESNI_TARGET void AESNI_CTR(AES_ctx* ctx, u8* data, u32 numBlocks)
+{
+    __m128i rk[11];
+    AESNI_LoadKey(ctx, rk);
+
+    // the counter is big endian
+    u64 hi, lo;
+    memcpy(&hi, &ctx->Iv[0], 8);
+    memcpy(&lo, &ctx->Iv[8], 8);
+    hi = __builtin_bswap64(hi);
+    lo = __builtin_bswap64(lo);
+
+    auto nextCounter = [&]()
+    {
+        __m128i ctr = _mm_set_epi64x((long long)__builtin_bswap64(lo), (long long)__builtin_bswap64(hi));
+        if (++lo == 0) hi++;
+        return ctr;
+    };
+
+    // the blocks don't depend on each other, so
+    // a few are done at once to keep the AES unit busy
+    while (numBlocks >= 4)
+    {
+        __m128i b0 = _mm_xor_si128(nextCounter(), rk[0]);
+        __m128i b1 = _mm_xor_si128(nextCounter(), rk[0]);
+        __m128i b2 = _mm_xor_si128(nextCounter(), rk[0]);
+        __m128i b3 = _mm_xor_si128(nextCounter(), rk[0]);
+        for (int i = 1; i < 10; i++)
+        {
+            b0 = _mm_aesenc_si128(b0, rk[i]);
+            b1 = _mm_aesenc_si128(b1, rk[i]);
+            b2 = _mm_aesenc_si128(b2, rk[i]);
+            b3 = _mm_aesenc_si128(b3, rk[i]);
+        }
+        b0 = _mm_aesenclast_si128(b0, rk[10]);
+        b1 = _mm_aesenclast_si128(b1, rk[10]);
+        b2 = _mm_aesenclast_si128(b2, rk[10]);
+        b3 = _mm_aesenclast_si128(b3, rk[10]);
+
+        __m128i* blocks = (__m128i*)data;
+        _mm_storeu_si128(&blocks[0], _mm_xor_si128(_mm_loadu_si128(&blocks[0]), b0));
+        _mm_storeu_si128(&blocks[1], _mm_xor_si128(_mm_loadu_si128(&blocks[1]), b1));
+        _mm_storeu_si128(&blocks[2], _mm_xor_si128(_mm_loadu_si128(&blocks[2]), b2));
+        _mm_storeu_si128(&blocks[3], _mm_xor_si128(_mm_loadu_si128(&blocks[3]), b3));
+
+        data += 64;
+        numBlocks -= 4;
+    }
+
+    while (numBlocks > 0)
+    {
+        __m128i b = AESNI_EncryptBlock(rk, nextCounter());
+        _mm_storeu_si128((__m128i*)data, _mm_xor_si128(_mm_loadu_si128((const __m128i*)data), b));
+
+        data += 16;
+        numBlocks--;
+    }
+
+    hi = __builtin_bswap64(hi);
+    lo = __builtin_bswap64(lo);
+    memcpy(&ctx->Iv[0], &hi, 8);
+    memcpy(&ctx->Iv[8], &lo, 8);
+}
+
+AESNI_TARGET void AESNI_CBCMAC(const AES_ctx* ctx, const u8* data, u32 numBlocks, u8* mac)
+{
+    __m128i rk[11];
+    AESNI_LoadKey(ctx, rk);
+
+    __m128i m = _mm_loadu_si128((const __m128i*)mac);
+    for (u32 i = 0; i < numBlocks; i++)
+    {
+        m = _mm_xor_si128(m, _mm_loadu_si128((const __m128i*)&data[i*16]));
+        m = AESNI_EncryptBlock(rk, m);
+    }
+    _mm_storeu_si128((__m128i*)mac, m);
+}
+
+const Backend AESNIBackend = {"AES-NI", AESNI_Encrypt, AESNI_CTR, AESNI_CBCMAC};
+
+#endif
+
+
+#ifdef HAVE_ARMV8_AES
+
+ARMV8_AES_TARGET inline void ARMv8_LoadKey(const AES_ctx* ctx, uint8x16_t* rk)
+{
+    for (int i = 0; i < 11; i++)
+        rk[i] = vld1q_u8(&ctx->RoundKey[i*16]);
+}
+
+ARMV8_AES_TARGET inline uint8x16_t ARMv8_EncryptBlock(const uint8x16_t* rk, uint8x16_t block)
+{
+    // AESE adds the round key first, so it's one round key ahead of AES-NI
+    for (int i = 0; i < 9; i++)
+        block = vaesmcq_u8(vaeseq_u8(block, rk[i]));
+    block = vaeseq_u8(block, rk[9]);
+    return veorq_u8(block, rk[10]);
+}
+
+ARMV8_AES_TARGET void ARMv8_Encrypt(const AES_ctx* ctx, u8* block)
+{
+    uint8x16_t rk[11];
+    ARMv8_LoadKey(ctx, rk);
+
+    vst1q_u8(block, ARMv8_EncryptBlock(rk, vld1q_u8(block)));
+}
+
+ARMV8_AES_TARGET void ARMv8_CTR(AES_ctx* ctx, u8* data, u32 numBlocks)
+{
+    uint8x16_t rk[11];
+    ARMv8_LoadKey(ctx, rk);
+
+    while (numBlocks >= 4)
+    {
+        uint8x16_t b0 = vld1q_u8(ctx->Iv); IncrementCounter(ctx->Iv);
+        uint8x16_t b1 = vld1q_u8(ctx->Iv); IncrementCounter(ctx->Iv);
+        uint8x16_t b2 = vld1q_u8(ctx->Iv); IncrementCounter(ctx->Iv);
+        uint8x16_t b3 = vld1q_u8(ctx->Iv); IncrementCounter(ctx->Iv);
+        for (int i = 0; i < 9; i++)
+        {
+            b0 = vaesmcq_u8(vaeseq_u8(b0, rk[i]));
+            b1 = vaesmcq_u8(vaeseq_u8(b1, rk[i]));
+            b2 = vaesmcq_u8(vaeseq_u8(b2, rk[i]));
+            b3 = vaesmcq_u8(vaeseq_u8(b3, rk[i]));
+        }
+        b0 = veorq_u8(vaeseq_u8(b0, rk[9]), rk[10]);
+        b1 = veorq_u8(vaeseq_u8(b1, rk[9]), rk[10]);
+        b2 = veorq_u8(vaeseq_u8(b2, rk[9]), rk[10]);
+        b3 = veorq_u8(vaeseq_u8(b3, rk[9]), rk[10]);
+
+        vst1q_u8(&data[0], veorq_u8(vld1q_u8(&data[0]), b0));
+        vst1q_u8(&data[16], veorq_u8(vld1q_u8(&data[16]), b1));
+        vst1q_u8(&data[32], veorq_u8(vld1q_u8(&data[32]), b2));
+        vst1q_u8(&data[48], veorq_u8(vld1q_u8(&data[48]), b3));
+
+        data += 64;
+        numBlocks -= 4;
+    }
+
+    while (numBlocks > 0)
+    {
+        uint8x16_t b = ARMv8_EncryptBlock(rk, vld1q_u8(ctx->Iv));
+        IncrementCounter(ctx->Iv);
+        vst1q_u8(data, veorq_u8(vld1q_u8(data), b));
+
+        data += 16;
+        numBlocks--;
+    }
+}
+
+ARMV8_AES_TARGET void ARMv8_CBCMAC(const AES_ctx* ctx, const u8* data, u32 numBlocks, u8* mac)
+{
+    uint8x16_t rk[11];
+    ARMv8_LoadKey(ctx, rk);
+
+    uint8x16_t m = vld1q_u8(mac);
+    for (u32 i = 0; i < numBlocks; i++)
+        m = ARMv8_EncryptBlock(rk, veorq_u8(m, vld1q_u8(&data[i*16])));
+    vst1q_u8(mac, m);
+}
+
+const Backend ARMv8Backend = {"ARMv8 crypto extensions", ARMv8_Encrypt, ARMv8_CTR, ARMv8_CBCMAC};
+
+#endif
+
+
+const Backend* PickBackend()
+{
+#ifdef HAVE_AESNI
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("aes"))
+        return &AESNIBackend;
+#endif
+
+#ifdef HAVE_ARMV8_AES
+#ifdef ARMV8_AES_ALWAYS
+    return &ARMv8Backend;
+#elif defined(__linux__)
+    if (getauxval(AT_HWCAP) & HWCAP_AES)
+        return &ARMv8Backend;
+#endif
+#endif
+
+    return &TinyBackend;
+}
+
+const Backend* GetBackend()
+{
+    static const Backend* backend = PickBackend();
+    return backend;
+}
+
+
+const char* BackendName()
+{
+    return GetBackend()->Name;
+}
+
+void ECBEncrypt(const AES_ctx* ctx, u8* block)
+{
+    GetBackend()->EncryptBlock(ctx, block);
+}
+
+void CTRCrypt(AES_ctx* ctx, u8* data, u32 len)
+{
+    GetBackend()->CTRBlocks(ctx, data, len >> 4);
+}
+
+void CCMEncrypt(AES_ctx* ctx, u8* data, u32 len, u8* mac)
+{
+    // the MAC is over the plaintext, so it has to come first
+    const Backend* backend = GetBackend();
+    backend->MACBlocks(ctx, data, len >> 4, mac);
+    backend->CTRBlocks(ctx, data, len >> 4);
+}
+
+void CCMDecrypt(AES_ctx* ctx, u8* data, u32 len, u8* mac)
+{
+    const Backend* backend = GetBackend();
+    backend->CTRBlocks(ctx, data, len >> 4);
+    backend->MACBlocks(ctx, data, len >> 4, mac);
+}
+
+void CBCMAC(const AES_ctx* ctx, const u8* data, u32 len, u8* mac)
+{
+    GetBackend()->MACBlocks(ctx, data, len >> 4, mac);
+}
+
+void SwapBlocks(u8* data, u32 len)
+{
+    for (u32 i = 0; i < len; i += 16)
+    {
+        u64 lo, hi;
+        memcpy(&lo, &data[i], 8);
+        memcpy(&hi, &data[i+8], 8);
+        lo = __builtin_bswap64(lo);
+        hi = __builtin_bswap64(hi);
+        memcpy(&data[i], &hi, 8);
+        memcpy(&data[i+8], &lo, 8);
+    }
+}
+
+}
@@ -0,0 +1,56 @@
+/*
+    Copyright 2016-2022 melonDS team
+
+    This file is part of melonDS.
+
+    melonDS is free software: you can redistribute it and/or modify it under
+    the terms of the GNU General Public License as published by the Free
+    Software Foundation, either version 3 of the License, or (at your option)
+    any later version.
+
+    melonDS is distributed in the hope that it will be useful, but WITHOUT ANY
+    WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+    FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with melonDS. If not, see http://www.gnu.org/licenses/.
+*/
+
+#ifndef AESCRYPT_H
+#define AESCRYPT_H
+
+#include "types.h"
+#include "tiny-AES-c/aes.hpp"
+
+// AES-128 for everything DSi, done with the AES instructions of the host
+// CPU where there are any (AES-NI, ARMv8 crypto extensions) and tiny-AES
+// otherwise. The keys are still expanded by tiny-AES and kept in its
+// AES_ctx, the round keys are the same for all of them.
+//
+// All the bulk functions take whole 16 byte blocks. Like tiny-AES the
+// counter is the IV of the context, taken as a 128-bit big endian number,
+// it's incremented once per block.
+
+namespace AESCrypt
+{
+
+// which implementation is used, picked once at startup
+const char* BackendName();
+
+// single block, in place
+void ECBEncrypt(const AES_ctx* ctx, u8* block);
+
+void CTRCrypt(AES_ctx* ctx, u8* data, u32 len);
+
+// CTR with a CBC-MAC over the plaintext, like the DSi AES engine in CCM mode
+void CCMEncrypt(AES_ctx* ctx, u8* data, u32 len, u8* mac);
+void CCMDecrypt(AES_ctx* ctx, u8* data, u32 len, u8* mac);
+// only the MAC, for the associated data
+void CBCMAC(const AES_ctx* ctx, const u8* data, u32 len, u8* mac);
+
+// the DSi hardware takes its blocks byte reversed
+void SwapBlocks(u8* data, u32 len);
+
+}
+
+#endif // AESCRYPT_H
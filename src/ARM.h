@@ -191,6 +191,9 @@ public:
 
     // all code accesses are forced nonseq 32bit
     u32 CodeRead32(u32 addr, bool branch);
+    // the cycles CodeRead32 takes in a region with the given timing,
+    // without touching any state
+    s32 CodeFetchCycles(u32 addr, bool branch, s32 regionCodeCycles) const;
 
     void DataRead8(u32 addr, u32* val);
     void DataRead16(u32 addr, u32* val);
@@ -20,7 +20,11 @@
 
 #include <string.h>
 #include <assert.h>
-#include <unordered_map>
+#include <atomic>
+#include <deque>
+#include <new>
+#include <unordered_set>
+#include <vector>
 
 #define XXH_STATIC_LINKING_ONLY
 #include "xxhash/xxhash.h"
@@ -28,6 +32,8 @@
 #include "Platform.h"
 
 #include "ARMJIT_Internal.h"
+#include "ARMJIT_DiskCache.h"
+#include "ARMJIT_Profiler.h"
 #include "ARMJIT_Memory.h"
 #include "ARMJIT_Compiler.h"
 
@@ -42,6 +48,7 @@
 #include "SPU.h"
 #include "Wifi.h"
 #include "NDSCart.h"
+#include "Profiler.h"
 #include "Platform.h"
 
 using Platform::Log;
@@ -64,12 +71,28 @@ int MaxBlockSize;
 bool LiteralOptimizations;
 bool BranchOptimizations;
 bool FastMemory;
+bool DiskCache;
+bool AsyncCompile;
+u32 CodeCacheSize = 32 * 1024 * 1024;
 
+BlockMap<JitBlock> JitBlocks9;
+BlockMap<JitBlock> JitBlocks7;
 
-std::unordered_map<u32, JitBlock*> JitBlocks9;
-std::unordered_map<u32, JitBlock*> JitBlocks7;
+// keyed by the hash of the instructions
+BlockMap<JitBlock> RestoreCandidates;
 
-std::unordered_map<u32, JitBlock*> RestoreCandidates;
+// every registered block with an exit to an address, see ExitKey
+BlockMap<TinyVector<JitBlock*>> BlocksExitingTo;
+
+// blocks are carved out of big chunks and put on a free list
+// by size when they're thrown out, games which keep on rewriting
+// their code would otherwise spend a lot of time in malloc
+const u32 BlockArenaChunkSize = 256 * 1024;
+
+std::vector<u8*> BlockArenaChunks;
+u8* BlockArenaCur = NULL;
+u32 BlockArenaLeft = 0;
+JitBlock* FreeBlocks[MaxBlockDataWords + 1];
 
 TinyVector<u32> InvalidLiterals;
 
@@ -167,6 +190,108 @@ u64* const FastBlockLookupRegions[ARMJIT_Memory::memregions_Count] =
     FastBlockLookupNWRAM_C
 };
 
+u8 ClassifyDataRegion(u32 num, u32 addr)
+{
+    return num == 0
+        ? ARMJIT_Memory::ClassifyAddress9(addr)
+        : ARMJIT_Memory::ClassifyAddress7(addr);
+}
+
+// the address Comp_JumpTo is given for a branch to a constant address,
+// bit 0 is set if it goes to Thumb code
+bool ConstantJumpTarget(u32 num, bool thumb, const FetchedInstr& instr, u32& target)
+{
+    if (thumb)
+    {
+        u32 r15 = instr.Addr + 4;
+        if (instr.Info.Kind == ARMInstrInfo::tk_BCOND)
+        {
+            target = r15 + ((s32)(instr.Instr << 24) >> 23) + 1;
+            return true;
+        }
+        else if (instr.Info.Kind == ARMInstrInfo::tk_B)
+        {
+            target = r15 + ((s32)((instr.Instr & 0x7FF) << 21) >> 20) + 1;
+            return true;
+        }
+        else if (instr.Info.Kind == ARMInstrInfo::tk_BL_LONG)
+        {
+            u32 upperPart = instr.Instr >> 16;
+            target = r15 + ((s32)((instr.Instr & 0x7FF) << 21) >> 9);
+            target += (upperPart & 0x7FF) << 1;
+            if (num == 1 || upperPart & (1 << 12))
+                target |= 1;
+            return true;
+        }
+    }
+    else if (instr.Info.Kind == ARMInstrInfo::ak_B
+        || instr.Info.Kind == ARMInstrInfo::ak_BL
+        || instr.Info.Kind == ARMInstrInfo::ak_BLX_IMM)
+    {
+        target = instr.Addr + 8 + ((s32)(instr.Instr << 8) >> 6);
+        if (instr.Cond() == 0xF)
+            target += (((instr.Instr >> 24) & 1) << 1) + 1;
+        return true;
+    }
+    return false;
+}
+
+// the timing tables are changed through CP15 and the memory control registers,
+// so the cycles are looked up on the emu thread and not while compiling
+void LookupCycles(ARM* cpu, bool thumb, FetchedInstr& instr)
+{
+    if (cpu->Num == 1)
+    {
+        instr.CodeCyclesN = NDS::ARM7MemTimings[instr.CodeCycles][thumb ? 0 : 2];
+        instr.CodeCyclesS = NDS::ARM7MemTimings[instr.CodeCycles][thumb ? 1 : 3];
+    }
+
+    u32 addr;
+    if (!ConstantJumpTarget(cpu->Num, thumb, instr, addr))
+        return;
+    instr.JumpTarget = addr;
+
+    u32 cycles = 0;
+    if (cpu->Num == 0)
+    {
+        ARMv5* cpu9 = (ARMv5*)cpu;
+
+        u32 regionCodeCycles = cpu9->MemTimings[addr >> 12][0];
+        instr.JumpRegionCodeCycles = regionCodeCycles;
+
+        if (addr & 0x1)
+        {
+            addr &= ~0x1;
+            // two-opcodes-at-once fetch
+            if (addr & 0x2)
+            {
+                cycles += cpu9->CodeFetchCycles(addr-2, true, regionCodeCycles);
+                cycles += cpu9->CodeFetchCycles(addr+2, false, regionCodeCycles);
+            }
+            else
+            {
+                cycles += cpu9->CodeFetchCycles(addr, true, regionCodeCycles);
+            }
+        }
+        else
+        {
+            addr &= ~0x3;
+            cycles += cpu9->CodeFetchCycles(addr, true, regionCodeCycles);
+            cycles += cpu9->CodeFetchCycles(addr+4, false, regionCodeCycles);
+        }
+    }
+    else
+    {
+        u32 codeCycles = addr >> 15;
+        if (addr & 0x1)
+            cycles += NDS::ARM7MemTimings[codeCycles][0] + NDS::ARM7MemTimings[codeCycles][1];
+        else
+            cycles += NDS::ARM7MemTimings[codeCycles][2] + NDS::ARM7MemTimings[codeCycles][3];
+    }
+
+    instr.JumpCycles = cycles;
+}
+
 u32 LocaliseCodeAddress(u32 num, u32 addr)
 {
     int region = num == 0
@@ -316,6 +441,229 @@ void SlowBlockTransfer7(u32 addr, u64* data, u32 num)
 INSTANTIATE_SLOWMEM(0)
 INSTANTIATE_SLOWMEM(1)
 
+JitBlock* AllocJitBlock(u32 num, u32 numAddresses, u32 numLiterals)
+{
+    u32 dataWords = numAddresses * 2 + numLiterals;
+    assert(dataWords <= MaxBlockDataWords);
+
+    void* mem = FreeBlocks[dataWords];
+    if (mem)
+    {
+        FreeBlocks[dataWords] = *(JitBlock**)mem;
+    }
+    else
+    {
+        u32 size = sizeof(JitBlock) + ((dataWords * sizeof(u32) + 7) & ~7);
+        if (BlockArenaLeft < size)
+        {
+            BlockArenaCur = new u8[BlockArenaChunkSize];
+            BlockArenaLeft = BlockArenaChunkSize;
+            BlockArenaChunks.push_back(BlockArenaCur);
+        }
+        mem = BlockArenaCur;
+        BlockArenaCur += size;
+        BlockArenaLeft -= size;
+    }
+
+    return new (mem) JitBlock(num, numAddresses, numLiterals);
+}
+
+void FreeJitBlock(JitBlock* block)
+{
+    u32 dataWords = block->DataSize() / sizeof(u32);
+    *(JitBlock**)block = FreeBlocks[dataWords];
+    FreeBlocks[dataWords] = block;
+}
+
+// only once every block is gone, including those of the compile thread
+void FreeBlockArena()
+{
+    for (u8* chunk : BlockArenaChunks)
+        delete[] chunk;
+    BlockArenaChunks.clear();
+    BlockArenaCur = NULL;
+    BlockArenaLeft = 0;
+    memset(FreeBlocks, 0, sizeof(FreeBlocks));
+}
+
+// whoever calls this needs to have the compiler for themselves
+void CompileJitBlock(ARM* cpu, JitBlock* block, bool thumb, FetchedInstr instrs[], int instrsCount, bool hasMemoryInstr)
+{
+    JITCompiler->ExecutionCounter = ARMJIT_Profiler::Enabled
+        ? ARMJIT_Profiler::ExecutionCounter(block->Num, block->StartAddr, thumb)
+        : NULL;
+    u64 startTime = ARMJIT_Profiler::Enabled ? ARMJIT_Profiler::Now() : 0;
+
+    JitEnableWrite();
+    block->EntryPoint = JITCompiler->CompileBlock(cpu, thumb, instrs, instrsCount, hasMemoryInstr);
+    JitEnableExecute();
+
+    ARMJIT_Profiler::BlockCompiled(block->Num, block->StartAddr, thumb, instrsCount, block->EntryPoint,
+        JITCompiler->BlockSize, ARMJIT_Profiler::Enabled ? ARMJIT_Profiler::Now() - startTime : 0);
+
+    block->NumExits = JITCompiler->NumExits;
+    memcpy(block->Exits, JITCompiler->Exits, sizeof(BlockExit) * JITCompiler->NumExits);
+
+    PROFILE_COUNT(Counter_JITBlocksCompiled);
+}
+
+// with AsyncCompile blocks are compiled on a thread of their own. Until a
+// block is done it's interpreted, the same way it is the first time around.
+// The compiler is the only thing shared with that thread, everything
+// else, including registering the finished blocks, happens over here.
+struct CompileJob
+{
+    ARM* CPU;
+    JitBlock* Block;
+    bool Thumb;
+    bool HasMemoryInstr;
+    u32 Generation;
+    std::vector<FetchedInstr> Instrs;
+    // to check the code is still the same once the block is done
+    std::vector<SourceWord> Code, Literals;
+};
+
+Platform::Thread* CompileThread = nullptr;
+Platform::Semaphore* CompileJobsPending;
+// guards the lists of jobs
+Platform::Mutex* CompileJobsLock;
+Platform::Mutex* CompilerLock;
+std::deque<CompileJob*> QueuedJobs;
+std::vector<CompileJob*> FinishedJobs;
+std::atomic<bool> JobsFinished;
+std::atomic<bool> CompileThreadOutOfSpace;
+std::atomic<bool> CompileThreadQuit;
+// jobs from before the last reset are thrown away
+std::atomic<u32> CompileGeneration;
+// blocks which are queued or finished but not registered yet
+std::unordered_set<u64> PendingBlocks;
+
+u64 PendingBlockKey(u32 num, u32 addr)
+{
+    return ((u64)num << 32) | addr;
+}
+
+void CompileThreadFunc()
+{
+    while (true)
+    {
+        Platform::Semaphore_Wait(CompileJobsPending);
+        if (CompileThreadQuit)
+            break;
+
+        Platform::Mutex_Lock(CompileJobsLock);
+        if (QueuedJobs.empty())
+        {
+            // the jobs were cancelled
+            Platform::Mutex_Unlock(CompileJobsLock);
+            continue;
+        }
+        CompileJob* job = QueuedJobs.front();
+        QueuedJobs.pop_front();
+        Platform::Mutex_Unlock(CompileJobsLock);
+
+        Platform::Mutex_Lock(CompilerLock);
+        // blocks are only evicted over on the emu thread, so once
+        // the current region is full everything fails until then
+        if (job->Generation == CompileGeneration && !CompileThreadOutOfSpace)
+        {
+            if (JITCompiler->CodeRegionFull())
+            {
+                CompileThreadOutOfSpace = true;
+            }
+            else
+            {
+                CompileJitBlock(job->CPU, job->Block, job->Thumb,
+                    job->Instrs.data(), job->Instrs.size(), job->HasMemoryInstr);
+            }
+        }
+        Platform::Mutex_Unlock(CompilerLock);
+
+        Platform::Mutex_Lock(CompileJobsLock);
+        FinishedJobs.push_back(job);
+        Platform::Mutex_Unlock(CompileJobsLock);
+        JobsFinished = true;
+    }
+}
+
+void DeleteCompileJob(CompileJob* job)
+{
+    FreeJitBlock(job->Block);
+    delete job;
+}
+
+void CancelCompileJobs()
+{
+    if (!CompileThread)
+        return;
+
+    Platform::Mutex_Lock(CompileJobsLock);
+    CompileGeneration++;
+    for (CompileJob* job : QueuedJobs)
+        DeleteCompileJob(job);
+    QueuedJobs.clear();
+    for (CompileJob* job : FinishedJobs)
+        DeleteCompileJob(job);
+    FinishedJobs.clear();
+    Platform::Mutex_Unlock(CompileJobsLock);
+
+    // wait for the job which might currently be compiled
+    Platform::Mutex_Lock(CompilerLock);
+    CompileThreadOutOfSpace = false;
+    Platform::Mutex_Unlock(CompilerLock);
+
+    PendingBlocks.clear();
+}
+
+void StartCompileThread()
+{
+    if (CompileThread)
+        return;
+
+    CompileJobsPending = Platform::Semaphore_Create();
+    CompileJobsLock = Platform::Mutex_Create();
+    CompilerLock = Platform::Mutex_Create();
+    CompileThreadQuit = false;
+    CompileThreadOutOfSpace = false;
+    JobsFinished = false;
+    CompileThread = Platform::Thread_Create(CompileThreadFunc);
+}
+
+void StopCompileThread()
+{
+    if (!CompileThread)
+        return;
+
+    CancelCompileJobs();
+
+    CompileThreadQuit = true;
+    Platform::Semaphore_Post(CompileJobsPending);
+    Platform::Thread_Wait(CompileThread);
+    Platform::Thread_Free(CompileThread);
+    CompileThread = nullptr;
+
+    // it might have finished one more job in the meantime
+    for (CompileJob* job : FinishedJobs)
+        DeleteCompileJob(job);
+    FinishedJobs.clear();
+
+    Platform::Semaphore_Free(CompileJobsPending);
+    Platform::Mutex_Free(CompileJobsLock);
+    Platform::Mutex_Free(CompilerLock);
+}
+
+void LockCompiler()
+{
+    if (CompileThread)
+        Platform::Mutex_Lock(CompilerLock);
+}
+
+void UnlockCompiler()
+{
+    if (CompileThread)
+        Platform::Mutex_Unlock(CompilerLock);
+}
+
 void Init()
 {
     JITCompiler = new Compiler();
@@ -325,8 +673,13 @@ void Init()
 
 void DeInit()
 {
+    StopCompileThread();
+    ARMJIT_DiskCache::Close();
+
     JitEnableWrite();
     ResetBlockCache();
+    FreeBlockArena();
+    ARMJIT_Profiler::DeInit();
     ARMJIT_Memory::DeInit();
 
     delete JITCompiler;
@@ -334,20 +687,41 @@ void DeInit()
 
 void Reset()
 {
+    // the compile thread uses the settings as well
+    CancelCompileJobs();
+    // written with the settings its blocks were analysed with
+    ARMJIT_DiskCache::Close();
+
     MaxBlockSize = Platform::GetConfigInt(Platform::JIT_MaxBlockSize);
     LiteralOptimizations = Platform::GetConfigBool(Platform::JIT_LiteralOptimizations);
     BranchOptimizations = Platform::GetConfigBool(Platform::JIT_BranchOptimizations);
     FastMemory = Platform::GetConfigBool(Platform::JIT_FastMemory);
+    DiskCache = Platform::GetConfigBool(Platform::JIT_DiskCache);
+    AsyncCompile = Platform::GetConfigBool(Platform::JIT_AsyncCompile);
 
     if (MaxBlockSize < 1)
         MaxBlockSize = 1;
-    if (MaxBlockSize > 32)
-        MaxBlockSize = 32;
+    if (MaxBlockSize > MaxBlockSizeLimit)
+        MaxBlockSize = MaxBlockSizeLimit;
+
+    int codeCacheSize = Platform::GetConfigInt(Platform::JIT_CodeCacheSize);
+    if (codeCacheSize < 4)
+        codeCacheSize = 4;
+    if (codeCacheSize > 32)
+        codeCacheSize = 32;
+    CodeCacheSize = codeCacheSize * 1024 * 1024;
 
     JitEnableWrite();
     ResetBlockCache();
+    // the old blocks counted their executions in there
+    ARMJIT_Profiler::Reset();
 
     ARMJIT_Memory::Reset();
+
+    if (AsyncCompile)
+        StartCompileThread();
+    else
+        StopCompileThread();
 }
 
 void FloodFillSetFlags(FetchedInstr instrs[], int start, u8 flags)
@@ -574,22 +948,455 @@ InterpreterFunc InterpretTHUMB[ARMInstrInfo::tk_Count] =
 };
 #undef F
 
+void UnlinkJitBlock(JitBlock* block);
+
 void RetireJitBlock(JitBlock* block)
 {
-    auto it = RestoreCandidates.find(block->InstrHash);
-    if (it != RestoreCandidates.end())
+    JitBlock* replaced = RestoreCandidates.Insert(block->InstrHash, block);
+    if (replaced)
+        FreeJitBlock(replaced);
+}
+
+// a block which was invalidated can be brought back as long as
+// it still covers the same code and literals
+JitBlock* TakeRestoreCandidate(u32 instrHash, u32 literalHash, u32 blockAddr,
+    u32* addressRanges, u32* addressMasks, u32 numAddressRanges)
+{
+    JitBlock* prevBlock = RestoreCandidates.Remove(instrHash);
+    if (!prevBlock)
+        return NULL;
+
+    bool mayRestore = prevBlock->StartAddr == blockAddr
+        && prevBlock->LiteralHash == literalHash
+        && prevBlock->NumAddresses == numAddressRanges;
+
+    // the order of the ranges doesn't matter
+    for (u32 j = 0; j < numAddressRanges && mayRestore; j++)
+    {
+        mayRestore = false;
+        for (u32 k = 0; k < numAddressRanges; k++)
+        {
+            if (prevBlock->AddressRanges()[k] == addressRanges[j])
+            {
+                mayRestore = prevBlock->AddressMasks()[k] == addressMasks[j];
+                break;
+            }
+        }
+    }
+
+    if (!mayRestore)
     {
-        delete it->second;
-        it->second = block;
+        FreeJitBlock(prevBlock);
+        return NULL;
+    }
+    return prevBlock;
+}
+
+u32 ExitKey(u32 num, u32 addr)
+{
+    return (addr & ~0x1) | num;
+}
+
+// code in these regions can always be found at the same address,
+// jumps into memory which can be remapped (shared WRAM, VRAM, …)
+// have to go through the dispatcher
+bool MayLinkTo(JitBlock* block)
+{
+    switch (block->StartAddrLocal >> 27)
+    {
+    case ARMJIT_Memory::memregion_ITCM:
+    case ARMJIT_Memory::memregion_MainRAM:
+    case ARMJIT_Memory::memregion_BIOS9:
+    case ARMJIT_Memory::memregion_BIOS7:
+        return true;
+    case ARMJIT_Memory::memregion_WRAM7:
+        // below that it can be replaced by shared WRAM
+        return block->StartAddr >= 0x03800000;
+    default:
+        return false;
+    }
+}
+
+// the block the exit should lead to right now, if there's any
+JitBlock* FindLinkTarget(JitBlock* block, int exit)
+{
+    u32 addr = block->Exits[exit].Addr & ~0x1;
+    JitBlock* target = (block->Num == 0 ? JitBlocks9 : JitBlocks7).Find(addr);
+    if (target && target->Thumb == (block->Exits[exit].Addr & 0x1) && MayLinkTo(target)
+        && LocaliseCodeAddress(block->Num, addr) == target->StartAddrLocal)
+        return target;
+    return NULL;
+}
+
+void LinkBlockExit(JitBlock* block, int exit, JitBlock* target)
+{
+    u8* jump = (u8*)block->EntryPoint + block->Exits[exit].Offset;
+    JITCompiler->LinkBlockExit(jump, target ? target->EntryPoint : NULL);
+}
+
+// links the exits of a block which was just registered,
+// as well as the exits of other blocks leading to it
+void ChainBlock(JitBlock* block)
+{
+    JitEnableWrite();
+
+    for (u32 i = 0; i < block->NumExits; i++)
+    {
+        u32 key = ExitKey(block->Num, block->Exits[i].Addr);
+        TinyVector<JitBlock*>* sources = BlocksExitingTo.Find(key);
+        if (!sources)
+        {
+            sources = new TinyVector<JitBlock*>();
+            BlocksExitingTo.Insert(key, sources);
+        }
+        if (sources->Find(block) == -1)
+            sources->Add(block);
+
+        JitBlock* target = FindLinkTarget(block, i);
+        if (target)
+            LinkBlockExit(block, i, target);
+    }
+
+    TinyVector<JitBlock*>* sources = BlocksExitingTo.Find(ExitKey(block->Num, block->StartAddr));
+    for (int i = 0; sources && i < sources->Length; i++)
+    {
+        JitBlock* source = (*sources)[i];
+        for (u32 j = 0; j < source->NumExits; j++)
+        {
+            if ((source->Exits[j].Addr & ~0x1) == block->StartAddr && FindLinkTarget(source, j) == block)
+                LinkBlockExit(source, j, block);
+        }
+    }
+
+    JitEnableExecute();
+}
+
+// has to be called once a block isn't registered anymore. Its own exits
+// are unlinked as well, it might be restored after the blocks they lead to are gone
+void UnchainBlock(JitBlock* block)
+{
+    JitEnableWrite();
+
+    for (u32 i = 0; i < block->NumExits; i++)
+    {
+        u32 key = ExitKey(block->Num, block->Exits[i].Addr);
+        TinyVector<JitBlock*>* sources = BlocksExitingTo.Find(key);
+        if (sources && sources->RemoveByValue(block) && sources->Length == 0)
+        {
+            BlocksExitingTo.Remove(key);
+            delete sources;
+        }
+
+        LinkBlockExit(block, i, NULL);
+    }
+
+    TinyVector<JitBlock*>* sources = BlocksExitingTo.Find(ExitKey(block->Num, block->StartAddr));
+    for (int i = 0; sources && i < sources->Length; i++)
+    {
+        JitBlock* source = (*sources)[i];
+        for (u32 j = 0; j < source->NumExits; j++)
+        {
+            if ((source->Exits[j].Addr & ~0x1) == block->StartAddr)
+                LinkBlockExit(source, j, NULL);
+        }
+    }
+
+    JitEnableExecute();
+}
+
+void RelinkBlocks()
+{
+    JitEnableWrite();
+
+    for (u32 i = 0; i < BlocksExitingTo.NumSlots(); i++)
+    {
+        TinyVector<JitBlock*>* sources = BlocksExitingTo.ValueAt(i);
+        for (int j = 0; sources && j < sources->Length; j++)
+        {
+            JitBlock* source = (*sources)[j];
+            for (u32 k = 0; k < source->NumExits; k++)
+                LinkBlockExit(source, k, FindLinkTarget(source, k));
+        }
+    }
+
+    JitEnableExecute();
+}
+
+void RegisterBlock(ARM* cpu, JitBlock* block, u32 blockAddr, u32 localAddr)
+{
+    assert((localAddr & 1) == 0);
+    for (u32 j = 0; j < block->NumAddresses; j++)
+    {
+        u32 addr = block->AddressRanges()[j];
+        AddressRange* region = CodeMemRegions[addr >> 27];
+
+        if (!PageContainsCode(&region[(addr & 0x7FFF000) / 512]))
+            ARMJIT_Memory::SetCodeProtection(addr >> 27, addr & 0x7FFFFFF, true);
+
+        AddressRange* range = &region[(addr & 0x7FFFFFF) / 512];
+        range->Code |= block->AddressMasks()[j];
+        range->Blocks.Add(block);
+    }
+
+    if (cpu->Num == 0)
+        JitBlocks9.Insert(blockAddr, block);
+    else
+        JitBlocks7.Insert(blockAddr, block);
+
+    u64* entry = &FastBlockLookupRegions[(localAddr >> 27)][(localAddr & 0x7FFFFFF) / 2];
+    *entry = ((u64)blockAddr | cpu->Num) << 32;
+    *entry |= JITCompiler->SubEntryOffset(block->EntryPoint);
+
+    ChainBlock(block);
+}
+
+// reads memory the way the slow memory path does, so without
+// touching any of the timing state of the CPU
+u32 PeekMemory(ARM* cpu, u32 addr, bool halfword)
+{
+    if (cpu->Num == 0)
+    {
+        ARMv5* cpu9 = (ARMv5*)cpu;
+        if (NDS::ConsoleType == 0)
+            return halfword ? SlowRead9<u16, 0>(addr, cpu9) : SlowRead9<u32, 0>(addr, cpu9);
+        else
+            return halfword ? SlowRead9<u16, 1>(addr, cpu9) : SlowRead9<u32, 1>(addr, cpu9);
     }
     else
     {
-        RestoreCandidates[block->InstrHash] = block;
+        if (NDS::ConsoleType == 0)
+            return halfword ? SlowRead7<u16, 0>(addr) : SlowRead7<u32, 0>(addr);
+        else
+            return halfword ? SlowRead7<u16, 1>(addr) : SlowRead7<u32, 1>(addr);
+    }
+}
+
+bool SourceUnchanged(ARM* cpu, bool thumb, const SourceWord* code, u32 numCode, const SourceWord* literals, u32 numLiterals)
+{
+    for (u32 j = 0; j < numCode; j++)
+    {
+        if (PeekMemory(cpu, code[j].Addr, thumb) != code[j].Value)
+            return false;
+    }
+    for (u32 j = 0; j < numLiterals; j++)
+    {
+        if (PeekMemory(cpu, literals[j].Addr, false) != literals[j].Value
+            || InvalidLiterals.Find(LocaliseCodeAddress(cpu->Num, literals[j].Addr)) != -1)
+            return false;
+    }
+    return true;
+}
+
+bool BlockCovers(JitBlock* block, u32 localAddr)
+{
+    for (u32 j = 0; j < block->NumAddresses; j++)
+    {
+        if (block->AddressRanges()[j] == (localAddr & ~0x1FF))
+            return block->AddressMasks()[j] & (1 << ((localAddr & 0x1FF) / 16));
+    }
+    return false;
+}
+
+// registers the blocks the compile thread is done with, if they
+// are still what the memory holds right now
+void InstallCompiledBlocks()
+{
+    if (!JobsFinished.exchange(false))
+        return;
+
+    std::vector<CompileJob*> jobs;
+    Platform::Mutex_Lock(CompileJobsLock);
+    jobs.swap(FinishedJobs);
+    Platform::Mutex_Unlock(CompileJobsLock);
+
+    for (CompileJob* job : jobs)
+    {
+        JitBlock* block = job->Block;
+        ARM* cpu = job->CPU;
+        PendingBlocks.erase(PendingBlockKey(cpu->Num, block->StartAddr));
+
+        auto& map = cpu->Num == 0 ? JitBlocks9 : JitBlocks7;
+        // a job might have been compiled right before the code cache was reset
+        bool valid = job->Generation == CompileGeneration
+            && block->EntryPoint
+            && !map.Find(block->StartAddr)
+            && LocaliseCodeAddress(cpu->Num, block->StartAddr) == block->StartAddrLocal
+            && SourceUnchanged(cpu, job->Thumb, job->Code.data(), job->Code.size(),
+                job->Literals.data(), job->Literals.size());
+        for (u32 j = 0; j < job->Code.size() && valid; j++)
+            valid = BlockCovers(block, LocaliseCodeAddress(cpu->Num, job->Code[j].Addr));
+        for (u32 j = 0; j < job->Literals.size() && valid; j++)
+            valid = BlockCovers(block, LocaliseCodeAddress(cpu->Num, job->Literals[j].Addr));
+        // the memory might have been mapped differently in the meantime
+        for (u32 j = 0; j < job->Instrs.size() && valid; j++)
+            valid = ClassifyDataRegion(cpu->Num, job->Instrs[j].DataRegion) == job->Instrs[j].DataRegionType;
+
+        if (valid)
+        {
+            RegisterBlock(cpu, block, block->StartAddr, block->StartAddrLocal);
+            delete job;
+        }
+        else
+        {
+            DeleteCompileJob(job);
+        }
+    }
+
+#ifdef __aarch64__
+    // the code was written by another core
+    __asm__ volatile("isb" ::: "memory");
+#endif
+
+    if (CompileThreadOutOfSpace)
+    {
+        Platform::Mutex_Lock(CompilerLock);
+        JITCompiler->NextCodeRegion();
+        CompileThreadOutOfSpace = false;
+        Platform::Mutex_Unlock(CompilerLock);
+    }
+}
+
+// compiles the block right away or hands it to the compile thread. In the latter
+// case false is returned, the block will be registered once it's done
+bool CompileOrQueueBlock(ARM* cpu, JitBlock* block, bool thumb, FetchedInstr instrs[], int instrsCount, bool hasMemoryInstr,
+    const SourceWord* code, u32 numCode, const SourceWord* literals, u32 numLiterals)
+{
+    if (!CompileThread)
+    {
+        if (JITCompiler->CodeRegionFull())
+            JITCompiler->NextCodeRegion();
+
+        CompileJitBlock(cpu, block, thumb, instrs, instrsCount, hasMemoryInstr);
+        return true;
+    }
+
+    block->EntryPoint = NULL;
+
+    CompileJob* job = new CompileJob();
+    job->CPU = cpu;
+    job->Block = block;
+    job->Thumb = thumb;
+    job->HasMemoryInstr = hasMemoryInstr;
+    job->Generation = CompileGeneration;
+    job->Instrs.assign(instrs, instrs + instrsCount);
+    job->Code.assign(code, code + numCode);
+    job->Literals.assign(literals, literals + numLiterals);
+
+    PendingBlocks.insert(PendingBlockKey(cpu->Num, block->StartAddr));
+
+    Platform::Mutex_Lock(CompileJobsLock);
+    QueuedJobs.push_back(job);
+    Platform::Mutex_Unlock(CompileJobsLock);
+    Platform::Semaphore_Post(CompileJobsPending);
+
+    return false;
+}
+
+bool CompileCachedBlock(ARM* cpu, bool thumb, u32 blockAddr, u32 localAddr)
+{
+    if (CompileThread && PendingBlocks.count(PendingBlockKey(cpu->Num, blockAddr)))
+        return false;
+
+    ARMJIT_DiskCache::Open();
+
+    const ARMJIT_DiskCache::CachedBlock* cached = ARMJIT_DiskCache::Find(cpu->Num, blockAddr);
+    for (; cached; cached = ARMJIT_DiskCache::FindOlder(cached))
+    {
+        if (cached->Thumb != thumb || cached->NumInstrs > MaxBlockSize)
+            continue;
+
+        const SourceWord* code = cached->Code();
+        const SourceWord* literals = cached->Literals();
+
+        if (!SourceUnchanged(cpu, thumb, code, cached->NumCode, literals, cached->NumLiterals))
+            continue;
+
+        bool valid = true;
+
+        // the memory might be mapped differently now
+        // the counts were checked against MaxBlockSize when the cache was loaded
+        u32 numWords = cached->NumCode + cached->NumLiterals;
+        u32 addressRanges[MaxBlockSizeLimit * 2];
+        u32 addressMasks[MaxBlockSizeLimit * 2];
+        u32 numAddressRanges = 0;
+        u32 literalLoadAddrs[MaxBlockSizeLimit];
+        for (u32 j = 0; j < numWords && valid; j++)
+        {
+            // code and literals are next to each other
+            u32 translatedAddr = LocaliseCodeAddress(cpu->Num, code[j].Addr);
+            if (!translatedAddr)
+            {
+                valid = false;
+                break;
+            }
+            if (j >= cached->NumCode)
+                literalLoadAddrs[j - cached->NumCode] = translatedAddr;
+
+            u32 k = 0;
+            while (k < numAddressRanges && addressRanges[k] != (translatedAddr & ~0x1FF))
+                k++;
+            if (k == numAddressRanges)
+            {
+                addressRanges[numAddressRanges] = translatedAddr & ~0x1FF;
+                addressMasks[numAddressRanges++] = 0;
+            }
+            addressMasks[k] |= 1 << ((translatedAddr & 0x1FF) / 16);
+        }
+        if (!valid)
+            continue;
+
+        if (numAddressRanges * 2 + cached->NumLiterals > MaxBlockDataWords)
+            continue;
+
+        JitBlock* block = TakeRestoreCandidate(cached->InstrHash, cached->LiteralHash, blockAddr,
+            addressRanges, addressMasks, numAddressRanges);
+        if (block)
+        {
+            RegisterBlock(cpu, block, blockAddr, localAddr);
+            return true;
+        }
+
+        block = AllocJitBlock(cpu->Num, numAddressRanges, cached->NumLiterals);
+        block->LiteralHash = cached->LiteralHash;
+        block->InstrHash = cached->InstrHash;
+        for (u32 j = 0; j < numAddressRanges; j++)
+            block->AddressRanges()[j] = addressRanges[j];
+        for (u32 j = 0; j < numAddressRanges; j++)
+            block->AddressMasks()[j] = addressMasks[j];
+        for (u32 j = 0; j < cached->NumLiterals; j++)
+            block->Literals()[j] = literalLoadAddrs[j];
+
+        block->StartAddr = blockAddr;
+        block->StartAddrLocal = localAddr;
+        block->Thumb = thumb;
+
+        // the compiler might modify them
+        FetchedInstr instrs[MaxBlockSizeLimit];
+        memcpy(instrs, cached->Instrs(), cached->NumInstrs * sizeof(FetchedInstr));
+        for (u32 j = 0; j < cached->NumInstrs; j++)
+        {
+            instrs[j].DataRegionType = ClassifyDataRegion(cpu->Num, instrs[j].DataRegion);
+            LookupCycles(cpu, thumb, instrs[j]);
+        }
+
+        PROFILE_COUNT(Counter_JITBlocksFromDisk);
+
+        // when queued the block is still interpreted this time
+        if (!CompileOrQueueBlock(cpu, block, thumb, instrs, cached->NumInstrs, cached->HasMemoryInstr,
+            code, cached->NumCode, literals, cached->NumLiterals))
+            return false;
+
+        RegisterBlock(cpu, block, blockAddr, localAddr);
+        return true;
     }
+
+    return false;
 }
 
 void CompileBlock(ARM* cpu)
 {
+    PROFILE_SCOPE(Section_JITCompile);
+
     bool thumb = cpu->CPSR & 0x20;
 
     u32 blockAddr = cpu->R[15] - (thumb ? 2 : 4);
@@ -600,48 +1407,62 @@ void CompileBlock(ARM* cpu)
         Log(LogLevel::Warn, "trying to compile non executable code? %x\n", blockAddr);
     }
 
+    if (CompileThread)
+        InstallCompiledBlocks();
+
     auto& map = cpu->Num == 0 ? JitBlocks9 : JitBlocks7;
-    auto existingBlockIt = map.find(blockAddr);
-    if (existingBlockIt != map.end())
+    JitBlock* existingBlock = map.Find(blockAddr);
+    if (existingBlock)
     {
         // there's already a block, though it's not inside the fast map
         // could be that there are two blocks at the same physical addr
         // but different mirrors
-        u32 otherLocalAddr = existingBlockIt->second->StartAddrLocal;
+        u32 otherLocalAddr = existingBlock->StartAddrLocal;
 
         if (localAddr == otherLocalAddr)
         {
-            JIT_DEBUGPRINT("switching out block %x %x %x\n", localAddr, blockAddr, existingBlockIt->second->StartAddr);
+            JIT_DEBUGPRINT("switching out block %x %x %x\n", localAddr, blockAddr, existingBlock->StartAddr);
 
             u64* entry = &FastBlockLookupRegions[localAddr >> 27][(localAddr & 0x7FFFFFF) / 2];
             *entry = ((u64)blockAddr | cpu->Num) << 32;
-            *entry |= JITCompiler->SubEntryOffset(existingBlockIt->second->EntryPoint);
+            *entry |= JITCompiler->SubEntryOffset(existingBlock->EntryPoint);
             return;
         }
 
         // some memory has been remapped
-        RetireJitBlock(existingBlockIt->second);
-        map.erase(existingBlockIt);
+        map.Remove(blockAddr);
+        UnchainBlock(existingBlock);
+        UnlinkJitBlock(existingBlock);
+        FastBlockLookupRegions[otherLocalAddr >> 27][(otherLocalAddr & 0x7FFFFFF) / 2] = (u64)UINT32_MAX << 32;
+        RetireJitBlock(existingBlock);
     }
 
-    FetchedInstr instrs[MaxBlockSize];
+    // the block will be run from the next lookup on, this time
+    // around nothing is executed (unless it's compiled on the compile thread)
+    if (DiskCache && localAddr && CompileCachedBlock(cpu, thumb, blockAddr, localAddr))
+        return;
+
+    FetchedInstr instrs[MaxBlockSizeLimit];
     int i = 0;
     u32 r15 = cpu->R[15];
 
-    u32 addressRanges[MaxBlockSize];
-    u32 addressMasks[MaxBlockSize];
+    u32 addressRanges[MaxBlockSizeLimit];
+    u32 addressMasks[MaxBlockSizeLimit];
     memset(addressMasks, 0, MaxBlockSize * sizeof(u32));
     u32 numAddressRanges = 0;
 
     u32 numLiterals = 0;
-    u32 literalLoadAddrs[MaxBlockSize];
+    u32 literalLoadAddrs[MaxBlockSizeLimit];
     // they are going to be hashed
-    u32 literalValues[MaxBlockSize];
-    u32 instrValues[MaxBlockSize];
+    u32 literalValues[MaxBlockSizeLimit];
+    u32 instrValues[MaxBlockSizeLimit];
+    u32 instrAddrs[MaxBlockSizeLimit];
     // due to instruction merging i might not reflect the amount of actual instructions
     u32 numInstrs = 0;
+    u32 literalRawAddrs[MaxBlockSizeLimit];
+    u32 literalInstrs[MaxBlockSizeLimit];
 
-    u32 writeAddrs[MaxBlockSize];
+    u32 writeAddrs[MaxBlockSizeLimit];
     u32 numWriteAddrs = 0, writeAddrsTranslated = 0;
 
     cpu->FillPipeline();
@@ -670,6 +1491,7 @@ void CompileBlock(ARM* cpu)
         nextInstrAddr[1] = r15;
         JIT_DEBUGPRINT("instr %08x %x\n", instrs[i].Instr & (thumb ? 0xFFFF : ~0), instrs[i].Addr);
 
+        instrAddrs[numInstrs] = instrs[i].Addr;
         instrValues[numInstrs++] = instrs[i].Instr;
 
         u32 translatedAddr = LocaliseCodeAddress(cpu->Num, instrs[i].Addr);
@@ -758,8 +1580,10 @@ void CompileBlock(ARM* cpu)
 
         instrs[i].DataCycles = cpu->DataCycles;
         instrs[i].DataRegion = cpu->DataRegion;
+        instrs[i].DataRegionType = ClassifyDataRegion(cpu->Num, cpu->DataRegion);
 
         u32 literalAddr;
+        bool isLiteral = false;
         if (LiteralOptimizations
             && instrs[i].Info.SpecialKind == ARMInstrInfo::special_LoadLiteral
             && DecodeLiteral(thumb, instrs[i], literalAddr))
@@ -782,7 +1606,11 @@ void CompileBlock(ARM* cpu)
                 addressMasks[j] |= 1 << ((translatedAddr & 0x1FF) / 16);
                 JIT_DEBUGPRINT("literal loading %08x %08x %08x %08x\n", literalAddr, translatedAddr, addressMasks[j], addressRanges[j]);
                 cpu->DataRead32(literalAddr, &literalValues[numLiterals]);
+                instrs[i].LiteralValue = literalValues[numLiterals];
+                literalRawAddrs[numLiterals] = literalAddr & ~0x3;
+                literalInstrs[numLiterals] = i;
                 literalLoadAddrs[numLiterals++] = translatedAddr;
+                isLiteral = true;
             }
         }
         else if (instrs[i].Info.SpecialKind == ARMInstrInfo::special_WriteMem)
@@ -799,6 +1627,12 @@ void CompileBlock(ARM* cpu)
             JIT_DEBUGPRINT("merged BL\n");
         }
 
+        // the compiler may only assume the literals we keep track of to stay the same
+        if (!isLiteral && instrs[i].Info.SpecialKind == ARMInstrInfo::special_LoadLiteral)
+            instrs[i].Info.SpecialKind = ARMInstrInfo::special_LoadMem;
+
+        LookupCycles(cpu, thumb, instrs[i]);
+
         if (instrs[i].Info.Branches() && BranchOptimizations
             && instrs[i].Info.Kind != (thumb ? ARMInstrInfo::tk_SVC : ARMInstrInfo::ak_SVC))
         {
@@ -893,53 +1727,25 @@ void CompileBlock(ARM* cpu)
                     {
                         if (InvalidLiterals.Find(translatedAddr) == -1)
                             InvalidLiterals.Add(translatedAddr);
-                        break;
+                        instrs[literalInstrs[k]].Info.SpecialKind = ARMInstrInfo::special_LoadMem;
                     }
                 }
             }
         }
     }
 
+    // it's still being compiled, so interpreting it was everything for this time
+    if (CompileThread && PendingBlocks.count(PendingBlockKey(cpu->Num, blockAddr)))
+        return;
+
     u32 literalHash = (u32)XXH3_64bits(literalValues, numLiterals * 4);
     u32 instrHash = (u32)XXH3_64bits(instrValues, numInstrs * 4);
 
-    auto prevBlockIt = RestoreCandidates.find(instrHash);
-    JitBlock* prevBlock = NULL;
-    bool mayRestore = true;
-    if (prevBlockIt != RestoreCandidates.end())
-    {
-        prevBlock = prevBlockIt->second;
-        RestoreCandidates.erase(prevBlockIt);
-
-        mayRestore = prevBlock->StartAddr == blockAddr && prevBlock->LiteralHash == literalHash;
-
-        if (mayRestore && prevBlock->NumAddresses == numAddressRanges)
-        {
-            for (u32 j = 0; j < numAddressRanges; j++)
-            {
-                if (prevBlock->AddressRanges()[j] != addressRanges[j]
-                    || prevBlock->AddressMasks()[j] != addressMasks[j])
-                {
-                    mayRestore = false;
-                    break;
-                }
-            }
-        }
-        else
-            mayRestore = false;
-    }
-    else
-    {
-        mayRestore = false;
-    }
-
-    JitBlock* block;
-    if (!mayRestore)
+    JitBlock* block = TakeRestoreCandidate(instrHash, literalHash, blockAddr,
+        addressRanges, addressMasks, numAddressRanges);
+    if (!block)
     {
-        if (prevBlock)
-            delete prevBlock;
-
-        block = new JitBlock(cpu->Num, i, numAddressRanges, numLiterals);
+        block = AllocJitBlock(cpu->Num, numAddressRanges, numLiterals);
         block->LiteralHash = literalHash;
         block->InstrHash = instrHash;
         for (u32 j = 0; j < numAddressRanges; j++)
@@ -951,52 +1757,142 @@ void CompileBlock(ARM* cpu)
 
         block->StartAddr = blockAddr;
         block->StartAddrLocal = localAddr;
+        block->Thumb = thumb;
 
         FloodFillSetFlags(instrs, i - 1, 0xF);
 
-        JitEnableWrite();
-        block->EntryPoint = JITCompiler->CompileBlock(cpu, thumb, instrs, i, hasMemoryInstr);
-        JitEnableExecute();
+        SourceWord code[MaxBlockSizeLimit];
+        for (u32 j = 0; j < numInstrs; j++)
+            code[j] = {instrAddrs[j], thumb ? (instrValues[j] & 0xFFFF) : instrValues[j]};
+        SourceWord literals[MaxBlockSizeLimit];
+        for (u32 j = 0; j < numLiterals; j++)
+            literals[j] = {literalRawAddrs[j], literalValues[j]};
+
+        if (DiskCache)
+        {
+            ARMJIT_DiskCache::CachedBlock cached;
+            cached.StartAddr = blockAddr;
+            cached.InstrHash = instrHash;
+            cached.LiteralHash = literalHash;
+            cached.Num = cpu->Num;
+            cached.Thumb = thumb;
+            cached.HasMemoryInstr = hasMemoryInstr;
+            cached.NumInstrs = i;
+            cached.NumCode = numInstrs;
+            cached.NumLiterals = numLiterals;
+            cached.Padding = 0;
+
+            ARMJIT_DiskCache::Add(cached, instrs, code, literals);
+        }
+
+        if (!CompileOrQueueBlock(cpu, block, thumb, instrs, i, hasMemoryInstr,
+            code, numInstrs, literals, numLiterals))
+            return;
 
         JIT_DEBUGPRINT("block start %p\n", block->EntryPoint);
     }
     else
     {
-        JIT_DEBUGPRINT("restored! %p\n", prevBlock);
-        block = prevBlock;
+        JIT_DEBUGPRINT("restored! %p\n", block);
     }
 
-    assert((localAddr & 1) == 0);
     for (u32 j = 0; j < numAddressRanges; j++)
-    {
-        assert(addressRanges[j] == block->AddressRanges()[j]);
-        assert(addressMasks[j] == block->AddressMasks()[j]);
         assert(addressMasks[j] != 0);
 
-        AddressRange* region = CodeMemRegions[addressRanges[j] >> 27];
+    RegisterBlock(cpu, block, blockAddr, localAddr);
+}
 
-        if (!PageContainsCode(&region[(addressRanges[j] & 0x7FFF000) / 512]))
-            ARMJIT_Memory::SetCodeProtection(addressRanges[j] >> 27, addressRanges[j] & 0x7FFFFFF, true);
+void UnlinkJitBlock(JitBlock* block)
+{
+    for (int j = 0; j < block->NumAddresses; j++)
+    {
+        u32 addr = block->AddressRanges()[j];
+        AddressRange* region = CodeMemRegions[addr >> 27];
+        AddressRange* range = &region[(addr & 0x7FFFFFF) / 512];
 
-        AddressRange* range = &region[(addressRanges[j] & 0x7FFFFFF) / 512];
-        range->Code |= addressMasks[j];
-        range->Blocks.Add(block);
+        bool removed = range->Blocks.RemoveByValue(block);
+        assert(removed);
+
+        // the remaining blocks might still cover some of the same code
+        range->Code = 0;
+        for (int k = 0; k < range->Blocks.Length; k++)
+        {
+            JitBlock* other = range->Blocks[k];
+            for (int l = 0; l < other->NumAddresses; l++)
+            {
+                if (other->AddressRanges()[l] == addr)
+                {
+                    range->Code |= other->AddressMasks()[l];
+                    break;
+                }
+            }
+        }
+
+        if (range->Blocks.Length == 0
+            && !PageContainsCode(&region[(addr & 0x7FFF000) / 512]))
+        {
+            ARMJIT_Memory::SetCodeProtection(addr >> 27, addr & 0x7FFFFFF, false);
+        }
     }
+}
 
-    if (cpu->Num == 0)
-        JitBlocks9[blockAddr] = block;
-    else
-        JitBlocks7[blockAddr] = block;
+void EvictCodeRange(u8* start, u8* end)
+{
+    u32 evicted = 0;
 
-    u64* entry = &FastBlockLookupRegions[(localAddr >> 27)][(localAddr & 0x7FFFFFF) / 2];
-    *entry = ((u64)blockAddr | cpu->Num) << 32;
-    *entry |= JITCompiler->SubEntryOffset(block->EntryPoint);
+    for (int num = 0; num < 2; num++)
+    {
+        auto& map = num == 0 ? JitBlocks9 : JitBlocks7;
+        for (u32 i = 0; i < map.NumSlots();)
+        {
+            JitBlock* block = map.ValueAt(i);
+            if (!block || (u8*)block->EntryPoint < start || (u8*)block->EntryPoint >= end)
+            {
+                i++;
+                continue;
+            }
+
+            UnlinkJitBlock(block);
+            FastBlockLookupRegions[block->StartAddrLocal >> 27][(block->StartAddrLocal & 0x7FFFFFF) / 2] = (u64)UINT32_MAX << 32;
+
+            map.RemoveAt(i);
+            UnchainBlock(block);
+            FreeJitBlock(block);
+            evicted++;
+        }
+    }
+
+    // retired blocks can't be restored once their code is gone
+    for (u32 i = 0; i < RestoreCandidates.NumSlots();)
+    {
+        JitBlock* block = RestoreCandidates.ValueAt(i);
+        if (block && (u8*)block->EntryPoint >= start && (u8*)block->EntryPoint < end)
+        {
+            RestoreCandidates.RemoveAt(i);
+            FreeJitBlock(block);
+        }
+        else
+            i++;
+    }
+
+    if (evicted)
+    {
+        JIT_DEBUGPRINT("evicted %d blocks\n", evicted);
+        PROFILE_COUNT(Counter_JITCacheEvictions);
+        PROFILE_ADD(Counter_JITBlocksEvicted, evicted);
+    }
 }
 
 void InvalidateByAddr(u32 localAddr)
 {
+    PROFILE_SCOPE(Section_JITInvalidate);
+    PROFILE_COUNT(Counter_JITInvalidations);
+
     JIT_DEBUGPRINT("invalidating by addr %x\n", localAddr);
 
+    if (ARMJIT_Profiler::Enabled)
+        ARMJIT_Profiler::RangeInvalidated(localAddr);
+
     AddressRange* region = CodeMemRegions[localAddr >> 27];
     AddressRange* range = &region[(localAddr & 0x7FFFFFF) / 512];
     u32 mask = 1 << ((localAddr & 0x1FF) / 16);
@@ -1072,9 +1968,10 @@ void InvalidateByAddr(u32 localAddr)
 
         FastBlockLookupRegions[block->StartAddrLocal >> 27][(block->StartAddrLocal & 0x7FFFFFF) / 2] = (u64)UINT32_MAX << 32;
         if (block->Num == 0)
-            JitBlocks9.erase(block->StartAddr);
+            JitBlocks9.Remove(block->StartAddr);
         else
-            JitBlocks7.erase(block->StartAddr);
+            JitBlocks7.Remove(block->StartAddr);
+        UnchainBlock(block);
 
         if (!literalInvalidation)
         {
@@ -1082,7 +1979,7 @@ void InvalidateByAddr(u32 localAddr)
         }
         else
         {
-            delete block;
+            FreeJitBlock(block);
         }
     }
 }
@@ -1179,6 +2076,9 @@ template void CheckAndInvalidate<1, ARMJIT_Memory::memregion_NewSharedWRAM_C>(u3
 void ResetBlockCache()
 {
     Log(LogLevel::Debug, "Resetting JIT block cache...\n");
+    PROFILE_COUNT(Counter_JITCacheFlushes);
+
+    CancelCompileJobs();
 
     // could be replace through a function which only resets
     // the permissions but we're too lazy
@@ -1190,39 +2090,45 @@ void ResetBlockCache()
         if (FastBlockLookupRegions[i])
             memset(FastBlockLookupRegions[i], 0xFF, CodeRegionSizes[i] * sizeof(u64) / 2);
     }
-    for (auto it = RestoreCandidates.begin(); it != RestoreCandidates.end(); it++)
-        delete it->second;
-    RestoreCandidates.clear();
-    for (auto it : JitBlocks9)
+    for (u32 i = 0; i < RestoreCandidates.NumSlots(); i++)
     {
-        JitBlock* block = it.second;
-        for (int j = 0; j < block->NumAddresses; j++)
-        {
-            u32 addr = block->AddressRanges()[j];
-            AddressRange* range = &CodeMemRegions[addr >> 27][(addr & 0x7FFFFFF) / 512];
-            range->Blocks.Clear();
-            range->Code = 0;
-        }
-        delete block;
+        if (RestoreCandidates.ValueAt(i))
+            FreeJitBlock(RestoreCandidates.ValueAt(i));
     }
-    for (auto it : JitBlocks7)
+    RestoreCandidates.Clear();
+    for (int num = 0; num < 2; num++)
     {
-        JitBlock* block = it.second;
-        for (int j = 0; j < block->NumAddresses; j++)
+        auto& map = num == 0 ? JitBlocks9 : JitBlocks7;
+        for (u32 i = 0; i < map.NumSlots(); i++)
         {
-            u32 addr = block->AddressRanges()[j];
-            AddressRange* range = &CodeMemRegions[addr >> 27][(addr & 0x7FFFFFF) / 512];
-            range->Blocks.Clear();
-            range->Code = 0;
+            JitBlock* block = map.ValueAt(i);
+            if (!block)
+                continue;
+            for (int j = 0; j < block->NumAddresses; j++)
+            {
+                u32 addr = block->AddressRanges()[j];
+                AddressRange* range = &CodeMemRegions[addr >> 27][(addr & 0x7FFFFFF) / 512];
+                range->Blocks.Clear();
+                range->Code = 0;
+            }
+            FreeJitBlock(block);
         }
-        delete block;
+        map.Clear();
     }
-    JitBlocks9.clear();
-    JitBlocks7.clear();
+    for (u32 i = 0; i < BlocksExitingTo.NumSlots(); i++)
+        delete BlocksExitingTo.ValueAt(i);
+    BlocksExitingTo.Clear();
 
     JITCompiler->Reset();
 }
 
+void GetCodeCacheUsage(u32& used, u32& size)
+{
+    LockCompiler();
+    JITCompiler->GetCodeCacheUsage(used, size);
+    UnlockCompiler();
+}
+
 void JitEnableWrite()
 {
     #if defined(__APPLE__) && defined(__aarch64__)
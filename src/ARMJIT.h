@@ -37,6 +37,7 @@ extern int MaxBlockSize;
 extern bool LiteralOptimizations;
 extern bool BranchOptimizations;
 extern bool FastMemory;
+extern u32 CodeCacheSize;
 
 void Init();
 void DeInit();
@@ -55,6 +56,13 @@ void CompileBlock(ARM* cpu);
 
 void ResetBlockCache();
 
+// the ITCM was moved or resized, the blocks linked
+// to each other might lead somewhere else now
+void RelinkBlocks();
+
+// how much of the code cache is currently filled with compiled blocks, in bytes
+void GetCodeCacheUsage(u32& used, u32& size);
+
 JitBlockEntry LookUpBlock(u32 num, u64* entries, u32 offset, u32 addr);
 bool SetupExecutableRegion(u32 num, u32 blockAddr, u64*& entry, u32& start, u32& size);
 
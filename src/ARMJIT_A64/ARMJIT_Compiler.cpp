@@ -695,24 +695,95 @@ void Compiler::Comp_BranchSpecialBehaviour(bool taken)
 
         if (ConstantCycles)
             ADD(RCycles, RCycles, ConstantCycles);
-        QuickTailCall(X0, ARM_Ret);
+
+        u32 next = taken ? ExitTarget : (CurInstr.Addr + (Thumb ? 2 : 4)) | Thumb;
+        Comp_BlockExit(&next, taken && !HasExitTarget ? 0 : 1);
     }
 }
 
-JitBlockEntry Compiler::CompileBlock(ARM* cpu, bool thumb, FetchedInstr instrs[], int instrsCount, bool hasMemInstr)
+/*
+    Instead of going back to the dispatcher after every block, a block can
+    continue with the next one right away, if it's known where it leads to
+    (the next block in memory or the target of a branch). The jumps are emitted
+    here, as nops falling through to ARM_Ret at first, and are linked to
+    the next block once it's compiled (see ChainBlock in ARMJIT.cpp).
+
+    Everything the dispatcher loop does between blocks has to be done here
+    as well, so the cycles are added to the timestamp and it's checked
+    whether we need to stop.
+*/
+void Compiler::Comp_BlockExit(const u32* next, int numNext)
 {
-    if (JitMemMainSize - GetCodeOffset() < 1024 * 16)
+    if (numNext == 0 || NumExits + numNext > MaxBlockExits)
     {
-        Log(LogLevel::Debug, "JIT near memory full, resetting...\n");
-        ResetBlockCache();
+        QuickTailCall(X0, ARM_Ret);
+        return;
     }
-    if ((JitMemMainSize +  JitMemSecondarySize) - OtherCodeRegion < 1024 * 8)
+
+    LDR(INDEX_UNSIGNED, W0, RCPU, offsetof(ARM, StopExecution));
+    FixupBranch stop = CBNZ(W0);
+
+    MOVP2R(X1, Num == 0 ? &NDS::ARM9Timestamp : &NDS::ARM7Timestamp);
+    LDR(INDEX_UNSIGNED, X0, X1, 0);
+    SXTW(X2, RCycles);
+    ADD(X0, X0, X2);
+    STR(INDEX_UNSIGNED, X0, X1, 0);
+    MOVI2R(RCycles, 0);
+    MOVP2R(X1, Num == 0 ? &NDS::ARM9Target : &NDS::ARM7Target);
+    LDR(INDEX_UNSIGNED, X1, X1, 0);
+    CMP(X0, X1);
+    FixupBranch timeUp = B(CC_HS);
+
+    for (int i = 0; i < numNext; i++)
     {
-        Log(LogLevel::Debug, "JIT far memory full, resetting...\n");
-        ResetBlockCache();
+        bool thumb = next[i] & 0x1;
+        u32 addr = next[i] & ~0x1;
+
+        // the interpreter might have gone somewhere else
+        LDR(INDEX_UNSIGNED, W0, RCPU, offsetof(ARM, R[15]));
+        MOVI2R(W1, addr + (thumb ? 2 : 4));
+        CMP(W0, W1);
+        FixupBranch otherAddr = B(CC_NEQ);
+        FixupBranch otherMode = thumb ? TBZ(RCPSR, 5) : TBNZ(RCPSR, 5);
+
+        Exits[NumExits].Addr = next[i];
+        Exits[NumExits].Offset = (u8*)GetRXPtr() - BlockStart;
+        NumExits++;
+        HINT(HINT_NOP);
+        QuickTailCall(X0, ARM_Ret);
+
+        SetJumpTarget(otherAddr);
+        SetJumpTarget(otherMode);
     }
 
+    SetJumpTarget(stop);
+    SetJumpTarget(timeUp);
+    QuickTailCall(X0, ARM_Ret);
+}
+
+void Compiler::LinkBlockExit(u8* exit, JitBlockEntry target)
+{
+    // the compile thread might be using the emitter right now
+    ARM64XEmitter emitter(GetRWBase(), GetRXBase(), exit - GetRXBase());
+    if (target)
+        emitter.B((const void*)target);
+    else
+        emitter.HINT(HINT_NOP);
+    FlushIcacheSection(exit, exit + 4);
+}
+
+bool Compiler::CodeRegionFull()
+{
+    ptrdiff_t nearEnd = (CurCodeRegion + 1) * CodeRegionNearSize;
+    ptrdiff_t farEnd = JitMemMainSize + (CurCodeRegion + 1) * CodeRegionFarSize;
+    return nearEnd - GetCodeOffset() < 1024 * 16 || farEnd - OtherCodeRegion < 1024 * 8;
+}
+
+JitBlockEntry Compiler::CompileBlock(ARM* cpu, bool thumb, FetchedInstr instrs[], int instrsCount, bool hasMemInstr)
+{
     JitBlockEntry res = (JitBlockEntry)GetRXPtr();
+    BlockStart = (u8*)GetRXPtr();
+    NumExits = 0;
 
     Thumb = thumb;
     Num = cpu->Num;
@@ -721,6 +792,14 @@ JitBlockEntry Compiler::CompileBlock(ARM* cpu, bool thumb, FetchedInstr instrs[]
     RegCache = RegisterCache<Compiler, ARM64Reg>(this, instrs, instrsCount, true);
     CPSRDirty = false;
 
+    if (ExecutionCounter)
+    {
+        MOVP2R(X0, ExecutionCounter);
+        LDR(INDEX_UNSIGNED, X1, X0, 0);
+        ADD(X1, X1, 1);
+        STR(INDEX_UNSIGNED, X1, X0, 0);
+    }
+
     if (hasMemInstr)
         MOVP2R(RMemBase, Num == 0 ? ARMJIT_Memory::FastMem9Start : ARMJIT_Memory::FastMem7Start);
 
@@ -735,6 +814,7 @@ JitBlockEntry Compiler::CompileBlock(ARM* cpu, bool thumb, FetchedInstr instrs[]
             : A_Comp[CurInstr.Info.Kind];
 
         Exit = i == (instrsCount - 1) || (CurInstr.BranchFlags & branch_FollowCondNotTaken);
+        HasExitTarget = false;
 
         //printf("%x instr %x regs: r%x w%x n%x flags: %x %x %x\n", R15, CurInstr.Instr, CurInstr.Info.SrcRegs, CurInstr.Info.DstRegs, CurInstr.Info.ReadFlags, CurInstr.Info.NotStrictlyNeeded, CurInstr.Info.WriteFlags, CurInstr.SetFlags);
 
@@ -847,7 +927,17 @@ JitBlockEntry Compiler::CompileBlock(ARM* cpu, bool thumb, FetchedInstr instrs[]
 
     if (ConstantCycles)
         ADD(RCycles, RCycles, ConstantCycles);
-    QuickTailCall(X0, ARM_Ret);
+
+    u32 next[2];
+    int numNext = 0;
+    if (HasExitTarget)
+        next[numNext++] = ExitTarget;
+    bool isConditional = Thumb ? CurInstr.Info.Kind == ARMInstrInfo::tk_BCOND : CurInstr.Cond() < 0xE;
+    if (!CurInstr.Info.Branches() || isConditional)
+        next[numNext++] = (CurInstr.Addr + (Thumb ? 2 : 4)) | Thumb;
+    Comp_BlockExit(next, numNext);
+
+    BlockSize = (u8*)GetRXPtr() - BlockStart;
 
     FlushIcache();
 
@@ -858,6 +948,12 @@ void Compiler::Reset()
 {
     LoadStorePatches.clear();
 
+    CodeRegionNearSize = (std::min(JitMemMainSize, CodeCacheSize / 4 * 3) / CodeRegionsCount) & ~0x3;
+    CodeRegionFarSize = (std::min(JitMemSecondarySize, CodeCacheSize / 4) / CodeRegionsCount) & ~0x3;
+
+    CurCodeRegion = 0;
+    memset(CodeRegionUsed, 0, sizeof(CodeRegionUsed));
+
     SetCodePtr(0);
     OtherCodeRegion = JitMemMainSize;
 
@@ -867,10 +963,61 @@ void Compiler::Reset()
         *(((u32*)GetRWPtr()) + i) = brk_0;
 }
 
+void Compiler::NextCodeRegion()
+{
+    ptrdiff_t nearStart = CurCodeRegion * CodeRegionNearSize;
+    ptrdiff_t farStart = JitMemMainSize + CurCodeRegion * CodeRegionFarSize;
+    CodeRegionUsed[CurCodeRegion] = (GetCodeOffset() - nearStart) + (OtherCodeRegion - farStart);
+
+    CurCodeRegion = (CurCodeRegion + 1) % CodeRegionsCount;
+    nearStart = CurCodeRegion * CodeRegionNearSize;
+    farStart = JitMemMainSize + CurCodeRegion * CodeRegionFarSize;
+
+    Log(LogLevel::Debug, "JIT code region full, moving on to region %d\n", CurCodeRegion);
+
+    EvictCodeRange(GetRXBase() + nearStart, GetRXBase() + nearStart + CodeRegionNearSize);
+
+    for (auto it = LoadStorePatches.begin(); it != LoadStorePatches.end();)
+    {
+        if (it->first >= nearStart && it->first < nearStart + CodeRegionNearSize)
+            it = LoadStorePatches.erase(it);
+        else
+            it++;
+    }
+
+    SetCodePtr(nearStart);
+    OtherCodeRegion = farStart;
+    CodeRegionUsed[CurCodeRegion] = 0;
+
+    const u32 brk_0 = 0xD4200000;
+
+    u32* nearCode = (u32*)GetRWPtr();
+    u32* farCode = (u32*)(GetRWPtr() + (farStart - nearStart));
+    for (u32 i = 0; i < CodeRegionNearSize / 4; i++)
+        nearCode[i] = brk_0;
+    for (u32 i = 0; i < CodeRegionFarSize / 4; i++)
+        farCode[i] = brk_0;
+
+    FlushIcacheSection(GetRXBase() + nearStart, GetRXBase() + nearStart + CodeRegionNearSize);
+    FlushIcacheSection(GetRXBase() + farStart, GetRXBase() + farStart + CodeRegionFarSize);
+}
+
+void Compiler::GetCodeCacheUsage(u32& used, u32& size)
+{
+    used = (GetCodeOffset() - CurCodeRegion * CodeRegionNearSize)
+        + (OtherCodeRegion - (JitMemMainSize + CurCodeRegion * CodeRegionFarSize));
+    for (int i = 0; i < CodeRegionsCount; i++)
+    {
+        if (i != CurCodeRegion)
+            used += CodeRegionUsed[i];
+    }
+    size = (CodeRegionNearSize + CodeRegionFarSize) * CodeRegionsCount;
+}
+
 void Compiler::Comp_AddCycles_C(bool forceNonConstant)
 {
     s32 cycles = Num ?
-        NDS::ARM7MemTimings[CurInstr.CodeCycles][Thumb ? 1 : 3]
+        CurInstr.CodeCyclesS
         : ((R15 & 0x2) ? 0 : CurInstr.CodeCycles);
 
     if (forceNonConstant)
@@ -884,7 +1031,7 @@ void Compiler::Comp_AddCycles_CI(u32 numI)
     IrregularCycles = true;
 
     s32 cycles = (Num ?
-        NDS::ARM7MemTimings[CurInstr.CodeCycles][Thumb ? 0 : 2]
+        CurInstr.CodeCyclesN
         : ((R15 & 0x2) ? 0 : CurInstr.CodeCycles)) + numI;
 
     if (Thumb || CurInstr.Cond() == 0xE)
@@ -898,7 +1045,7 @@ void Compiler::Comp_AddCycles_CI(u32 c, ARM64Reg numI, ArithOption shift)
     IrregularCycles = true;
 
     s32 cycles = (Num ?
-        NDS::ARM7MemTimings[CurInstr.CodeCycles][Thumb ? 0 : 2]
+        CurInstr.CodeCyclesN
         : ((R15 & 0x2) ? 0 : CurInstr.CodeCycles)) + c;
 
     ADD(RCycles, RCycles, cycles);
@@ -918,7 +1065,7 @@ void Compiler::Comp_AddCycles_CDI()
 
         s32 cycles;
 
-        s32 numC = NDS::ARM7MemTimings[CurInstr.CodeCycles][Thumb ? 0 : 2];
+        s32 numC = CurInstr.CodeCyclesN;
         s32 numD = CurInstr.DataCycles;
 
         if ((CurInstr.DataRegion >> 24) == 0x02) // mainRAM
@@ -963,7 +1110,7 @@ void Compiler::Comp_AddCycles_CD()
     }
     else
     {
-        s32 numC = NDS::ARM7MemTimings[CurInstr.CodeCycles][Thumb ? 0 : 2];
+        s32 numC = CurInstr.CodeCyclesN;
         s32 numD = CurInstr.DataCycles;
 
         if ((CurInstr.DataRegion >> 24) == 0x02)
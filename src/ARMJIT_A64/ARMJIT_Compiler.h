@@ -111,6 +111,22 @@ public:
 
     JitBlockEntry CompileBlock(ARM* cpu, bool thumb, FetchedInstr instrs[], int instrsCount, bool hasMemInstr);
 
+    void GetCodeCacheUsage(u32& used, u32& size);
+
+    // there's no guarantee a block fits anymore, NextCodeRegion
+    // has to be called before anything else is compiled
+    bool CodeRegionFull();
+    void NextCodeRegion();
+
+    // lets the exit jump directly to the given block
+    // or back to the dispatcher if it's NULL
+    void LinkBlockExit(u8* exit, JitBlockEntry target);
+
+    // if set the next block compiled increments it whenever it's entered
+    u64* ExecutionCounter = NULL;
+    // how much code the last block took up
+    u32 BlockSize;
+
     bool CanCompile(bool thumb, u16 kind);
 
     bool FlagsNZNeeded()
@@ -222,6 +238,7 @@ public:
     void* Gen_JumpTo7(int kind);
 
     void Comp_BranchSpecialBehaviour(bool taken);
+    void Comp_BlockExit(const u32* next, int numNext);
 
     JitBlockEntry AddEntryOffset(u32 offset)
     {
@@ -260,6 +277,15 @@ public:
     u32 JitMemSecondarySize;
     u32 JitMemMainSize;
 
+    // the memory for blocks is split into a ring of regions, each with a part
+    // in main and one in secondary memory. When the current one is full we move on
+    // to the next one, evicting the blocks which were compiled into it the last time around.
+    static constexpr int CodeRegionsCount = 8;
+    int CurCodeRegion;
+    u32 CodeRegionNearSize;
+    u32 CodeRegionFarSize;
+    u32 CodeRegionUsed[CodeRegionsCount];
+
     std::unordered_map<ptrdiff_t, LoadStorePatch> LoadStorePatches; 
 
     RegisterCache<Compiler, Arm64Gen::ARM64Reg> RegCache;
@@ -268,6 +294,17 @@ public:
 
     bool IrregularCycles = false;
 
+    // the exits of the last block which was compiled
+    // which can be linked to the block they lead to
+    u32 NumExits;
+    BlockExit Exits[MaxBlockExits];
+
+    u8* BlockStart;
+    // set when the current instruction is a branch
+    // leaving the block to a known address
+    bool HasExitTarget;
+    u32 ExitTarget;
+
 #ifdef __SWITCH__
     void* JitRWBase;
     void* JitRWStart;
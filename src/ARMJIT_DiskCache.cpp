@@ -0,0 +1,385 @@
+/*
+    Copyright 2016-2022 melonDS team
+
+    This file is part of melonDS.
+
+    melonDS is free software: you can redistribute it and/or modify it under
+    the terms of the GNU General Public License as published by the Free
+    Software Foundation, either version 3 of the License, or (at your option)
+    any later version.
+
+    melonDS is distributed in the hope that it will be useful, but WITHOUT ANY
+    WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+    FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with melonDS. If not, see http://www.gnu.org/licenses/.
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include <unordered_map>
+
+#include "ARMJIT_DiskCache.h"
+#include "NDS.h"
+#include "NDSCart.h"
+#include "Platform.h"
+
+using Platform::Log;
+using Platform::LogLevel;
+
+namespace ARMJIT_DiskCache
+{
+
+using ARMJIT::FetchedInstr;
+using ARMJIT::SourceWord;
+
+const u32 FileMagic = 0x54494A4D; // MJIT
+// bump whenever FetchedInstr, CachedBlock or the block analysis changes
+const u32 FileVersion = 4;
+
+// the same address can hold different code over time (overlays)
+const u32 MaxBlocksPerAddr = 4;
+
+const u32 NoBlock = 0xFFFFFFFF;
+
+struct FileHeader
+{
+    u32 Magic;
+    u32 Version;
+    u32 InstrSize;
+    u32 ConsoleType;
+    u32 MaxBlockSize;
+    u32 Flags;
+    u32 NumBlocks;
+    u32 NumInvalidLiterals;
+};
+
+bool IsOpen = false;
+bool Dirty = false;
+std::string FileName;
+
+std::vector<u8> Data;
+std::unordered_map<u64, u32> Heads;
+// taken up by blocks which were replaced, they're
+// thrown out once there's more of them than of the rest
+u32 DeadBytes = 0;
+const u32 MinCompactBytes = 1024*1024;
+
+
+u32 SettingsFlags()
+{
+    return (ARMJIT::LiteralOptimizations ? (1<<0) : 0)
+        | (ARMJIT::BranchOptimizations ? (1<<1) : 0);
+}
+
+u64 BlockKey(u32 num, u32 addr)
+{
+    return ((u64)num << 32) | addr;
+}
+
+CachedBlock* BlockAt(u32 offset)
+{
+    return (CachedBlock*)&Data[offset];
+}
+
+// the file might be corrupt or come from a different build. Everything the
+// compiler indexes tables with is decoded again and has to come out the same
+bool BlockValid(const CachedBlock* block)
+{
+    if (block->NumInstrs == 0 || block->NumInstrs > ARMJIT::MaxBlockSize
+        || block->NumCode < block->NumInstrs || block->NumCode > ARMJIT::MaxBlockSize
+        || block->NumLiterals > ARMJIT::MaxBlockSize
+        || block->NumCode + block->NumLiterals > ARMJIT::MaxBlockDataWords
+        || block->Num > 1 || block->Thumb > 1)
+        return false;
+
+    bool thumb = block->Thumb;
+    const FetchedInstr* instrs = block->Instrs();
+    const SourceWord* code = block->Code();
+    const SourceWord* literals = block->Literals();
+
+    // the instructions were fetched in the same order as the code words,
+    // except that a Thumb BL is merged from two of them
+    u32 c = 0;
+    for (u32 i = 0; i < block->NumInstrs; i++)
+    {
+        const FetchedInstr& instr = instrs[i];
+        if (c >= block->NumCode || instr.Addr != code[c].Addr
+            || (thumb ? (instr.Instr & 0xFFFF) : instr.Instr) != code[c].Value)
+            return false;
+
+        ARMInstrInfo::Info info = ARMInstrInfo::Decode(thumb, block->Num, instr.Instr);
+
+        if (thumb && instr.Info.Kind == ARMInstrInfo::tk_BL_LONG)
+        {
+            if (info.Kind != ARMInstrInfo::tk_BL_LONG_1 || c + 1 >= block->NumCode
+                || (instr.Instr >> 16) != code[c + 1].Value
+                || ARMInstrInfo::Decode(true, block->Num, code[c + 1].Value).Kind != ARMInstrInfo::tk_BL_LONG_2
+                || instr.Info.DstRegs != 0xC000 || instr.Info.SrcRegs != 0 || !instr.Info.EndBlock)
+                return false;
+            c += 2;
+            continue;
+        }
+
+        // the analysis only ever turns literal loads into plain loads
+        // and lets blocks continue past branches
+        if (instr.Info.Kind != info.Kind
+            || instr.Info.DstRegs != info.DstRegs || instr.Info.SrcRegs != info.SrcRegs
+            || instr.Info.NotStrictlyNeeded != info.NotStrictlyNeeded
+            || instr.Info.ReadFlags != info.ReadFlags || instr.Info.WriteFlags != info.WriteFlags
+            || (instr.Info.EndBlock && !info.EndBlock))
+            return false;
+
+        if (instr.Info.SpecialKind != info.SpecialKind
+            && !(info.SpecialKind == ARMInstrInfo::special_LoadLiteral && instr.Info.SpecialKind == ARMInstrInfo::special_LoadMem))
+            return false;
+
+        if (instr.Info.SpecialKind == ARMInstrInfo::special_LoadLiteral)
+        {
+            u32 j = 0;
+            while (j < block->NumLiterals && literals[j].Value != instr.LiteralValue)
+                j++;
+            if (j == block->NumLiterals)
+                return false;
+        }
+
+        c++;
+    }
+
+    return true;
+}
+
+void Load(FILE* f)
+{
+    FileHeader header;
+    if (fread(&header, sizeof(header), 1, f) != 1)
+        return;
+
+    if (header.Magic != FileMagic
+        || header.Version != FileVersion
+        || header.InstrSize != sizeof(FetchedInstr)
+        || header.ConsoleType != NDS::ConsoleType
+        || header.MaxBlockSize != ARMJIT::MaxBlockSize
+        || header.Flags != SettingsFlags())
+    {
+        Log(LogLevel::Info, "JIT disk cache %s is outdated, starting over\n", FileName.c_str());
+        return;
+    }
+
+    for (u32 i = 0; i < header.NumInvalidLiterals; i++)
+    {
+        u32 addr;
+        if (fread(&addr, 4, 1, f) != 1)
+            return;
+        if (ARMJIT::InvalidLiterals.Find(addr) == -1)
+            ARMJIT::InvalidLiterals.Add(addr);
+    }
+
+    long start = ftell(f);
+    fseek(f, 0, SEEK_END);
+    long len = ftell(f) - start;
+    fseek(f, start, SEEK_SET);
+    if (len <= 0)
+        return;
+
+    Data.resize(len);
+    if (fread(Data.data(), len, 1, f) != 1)
+    {
+        Data.clear();
+        return;
+    }
+
+    // the blocks for an address are stored oldest first
+    u32 numLoaded = 0;
+    u32 offset = 0;
+    while (numLoaded < header.NumBlocks && offset + sizeof(CachedBlock) <= Data.size())
+    {
+        CachedBlock* block = BlockAt(offset);
+        if (offset + block->Size() > Data.size() || !BlockValid(block))
+        {
+            Log(LogLevel::Warn, "JIT disk cache %s is damaged, only using the first %u blocks\n", FileName.c_str(), numLoaded);
+            break;
+        }
+
+        auto head = Heads.try_emplace(BlockKey(block->Num & 0x1, block->StartAddr), NoBlock).first;
+        block->Older = head->second;
+        head->second = offset;
+
+        offset += block->Size();
+        numLoaded++;
+    }
+    Data.resize(offset);
+
+    Log(LogLevel::Info, "JIT disk cache: loaded %u blocks from %s\n", numLoaded, FileName.c_str());
+}
+
+void Compact()
+{
+    std::vector<u8> compacted;
+    compacted.reserve(Data.size() - DeadBytes);
+
+    for (auto& it : Heads)
+    {
+        u32 chain[MaxBlocksPerAddr];
+        u32 chainLen = 0;
+        for (u32 offset = it.second; offset != NoBlock && chainLen < MaxBlocksPerAddr; offset = BlockAt(offset)->Older)
+            chain[chainLen++] = offset;
+
+        // oldest first, like in the file
+        u32 older = NoBlock;
+        while (chainLen > 0)
+        {
+            CachedBlock* block = BlockAt(chain[--chainLen]);
+            u32 offset = compacted.size();
+            compacted.insert(compacted.end(), (u8*)block, (u8*)block + block->Size());
+            ((CachedBlock*)&compacted[offset])->Older = older;
+            older = offset;
+        }
+        it.second = older;
+    }
+
+    Data.swap(compacted);
+    DeadBytes = 0;
+}
+
+void Save()
+{
+    FILE* f = Platform::OpenLocalFile(FileName, "wb");
+    if (!f)
+    {
+        Log(LogLevel::Warn, "JIT disk cache: couldn't write %s\n", FileName.c_str());
+        return;
+    }
+
+    FileHeader header;
+    header.Magic = FileMagic;
+    header.Version = FileVersion;
+    header.InstrSize = sizeof(FetchedInstr);
+    header.ConsoleType = NDS::ConsoleType;
+    header.MaxBlockSize = ARMJIT::MaxBlockSize;
+    header.Flags = SettingsFlags();
+    header.NumBlocks = 0;
+    header.NumInvalidLiterals = ARMJIT::InvalidLiterals.Length;
+    fwrite(&header, sizeof(header), 1, f);
+
+    for (u32 i = 0; i < ARMJIT::InvalidLiterals.Length; i++)
+        fwrite(&ARMJIT::InvalidLiterals[i], 4, 1, f);
+
+    for (auto& it : Heads)
+    {
+        u32 chain[MaxBlocksPerAddr];
+        u32 chainLen = 0;
+        for (u32 offset = it.second; offset != NoBlock && chainLen < MaxBlocksPerAddr; offset = BlockAt(offset)->Older)
+            chain[chainLen++] = offset;
+
+        while (chainLen > 0)
+        {
+            CachedBlock* block = BlockAt(chain[--chainLen]);
+            fwrite(block, block->Size(), 1, f);
+            header.NumBlocks++;
+        }
+    }
+
+    fseek(f, 0, SEEK_SET);
+    fwrite(&header, sizeof(header), 1, f);
+    fclose(f);
+
+    Log(LogLevel::Info, "JIT disk cache: saved %u blocks to %s\n", header.NumBlocks, FileName.c_str());
+}
+
+void Open()
+{
+    if (IsOpen)
+        return;
+    IsOpen = true;
+
+    // without a cart there's nothing we could tell the code apart by
+    if (!NDSCart::Cart)
+        return;
+
+    const NDSHeader& header = NDSCart::Cart->GetHeader();
+    char name[64];
+    snprintf(name, sizeof(name), "jitcache_%.4s_%04X.bin", header.GameCode, header.HeaderCRC16);
+    FileName = name;
+
+    FILE* f = Platform::OpenLocalFile(FileName, "rb");
+    if (f)
+    {
+        Load(f);
+        fclose(f);
+    }
+}
+
+void Close()
+{
+    if (IsOpen && Dirty && !FileName.empty())
+        Save();
+
+    IsOpen = false;
+    Dirty = false;
+    FileName.clear();
+    Heads.clear();
+    Data.clear();
+    Data.shrink_to_fit();
+    DeadBytes = 0;
+}
+
+const CachedBlock* Find(u32 num, u32 addr)
+{
+    auto it = Heads.find(BlockKey(num, addr));
+    if (it == Heads.end())
+        return nullptr;
+    return BlockAt(it->second);
+}
+
+const CachedBlock* FindOlder(const CachedBlock* block)
+{
+    return block->Older == NoBlock ? nullptr : BlockAt(block->Older);
+}
+
+void Add(const CachedBlock& block, const FetchedInstr* instrs, const SourceWord* code, const SourceWord* literals)
+{
+    Open();
+    if (FileName.empty())
+        return;
+
+    u32& head = Heads.try_emplace(BlockKey(block.Num, block.StartAddr), NoBlock).first->second;
+
+    u32 offset = Data.size();
+    Data.resize(offset + block.Size());
+
+    CachedBlock* newBlock = BlockAt(offset);
+    *newBlock = block;
+    memcpy((void*)newBlock->Instrs(), instrs, block.NumInstrs * sizeof(FetchedInstr));
+    memcpy((void*)newBlock->Code(), code, block.NumCode * sizeof(SourceWord));
+    memcpy((void*)newBlock->Literals(), literals, block.NumLiterals * sizeof(SourceWord));
+
+    // drop an older copy of the same code and whatever is past the limit
+    u32* link = &newBlock->Older;
+    *link = head;
+    u32 count = 1;
+    while (*link != NoBlock)
+    {
+        CachedBlock* older = BlockAt(*link);
+        if (count == MaxBlocksPerAddr
+            || (older->InstrHash == block.InstrHash && older->Thumb == block.Thumb))
+        {
+            DeadBytes += older->Size();
+            *link = older->Older;
+        }
+        else
+        {
+            link = &older->Older;
+            count++;
+        }
+    }
+    head = offset;
+
+    Dirty = true;
+
+    if (DeadBytes >= MinCompactBytes && DeadBytes > Data.size() / 2)
+        Compact();
+}
+
+}
@@ -0,0 +1,86 @@
+/*
+    Copyright 2016-2022 melonDS team
+
+    This file is part of melonDS.
+
+    melonDS is free software: you can redistribute it and/or modify it under
+    the terms of the GNU General Public License as published by the Free
+    Software Foundation, either version 3 of the License, or (at your option)
+    any later version.
+
+    melonDS is distributed in the hope that it will be useful, but WITHOUT ANY
+    WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+    FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with melonDS. If not, see http://www.gnu.org/licenses/.
+*/
+
+#ifndef ARMJIT_DISKCACHE_H
+#define ARMJIT_DISKCACHE_H
+
+#include <utility>
+#include <vector>
+
+#include "types.h"
+#include "ARMJIT_Internal.h"
+
+// keeps the analysed instructions of every compiled block around and stores
+// them in a file per game, so that the next time the game is run the blocks
+// can be compiled without having to go through the analysis again.
+// The generated code itself isn't stored, it's full of absolute addresses.
+
+namespace ARMJIT_DiskCache
+{
+
+// all blocks are kept back to back in one buffer, which is exactly
+// what's written to the file, followed by the analysed instructions,
+// then every instruction word which was fetched for the block and every
+// literal it loads, to check the memory still holds the same code
+struct CachedBlock
+{
+    u32 StartAddr;
+    u32 InstrHash, LiteralHash;
+    // the block which was cached before at the same address, if any
+    u32 Older;
+    u8 Num;
+    u8 Thumb;
+    u8 HasMemoryInstr;
+    u8 NumInstrs, NumCode, NumLiterals;
+    u16 Padding;
+
+    const ARMJIT::FetchedInstr* Instrs() const
+    {
+        return (const ARMJIT::FetchedInstr*)(this + 1);
+    }
+    const ARMJIT::SourceWord* Code() const
+    {
+        return (const ARMJIT::SourceWord*)(Instrs() + NumInstrs);
+    }
+    const ARMJIT::SourceWord* Literals() const
+    {
+        return Code() + NumCode;
+    }
+
+    u32 Size() const
+    {
+        return sizeof(CachedBlock) + NumInstrs * sizeof(ARMJIT::FetchedInstr) + (NumCode + NumLiterals) * sizeof(ARMJIT::SourceWord);
+    }
+};
+
+// opens the cache for the game which is currently inserted
+// does nothing if it's already open
+void Open();
+// writes the cache back if anything was added and forgets about it
+void Close();
+
+// the most recent block cached for an address
+const CachedBlock* Find(u32 num, u32 addr);
+const CachedBlock* FindOlder(const CachedBlock* block);
+
+// opens the cache if necessary, the counts are taken from the block
+void Add(const CachedBlock& block, const ARMJIT::FetchedInstr* instrs, const ARMJIT::SourceWord* code, const ARMJIT::SourceWord* literals);
+
+}
+
+#endif
@@ -65,10 +65,30 @@ struct FetchedInstr
     u8 DataCycles;
     u16 CodeCycles;
     u32 DataRegion;
+    // the memregion DataRegion is in. Looked up when the block is analysed,
+    // since the compile thread mustn't read the memory mapping registers
+    u8 DataRegionType;
+    // the same goes for the memory timings. For the ARM7 the code cycles
+    // of this instruction, nonsequential and sequential
+    u8 CodeCyclesN, CodeCyclesS;
+    // and for a jump to a constant address, the cycles it takes and
+    // for the ARM9 the code cycles of the region it goes to
+    u32 JumpTarget;
+    u16 JumpCycles;
+    u8 JumpRegionCodeCycles;
+    // the word the literal is loaded from, if SpecialKind is special_LoadLiteral
+    u32 LiteralValue;
 
     ARMInstrInfo::Info Info;
 };
 
+// a word a block was built from, to be able to tell
+// whether memory still holds the same code later on
+struct SourceWord
+{
+    u32 Addr, Value;
+};
+
 /*
     TinyVector
         - because reinventing the wheel is the best!
@@ -171,37 +191,206 @@ struct __attribute__((packed)) TinyVector
     }
 };
 
+/*
+    BlockMap
+        - maps addresses (or hashes) to pointers
+        - open addressing with linear probing, so a lookup is
+        usually just a single cache line
+        - NULL can't be stored, it marks empty slots
+        - no tombstones, removing moves the following entries back
+*/
+template <typename T>
+class BlockMap
+{
+public:
+    ~BlockMap()
+    {
+        delete[] Slots;
+    }
+
+    T* Find(u32 key)
+    {
+        if (Count == 0)
+            return NULL;
+
+        for (u32 i = Home(key);; i = (i + 1) & Mask)
+        {
+            if (!Slots[i].Value || Slots[i].Key == key)
+                return Slots[i].Value;
+        }
+    }
+
+    // returns the value which was replaced, if any
+    T* Insert(u32 key, T* value)
+    {
+        assert(value);
+        // keep it at most half full
+        if ((Count + 1) * 2 > Mask + 1)
+            Grow();
+
+        u32 i = Home(key);
+        while (Slots[i].Value && Slots[i].Key != key)
+            i = (i + 1) & Mask;
+
+        T* old = Slots[i].Value;
+        if (!old)
+            Count++;
+        Slots[i].Key = key;
+        Slots[i].Value = value;
+        return old;
+    }
+
+    // returns the value which was removed, if any
+    T* Remove(u32 key)
+    {
+        if (Count == 0)
+            return NULL;
+
+        u32 i = Home(key);
+        while (Slots[i].Value && Slots[i].Key != key)
+            i = (i + 1) & Mask;
+
+        T* old = Slots[i].Value;
+        if (old)
+            RemoveAt(i);
+        return old;
+    }
+
+    void Clear()
+    {
+        if (Slots)
+            memset(Slots, 0, (Mask + 1) * sizeof(Slot));
+        Count = 0;
+    }
+
+    u32 Length() const
+    { return Count; }
+
+    // for going over all entries, slots may be empty
+    u32 NumSlots() const
+    { return Slots ? Mask + 1 : 0; }
+    T* ValueAt(u32 slot)
+    { return Slots[slot].Value; }
+
+    // the slot might be filled by another entry afterwards,
+    // so it needs to be looked at again when iterating
+    void RemoveAt(u32 slot)
+    {
+        assert(Slots[slot].Value);
+        Count--;
+
+        u32 hole = slot;
+        for (u32 i = (slot + 1) & Mask; Slots[i].Value; i = (i + 1) & Mask)
+        {
+            // entries can only move back if that's not before their home
+            if (((i - Home(Slots[i].Key)) & Mask) >= ((i - hole) & Mask))
+            {
+                Slots[hole] = Slots[i];
+                hole = i;
+            }
+        }
+        Slots[hole].Value = NULL;
+    }
+
+private:
+    struct Slot
+    {
+        u32 Key;
+        T* Value;
+    };
+
+    Slot* Slots = NULL;
+    u32 Mask = 0;
+    // 32 - log2 of the number of slots
+    u32 Shift = 0;
+    u32 Count = 0;
+
+    u32 Home(u32 key) const
+    {
+        // Fibonacci hashing, the top bits of the product depend on all bits
+        // of the key. The low bits would only depend on the low bits, so
+        // e.g. the same offset in different mirrors would end up together
+        return (key * 0x9E3779B1) >> Shift;
+    }
+
+    void Grow()
+    {
+        Slot* oldSlots = Slots;
+        u32 oldNumSlots = NumSlots();
+
+        u32 numSlots = oldSlots ? oldNumSlots * 2 : 1024;
+        Slots = new Slot[numSlots];
+        memset(Slots, 0, numSlots * sizeof(Slot));
+        Mask = numSlots - 1;
+        Shift = 32 - __builtin_ctz(numSlots);
+        Count = 0;
+
+        for (u32 i = 0; i < oldNumSlots; i++)
+        {
+            if (oldSlots[i].Value)
+                Insert(oldSlots[i].Key, oldSlots[i].Value);
+        }
+        delete[] oldSlots;
+    }
+};
+
+// a jump at the end of a block which always leads to the same address.
+// Once there's a block at that address it's patched to go there directly
+struct BlockExit
+{
+    // where the next block starts, bit 0 is set for Thumb code
+    u32 Addr;
+    // of the jump, relative to the entry point of the block
+    u32 Offset;
+};
+
+const int MaxBlockExits = 4;
+
+// allocated through AllocJitBlock, with the address ranges
+// and literals following right after it
 class JitBlock
 {
 public:
-    JitBlock(u32 num, u32 literalHash, u32 numAddresses, u32 numLiterals)
+    JitBlock(u32 num, u32 numAddresses, u32 numLiterals)
     {
         Num = num;
         NumAddresses = numAddresses;
         NumLiterals = numLiterals;
-        Data.SetLength(numAddresses * 2 + numLiterals);
     }
 
     u32 StartAddr;
     u32 StartAddrLocal;
     u32 InstrHash, LiteralHash;
     u8 Num;
+    u8 Thumb;
     u16 NumAddresses;
     u16 NumLiterals;
 
     JitBlockEntry EntryPoint;
 
+    u32 NumExits;
+    BlockExit Exits[MaxBlockExits];
+
     u32* AddressRanges()
-    { return &Data[0]; }
+    { return (u32*)(this + 1); }
     u32* AddressMasks()
-    { return &Data[NumAddresses]; }
+    { return AddressRanges() + NumAddresses; }
     u32* Literals()
-    { return &Data[NumAddresses * 2]; }
+    { return AddressRanges() + NumAddresses * 2; }
 
-private:
-    TinyVector<u32> Data;
+    u32 DataSize() const
+    { return (NumAddresses * 2 + NumLiterals) * sizeof(u32); }
 };
 
+// the largest MaxBlockSize can be set to, for sizing buffers
+const int MaxBlockSizeLimit = 32;
+
+// a range for every instruction and every literal and a literal per instruction
+const u32 MaxBlockDataWords = MaxBlockSizeLimit * 2 * 2 + MaxBlockSizeLimit;
+
+JitBlock* AllocJitBlock(u32 num, u32 numAddresses, u32 numLiterals);
+void FreeJitBlock(JitBlock* block);
+
 // size should be 16 bytes because I'm to lazy to use mul and whatnot
 struct __attribute__((packed)) AddressRange
 {
@@ -230,6 +419,14 @@ inline bool PageContainsCode(AddressRange* range)
 
 u32 LocaliseCodeAddress(u32 num, u32 addr);
 
+// throws out every block whose entry point lies in the given range of the code cache
+void EvictCodeRange(u8* start, u8* end);
+
+// the compiler might be busy on another thread, this
+// has to be held when anything else is done with it
+void LockCompiler();
+void UnlockCompiler();
+
 template <u32 Num>
 void LinkBlock(ARM* cpu, u32 codeOffset);
 
@@ -687,7 +687,11 @@ bool FaultHandler(FaultDescription& faultDesc)
             rewriteToSlowPath = !MapAtAddress(faultDesc.EmulatedFaultAddr);
 
         if (rewriteToSlowPath)
+        {
+            ARMJIT::LockCompiler();
             faultDesc.FaultPC = ARMJIT::JITCompiler->RewriteMemAccess(faultDesc.FaultPC);
+            ARMJIT::UnlockCompiler();
+        }
 
         return true;
     }
@@ -1181,6 +1185,15 @@ u32 WifiRead32(u32 addr)
     return (u32)Wifi::Read(addr) | ((u32)Wifi::Read(addr + 2) << 16);
 }
 
+// who owns the cartridge is checked when the access happens, blocks
+// are compiled on another thread which mustn't look at EXMEMCNT
+u32 ROMDataRead32(u32 addr)
+{
+    if (!(NDS::ExMemCnt[0] & (1<<11)))
+        return NDSCart::ReadROMData();
+    return 0;
+}
+
 template <typename T>
 void VRAMWrite(u32 addr, T val)
 {
@@ -1213,8 +1226,8 @@ void* GetFuncForAddr(ARM* cpu, u32 addr, bool store, int size)
         switch (addr & 0xFF000000)
         {
         case 0x04000000:
-            if (!store && size == 32 && addr == 0x04100010 && NDS::ExMemCnt[0] & (1<<11))
-                return (void*)NDSCart::ReadROMData;
+            if (!store && size == 32 && addr == 0x04100010)
+                return (void*)ROMDataRead32;
 
             /*
                 unfortunately we can't map GPU2D this way
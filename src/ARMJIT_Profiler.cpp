@@ -0,0 +1,215 @@
+/*
+    Copyright 2016-2022 melonDS team
+
+    This file is part of melonDS.
+
+    melonDS is free software: you can redistribute it and/or modify it under
+    the terms of the GNU General Public License as published by the Free
+    Software Foundation, either version 3 of the License, or (at your option)
+    any later version.
+
+    melonDS is distributed in the hope that it will be useful, but WITHOUT ANY
+    WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+    FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with melonDS. If not, see http://www.gnu.org/licenses/.
+*/
+
+#include <stdio.h>
+#include <algorithm>
+#include <chrono>
+#include <unordered_map>
+
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+#include "ARMJIT_Profiler.h"
+#include "ARMJIT_Memory.h"
+#include "Platform.h"
+
+using Platform::Log;
+using Platform::LogLevel;
+
+namespace ARMJIT_Profiler
+{
+
+bool Enabled = false;
+
+// the compiled code increments the execution counter in here directly,
+// elements of an unordered_map don't move when it grows
+std::unordered_map<u64, BlockStats> Blocks;
+std::unordered_map<u32, u32> Ranges;
+// the blocks might be compiled on another thread
+Platform::Mutex* Lock = nullptr;
+
+// for perf, see tools/perf/Documentation/jit-interface.txt in the Linux sources
+FILE* PerfMap = nullptr;
+
+
+u64 BlockKey(u32 num, u32 addr)
+{
+    return ((u64)num << 32) | addr;
+}
+
+BlockStats& GetBlock(u32 num, u32 addr, bool thumb)
+{
+    BlockStats& block = Blocks[BlockKey(num, addr)];
+    block.Num = num;
+    block.Addr = addr;
+    block.Thumb = thumb;
+    return block;
+}
+
+void Reset()
+{
+    if (!Lock)
+        Lock = Platform::Mutex_Create();
+
+    Enabled = Platform::GetConfigBool(Platform::JIT_Profiler);
+
+    // a block which was cancelled might still finish compiling
+    Platform::Mutex_Lock(Lock);
+    Blocks.clear();
+    Ranges.clear();
+    Platform::Mutex_Unlock(Lock);
+
+#ifndef _WIN32
+    if (Platform::GetConfigBool(Platform::JIT_PerfMap) && !PerfMap)
+    {
+        // the code is reused, so there can be multiple entries for the same address.
+        // perf always goes with the last one, it's the best we can do
+        char name[64];
+        snprintf(name, sizeof(name), "/tmp/perf-%d.map", (int)getpid());
+        PerfMap = fopen(name, "w");
+        if (!PerfMap)
+            Log(LogLevel::Warn, "JIT profiler: couldn't open %s\n", name);
+    }
+#endif
+}
+
+void DeInit()
+{
+    if (PerfMap)
+    {
+        fclose(PerfMap);
+        PerfMap = nullptr;
+    }
+
+    Blocks.clear();
+    Ranges.clear();
+
+    if (Lock)
+    {
+        Platform::Mutex_Free(Lock);
+        Lock = nullptr;
+    }
+}
+
+const char* RegionName(u32 region)
+{
+    switch (region)
+    {
+    case ARMJIT_Memory::memregion_ITCM: return "ITCM";
+    case ARMJIT_Memory::memregion_DTCM: return "DTCM";
+    case ARMJIT_Memory::memregion_BIOS9: return "BIOS9";
+    case ARMJIT_Memory::memregion_MainRAM: return "MainRAM";
+    case ARMJIT_Memory::memregion_SharedWRAM: return "SharedWRAM";
+    case ARMJIT_Memory::memregion_VRAM: return "VRAM";
+    case ARMJIT_Memory::memregion_BIOS7: return "BIOS7";
+    case ARMJIT_Memory::memregion_WRAM7: return "WRAM7";
+    case ARMJIT_Memory::memregion_VWRAM: return "VWRAM";
+    case ARMJIT_Memory::memregion_BIOS9DSi: return "BIOS9DSi";
+    case ARMJIT_Memory::memregion_BIOS7DSi: return "BIOS7DSi";
+    case ARMJIT_Memory::memregion_NewSharedWRAM_A: return "NewSharedWRAM_A";
+    case ARMJIT_Memory::memregion_NewSharedWRAM_B: return "NewSharedWRAM_B";
+    case ARMJIT_Memory::memregion_NewSharedWRAM_C: return "NewSharedWRAM_C";
+    default: return "Other";
+    }
+}
+
+u64* ExecutionCounter(u32 num, u32 addr, bool thumb)
+{
+    Platform::Mutex_Lock(Lock);
+    u64* counter = &GetBlock(num, addr, thumb).Executions;
+    Platform::Mutex_Unlock(Lock);
+    return counter;
+}
+
+void BlockCompiled(u32 num, u32 addr, bool thumb, u32 numInstrs,
+    ARMJIT::JitBlockEntry entry, u32 codeSize, u64 compileTime)
+{
+    if (!Enabled && !PerfMap)
+        return;
+
+    Platform::Mutex_Lock(Lock);
+
+    if (Enabled)
+    {
+        BlockStats& block = GetBlock(num, addr, thumb);
+        block.NumInstrs = numInstrs;
+        block.Compiles++;
+        block.CompileTime += compileTime;
+        block.CodeSize = codeSize;
+    }
+
+    if (PerfMap)
+    {
+        fprintf(PerfMap, "%llx %x ARM%d_%s_%08X\n",
+            (unsigned long long)entry, codeSize, num == 0 ? 9 : 7, thumb ? "Thumb" : "ARM", addr);
+        // so it's usable even if we don't exit properly
+        fflush(PerfMap);
+    }
+
+    Platform::Mutex_Unlock(Lock);
+}
+
+void RangeInvalidated(u32 localAddr)
+{
+    Platform::Mutex_Lock(Lock);
+    Ranges[localAddr & ~0x1FF]++;
+    Platform::Mutex_Unlock(Lock);
+}
+
+void GetBlockStats(std::vector<BlockStats>& stats)
+{
+    stats.clear();
+    if (!Lock)
+        return;
+
+    Platform::Mutex_Lock(Lock);
+    for (auto& it : Blocks)
+        stats.push_back(it.second);
+    Platform::Mutex_Unlock(Lock);
+
+    std::sort(stats.begin(), stats.end(), [](const BlockStats& a, const BlockStats& b)
+    {
+        return a.Executions > b.Executions;
+    });
+}
+
+void GetRangeStats(std::vector<RangeStats>& stats)
+{
+    stats.clear();
+    if (!Lock)
+        return;
+
+    Platform::Mutex_Lock(Lock);
+    for (auto& it : Ranges)
+        stats.push_back({it.first, it.second});
+    Platform::Mutex_Unlock(Lock);
+
+    std::sort(stats.begin(), stats.end(), [](const RangeStats& a, const RangeStats& b)
+    {
+        return a.Invalidations > b.Invalidations;
+    });
+}
+
+u64 Now()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+}
@@ -0,0 +1,84 @@
+/*
+    Copyright 2016-2022 melonDS team
+
+    This file is part of melonDS.
+
+    melonDS is free software: you can redistribute it and/or modify it under
+    the terms of the GNU General Public License as published by the Free
+    Software Foundation, either version 3 of the License, or (at your option)
+    any later version.
+
+    melonDS is distributed in the hope that it will be useful, but WITHOUT ANY
+    WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+    FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with melonDS. If not, see http://www.gnu.org/licenses/.
+*/
+
+#ifndef ARMJIT_PROFILER_H
+#define ARMJIT_PROFILER_H
+
+#include <vector>
+
+#include "types.h"
+#include "ARMJIT.h"
+
+// statistics about the blocks the JIT compiles, collected per guest address
+// so they survive the blocks being invalidated and compiled again.
+// Unlike the rest of the profiling it doesn't need a special build,
+// it's switched on with the JIT_Profiler and JIT_PerfMap settings.
+
+namespace ARMJIT_Profiler
+{
+
+struct BlockStats
+{
+    u32 Num;
+    u32 Addr;
+    bool Thumb;
+    u32 NumInstrs;
+    // how often it was entered, from the dispatcher or another block
+    u64 Executions;
+    // how often a block was compiled for this address and how long that took in total, in nanoseconds
+    u32 Compiles;
+    u64 CompileTime;
+    // in bytes, of the most recent block
+    u32 CodeSize;
+};
+
+struct RangeStats
+{
+    // the first address of the range in the form ARMJIT_Memory uses (region << 27 | offset)
+    u32 LocalAddr;
+    u32 Invalidations;
+};
+
+// whether blocks are counted, the perf map is written regardless
+extern bool Enabled;
+
+// reads the settings, throws away everything collected
+// has to be called while there's no compiled code around
+void Reset();
+void DeInit();
+
+const char* RegionName(u32 region);
+
+// where the code for the block about to be compiled should count its executions
+u64* ExecutionCounter(u32 num, u32 addr, bool thumb);
+
+// may be called from the compile thread
+void BlockCompiled(u32 num, u32 addr, bool thumb, u32 numInstrs,
+    ARMJIT::JitBlockEntry entry, u32 codeSize, u64 compileTime);
+
+void RangeInvalidated(u32 localAddr);
+
+// sorted by the number of executions/invalidations, the most first
+void GetBlockStats(std::vector<BlockStats>& stats);
+void GetRangeStats(std::vector<RangeStats>& stats);
+
+u64 Now();
+
+}
+
+#endif
@@ -656,14 +656,62 @@ bool Compiler::CanCompile(bool thumb, u16 kind)
 void Compiler::Reset()
 {
     memset(ResetStart, 0xcc, CodeMemSize);
-    SetCodePtr(ResetStart);
 
+    CodeRegionNearSize = (std::min(NearSize, CodeCacheSize / 4 * 3) / CodeRegionsCount) & ~0xF;
+    CodeRegionFarSize = (std::min(FarSize, CodeCacheSize / 4) / CodeRegionsCount) & ~0xF;
+
+    CurCodeRegion = 0;
+    memset(CodeRegionUsed, 0, sizeof(CodeRegionUsed));
+
+    SetCodePtr(ResetStart);
     NearCode = NearStart;
     FarCode = FarStart;
 
     LoadStorePatches.clear();
 }
 
+void Compiler::NextCodeRegion()
+{
+    u8* nearStart = NearStart + CurCodeRegion * CodeRegionNearSize;
+    u8* farStart = FarStart + CurCodeRegion * CodeRegionFarSize;
+    CodeRegionUsed[CurCodeRegion] = (GetWritableCodePtr() - nearStart) + (FarCode - farStart);
+
+    CurCodeRegion = (CurCodeRegion + 1) % CodeRegionsCount;
+    nearStart = NearStart + CurCodeRegion * CodeRegionNearSize;
+    farStart = FarStart + CurCodeRegion * CodeRegionFarSize;
+
+    Log(LogLevel::Debug, "JIT code region full, moving on to region %d\n", CurCodeRegion);
+
+    EvictCodeRange(nearStart, nearStart + CodeRegionNearSize);
+
+    for (auto it = LoadStorePatches.begin(); it != LoadStorePatches.end();)
+    {
+        if (it->first >= nearStart && it->first < nearStart + CodeRegionNearSize)
+            it = LoadStorePatches.erase(it);
+        else
+            it++;
+    }
+
+    memset(nearStart, 0xcc, CodeRegionNearSize);
+    memset(farStart, 0xcc, CodeRegionFarSize);
+    CodeRegionUsed[CurCodeRegion] = 0;
+
+    SetCodePtr(nearStart);
+    FarCode = farStart;
+}
+
+void Compiler::GetCodeCacheUsage(u32& used, u32& size)
+{
+    used = (GetCodePtr() - (NearStart + CurCodeRegion * CodeRegionNearSize))
+        + (FarCode - (FarStart + CurCodeRegion * CodeRegionFarSize));
+    for (int i = 0; i < CodeRegionsCount; i++)
+    {
+        if (i != CurCodeRegion)
+            used += CodeRegionUsed[i];
+    }
+    size = (CodeRegionNearSize + CodeRegionFarSize) * CodeRegionsCount;
+}
+
 bool Compiler::IsJITFault(u8* addr)
 {
     return (u64)addr >= (u64)ResetStart && (u64)addr < (u64)ResetStart + CodeMemSize;
@@ -681,8 +729,73 @@ void Compiler::Comp_SpecialBranchBehaviour(bool taken)
 
         if (ConstantCycles)
             ADD(32, MDisp(RCPU, offsetof(ARM, Cycles)), Imm32(ConstantCycles));
+
+        u32 next = taken ? ExitTarget : (CurInstr.Addr + (Thumb ? 2 : 4)) | Thumb;
+        Comp_BlockExit(&next, taken && !HasExitTarget ? 0 : 1);
+    }
+}
+
+/*
+    Instead of going back to the dispatcher after every block, a block can
+    continue with the next one right away, if it's known where it leads to
+    (the next block in memory or the target of a branch). The jumps are emitted
+    here, pointing to ARM_Ret at first, and are linked to the next block once
+    it's compiled (see ChainBlock in ARMJIT.cpp).
+
+    Everything the dispatcher loop does between blocks has to be done here
+    as well, so the cycles are added to the timestamp and it's checked
+    whether we need to stop.
+*/
+void Compiler::Comp_BlockExit(const u32* next, int numNext)
+{
+    if (numNext == 0 || NumExits + numNext > MaxBlockExits)
+    {
         JMP((u8*)&ARM_Ret, true);
+        return;
     }
+
+    CMP(32, MDisp(RCPU, offsetof(ARM, StopExecution)), Imm8(0));
+    FixupBranch stop = J_CC(CC_NZ, true);
+
+    MOV(64, R(RSCRATCH2), ImmPtr(Num == 0 ? &NDS::ARM9Timestamp : &NDS::ARM7Timestamp));
+    MOVSX(64, 32, RSCRATCH, MDisp(RCPU, offsetof(ARM, Cycles)));
+    ADD(64, R(RSCRATCH), MatR(RSCRATCH2));
+    MOV(64, MatR(RSCRATCH2), R(RSCRATCH));
+    MOV(32, MDisp(RCPU, offsetof(ARM, Cycles)), Imm32(0));
+    MOV(64, R(RSCRATCH2), ImmPtr(Num == 0 ? &NDS::ARM9Target : &NDS::ARM7Target));
+    CMP(64, R(RSCRATCH), MatR(RSCRATCH2));
+    FixupBranch timeUp = J_CC(CC_AE, true);
+
+    for (int i = 0; i < numNext; i++)
+    {
+        bool thumb = next[i] & 0x1;
+        u32 addr = next[i] & ~0x1;
+
+        // the interpreter might have gone somewhere else
+        CMP(32, MDisp(RCPU, offsetof(ARM, R[15])), Imm32(addr + (thumb ? 2 : 4)));
+        FixupBranch otherAddr = J_CC(CC_NZ, true);
+        TEST(32, R(RCPSR), Imm32(0x20));
+        FixupBranch otherMode = J_CC(thumb ? CC_Z : CC_NZ, true);
+
+        Exits[NumExits].Addr = next[i];
+        Exits[NumExits].Offset = GetWritableCodePtr() - BlockStart;
+        NumExits++;
+        JMP((u8*)&ARM_Ret, true);
+
+        SetJumpTarget(otherAddr);
+        SetJumpTarget(otherMode);
+    }
+
+    SetJumpTarget(stop);
+    SetJumpTarget(timeUp);
+    JMP((u8*)&ARM_Ret, true);
+}
+
+void Compiler::LinkBlockExit(u8* exit, JitBlockEntry target)
+{
+    // the compile thread might be using the emitter right now
+    XEmitter emitter(exit);
+    emitter.JMP(target ? (u8*)target : (u8*)&ARM_Ret, true);
 }
 
 #ifdef JIT_PROFILING_ENABLED
@@ -707,19 +820,15 @@ void Compiler::CreateMethod(const char* namefmt, void* start, ...)
 }
 #endif
 
-JitBlockEntry Compiler::CompileBlock(ARM* cpu, bool thumb, FetchedInstr instrs[], int instrsCount, bool hasMemoryInstr)
+bool Compiler::CodeRegionFull()
 {
-    if (NearSize - (GetCodePtr() - NearStart) < 1024 * 32) // guess...
-    {
-        Log(LogLevel::Debug, "near reset\n");
-        ResetBlockCache();
-    }
-    if (FarSize - (FarCode - FarStart) < 1024 * 32) // guess...
-    {
-        Log(LogLevel::Debug, "far reset\n");
-        ResetBlockCache();
-    }
+    u8* nearEnd = NearStart + (CurCodeRegion + 1) * CodeRegionNearSize;
+    u8* farEnd = FarStart + (CurCodeRegion + 1) * CodeRegionFarSize;
+    return nearEnd - GetCodePtr() < 1024 * 32 || farEnd - FarCode < 1024 * 32; // guess...
+}
 
+JitBlockEntry Compiler::CompileBlock(ARM* cpu, bool thumb, FetchedInstr instrs[], int instrsCount, bool hasMemoryInstr)
+{
     ConstantCycles = 0;
     Thumb = thumb;
     Num = cpu->Num;
@@ -729,6 +838,14 @@ JitBlockEntry Compiler::CompileBlock(ARM* cpu, bool thumb, FetchedInstr instrs[]
     CPSRDirty = false;
 
     JitBlockEntry res = (JitBlockEntry)GetWritableCodePtr();
+    BlockStart = GetWritableCodePtr();
+    NumExits = 0;
+
+    if (ExecutionCounter)
+    {
+        MOV(64, R(RSCRATCH), ImmPtr(ExecutionCounter));
+        ADD(64, MatR(RSCRATCH), Imm8(1));
+    }
 
     RegCache = RegisterCache<Compiler, X64Reg>(this, instrs, instrsCount);
 
@@ -739,6 +856,7 @@ JitBlockEntry Compiler::CompileBlock(ARM* cpu, bool thumb, FetchedInstr instrs[]
         CodeRegion = R15 >> 24;
 
         Exit = i == instrsCount - 1 || (CurInstr.BranchFlags & branch_FollowCondNotTaken);
+        HasExitTarget = false;
 
         CompileFunc comp = Thumb
             ? T_Comp[CurInstr.Info.Kind]
@@ -843,7 +961,17 @@ JitBlockEntry Compiler::CompileBlock(ARM* cpu, bool thumb, FetchedInstr instrs[]
 
     if (ConstantCycles)
         ADD(32, MDisp(RCPU, offsetof(ARM, Cycles)), Imm32(ConstantCycles));
-    JMP((u8*)ARM_Ret, true);
+
+    u32 next[2];
+    int numNext = 0;
+    if (HasExitTarget)
+        next[numNext++] = ExitTarget;
+    bool isConditional = Thumb ? CurInstr.Info.Kind == ARMInstrInfo::tk_BCOND : CurInstr.Cond() < 0xE;
+    if (!CurInstr.Info.Branches() || isConditional)
+        next[numNext++] = (CurInstr.Addr + (Thumb ? 2 : 4)) | Thumb;
+    Comp_BlockExit(next, numNext);
+
+    BlockSize = GetWritableCodePtr() - BlockStart;
 
 #ifdef JIT_PROFILING_ENABLED
     CreateMethod("JIT_Block_%d_%d_%08X", (void*)res, Num, Thumb, instrs[0].Addr);
@@ -861,7 +989,7 @@ JitBlockEntry Compiler::CompileBlock(ARM* cpu, bool thumb, FetchedInstr instrs[]
 void Compiler::Comp_AddCycles_C(bool forceNonConstant)
 {
     s32 cycles = Num ?
-        NDS::ARM7MemTimings[CurInstr.CodeCycles][Thumb ? 1 : 3]
+        CurInstr.CodeCyclesS
         : ((R15 & 0x2) ? 0 : CurInstr.CodeCycles);
 
     if ((!Thumb && CurInstr.Cond() < 0xE) || forceNonConstant)
@@ -873,7 +1001,7 @@ void Compiler::Comp_AddCycles_C(bool forceNonConstant)
 void Compiler::Comp_AddCycles_CI(u32 i)
 {
     s32 cycles = (Num ?
-        NDS::ARM7MemTimings[CurInstr.CodeCycles][Thumb ? 0 : 2]
+        CurInstr.CodeCyclesN
         : ((R15 & 0x2) ? 0 : CurInstr.CodeCycles)) + i;
 
     if (!Thumb && CurInstr.Cond() < 0xE)
@@ -885,7 +1013,7 @@ void Compiler::Comp_AddCycles_CI(u32 i)
 void Compiler::Comp_AddCycles_CI(Gen::X64Reg i, int add)
 {
     s32 cycles = Num ?
-        NDS::ARM7MemTimings[CurInstr.CodeCycles][Thumb ? 0 : 2]
+        CurInstr.CodeCyclesN
         : ((R15 & 0x2) ? 0 : CurInstr.CodeCycles);
 
     if (!Thumb && CurInstr.Cond() < 0xE)
@@ -910,7 +1038,7 @@ void Compiler::Comp_AddCycles_CDI()
 
         s32 cycles;
 
-        s32 numC = NDS::ARM7MemTimings[CurInstr.CodeCycles][Thumb ? 0 : 2];
+        s32 numC = CurInstr.CodeCyclesN;
         s32 numD = CurInstr.DataCycles;
 
         if ((CurInstr.DataRegion >> 24) == 0x02) // mainRAM
@@ -955,7 +1083,7 @@ void Compiler::Comp_AddCycles_CD()
     }
     else
     {
-        s32 numC = NDS::ARM7MemTimings[CurInstr.CodeCycles][Thumb ? 0 : 2];
+        s32 numC = CurInstr.CodeCyclesN;
         s32 numD = CurInstr.DataCycles;
 
         if ((CurInstr.DataRegion >> 4) == 0x02)
@@ -85,6 +85,22 @@ public:
 
     JitBlockEntry CompileBlock(ARM* cpu, bool thumb, FetchedInstr instrs[], int instrsCount, bool hasMemoryInstr);
 
+    void GetCodeCacheUsage(u32& used, u32& size);
+
+    // there's no guarantee a block fits anymore, NextCodeRegion
+    // has to be called before anything else is compiled
+    bool CodeRegionFull();
+    void NextCodeRegion();
+
+    // lets the exit jump directly to the given block
+    // or back to the dispatcher if it's NULL
+    void LinkBlockExit(u8* exit, JitBlockEntry target);
+
+    // if set the next block compiled increments it whenever it's entered
+    u64* ExecutionCounter = NULL;
+    // how much code the last block took up
+    u32 BlockSize;
+
     void LoadReg(int reg, Gen::X64Reg nativeReg);
     void SaveReg(int reg, Gen::X64Reg nativeReg);
 
@@ -181,6 +197,7 @@ public:
     void Comp_RetriveFlags(bool sign, bool retriveCV, bool carryUsed);
 
     void Comp_SpecialBranchBehaviour(bool taken);
+    void Comp_BlockExit(const u32* next, int numNext);
 
 
     Gen::OpArg Comp_RegShiftImm(int op, int amount, Gen::OpArg rm, bool S, bool& carryUsed);
@@ -246,6 +263,15 @@ public:
     u8* NearStart;
     u8* FarStart;
 
+    // the memory for blocks is split into a ring of regions, each with a near and a far part.
+    // When the current one is full we move on to the next one, evicting the blocks
+    // which were compiled into it the last time around.
+    static constexpr int CodeRegionsCount = 8;
+    int CurCodeRegion;
+    u32 CodeRegionNearSize;
+    u32 CodeRegionFarSize;
+    u32 CodeRegionUsed[CodeRegionsCount];
+
     void* PatchedStoreFuncs[2][2][3][16];
     void* PatchedLoadFuncs[2][2][3][2][16];
 
@@ -257,6 +283,17 @@ public:
     bool Exit;
     bool IrregularCycles;
 
+    // the exits of the last block which was compiled
+    // which can be linked to the block they lead to
+    u32 NumExits;
+    BlockExit Exits[MaxBlockExits];
+
+    u8* BlockStart;
+    // set when the current instruction is a branch
+    // leaving the block to a known address
+    bool HasExitTarget;
+    u32 ExitTarget;
+
     void* ReadBanked;
     void* WriteBanked;
 
@@ -146,6 +146,9 @@ void ARMv5::UpdateITCMSetting()
     {
         ITCMSize = 0;
     }
+#ifdef JIT_ENABLED
+    ARMJIT::RelinkBlocks();
+#endif
 }
 
 
@@ -805,6 +808,17 @@ u32 ARMv5::CodeRead32(u32 addr, bool branch)
     return BusRead32(addr);
 }
 
+s32 ARMv5::CodeFetchCycles(u32 addr, bool branch, s32 regionCodeCycles) const
+{
+    if (addr < ITCMSize)
+        return 1;
+
+    if (regionCodeCycles == 0xFF) // cached memory. hax
+        return (branch || !(addr & 0x1F)) ? kCodeCacheTiming : 1;
+
+    return regionCodeCycles;
+}
+
 
 void ARMv5::DataRead8(u32 addr, u32* val)
 {
@@ -19,6 +19,7 @@
 #include <stdio.h>
 #include <string.h>
 #include <inttypes.h>
+#include <algorithm>
 #include "NDS.h"
 #include "DSi.h"
 #include "ARM.h"
@@ -40,6 +41,7 @@
 #include "DSi_NAND.h"
 #include "DSi_DSP.h"
 #include "DSi_Camera.h"
+#include "AESCrypt.h"
 
 #include "tiny-AES-c/aes.hpp"
 
@@ -366,23 +368,20 @@ void DecryptModcryptArea(u32 offset, u32 size, u8* iv)
 
 #undef BINARY_GOOD
 
-    for (u32 i = 0; i < size; i+=16)
+    for (u32 i = 0; i < roundedsize; i += 0x1000)
     {
-        u8 data[16];
+        u8 data[0x1000];
+        u32 len = std::min(roundedsize - i, (u32)sizeof(data));
 
-        *(u32*)&data[0] = ARM9Read32(binaryaddr+i);
-        *(u32*)&data[4] = ARM9Read32(binaryaddr+i+4);
-        *(u32*)&data[8] = ARM9Read32(binaryaddr+i+8);
-        *(u32*)&data[12] = ARM9Read32(binaryaddr+i+12);
+        for (u32 j = 0; j < len; j += 4)
+            *(u32*)&data[j] = ARM9Read32(binaryaddr+i+j);
 
-        DSi_AES::Swap16(tmp, data);
-        AES_CTR_xcrypt_buffer(&ctx, tmp, 16);
-        DSi_AES::Swap16(data, tmp);
+        AESCrypt::SwapBlocks(data, len);
+        AESCrypt::CTRCrypt(&ctx, data, len);
+        AESCrypt::SwapBlocks(data, len);
 
-        ARM9Write32(binaryaddr+i, *(u32*)&data[0]);
-        ARM9Write32(binaryaddr+i+4, *(u32*)&data[4]);
-        ARM9Write32(binaryaddr+i+8, *(u32*)&data[8]);
-        ARM9Write32(binaryaddr+i+12, *(u32*)&data[12]);
+        for (u32 j = 0; j < len; j += 4)
+            ARM9Write32(binaryaddr+i+j, *(u32*)&data[j]);
     }
 }
 
@@ -888,7 +887,9 @@ bool LoadNAND()
         const u8 boot2key[16] = {0xAD, 0x34, 0xEC, 0xF9, 0x62, 0x6E, 0xC2, 0x3A, 0xF6, 0xB4, 0x6C, 0x00, 0x80, 0x80, 0xEE, 0x98};
         u8 boot2iv[16];
         u8 tmp[16];
-        u32 dstaddr;
+        // the binaries are decrypted a chunk at a time
+        u8 data[0x1000];
+        u32 dstaddr, size;
 
         *(u32*)&tmp[0] = bootparams[3];
         *(u32*)&tmp[4] = -bootparams[3];
@@ -900,19 +901,20 @@ bool LoadNAND()
 
         fseek(nand, bootparams[0], SEEK_SET);
         dstaddr = bootparams[2];
-        for (u32 i = 0; i < bootparams[3]; i += 16)
+        size = (bootparams[3] + 0xF) & ~0xF;
+        for (u32 i = 0; i < size; i += sizeof(data))
         {
-            u8 data[16];
-            fread(data, 16, 1, nand);
+            u32 len = std::min(size - i, (u32)sizeof(data));
+            fread(data, len, 1, nand);
 
-            for (int j = 0; j < 16; j++) tmp[j] = data[15-j];
-            AES_CTR_xcrypt_buffer(&ctx, tmp, 16);
-            for (int j = 0; j < 16; j++) data[j] = tmp[15-j];
+            AESCrypt::SwapBlocks(data, len);
+            AESCrypt::CTRCrypt(&ctx, data, len);
+            AESCrypt::SwapBlocks(data, len);
 
-            ARM9Write32(dstaddr, *(u32*)&data[0]); dstaddr += 4;
-            ARM9Write32(dstaddr, *(u32*)&data[4]); dstaddr += 4;
-            ARM9Write32(dstaddr, *(u32*)&data[8]); dstaddr += 4;
-            ARM9Write32(dstaddr, *(u32*)&data[12]); dstaddr += 4;
+            for (u32 j = 0; j < len; j += 4)
+            {
+                ARM9Write32(dstaddr, *(u32*)&data[j]); dstaddr += 4;
+            }
         }
 
         *(u32*)&tmp[0] = bootparams[7];
@@ -925,19 +927,20 @@ bool LoadNAND()
 
         fseek(nand, bootparams[4], SEEK_SET);
         dstaddr = bootparams[6];
-        for (u32 i = 0; i < bootparams[7]; i += 16)
+        size = (bootparams[7] + 0xF) & ~0xF;
+        for (u32 i = 0; i < size; i += sizeof(data))
         {
-            u8 data[16];
-            fread(data, 16, 1, nand);
+            u32 len = std::min(size - i, (u32)sizeof(data));
+            fread(data, len, 1, nand);
 
-            for (int j = 0; j < 16; j++) tmp[j] = data[15-j];
-            AES_CTR_xcrypt_buffer(&ctx, tmp, 16);
-            for (int j = 0; j < 16; j++) data[j] = tmp[15-j];
+            AESCrypt::SwapBlocks(data, len);
+            AESCrypt::CTRCrypt(&ctx, data, len);
+            AESCrypt::SwapBlocks(data, len);
 
-            ARM7Write32(dstaddr, *(u32*)&data[0]); dstaddr += 4;
-            ARM7Write32(dstaddr, *(u32*)&data[4]); dstaddr += 4;
-            ARM7Write32(dstaddr, *(u32*)&data[8]); dstaddr += 4;
-            ARM7Write32(dstaddr, *(u32*)&data[12]); dstaddr += 4;
+            for (u32 j = 0; j < len; j += 4)
+            {
+                ARM7Write32(dstaddr, *(u32*)&data[j]); dstaddr += 4;
+            }
         }
     }
 
@@ -1131,6 +1134,7 @@ void MapNWRAM_B(u32 num, u8 val)
     u8 oldval = (MBK[0][mbkn] >> mbks) & 0xFF;
     if (oldval == val) return;
 
+    DSi_DSP::PrepareNWRAMRemap();
 #ifdef JIT_ENABLED
     ARMJIT_Memory::RemapNWRAM(1);
 #endif
@@ -1180,6 +1184,7 @@ void MapNWRAM_C(u32 num, u8 val)
     u8 oldval = (MBK[0][mbkn] >> mbks) & 0xFF;
     if (oldval == val) return;
 
+    DSi_DSP::PrepareNWRAMRemap();
 #ifdef JIT_ENABLED
     ARMJIT_Memory::RemapNWRAM(2);
 #endif
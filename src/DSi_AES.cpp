@@ -18,9 +18,11 @@
 
 #include <stdio.h>
 #include <string.h>
+#include <algorithm>
 #include "DSi.h"
 #include "DSi_AES.h"
 #include "FIFO.h"
+#include "AESCrypt.h"
 #include "tiny-AES-c/aes.hpp"
 #include "Platform.h"
 
@@ -97,6 +99,8 @@ bool Init()
     const u8 zero[16] = {0};
     AES_init_ctx_iv(&Ctx, zero, zero);
 
+    Log(LogLevel::Info, "DSi AES: using %s\n", AESCrypt::BackendName());
+
     return true;
 }
 
@@ -195,100 +199,47 @@ void DoSavestate(Savestate* file)
 }
 
 
-void ProcessBlock_CCM_Extra()
+// the FIFOs are processed in bursts of whole blocks, the block data is
+// byte reversed for the AES core
+void ReadInputBlocks(u8* data, u32 num)
 {
-    u8 data[16];
-    u8 data_rev[16];
-
-    *(u32*)&data[0] = InputFIFO.Read();
-    *(u32*)&data[4] = InputFIFO.Read();
-    *(u32*)&data[8] = InputFIFO.Read();
-    *(u32*)&data[12] = InputFIFO.Read();
-
-    Swap16(data_rev, data);
+    for (u32 i = 0; i < num*16; i += 4)
+        *(u32*)&data[i] = InputFIFO.Read();
 
-    for (int i = 0; i < 16; i++) CurMAC[i] ^= data_rev[i];
-    AES_ECB_encrypt(&Ctx, CurMAC);
+    AESCrypt::SwapBlocks(data, num*16);
 }
 
-void ProcessBlock_CCM_Decrypt()
+void WriteOutputBlocks(u8* data, u32 num)
 {
-    u8 data[16];
-    u8 data_rev[16];
-
-    *(u32*)&data[0] = InputFIFO.Read();
-    *(u32*)&data[4] = InputFIFO.Read();
-    *(u32*)&data[8] = InputFIFO.Read();
-    *(u32*)&data[12] = InputFIFO.Read();
-
-    //printf("AES-CCM: "); _printhex2(data, 16);
-
-    Swap16(data_rev, data);
+    AESCrypt::SwapBlocks(data, num*16);
 
-    AES_CTR_xcrypt_buffer(&Ctx, data_rev, 16);
-    for (int i = 0; i < 16; i++) CurMAC[i] ^= data_rev[i];
-    AES_ECB_encrypt(&Ctx, CurMAC);
-
-    Swap16(data, data_rev);
-
-    //printf(" -> "); _printhex2(data, 16);
-
-    OutputFIFO.Write(*(u32*)&data[0]);
-    OutputFIFO.Write(*(u32*)&data[4]);
-    OutputFIFO.Write(*(u32*)&data[8]);
-    OutputFIFO.Write(*(u32*)&data[12]);
+    for (u32 i = 0; i < num*16; i += 4)
+        OutputFIFO.Write(*(u32*)&data[i]);
 }
 
-void ProcessBlock_CCM_Encrypt()
+void ProcessBlocks_CCM_Extra(u32 num)
 {
-    u8 data[16];
-    u8 data_rev[16];
-
-    *(u32*)&data[0] = InputFIFO.Read();
-    *(u32*)&data[4] = InputFIFO.Read();
-    *(u32*)&data[8] = InputFIFO.Read();
-    *(u32*)&data[12] = InputFIFO.Read();
-
-    //printf("AES-CCM: "); _printhex2(data, 16);
+    u8 data[16*4];
 
-    Swap16(data_rev, data);
-
-    for (int i = 0; i < 16; i++) CurMAC[i] ^= data_rev[i];
-    AES_CTR_xcrypt_buffer(&Ctx, data_rev, 16);
-    AES_ECB_encrypt(&Ctx, CurMAC);
-
-    Swap16(data, data_rev);
-
-    //printf(" -> "); _printhex2(data, 16);
-
-    OutputFIFO.Write(*(u32*)&data[0]);
-    OutputFIFO.Write(*(u32*)&data[4]);
-    OutputFIFO.Write(*(u32*)&data[8]);
-    OutputFIFO.Write(*(u32*)&data[12]);
+    ReadInputBlocks(data, num);
+    AESCrypt::CBCMAC(&Ctx, data, num*16, CurMAC);
 }
 
-void ProcessBlock_CTR()
+void ProcessBlocks(u32 num)
 {
-    u8 data[16];
-    u8 data_rev[16];
-
-    *(u32*)&data[0] = InputFIFO.Read();
-    *(u32*)&data[4] = InputFIFO.Read();
-    *(u32*)&data[8] = InputFIFO.Read();
-    *(u32*)&data[12] = InputFIFO.Read();
-
-    //printf("AES-CTR: "); _printhex2(data, 16);
+    u8 data[16*4];
 
-    Swap16(data_rev, data);
-    AES_CTR_xcrypt_buffer(&Ctx, data_rev, 16);
-    Swap16(data, data_rev);
+    ReadInputBlocks(data, num);
 
-    //printf(" -> "); _printhex(data, 16);
+    switch (AESMode)
+    {
+    case 0: AESCrypt::CCMDecrypt(&Ctx, data, num*16, CurMAC); break;
+    case 1: AESCrypt::CCMEncrypt(&Ctx, data, num*16, CurMAC); break;
+    case 2:
+    case 3: AESCrypt::CTRCrypt(&Ctx, data, num*16); break;
+    }
 
-    OutputFIFO.Write(*(u32*)&data[0]);
-    OutputFIFO.Write(*(u32*)&data[4]);
-    OutputFIFO.Write(*(u32*)&data[8]);
-    OutputFIFO.Write(*(u32*)&data[12]);
+    WriteOutputBlocks(data, num);
 }
 
 
@@ -363,7 +314,7 @@ void WriteCnt(u32 val)
                 iv[15] = RemBlocks << 4;
 
                 memcpy(CurMAC, iv, 16);
-                AES_ECB_encrypt(&Ctx, CurMAC);
+                AESCrypt::ECBEncrypt(&Ctx, CurMAC);
             }
             else
             {
@@ -460,26 +411,21 @@ void Update()
 {
     if (RemExtra > 0)
     {
-        while (InputFIFO.Level() >= 4 && RemExtra > 0)
+        u32 num = std::min(InputFIFO.Level() >> 2, RemExtra);
+        if (num > 0)
         {
-            ProcessBlock_CCM_Extra();
-            RemExtra--;
+            ProcessBlocks_CCM_Extra(num);
+            RemExtra -= num;
         }
     }
 
     if (RemExtra == 0)
     {
-        while (InputFIFO.Level() >= 4 && OutputFIFO.Level() <= 12 && RemBlocks > 0)
+        u32 num = std::min({InputFIFO.Level() >> 2, (16 - OutputFIFO.Level()) >> 2, RemBlocks});
+        if (num > 0)
         {
-            switch (AESMode)
-            {
-            case 0: ProcessBlock_CCM_Decrypt(); break;
-            case 1: ProcessBlock_CCM_Encrypt(); break;
-            case 2:
-            case 3: ProcessBlock_CTR(); break;
-            }
-
-            RemBlocks--;
+            ProcessBlocks(num);
+            RemBlocks -= num;
         }
     }
 
@@ -492,7 +438,7 @@ void Update()
             Ctx.Iv[13] = 0x00;
             Ctx.Iv[14] = 0x00;
             Ctx.Iv[15] = 0x00;
-            AES_CTR_xcrypt_buffer(&Ctx, CurMAC, 16);
+            AESCrypt::CTRCrypt(&Ctx, CurMAC, 16);
 
             //printf("FINAL MAC: "); _printhexR(CurMAC, 16);
             //printf("INPUT MAC: "); _printhex(MAC, 16);
@@ -508,7 +454,7 @@ void Update()
             Ctx.Iv[13] = 0x00;
             Ctx.Iv[14] = 0x00;
             Ctx.Iv[15] = 0x00;
-            AES_CTR_xcrypt_buffer(&Ctx, CurMAC, 16);
+            AESCrypt::CTRCrypt(&Ctx, CurMAC, 16);
 
             Swap16(OutputMAC, CurMAC);
 
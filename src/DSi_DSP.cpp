@@ -16,6 +16,8 @@
     with melonDS. If not, see http://www.gnu.org/licenses/.
 */
 
+#include <atomic>
+
 #include "teakra/include/teakra/teakra.h"
 
 #include "DSi.h"
@@ -54,6 +56,45 @@ int PDataDMALen = 0;
 constexpr u32 DataMemoryOffset = 0x20000; // from Teakra memory_interface.h
 // NOTE: ^ IS IN DSP WORDS, NOT IN BYTES!
 
+// With DSPThreaded the DSP runs on a thread of its own, in slices which
+// go up to SyncWindow cycles ahead of the ARM9. Everything which looks at
+// or changes the DSP (its registers, remapping its NWRAM, savestates) waits
+// for the current slice first and then catches it up on the spot, the same
+// way it's done without the thread. What the DSP does to the rest of the
+// system (IRQs, AHBM accesses) is handed over to the emu thread.
+bool DSPThreaded;
+u32 SyncWindow;
+
+Platform::Thread* DSPThread = nullptr;
+Platform::Semaphore* SliceStart;
+// posted when the slice is done or the DSP wants to access the ARM9 bus
+Platform::Semaphore* ThreadEvent;
+Platform::Semaphore* BusAccessDone;
+std::atomic<bool> ThreadQuit;
+// only changed by the emu thread
+std::atomic<bool> SliceRunning;
+u32 SliceCycles;
+
+// the IRQs the DSP raised during the current slice
+enum
+{
+    pendingIRQ_Rep0 = 1 << 0,
+    pendingIRQ_Rep1 = 1 << 1,
+    pendingIRQ_Rep2 = 1 << 2,
+    pendingIRQ_Sem = 1 << 3,
+};
+std::atomic<u32> PendingIRQs;
+
+struct BusAccess
+{
+    u8 Size;
+    bool Write;
+    u32 Addr;
+    u32 Value;
+};
+BusAccess PendingBusAccess;
+std::atomic<bool> BusAccessPending;
+
 u16 GetPSTS()
 {
     u16 r = DSP_PSTS & (1<<9); // this is the only sticky bit
@@ -75,23 +116,141 @@ u16 GetPSTS()
 
 void IrqRep0()
 {
+    if (SliceRunning) { PendingIRQs |= pendingIRQ_Rep0; return; }
     if (DSP_PCFG & (1<< 9)) NDS::SetIRQ(0, NDS::IRQ_DSi_DSP);
 }
 void IrqRep1()
 {
+    if (SliceRunning) { PendingIRQs |= pendingIRQ_Rep1; return; }
     if (DSP_PCFG & (1<<10)) NDS::SetIRQ(0, NDS::IRQ_DSi_DSP);
 }
 void IrqRep2()
 {
+    if (SliceRunning) { PendingIRQs |= pendingIRQ_Rep2; return; }
     if (DSP_PCFG & (1<<11)) NDS::SetIRQ(0, NDS::IRQ_DSi_DSP);
 }
 void IrqSem()
 {
+    if (SliceRunning) { PendingIRQs |= pendingIRQ_Sem; return; }
     DSP_PSTS |= 1<<9;
     // apparently these are always fired?
     NDS::SetIRQ(0, NDS::IRQ_DSi_DSP);
 }
 
+u32 DoBusAccess(u8 size, bool write, u32 addr, u32 val)
+{
+    if (write)
+    {
+        switch (size)
+        {
+        case 8: DSi::ARM9Write8(addr, val); break;
+        case 16: DSi::ARM9Write16(addr, val); break;
+        case 32: DSi::ARM9Write32(addr, val); break;
+        }
+        return 0;
+    }
+
+    switch (size)
+    {
+    case 8: return DSi::ARM9Read8(addr);
+    case 16: return DSi::ARM9Read16(addr);
+    case 32: return DSi::ARM9Read32(addr);
+    }
+    return 0;
+}
+
+u32 AHBMAccess(u8 size, bool write, u32 addr, u32 val)
+{
+    if (!SliceRunning)
+        return DoBusAccess(size, write, addr, val);
+
+    // on the DSP thread, wait for the emu thread to do it
+    PendingBusAccess = {size, write, addr, val};
+    BusAccessPending = true;
+    Platform::Semaphore_Post(ThreadEvent);
+    Platform::Semaphore_Wait(BusAccessDone);
+    return PendingBusAccess.Value;
+}
+
+u8 AHBMRead8(u32 addr) { return AHBMAccess(8, false, addr, 0); }
+u16 AHBMRead16(u32 addr) { return AHBMAccess(16, false, addr, 0); }
+u32 AHBMRead32(u32 addr) { return AHBMAccess(32, false, addr, 0); }
+void AHBMWrite8(u32 addr, u8 val) { AHBMAccess(8, true, addr, val); }
+void AHBMWrite16(u32 addr, u16 val) { AHBMAccess(16, true, addr, val); }
+void AHBMWrite32(u32 addr, u32 val) { AHBMAccess(32, true, addr, val); }
+
+void DSPThreadFunc()
+{
+    while (true)
+    {
+        Platform::Semaphore_Wait(SliceStart);
+        if (ThreadQuit)
+            break;
+
+        TeakraCore->Run(SliceCycles);
+        Platform::Semaphore_Post(ThreadEvent);
+    }
+}
+
+void WaitForSlice()
+{
+    if (!SliceRunning)
+        return;
+
+    while (true)
+    {
+        Platform::Semaphore_Wait(ThreadEvent);
+        if (!BusAccessPending)
+            break;
+
+        PendingBusAccess.Value = DoBusAccess(PendingBusAccess.Size, PendingBusAccess.Write,
+            PendingBusAccess.Addr, PendingBusAccess.Value);
+        BusAccessPending = false;
+        Platform::Semaphore_Post(BusAccessDone);
+    }
+
+    SliceRunning = false;
+
+    u32 irqs = PendingIRQs.exchange(0);
+    if (irqs & pendingIRQ_Rep0) IrqRep0();
+    if (irqs & pendingIRQ_Rep1) IrqRep1();
+    if (irqs & pendingIRQ_Rep2) IrqRep2();
+    if (irqs & pendingIRQ_Sem) IrqSem();
+}
+
+void StartDSPThread()
+{
+    if (DSPThread)
+        return;
+
+    SliceStart = Platform::Semaphore_Create();
+    ThreadEvent = Platform::Semaphore_Create();
+    BusAccessDone = Platform::Semaphore_Create();
+    ThreadQuit = false;
+    SliceRunning = false;
+    BusAccessPending = false;
+    PendingIRQs = 0;
+    DSPThread = Platform::Thread_Create(DSPThreadFunc);
+}
+
+void StopDSPThread()
+{
+    if (!DSPThread)
+        return;
+
+    WaitForSlice();
+
+    ThreadQuit = true;
+    Platform::Semaphore_Post(SliceStart);
+    Platform::Thread_Wait(DSPThread);
+    Platform::Thread_Free(DSPThread);
+    DSPThread = nullptr;
+
+    Platform::Semaphore_Free(SliceStart);
+    Platform::Semaphore_Free(ThreadEvent);
+    Platform::Semaphore_Free(BusAccessDone);
+}
+
 u16 DSPRead16(u32 addr)
 {
     if (!(addr & 0x40000))
@@ -148,12 +307,12 @@ bool Init()
     // these happen instantaneously and without too much regard for bus aribtration
     // rules, so, this might have to be changed later on
     Teakra::AHBMCallback cb;
-    cb.read8 = DSi::ARM9Read8;
-    cb.write8 = DSi::ARM9Write8;
-    cb.read16 = DSi::ARM9Read16;
-    cb.write16 = DSi::ARM9Write16;
-    cb.read32 = DSi::ARM9Read32;
-    cb.write32 = DSi::ARM9Write32;
+    cb.read8 = AHBMRead8;
+    cb.write8 = AHBMWrite8;
+    cb.read16 = AHBMRead16;
+    cb.write16 = AHBMWrite16;
+    cb.read32 = AHBMRead32;
+    cb.write32 = AHBMWrite32;
     TeakraCore->SetAHBMCallback(cb);
 
     TeakraCore->SetAudioCallback(AudioCb);
@@ -165,6 +324,8 @@ bool Init()
 }
 void DeInit()
 {
+    StopDSPThread();
+
     //if (PDATAWriteFifo) delete PDATAWriteFifo;
     if (TeakraCore) delete TeakraCore;
 
@@ -175,6 +336,8 @@ void DeInit()
 
 void Reset()
 {
+    WaitForSlice();
+
     DSPTimestamp = 0;
 
     DSP_PADR = 0;
@@ -194,6 +357,19 @@ void Reset()
     NDS::CancelEvent(NDS::Event_DSi_DSP);
 
     SNDExCnt = 0;
+
+    DSPThreaded = Platform::GetConfigBool(Platform::DSi_DSPThreaded);
+    int syncWindow = Platform::GetConfigInt(Platform::DSi_DSPSyncWindow);
+    if (syncWindow < 256)
+        syncWindow = 256;
+    if (syncWindow > 1048576)
+        syncWindow = 1048576;
+    SyncWindow = syncWindow;
+
+    if (DSPThreaded)
+        StartDSPThread();
+    else
+        StopDSPThread();
 }
 
 bool IsRstReleased()
@@ -207,6 +383,12 @@ void SetRstLine(bool release)
     DSPTimestamp = NDS::ARM9Timestamp; // only start now!
 }
 
+void PrepareNWRAMRemap()
+{
+    WaitForSlice();
+    TeakraCore->InvalidateProgramCache();
+}
+
 inline bool IsDSPCoreEnabled()
 {
     return (DSi::SCFG_Clock9 & (1<<1)) && SCFG_RST && (!(DSP_PCFG & (1<<0)));
@@ -220,6 +402,8 @@ inline bool IsDSPIOEnabled()
 bool DSPCatchUp()
 {
     //asm volatile("int3");
+    WaitForSlice();
+
     if (!IsDSPCoreEnabled())
     {
         // nothing to do, but advance the current time so that we don't do an
@@ -245,7 +429,40 @@ bool DSPCatchUp()
 
     return true;
 }
-void DSPCatchUpU32(u32 _) { DSPCatchUp(); }
+
+// the next slice for the DSP thread, after the one before is done
+void StartSlice()
+{
+    WaitForSlice();
+
+    if (!IsDSPCoreEnabled())
+    {
+        DSPCatchUp();
+        return;
+    }
+
+    u64 target = NDS::ARM9Timestamp + SyncWindow;
+    if (DSPTimestamp < target)
+    {
+        // the DSP can't be further behind than that, every
+        // access from outside catches it up completely
+        SliceCycles = (u32)(target - DSPTimestamp);
+        DSPTimestamp = target;
+
+        SliceRunning = true;
+        Platform::Semaphore_Post(SliceStart);
+    }
+
+    NDS::ScheduleEvent(NDS::Event_DSi_DSP, false, SyncWindow, DSPCatchUpU32, 0);
+}
+
+void DSPCatchUpU32(u32 _)
+{
+    if (DSPThread)
+        StartSlice();
+    else
+        DSPCatchUp();
+}
 
 void PDataDMAWrite(u16 wrval)
 {
@@ -579,11 +796,13 @@ void Run(u32 cycles)
 
     NDS::CancelEvent(NDS::Event_DSi_DSP);
     NDS::ScheduleEvent(NDS::Event_DSi_DSP, false,
-            16384/*from citra (TeakraSlice)*/, DSPCatchUpU32, 0);
+            DSPThread ? SyncWindow : 16384/*from citra (TeakraSlice)*/, DSPCatchUpU32, 0);
 }
 
 void DoSavestate(Savestate* file)
 {
+    WaitForSlice();
+
     file->Section("DSPi");
 
     PDATAReadFifo.DoSavestate(file);
@@ -53,6 +53,10 @@ void DSPCatchUpU32(u32 _);
 bool IsRstReleased();
 void SetRstLine(bool release);
 
+// has to be called before NWRAM banks B and C are remapped,
+// the DSP keeps its code and data in there
+void PrepareNWRAMRemap();
+
 // DSP_* regs (0x040043xx) (NOTE: checks SCFG_EXT)
 u8 Read8(u32 addr);
 void Write8(u32 addr, u8 val);
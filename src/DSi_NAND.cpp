@@ -17,12 +17,22 @@
 */
 
 #include <stdio.h>
+#include <algorithm>
 #include <codecvt>
+#include <unordered_map>
+#include <vector>
+
+#ifdef _WIN32
+#include <io.h>
+#elif !defined(__SWITCH__)
+#include <sys/mman.h>
+#endif
 
 #include "DSi.h"
 #include "DSi_AES.h"
 #include "DSi_NAND.h"
 #include "Platform.h"
+#include "AESCrypt.h"
 
 #include "sha1/sha1.hpp"
 #include "tiny-AES-c/aes.hpp"
@@ -38,6 +48,36 @@ namespace DSi_NAND
 FILE* CurFile;
 FATFS CurFS;
 
+// the image is mapped into memory where possible,
+// otherwise it's accessed through CurFile
+u8* NANDImage;
+u64 NANDImageSize;
+#ifdef _WIN32
+HANDLE NANDMapping;
+#endif
+
+// recently used sectors of the FAT partition, decrypted.
+// writes stay in here until they're evicted or FatFs syncs
+struct CachedSector
+{
+    u32 Sector;
+    bool Dirty;
+    u32 Prev, Next;
+    u8 Data[0x200];
+};
+
+const u32 SectorCacheSize = 1024;
+const u32 SectorCacheNone = 0xFFFFFFFF;
+// bigger accesses are file contents, they'd only push
+// the filesystem structures out so they go around the cache
+const u32 SectorCacheMaxAccess = 16;
+
+std::vector<CachedSector> SectorCache;
+std::unordered_map<u32, u32> SectorCacheMap;
+// most recently used first
+u32 SectorCacheHead, SectorCacheTail;
+u32 SectorCacheUsed;
+
 u8 eMMC_CID[16];
 u64 ConsoleID;
 
@@ -49,11 +89,61 @@ u8 ESKey[16];
 
 UINT FF_ReadNAND(BYTE* buf, LBA_t sector, UINT num);
 UINT FF_WriteNAND(BYTE* buf, LBA_t sector, UINT num);
+UINT FF_SyncNAND();
+
+void ResetSectorCache();
+bool FlushSectorCache();
+
+void MapImage(FILE* file, u64 len)
+{
+    NANDImage = nullptr;
+    NANDImageSize = 0;
+
+#ifdef _WIN32
+    HANDLE handle = (HANDLE)_get_osfhandle(_fileno(file));
+    NANDMapping = CreateFileMappingA(handle, nullptr, PAGE_READWRITE, 0, 0, nullptr);
+    if (NANDMapping)
+    {
+        NANDImage = (u8*)MapViewOfFile(NANDMapping, FILE_MAP_READ | FILE_MAP_WRITE, 0, 0, 0);
+        if (!NANDImage)
+        {
+            CloseHandle(NANDMapping);
+            NANDMapping = nullptr;
+        }
+    }
+#elif !defined(__SWITCH__)
+    void* map = mmap(nullptr, len, PROT_READ | PROT_WRITE, MAP_SHARED, fileno(file), 0);
+    if (map != MAP_FAILED)
+        NANDImage = (u8*)map;
+#endif
+
+    if (NANDImage)
+        NANDImageSize = len;
+    else
+        Log(LogLevel::Warn, "DSi NAND: couldn't map the image, falling back to file accesses\n");
+}
+
+void UnmapImage()
+{
+    if (!NANDImage) return;
+
+#ifdef _WIN32
+    UnmapViewOfFile(NANDImage);
+    CloseHandle(NANDMapping);
+    NANDMapping = nullptr;
+#elif !defined(__SWITCH__)
+    munmap(NANDImage, NANDImageSize);
+#endif
+
+    NANDImage = nullptr;
+    NANDImageSize = 0;
+}
 
 
 bool Init(u8* es_keyY)
 {
     CurFile = nullptr;
+    ResetSectorCache();
 
     std::string nandpath = Platform::GetConfigString(Platform::DSi_NANDPath);
     std::string instnand = nandpath + Platform::InstanceFileSuffix();
@@ -100,6 +190,7 @@ bool Init(u8* es_keyY)
     u64 nandlen = ftell(nandfile);
 
     ff_disk_open(FF_ReadNAND, FF_WriteNAND, (LBA_t)(nandlen>>9));
+    ff_disk_sync_callback(FF_SyncNAND);
 
     FRESULT res;
     res = f_mount(&CurFS, "0:", 0);
@@ -171,6 +262,8 @@ bool Init(u8* es_keyY)
     DSi_AES::DeriveNormalKey(keyX, keyY, tmp);
     DSi_AES::Swap16(ESKey, tmp);
 
+    MapImage(nandfile, nandlen);
+
     CurFile = nandfile;
     return true;
 }
@@ -178,8 +271,12 @@ bool Init(u8* es_keyY)
 void DeInit()
 {
     f_unmount("0:");
+    if (CurFile) FlushSectorCache();
     ff_disk_close();
 
+    UnmapImage();
+    ResetSectorCache();
+
     if (CurFile) fclose(CurFile);
     CurFile = nullptr;
 }
@@ -229,18 +326,22 @@ u32 ReadFATBlock(u64 addr, u32 len, u8* buf)
     AES_ctx ctx;
     SetupFATCrypto(&ctx, ctr);
 
-    fseek(CurFile, addr, SEEK_SET);
-    u32 res = fread(buf, len, 1, CurFile);
-    if (!res) return 0;
-
-    for (u32 i = 0; i < len; i += 16)
+    if (NANDImage)
+    {
+        if ((addr + len) > NANDImageSize) return 0;
+        memcpy(buf, &NANDImage[addr], len);
+    }
+    else
     {
-        u8 tmp[16];
-        DSi_AES::Swap16(tmp, &buf[i]);
-        AES_CTR_xcrypt_buffer(&ctx, tmp, 16);
-        DSi_AES::Swap16(&buf[i], tmp);
+        fseek(CurFile, addr, SEEK_SET);
+        u32 res = fread(buf, len, 1, CurFile);
+        if (!res) return 0;
     }
 
+    AESCrypt::SwapBlocks(buf, len);
+    AESCrypt::CTRCrypt(&ctx, buf, len);
+    AESCrypt::SwapBlocks(buf, len);
+
     return len;
 }
 
@@ -251,48 +352,245 @@ u32 WriteFATBlock(u64 addr, u32 len, u8* buf)
     AES_ctx ctx;
     SetupFATCrypto(&ctx, ctr);
 
-    fseek(CurFile, addr, SEEK_SET);
+    if (NANDImage)
+    {
+        if ((addr + len) > NANDImageSize) return 0;
+    }
+    else
+        fseek(CurFile, addr, SEEK_SET);
 
     for (u32 s = 0; s < len; s += 0x200)
     {
         u8 tempbuf[0x200];
 
-        for (u32 i = 0; i < 0x200; i += 16)
+        memcpy(tempbuf, &buf[s], 0x200);
+        AESCrypt::SwapBlocks(tempbuf, 0x200);
+        AESCrypt::CTRCrypt(&ctx, tempbuf, 0x200);
+        AESCrypt::SwapBlocks(tempbuf, 0x200);
+
+        if (NANDImage)
+            memcpy(&NANDImage[addr+s], tempbuf, 0x200);
+        else
         {
-            u8 tmp[16];
-            DSi_AES::Swap16(tmp, &buf[s+i]);
-            AES_CTR_xcrypt_buffer(&ctx, tmp, 16);
-            DSi_AES::Swap16(&tempbuf[i], tmp);
+            u32 res = fwrite(tempbuf, 0x200, 1, CurFile);
+            if (!res) return 0;
         }
-
-        u32 res = fwrite(tempbuf, 0x200, 1, CurFile);
-        if (!res) return 0;
     }
 
     return len;
 }
 
 
-UINT FF_ReadNAND(BYTE* buf, LBA_t sector, UINT num)
+u64 SectorAddr(u32 sector)
 {
     // TODO: allow selecting other partitions?
     u64 baseaddr = 0x10EE00;
 
-    u64 blockaddr = baseaddr + (sector * 0x200ULL);
+    return baseaddr + (sector * 0x200ULL);
+}
+
+void ResetSectorCache()
+{
+    SectorCache.resize(SectorCacheSize);
+    SectorCacheMap.clear();
+    SectorCacheHead = SectorCacheNone;
+    SectorCacheTail = SectorCacheNone;
+    SectorCacheUsed = 0;
+}
+
+void UnlinkCachedSector(u32 idx)
+{
+    CachedSector& entry = SectorCache[idx];
+
+    if (entry.Prev != SectorCacheNone) SectorCache[entry.Prev].Next = entry.Next;
+    else                               SectorCacheHead = entry.Next;
+    if (entry.Next != SectorCacheNone) SectorCache[entry.Next].Prev = entry.Prev;
+    else                               SectorCacheTail = entry.Prev;
+}
+
+void LinkCachedSector(u32 idx)
+{
+    CachedSector& entry = SectorCache[idx];
 
-    u32 res = ReadFATBlock(blockaddr, num*0x200, buf);
-    return res >> 9;
+    entry.Prev = SectorCacheNone;
+    entry.Next = SectorCacheHead;
+    if (SectorCacheHead != SectorCacheNone) SectorCache[SectorCacheHead].Prev = idx;
+    else                                    SectorCacheTail = idx;
+    SectorCacheHead = idx;
+}
+
+bool WriteBackSector(CachedSector& entry)
+{
+    if (!WriteFATBlock(SectorAddr(entry.Sector), 0x200, entry.Data))
+        return false;
+
+    entry.Dirty = false;
+    return true;
+}
+
+CachedSector* FindCachedSector(u32 sector)
+{
+    auto it = SectorCacheMap.find(sector);
+    if (it == SectorCacheMap.end())
+        return nullptr;
+
+    u32 idx = it->second;
+    if (idx != SectorCacheHead)
+    {
+        UnlinkCachedSector(idx);
+        LinkCachedSector(idx);
+    }
+    return &SectorCache[idx];
+}
+
+CachedSector* AddCachedSector(u32 sector)
+{
+    u32 idx;
+    if (SectorCacheUsed < SectorCacheSize)
+        idx = SectorCacheUsed++;
+    else
+    {
+        idx = SectorCacheTail;
+
+        CachedSector& old = SectorCache[idx];
+        if (old.Dirty && !WriteBackSector(old))
+            return nullptr;
+
+        SectorCacheMap.erase(old.Sector);
+        UnlinkCachedSector(idx);
+    }
+
+    CachedSector& entry = SectorCache[idx];
+    entry.Sector = sector;
+    entry.Dirty = false;
+    SectorCacheMap[sector] = idx;
+    LinkCachedSector(idx);
+
+    return &entry;
+}
+
+bool FlushSectorCache()
+{
+    bool ret = true;
+
+    std::vector<u32> dirty;
+    for (u32 i = 0; i < SectorCacheUsed; i++)
+    {
+        if (SectorCache[i].Dirty)
+            dirty.push_back(i);
+    }
+
+    // neighbouring sectors are written back together
+    std::sort(dirty.begin(), dirty.end(), [](u32 a, u32 b)
+    {
+        return SectorCache[a].Sector < SectorCache[b].Sector;
+    });
+
+    for (u32 i = 0; i < dirty.size();)
+    {
+        u8 buf[SectorCacheMaxAccess * 0x200];
+        u32 first = SectorCache[dirty[i]].Sector;
+        u32 num = 0;
+        while ((i+num) < dirty.size() && num < SectorCacheMaxAccess &&
+               SectorCache[dirty[i+num]].Sector == (first+num))
+        {
+            memcpy(&buf[num*0x200], SectorCache[dirty[i+num]].Data, 0x200);
+            num++;
+        }
+
+        if (WriteFATBlock(SectorAddr(first), num*0x200, buf))
+        {
+            for (u32 j = 0; j < num; j++)
+                SectorCache[dirty[i+j]].Dirty = false;
+        }
+        else
+            ret = false;
+
+        i += num;
+    }
+
+    if (!NANDImage && CurFile)
+        fflush(CurFile);
+
+    return ret;
+}
+
+
+UINT FF_ReadNAND(BYTE* buf, LBA_t sector, UINT num)
+{
+    bool cache = (num <= SectorCacheMaxAccess);
+
+    UINT i = 0;
+    while (i < num)
+    {
+        CachedSector* entry = FindCachedSector(sector+i);
+        if (entry)
+        {
+            memcpy(&buf[i*0x200], entry->Data, 0x200);
+            i++;
+            continue;
+        }
+
+        // everything up to the next cached sector can be read at once
+        UINT len = 1;
+        while ((i+len) < num && !SectorCacheMap.count(sector+i+len))
+            len++;
+
+        u32 res = ReadFATBlock(SectorAddr(sector+i), len*0x200, &buf[i*0x200]);
+        if (!res) return i;
+
+        if (cache)
+        {
+            for (UINT j = 0; j < len; j++)
+            {
+                entry = AddCachedSector(sector+i+j);
+                if (entry) memcpy(entry->Data, &buf[(i+j)*0x200], 0x200);
+            }
+        }
+
+        i += len;
+    }
+
+    return num;
 }
 
 UINT FF_WriteNAND(BYTE* buf, LBA_t sector, UINT num)
 {
-    // TODO: allow selecting other partitions?
-    u64 baseaddr = 0x10EE00;
+    if (num > SectorCacheMaxAccess)
+    {
+        u32 res = WriteFATBlock(SectorAddr(sector), num*0x200, buf);
+        if (!res) return 0;
+
+        // the cached copies of these are out of date now
+        for (UINT i = 0; i < num; i++)
+        {
+            auto it = SectorCacheMap.find(sector+i);
+            if (it == SectorCacheMap.end()) continue;
+
+            CachedSector& entry = SectorCache[it->second];
+            memcpy(entry.Data, &buf[i*0x200], 0x200);
+            entry.Dirty = false;
+        }
+
+        return num;
+    }
 
-    u64 blockaddr = baseaddr + (sector * 0x200ULL);
+    for (UINT i = 0; i < num; i++)
+    {
+        CachedSector* entry = FindCachedSector(sector+i);
+        if (!entry) entry = AddCachedSector(sector+i);
+        if (!entry) return i;
+
+        memcpy(entry->Data, &buf[i*0x200], 0x200);
+        entry->Dirty = true;
+    }
+
+    return num;
+}
 
-    u32 res = WriteFATBlock(blockaddr, num*0x200, buf);
-    return res >> 9;
+UINT FF_SyncNAND()
+{
+    return FlushSectorCache() ? 1 : 0;
 }
 
 
@@ -317,21 +615,12 @@ bool ESEncrypt(u8* data, u32 len)
     mac[14] = (blklen >> 8) & 0xFF;
     mac[15] = blklen & 0xFF;
 
-    AES_ECB_encrypt(&ctx, mac);
+    AESCrypt::ECBEncrypt(&ctx, mac);
 
     u32 coarselen = len & ~0xF;
-    for (u32 i = 0; i < coarselen; i += 16)
-    {
-        u8 tmp[16];
-
-        DSi_AES::Swap16(tmp, &data[i]);
-
-        for (int i = 0; i < 16; i++) mac[i] ^= tmp[i];
-        AES_CTR_xcrypt_buffer(&ctx, tmp, 16);
-        AES_ECB_encrypt(&ctx, mac);
-
-        DSi_AES::Swap16(&data[i], tmp);
-    }
+    AESCrypt::SwapBlocks(data, coarselen);
+    AESCrypt::CCMEncrypt(&ctx, data, coarselen, mac);
+    AESCrypt::SwapBlocks(data, coarselen);
 
     u32 remlen = len - coarselen;
     if (remlen)
@@ -344,8 +633,8 @@ bool ESEncrypt(u8* data, u32 len)
             rem[15-i] = data[coarselen+i];
 
         for (int i = 0; i < 16; i++) mac[i] ^= rem[i];
-        AES_CTR_xcrypt_buffer(&ctx, rem, 16);
-        AES_ECB_encrypt(&ctx, mac);
+        AESCrypt::CTRCrypt(&ctx, rem, 16);
+        AESCrypt::ECBEncrypt(&ctx, mac);
 
         for (int i = 0; i < remlen; i++)
             data[coarselen+i] = rem[15-i];
@@ -354,7 +643,7 @@ bool ESEncrypt(u8* data, u32 len)
     ctx.Iv[13] = 0x00;
     ctx.Iv[14] = 0x00;
     ctx.Iv[15] = 0x00;
-    AES_CTR_xcrypt_buffer(&ctx, mac, 16);
+    AESCrypt::CTRCrypt(&ctx, mac, 16);
 
     for (int i = 0; i < 16; i++)
         data[len+i] = mac[15-i];
@@ -373,7 +662,7 @@ bool ESEncrypt(u8* data, u32 len)
     footer[0] = len & 0xFF;
 
     AES_ctx_set_iv(&ctx, iv);
-    AES_CTR_xcrypt_buffer(&ctx, footer, 16);
+    AESCrypt::CTRCrypt(&ctx, footer, 16);
 
     data[len+0x10] = footer[15];
     data[len+0x1D] = footer[2];
@@ -404,21 +693,12 @@ bool ESDecrypt(u8* data, u32 len)
     mac[14] = (blklen >> 8) & 0xFF;
     mac[15] = blklen & 0xFF;
 
-    AES_ECB_encrypt(&ctx, mac);
+    AESCrypt::ECBEncrypt(&ctx, mac);
 
     u32 coarselen = len & ~0xF;
-    for (u32 i = 0; i < coarselen; i += 16)
-    {
-        u8 tmp[16];
-
-        DSi_AES::Swap16(tmp, &data[i]);
-
-        AES_CTR_xcrypt_buffer(&ctx, tmp, 16);
-        for (int i = 0; i < 16; i++) mac[i] ^= tmp[i];
-        AES_ECB_encrypt(&ctx, mac);
-
-        DSi_AES::Swap16(&data[i], tmp);
-    }
+    AESCrypt::SwapBlocks(data, coarselen);
+    AESCrypt::CCMDecrypt(&ctx, data, coarselen, mac);
+    AESCrypt::SwapBlocks(data, coarselen);
 
     u32 remlen = len - coarselen;
     if (remlen)
@@ -432,15 +712,15 @@ bool ESDecrypt(u8* data, u32 len)
 
         memset(rem, 0, 16);
         AES_ctx_set_iv(&ctx, iv);
-        AES_CTR_xcrypt_buffer(&ctx, rem, 16);
+        AESCrypt::CTRCrypt(&ctx, rem, 16);
 
         for (int i = 0; i < remlen; i++)
             rem[15-i] = data[coarselen+i];
 
         AES_ctx_set_iv(&ctx, iv);
-        AES_CTR_xcrypt_buffer(&ctx, rem, 16);
+        AESCrypt::CTRCrypt(&ctx, rem, 16);
         for (int i = 0; i < 16; i++) mac[i] ^= rem[i];
-        AES_ECB_encrypt(&ctx, mac);
+        AESCrypt::ECBEncrypt(&ctx, mac);
 
         for (int i = 0; i < remlen; i++)
             data[coarselen+i] = rem[15-i];
@@ -449,7 +729,7 @@ bool ESDecrypt(u8* data, u32 len)
     ctx.Iv[13] = 0x00;
     ctx.Iv[14] = 0x00;
     ctx.Iv[15] = 0x00;
-    AES_CTR_xcrypt_buffer(&ctx, mac, 16);
+    AESCrypt::CTRCrypt(&ctx, mac, 16);
 
     u8 footer[16];
 
@@ -463,7 +743,7 @@ bool ESDecrypt(u8* data, u32 len)
         footer[15-i] = data[len+0x10+i];
 
     AES_ctx_set_iv(&ctx, iv);
-    AES_CTR_xcrypt_buffer(&ctx, footer, 16);
+    AESCrypt::CTRCrypt(&ctx, footer, 16);
 
     data[len+0x10] = footer[15];
     data[len+0x1D] = footer[2];
@@ -22,6 +22,7 @@
 #include "DSi_NDMA.h"
 #include "GPU.h"
 #include "DSi_AES.h"
+#include "Profiler.h"
 
 using Platform::Log;
 using Platform::LogLevel;
@@ -191,6 +192,10 @@ void DSi_NDMA::Start()
 void DSi_NDMA::Run()
 {
     if (!Running) return;
+
+    PROFILE_SCOPE(Section_DMA);
+    PROFILE_COUNT(Counter_DMARuns);
+
     if (CPU == 0) return Run9();
     else          return Run7();
 }
@@ -25,6 +25,7 @@
 #endif
 
 #include "GPU2D_Soft.h"
+#include "Profiler.h"
 
 using Platform::Log;
 using Platform::LogLevel;
@@ -203,6 +204,8 @@ void ResetVRAMCache()
 
 void Reset()
 {
+    GPU2D_Renderer->SyncScanlines();
+
     VCount = 0;
     NextVCount = -1;
     TotalScanlines = 0;
@@ -306,6 +309,8 @@ void Stop()
 
 void DoSavestate(Savestate* file)
 {
+    GPU2D_Renderer->SyncScanlines();
+
     file->Section("GPUG");
 
     file->Var16(&VCount);
@@ -485,6 +490,10 @@ void SetRenderSettings(int renderer, RenderSettings& settings)
         GPU3D::CurrentRenderer->SetRenderSettings(settings);
     }
 #endif
+
+    // the accelerated renderers do the final compositing on the GPU
+    // which needs the 2D scanlines to be ready at the right time
+    GPU2D_Renderer->SetThreaded(settings.Threaded2D && !GPU3D::CurrentRenderer->Accelerated);
 }
 
 
@@ -1035,6 +1044,8 @@ void StartFrame()
 
 void StartHBlank(u32 line)
 {
+    PROFILE_SCOPE(Section_GPU2D);
+
     DispStat[0] |= (1<<1);
     DispStat[1] |= (1<<1);
 
@@ -1059,6 +1070,8 @@ void StartHBlank(u32 line)
     }
     else if (VCount == 215)
     {
+        // the 3D renderer is about to start on the next frame
+        GPU2D_Renderer->SyncScanlines();
         GPU3D::VCount215();
     }
     else if (VCount == 262)
@@ -1078,6 +1091,8 @@ void StartHBlank(u32 line)
 
 void FinishFrame(u32 lines)
 {
+    GPU2D_Renderer->SyncScanlines();
+
     FrontBuffer = FrontBuffer ? 0 : 1;
     AssignFramebuffers();
 
@@ -1207,6 +1222,9 @@ void SetVCount(u16 val)
     // 3D engine seems to give up on the current frame in that situation, repeating the last two scanlines
     // TODO: also check the various DMA types that can be involved
 
+    // scanlines which are still being drawn need to see the old state
+    GPU2D_Renderer->SyncScanlines();
+
     GPU3D::AbortFrame |= NextVCount != val;
     NextVCount = val;
 }
@@ -1283,7 +1301,7 @@ template NonStupidBitField<256*1024/VRAMDirtyGranularity> VRAMTrackingSet<256*10
 template NonStupidBitField<512*1024/VRAMDirtyGranularity> VRAMTrackingSet<512*1024, 16*1024>::DeriveState(u32*);
 
 template <u32 MappingGranularity, u32 Size>
-inline bool CopyLinearVRAM(u8* flat, u32* mappings, NonStupidBitField<Size>& dirty, u64 (*slowAccess)(u32 addr))
+inline bool CopyLinearVRAM(u8* flat, u32* mappings, NonStupidBitField<Size>& dirty, u64 (*slowAccess)(u32 addr), VRAMFlatLog* log = nullptr)
 {
     const u32 VRAMBitsPerMapping = MappingGranularity / VRAMDirtyGranularity;
 
@@ -1293,7 +1311,7 @@ inline bool CopyLinearVRAM(u8* flat, u32* mappings, NonStupidBitField<Size>& dir
     while (it != dirty.End())
     {
         u32 offset = *it * VRAMDirtyGranularity;
-        u8* dst = flat + offset;
+        u8* dst = log ? log->Append(flat + offset) : (flat + offset);
         u8* fastAccess = GetUniqueBankPtr(mappings[*it / VRAMBitsPerMapping], offset);
         if (fastAccess)
         {
@@ -1319,22 +1337,22 @@ bool MakeVRAMFlat_TexPalCoherent(NonStupidBitField<128*1024/VRAMDirtyGranularity
     return CopyLinearVRAM<16*1024>(VRAMFlat_TexPal, VRAMMap_TexPal, dirty, ReadVRAM_TexPal<u64>);
 }
 
-bool MakeVRAMFlat_ABGCoherent(NonStupidBitField<512*1024/VRAMDirtyGranularity>& dirty)
+bool MakeVRAMFlat_ABGCoherent(NonStupidBitField<512*1024/VRAMDirtyGranularity>& dirty, VRAMFlatLog* log)
 {
-    return CopyLinearVRAM<16*1024>(VRAMFlat_ABG, VRAMMap_ABG, dirty, ReadVRAM_ABG<u64>);
+    return CopyLinearVRAM<16*1024>(VRAMFlat_ABG, VRAMMap_ABG, dirty, ReadVRAM_ABG<u64>, log);
 }
-bool MakeVRAMFlat_BBGCoherent(NonStupidBitField<128*1024/VRAMDirtyGranularity>& dirty)
+bool MakeVRAMFlat_BBGCoherent(NonStupidBitField<128*1024/VRAMDirtyGranularity>& dirty, VRAMFlatLog* log)
 {
-    return CopyLinearVRAM<16*1024>(VRAMFlat_BBG, VRAMMap_BBG, dirty, ReadVRAM_BBG<u64>);
+    return CopyLinearVRAM<16*1024>(VRAMFlat_BBG, VRAMMap_BBG, dirty, ReadVRAM_BBG<u64>, log);
 }
 
-bool MakeVRAMFlat_AOBJCoherent(NonStupidBitField<256*1024/VRAMDirtyGranularity>& dirty)
+bool MakeVRAMFlat_AOBJCoherent(NonStupidBitField<256*1024/VRAMDirtyGranularity>& dirty, VRAMFlatLog* log)
 {
-    return CopyLinearVRAM<16*1024>(VRAMFlat_AOBJ, VRAMMap_AOBJ, dirty, ReadVRAM_AOBJ<u64>);
+    return CopyLinearVRAM<16*1024>(VRAMFlat_AOBJ, VRAMMap_AOBJ, dirty, ReadVRAM_AOBJ<u64>, log);
 }
-bool MakeVRAMFlat_BOBJCoherent(NonStupidBitField<128*1024/VRAMDirtyGranularity>& dirty)
+bool MakeVRAMFlat_BOBJCoherent(NonStupidBitField<128*1024/VRAMDirtyGranularity>& dirty, VRAMFlatLog* log)
 {
-    return CopyLinearVRAM<16*1024>(VRAMFlat_BOBJ, VRAMMap_BOBJ, dirty, ReadVRAM_BOBJ<u64>);
+    return CopyLinearVRAM<16*1024>(VRAMFlat_BOBJ, VRAMMap_BOBJ, dirty, ReadVRAM_BOBJ<u64>, log);
 }
 
 template<typename T>
@@ -1384,22 +1402,22 @@ T ReadVRAM_BOBJExtPal(u32 addr)
     return ret;
 }
 
-bool MakeVRAMFlat_ABGExtPalCoherent(NonStupidBitField<32*1024/VRAMDirtyGranularity>& dirty)
+bool MakeVRAMFlat_ABGExtPalCoherent(NonStupidBitField<32*1024/VRAMDirtyGranularity>& dirty, VRAMFlatLog* log)
 {
-    return CopyLinearVRAM<8*1024>(VRAMFlat_ABGExtPal, VRAMMap_ABGExtPal, dirty, ReadVRAM_ABGExtPal<u64>);
+    return CopyLinearVRAM<8*1024>(VRAMFlat_ABGExtPal, VRAMMap_ABGExtPal, dirty, ReadVRAM_ABGExtPal<u64>, log);
 }
-bool MakeVRAMFlat_BBGExtPalCoherent(NonStupidBitField<32*1024/VRAMDirtyGranularity>& dirty)
+bool MakeVRAMFlat_BBGExtPalCoherent(NonStupidBitField<32*1024/VRAMDirtyGranularity>& dirty, VRAMFlatLog* log)
 {
-    return CopyLinearVRAM<8*1024>(VRAMFlat_BBGExtPal, VRAMMap_BBGExtPal, dirty, ReadVRAM_BBGExtPal<u64>);
+    return CopyLinearVRAM<8*1024>(VRAMFlat_BBGExtPal, VRAMMap_BBGExtPal, dirty, ReadVRAM_BBGExtPal<u64>, log);
 }
 
-bool MakeVRAMFlat_AOBJExtPalCoherent(NonStupidBitField<8*1024/VRAMDirtyGranularity>& dirty)
+bool MakeVRAMFlat_AOBJExtPalCoherent(NonStupidBitField<8*1024/VRAMDirtyGranularity>& dirty, VRAMFlatLog* log)
 {
-    return CopyLinearVRAM<8*1024>(VRAMFlat_AOBJExtPal, &VRAMMap_AOBJExtPal, dirty, ReadVRAM_AOBJExtPal<u64>);
+    return CopyLinearVRAM<8*1024>(VRAMFlat_AOBJExtPal, &VRAMMap_AOBJExtPal, dirty, ReadVRAM_AOBJExtPal<u64>, log);
 }
-bool MakeVRAMFlat_BOBJExtPalCoherent(NonStupidBitField<8*1024/VRAMDirtyGranularity>& dirty)
+bool MakeVRAMFlat_BOBJExtPalCoherent(NonStupidBitField<8*1024/VRAMDirtyGranularity>& dirty, VRAMFlatLog* log)
 {
-    return CopyLinearVRAM<8*1024>(VRAMFlat_BOBJExtPal, &VRAMMap_BOBJExtPal, dirty, ReadVRAM_BOBJExtPal<u64>);
+    return CopyLinearVRAM<8*1024>(VRAMFlat_BOBJExtPal, &VRAMMap_BOBJExtPal, dirty, ReadVRAM_BOBJExtPal<u64>, log);
 }
 
 }
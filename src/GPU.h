@@ -20,6 +20,7 @@
 #define GPU_H
 
 #include <memory>
+#include <vector>
 
 #include "GPU2D.h"
 #include "NonStupidBitfield.h"
@@ -116,6 +117,33 @@ extern VRAMTrackingSet<8*1024, 8*1024> VRAMDirty_BOBJExtPal;
 extern VRAMTrackingSet<512*1024, 128*1024> VRAMDirty_Texture;
 extern VRAMTrackingSet<128*1024, 16*1024> VRAMDirty_TexPal;
 
+// blocks of flat VRAM which still have to be updated
+// used to hand VRAM changes over to the threaded 2D renderer
+struct VRAMFlatLog
+{
+    std::vector<u8*> Dst;
+    std::vector<u8> Data;
+
+    u8* Append(u8* dst)
+    {
+        Dst.push_back(dst);
+        Data.resize(Data.size() + VRAMDirtyGranularity);
+        return &Data[Data.size() - VRAMDirtyGranularity];
+    }
+
+    void Apply()
+    {
+        for (size_t i = 0; i < Dst.size(); i++)
+            memcpy(Dst[i], &Data[i * VRAMDirtyGranularity], VRAMDirtyGranularity);
+    }
+
+    void Clear()
+    {
+        Dst.clear();
+        Data.clear();
+    }
+};
+
 extern u8 VRAMFlat_ABG[512*1024];
 extern u8 VRAMFlat_BBG[128*1024];
 extern u8 VRAMFlat_AOBJ[256*1024];
@@ -130,17 +158,17 @@ extern u8 VRAMFlat_BOBJExtPal[8*1024];
 extern u8 VRAMFlat_Texture[512*1024];
 extern u8 VRAMFlat_TexPal[128*1024];
 
-bool MakeVRAMFlat_ABGCoherent(NonStupidBitField<512*1024/VRAMDirtyGranularity>& dirty);
-bool MakeVRAMFlat_BBGCoherent(NonStupidBitField<128*1024/VRAMDirtyGranularity>& dirty);
+bool MakeVRAMFlat_ABGCoherent(NonStupidBitField<512*1024/VRAMDirtyGranularity>& dirty, VRAMFlatLog* log = nullptr);
+bool MakeVRAMFlat_BBGCoherent(NonStupidBitField<128*1024/VRAMDirtyGranularity>& dirty, VRAMFlatLog* log = nullptr);
 
-bool MakeVRAMFlat_AOBJCoherent(NonStupidBitField<256*1024/VRAMDirtyGranularity>& dirty);
-bool MakeVRAMFlat_BOBJCoherent(NonStupidBitField<128*1024/VRAMDirtyGranularity>& dirty);
+bool MakeVRAMFlat_AOBJCoherent(NonStupidBitField<256*1024/VRAMDirtyGranularity>& dirty, VRAMFlatLog* log = nullptr);
+bool MakeVRAMFlat_BOBJCoherent(NonStupidBitField<128*1024/VRAMDirtyGranularity>& dirty, VRAMFlatLog* log = nullptr);
 
-bool MakeVRAMFlat_ABGExtPalCoherent(NonStupidBitField<32*1024/VRAMDirtyGranularity>& dirty);
-bool MakeVRAMFlat_BBGExtPalCoherent(NonStupidBitField<32*1024/VRAMDirtyGranularity>& dirty);
+bool MakeVRAMFlat_ABGExtPalCoherent(NonStupidBitField<32*1024/VRAMDirtyGranularity>& dirty, VRAMFlatLog* log = nullptr);
+bool MakeVRAMFlat_BBGExtPalCoherent(NonStupidBitField<32*1024/VRAMDirtyGranularity>& dirty, VRAMFlatLog* log = nullptr);
 
-bool MakeVRAMFlat_AOBJExtPalCoherent(NonStupidBitField<8*1024/VRAMDirtyGranularity>& dirty);
-bool MakeVRAMFlat_BOBJExtPalCoherent(NonStupidBitField<8*1024/VRAMDirtyGranularity>& dirty);
+bool MakeVRAMFlat_AOBJExtPalCoherent(NonStupidBitField<8*1024/VRAMDirtyGranularity>& dirty, VRAMFlatLog* log = nullptr);
+bool MakeVRAMFlat_BOBJExtPalCoherent(NonStupidBitField<8*1024/VRAMDirtyGranularity>& dirty, VRAMFlatLog* log = nullptr);
 
 bool MakeVRAMFlat_TextureCoherent(NonStupidBitField<512*1024/VRAMDirtyGranularity>& dirty);
 bool MakeVRAMFlat_TexPalCoherent(NonStupidBitField<128*1024/VRAMDirtyGranularity>& dirty);
@@ -157,6 +185,9 @@ extern std::unique_ptr<GLCompositor> CurGLCompositor;
 struct RenderSettings
 {
     bool Soft_Threaded;
+    int Soft_NumThreads;
+
+    bool Threaded2D;
 
     int GL_ScaleFactor;
     bool GL_BetterPolygons;
@@ -101,6 +101,7 @@ void Unit::Reset()
     memset(BGYRef, 0, 2*4);
     memset(BGXRefInternal, 0, 2*4);
     memset(BGYRefInternal, 0, 2*4);
+    BGRefReload = 0;
     memset(BGRotA, 0, 2*2);
     memset(BGRotB, 0, 2*2);
     memset(BGRotC, 0, 2*2);
@@ -422,21 +423,21 @@ void Unit::Write16(u32 addr, u16 val)
     case 0x026: BGRotD[0] = val; return;
     case 0x028:
         BGXRef[0] = (BGXRef[0] & 0xFFFF0000) | val;
-        if (GPU::VCount < 192) BGXRefInternal[0] = BGXRef[0];
+        if (GPU::VCount < 192) ReloadBGXRef(0);
         return;
     case 0x02A:
         if (val & 0x0800) val |= 0xF000;
         BGXRef[0] = (BGXRef[0] & 0xFFFF) | (val << 16);
-        if (GPU::VCount < 192) BGXRefInternal[0] = BGXRef[0];
+        if (GPU::VCount < 192) ReloadBGXRef(0);
         return;
     case 0x02C:
         BGYRef[0] = (BGYRef[0] & 0xFFFF0000) | val;
-        if (GPU::VCount < 192) BGYRefInternal[0] = BGYRef[0];
+        if (GPU::VCount < 192) ReloadBGYRef(0);
         return;
     case 0x02E:
         if (val & 0x0800) val |= 0xF000;
         BGYRef[0] = (BGYRef[0] & 0xFFFF) | (val << 16);
-        if (GPU::VCount < 192) BGYRefInternal[0] = BGYRef[0];
+        if (GPU::VCount < 192) ReloadBGYRef(0);
         return;
 
     case 0x030: BGRotA[1] = val; return;
@@ -445,21 +446,21 @@ void Unit::Write16(u32 addr, u16 val)
     case 0x036: BGRotD[1] = val; return;
     case 0x038:
         BGXRef[1] = (BGXRef[1] & 0xFFFF0000) | val;
-        if (GPU::VCount < 192) BGXRefInternal[1] = BGXRef[1];
+        if (GPU::VCount < 192) ReloadBGXRef(1);
         return;
     case 0x03A:
         if (val & 0x0800) val |= 0xF000;
         BGXRef[1] = (BGXRef[1] & 0xFFFF) | (val << 16);
-        if (GPU::VCount < 192) BGXRefInternal[1] = BGXRef[1];
+        if (GPU::VCount < 192) ReloadBGXRef(1);
         return;
     case 0x03C:
         BGYRef[1] = (BGYRef[1] & 0xFFFF0000) | val;
-        if (GPU::VCount < 192) BGYRefInternal[1] = BGYRef[1];
+        if (GPU::VCount < 192) ReloadBGYRef(1);
         return;
     case 0x03E:
         if (val & 0x0800) val |= 0xF000;
         BGYRef[1] = (BGYRef[1] & 0xFFFF) | (val << 16);
-        if (GPU::VCount < 192) BGYRefInternal[1] = BGYRef[1];
+        if (GPU::VCount < 192) ReloadBGYRef(1);
         return;
 
     case 0x040:
@@ -541,23 +542,23 @@ void Unit::Write32(u32 addr, u32 val)
         case 0x028:
             if (val & 0x08000000) val |= 0xF0000000;
             BGXRef[0] = val;
-            if (GPU::VCount < 192) BGXRefInternal[0] = BGXRef[0];
+            if (GPU::VCount < 192) ReloadBGXRef(0);
             return;
         case 0x02C:
             if (val & 0x08000000) val |= 0xF0000000;
             BGYRef[0] = val;
-            if (GPU::VCount < 192) BGYRefInternal[0] = BGYRef[0];
+            if (GPU::VCount < 192) ReloadBGYRef(0);
             return;
 
         case 0x038:
             if (val & 0x08000000) val |= 0xF0000000;
             BGXRef[1] = val;
-            if (GPU::VCount < 192) BGXRefInternal[1] = BGXRef[1];
+            if (GPU::VCount < 192) ReloadBGXRef(1);
             return;
         case 0x03C:
             if (val & 0x08000000) val |= 0xF0000000;
             BGYRef[1] = val;
-            if (GPU::VCount < 192) BGYRefInternal[1] = BGYRef[1];
+            if (GPU::VCount < 192) ReloadBGYRef(1);
             return;
         }
     }
@@ -566,6 +567,67 @@ void Unit::Write32(u32 addr, u32 val)
     Write16(addr+2, val>>16);
 }
 
+void Unit::CopyRegisters(const Unit& other)
+{
+    Enabled = other.Enabled;
+
+    DispCnt = other.DispCnt;
+    memcpy(BGCnt, other.BGCnt, 4*2);
+    memcpy(BGXPos, other.BGXPos, 4*2);
+    memcpy(BGYPos, other.BGYPos, 4*2);
+    memcpy(BGXRef, other.BGXRef, 2*4);
+    memcpy(BGYRef, other.BGYRef, 2*4);
+    memcpy(BGXRefInternal, other.BGXRefInternal, 2*4);
+    memcpy(BGYRefInternal, other.BGYRefInternal, 2*4);
+    memcpy(BGRotA, other.BGRotA, 2*2);
+    memcpy(BGRotB, other.BGRotB, 2*2);
+    memcpy(BGRotC, other.BGRotC, 2*2);
+    memcpy(BGRotD, other.BGRotD, 2*2);
+    BGRefReload = other.BGRefReload;
+
+    memcpy(Win0Coords, other.Win0Coords, 4);
+    memcpy(Win1Coords, other.Win1Coords, 4);
+    memcpy(WinCnt, other.WinCnt, 4);
+    Win0Active = other.Win0Active;
+    Win1Active = other.Win1Active;
+
+    memcpy(BGMosaicSize, other.BGMosaicSize, 2);
+    memcpy(OBJMosaicSize, other.OBJMosaicSize, 2);
+    BGMosaicY = other.BGMosaicY;
+    BGMosaicYMax = other.BGMosaicYMax;
+    OBJMosaicYCount = other.OBJMosaicYCount;
+    OBJMosaicY = other.OBJMosaicY;
+    OBJMosaicYMax = other.OBJMosaicYMax;
+
+    BlendCnt = other.BlendCnt;
+    BlendAlpha = other.BlendAlpha;
+    EVA = other.EVA;
+    EVB = other.EVB;
+    EVY = other.EVY;
+
+    CaptureLatch = other.CaptureLatch;
+    CaptureCnt = other.CaptureCnt;
+
+    MasterBrightness = other.MasterBrightness;
+}
+
+void Unit::CopyInternalState(const Unit& other, u32 mask)
+{
+    if (mask & (1<<0)) BGXRefInternal[0] = other.BGXRefInternal[0];
+    if (mask & (1<<1)) BGYRefInternal[0] = other.BGYRefInternal[0];
+    if (mask & (1<<2)) BGXRefInternal[1] = other.BGXRefInternal[1];
+    if (mask & (1<<3)) BGYRefInternal[1] = other.BGYRefInternal[1];
+
+    if (mask & (1<<4))
+    {
+        BGMosaicY = other.BGMosaicY;
+        BGMosaicYMax = other.BGMosaicYMax;
+        OBJMosaicYCount = other.OBJMosaicYCount;
+        OBJMosaicY = other.OBJMosaicY;
+        OBJMosaicYMax = other.OBJMosaicYMax;
+    }
+}
+
 void Unit::UpdateMosaicCounters(u32 line)
 {
     // Y mosaic uses incrementing 4-bit counters
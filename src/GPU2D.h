@@ -69,6 +69,13 @@ public:
     void GetBGVRAM(u8*& data, u32& mask);
     void GetOBJVRAM(u8*& data, u32& mask);
 
+    // used by the threaded renderer, which works on a copy of the unit
+    // CopyRegisters() copies everything except the display FIFO
+    // CopyInternalState() copies the state that is updated while drawing:
+    // bits 0-3 of the mask select the BG2/BG3 X/Y reference points, bit 4 the mosaic counters
+    void CopyRegisters(const Unit& other);
+    void CopyInternalState(const Unit& other, u32 mask);
+
     void UpdateMosaicCounters(u32 line);
     void CalculateWindowMask(u32 line, u8* windowMask, u8* objWindow);
 
@@ -96,6 +103,11 @@ public:
     s16 BGRotC[2];
     s16 BGRotD[2];
 
+    // reference points that were reloaded since the renderer last took a copy
+    u32 BGRefReload;
+    void ReloadBGXRef(u32 num) { BGXRefInternal[num] = BGXRef[num]; BGRefReload |= (1 << (num*2)); }
+    void ReloadBGYRef(u32 num) { BGYRefInternal[num] = BGYRef[num]; BGRefReload |= (2 << (num*2)); }
+
     u8 Win0Coords[4];
     u8 Win1Coords[4];
     u8 WinCnt[4];
@@ -128,6 +140,10 @@ public:
 
     virtual void VBlankEnd(Unit* unitA, Unit* unitB) = 0;
 
+    virtual void SetThreaded(bool threaded) {}
+    // waits until all the scanlines that were submitted so far are drawn
+    virtual void SyncScanlines() {}
+
     void SetFramebuffer(u32* unitA, u32* unitB)
     {
         Framebuffer[0] = unitA;
@@ -0,0 +1,364 @@
+/*
+    Copyright 2016-2022 melonDS team
+
+    This file is part of melonDS.
+
+    melonDS is free software: you can redistribute it and/or modify it under
+    the terms of the GNU General Public License as published by the Free
+    Software Foundation, either version 3 of the License, or (at your option)
+    any later version.
+
+    melonDS is distributed in the hope that it will be useful, but WITHOUT ANY
+    WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+    FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with melonDS. If not, see http://www.gnu.org/licenses/.
+*/
+
+#include <string.h>
+#include "GPU2D_Effects.h"
+
+namespace GPU2D
+{
+
+u32 ColorBlend4(u32 val1, u32 val2, u32 eva, u32 evb)
+{
+    u32 r =  (((val1 & 0x00003F) * eva) + ((val2 & 0x00003F) * evb) + 0x000008) >> 4;
+    u32 g = ((((val1 & 0x003F00) * eva) + ((val2 & 0x003F00) * evb) + 0x000800) >> 4) & 0x007F00;
+    u32 b = ((((val1 & 0x3F0000) * eva) + ((val2 & 0x3F0000) * evb) + 0x080000) >> 4) & 0x7F0000;
+
+    if (r > 0x00003F) r = 0x00003F;
+    if (g > 0x003F00) g = 0x003F00;
+    if (b > 0x3F0000) b = 0x3F0000;
+
+    return r | g | b | 0xFF000000;
+}
+
+u32 ColorBlend5(u32 val1, u32 val2)
+{
+    u32 eva = ((val1 >> 24) & 0x1F) + 1;
+    u32 evb = 32 - eva;
+
+    if (eva == 32) return val1;
+
+    u32 r =  (((val1 & 0x00003F) * eva) + ((val2 & 0x00003F) * evb) + 0x000010) >> 5;
+    u32 g = ((((val1 & 0x003F00) * eva) + ((val2 & 0x003F00) * evb) + 0x001000) >> 5) & 0x007F00;
+    u32 b = ((((val1 & 0x3F0000) * eva) + ((val2 & 0x3F0000) * evb) + 0x100000) >> 5) & 0x7F0000;
+
+    if (r > 0x00003F) r = 0x00003F;
+    if (g > 0x003F00) g = 0x003F00;
+    if (b > 0x3F0000) b = 0x3F0000;
+
+    return r | g | b | 0xFF000000;
+}
+
+u32 ColorBrightnessUp(u32 val, u32 factor, u32 bias)
+{
+    u32 rb = val & 0x3F003F;
+    u32 g = val & 0x003F00;
+
+    rb += (((((0x3F003F - rb) * factor) + (bias*0x010001)) >> 4) & 0x3F003F);
+    g +=  (((((0x003F00 - g ) * factor) + (bias*0x000100)) >> 4) & 0x003F00);
+
+    return rb | g | 0xFF000000;
+}
+
+u32 ColorBrightnessDown(u32 val, u32 factor, u32 bias)
+{
+    u32 rb = val & 0x3F003F;
+    u32 g = val & 0x003F00;
+
+    rb -= ((((rb * factor) + (bias*0x010001)) >> 4) & 0x3F003F);
+    g -=  ((((g  * factor) + (bias*0x000100)) >> 4) & 0x003F00);
+
+    return rb | g | 0xFF000000;
+}
+
+u32 ColorComposite(u32 val1, u32 val2, u8 windowMask, u32 blendCnt, u32 eva, u32 evb, u32 evy)
+{
+    u32 coloreffect = 0;
+    u32 factorA, factorB;
+
+    u32 flag1 = val1 >> 24;
+    u32 flag2 = val2 >> 24;
+
+    u32 target2;
+    if      (flag2 & 0x80) target2 = 0x1000;
+    else if (flag2 & 0x40) target2 = 0x0100;
+    else                   target2 = flag2 << 8;
+
+    if ((flag1 & 0x80) && (blendCnt & target2))
+    {
+        // sprite blending
+
+        coloreffect = 1;
+
+        if (flag1 & 0x40)
+        {
+            factorA = flag1 & 0x1F;
+            factorB = 16 - factorA;
+        }
+        else
+        {
+            factorA = eva;
+            factorB = evb;
+        }
+    }
+    else if ((flag1 & 0x40) && (blendCnt & target2))
+    {
+        // 3D layer blending
+
+        coloreffect = 4;
+    }
+    else
+    {
+        if      (flag1 & 0x80) flag1 = 0x10;
+        else if (flag1 & 0x40) flag1 = 0x01;
+
+        if ((blendCnt & flag1) && (windowMask & 0x20))
+        {
+            coloreffect = (blendCnt >> 6) & 0x3;
+
+            if (coloreffect == 1)
+            {
+                if (blendCnt & target2)
+                {
+                    factorA = eva;
+                    factorB = evb;
+                }
+                else
+                    coloreffect = 0;
+            }
+        }
+    }
+
+    switch (coloreffect)
+    {
+    case 0: return val1;
+    case 1: return ColorBlend4(val1, val2, factorA, factorB);
+    case 2: return ColorBrightnessUp(val1, evy, 0x8);
+    case 3: return ColorBrightnessDown(val1, evy, 0x7);
+    case 4: return ColorBlend5(val1, val2);
+    }
+
+    return val1;
+}
+
+void CompositeLine_Scalar(u32* line, const u8* windowMask, u32 blendCnt, u32 eva, u32 evb, u32 evy)
+{
+    for (int i = 0; i < 256; i++)
+    {
+        u32 val1 = line[i];
+        u32 val2 = line[256+i];
+
+        line[i] = ColorComposite(val1, val2, windowMask[i], blendCnt, eva, evb, evy);
+    }
+}
+
+void FinishLine_Scalar(u32* dst, u32 masterBrightness)
+{
+    // master brightness
+    if ((masterBrightness >> 14) == 1)
+    {
+        // up
+        u32 factor = masterBrightness & 0x1F;
+        if (factor > 16) factor = 16;
+
+        for (int i = 0; i < 256; i++)
+        {
+            dst[i] = ColorBrightnessUp(dst[i], factor, 0x0);
+        }
+    }
+    else if ((masterBrightness >> 14) == 2)
+    {
+        // down
+        u32 factor = masterBrightness & 0x1F;
+        if (factor > 16) factor = 16;
+
+        for (int i = 0; i < 256; i++)
+        {
+            dst[i] = ColorBrightnessDown(dst[i], factor, 0xF);
+        }
+    }
+
+    // convert to 32-bit BGRA
+    // note: 32-bit RGBA would be more straightforward, but
+    // BGRA seems to be more compatible (Direct2D soft, cairo...)
+    for (int i = 0; i < 256; i+=2)
+    {
+        u64 c = *(u64*)&dst[i];
+
+        u64 r = (c << 18) & 0xFC000000FC0000;
+        u64 g = (c << 2) & 0xFC000000FC00;
+        u64 b = (c >> 14) & 0xFC000000FC;
+        c = r | g | b;
+
+        *(u64*)&dst[i] = c | ((c & 0x00C0C0C000C0C0C0) >> 6) | 0xFF000000FF000000;
+    }
+}
+
+#ifdef GPU2D_SIMD
+
+// vectorised versions of CompositeLine_Scalar and FinishLine_Scalar
+// they're written with GCC vector extensions, so the same code is
+// compiled for SSE2/NEON (16 bytes) and AVX2 (32 bytes)
+//
+// all the color effects are done as (c1*a + c2*b + round) >> 5 per color
+// component, with a/b scaled to 32 the results are the same as
+// ColorBlend4/ColorBlend5/ColorBrightnessUp/ColorBrightnessDown
+
+#define VSEL(m, a, b) (((a) & (m)) | ((b) & ~(m)))
+
+typedef u32 u32x4 __attribute__((vector_size(16)));
+typedef u16 u16x8 __attribute__((vector_size(16)));
+typedef u8 u8x4 __attribute__((vector_size(4)));
+
+typedef u32 u32x8 __attribute__((vector_size(32)));
+typedef u16 u16x16 __attribute__((vector_size(32)));
+typedef u8 u8x8 __attribute__((vector_size(8)));
+
+template <typename U32, typename U16, typename U8>
+__attribute__((always_inline)) inline void CompositeLineImpl(u32* line, const u8* windowMask, u32 blendCnt, u32 eva, u32 evb, u32 evy)
+{
+    constexpr int Bytes = sizeof(U32);
+    constexpr int N = Bytes / 4;
+
+    u32 effect = (blendCnt >> 6) & 0x3;
+    u32 effA, effB, effC;
+    switch (effect)
+    {
+    case 0: effA = 32;           effB = 0;      effC = 0;        break;
+    case 1: effA = eva*2;        effB = evb*2;  effC = 0;        break;
+    case 2: effA = (16-evy)*2;   effB = evy*2;  effC = 0x3F3F3F; break;
+    case 3: effA = (16-evy)*2;   effB = 0;      effC = 0;        break;
+    }
+
+    for (int i = 0; i < 256; i += N)
+    {
+        U32 val1, val2;
+        U8 wm;
+        memcpy(&val1, &line[i], Bytes);
+        memcpy(&val2, &line[256+i], Bytes);
+        memcpy(&wm, &windowMask[i], N);
+
+        U32 flag1 = val1 >> 24;
+        U32 flag2 = val2 >> 24;
+
+        U32 flag1_80 = (U32)((flag1 & 0x80) != 0);
+        U32 flag1_40 = (U32)((flag1 & 0x40) != 0);
+        U32 flag2_80 = (U32)((flag2 & 0x80) != 0);
+        U32 flag2_40 = (U32)((flag2 & 0x40) != 0);
+
+        U32 target1 = VSEL(flag1_80, 0x10, VSEL(flag1_40, 0x01, flag1));
+        U32 target2 = VSEL(flag2_80, 0x1000, VSEL(flag2_40, 0x0100, flag2 << 8));
+        U32 target1ok = (U32)((target1 & blendCnt) != 0);
+        U32 target2ok = (U32)((target2 & blendCnt) != 0);
+        U32 windowok = (U32)((__builtin_convertvector(wm, U32) & 0x20) != 0);
+
+        // sprite blending
+        U32 spriteMask = flag1_80 & target2ok;
+        U32 spriteAlpha = flag1 & 0x1F;
+        U32 spriteA = VSEL(flag1_40, spriteAlpha*2, eva*2);
+        U32 spriteB = VSEL(flag1_40, (16-spriteAlpha)*2, evb*2);
+
+        // 3D layer blending
+        U32 _3dMask = ~flag1_80 & flag1_40 & target2ok;
+        U32 _3dA = (flag1 & 0x1F) + 1;
+        U32 _3dB = 32 - _3dA;
+        U32 _3dSkip = (U32)(_3dA == 32);
+
+        // regular color effects
+        U32 effMask = ~(spriteMask | _3dMask) & target1ok & windowok;
+        if (effect == 0) effMask = (U32){};
+        else if (effect == 1) effMask &= target2ok;
+
+        U32 mask = spriteMask | (_3dMask & ~_3dSkip) | effMask;
+        U32 a = VSEL(spriteMask, spriteA, VSEL(_3dMask, _3dA, effA));
+        U32 b = VSEL(spriteMask, spriteB, VSEL(_3dMask, _3dB, effB));
+        U32 src2 = VSEL(effMask, effC, val2);
+        if (effect != 2) src2 = val2;
+
+        a |= (a << 16);
+        b |= (b << 16);
+
+        U16 rb = ((U16)(val1 & 0x3F003F) * (U16)a + (U16)(src2 & 0x3F003F) * (U16)b + 16) >> 5;
+        U16 g = ((U16)((val1 >> 8) & 0x3F) * (U16)a + (U16)((src2 >> 8) & 0x3F) * (U16)b + 16) >> 5;
+        rb = VSEL((U16)(rb > 0x3F), 0x3F, rb);
+        g = VSEL((U16)(g > 0x3F), 0x3F, g);
+
+        U32 res = (U32)rb | ((U32)g << 8) | 0xFF000000;
+        res = VSEL(mask, res, val1);
+        memcpy(&line[i], &res, Bytes);
+    }
+}
+
+template <typename U32, typename U16>
+__attribute__((always_inline)) inline void FinishLineImpl(u32* dst, u32 masterBrightness)
+{
+    constexpr int Bytes = sizeof(U32);
+    constexpr int N = Bytes / 4;
+
+    u32 factor = masterBrightness & 0x1F;
+    if (factor > 16) factor = 16;
+
+    u32 a = 32, b = 0, c = 0;
+    if ((masterBrightness >> 14) == 1)
+    {
+        a = (16-factor)*2;
+        b = factor*2;
+        c = 0x3F3F3F;
+    }
+    else if ((masterBrightness >> 14) == 2)
+    {
+        a = (16-factor)*2;
+    }
+
+    U32 av = (U32){} + (a | (a << 16));
+    U32 bv = (U32){} + (b | (b << 16));
+    U32 cv = (U32){} + c;
+
+    for (int i = 0; i < 256; i += N)
+    {
+        U32 val;
+        memcpy(&val, &dst[i], Bytes);
+
+        // master brightness
+        U16 rb = ((U16)(val & 0x3F003F) * (U16)av + (U16)(cv & 0x3F003F) * (U16)bv) >> 5;
+        U16 g = ((U16)((val >> 8) & 0x3F) * (U16)av + (U16)((cv >> 8) & 0x3F) * (U16)bv) >> 5;
+        val = (U32)rb | ((U32)g << 8);
+
+        // convert to 32-bit BGRA
+        val = (val << 2) | ((val >> 4) & 0x030303);
+        val = ((val & 0xFF) << 16) | (val & 0xFF00) | ((val >> 16) & 0xFF) | 0xFF000000;
+        memcpy(&dst[i], &val, Bytes);
+    }
+}
+
+#undef VSEL
+
+void CompositeLine_Base(u32* line, const u8* windowMask, u32 blendCnt, u32 eva, u32 evb, u32 evy)
+{
+    CompositeLineImpl<u32x4, u16x8, u8x4>(line, windowMask, blendCnt, eva, evb, evy);
+}
+
+void FinishLine_Base(u32* dst, u32 masterBrightness)
+{
+    FinishLineImpl<u32x4, u16x8>(dst, masterBrightness);
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+__attribute__((target("avx2"))) void CompositeLine_AVX2(u32* line, const u8* windowMask, u32 blendCnt, u32 eva, u32 evb, u32 evy)
+{
+    CompositeLineImpl<u32x8, u16x16, u8x8>(line, windowMask, blendCnt, eva, evb, evy);
+}
+
+__attribute__((target("avx2"))) void FinishLine_AVX2(u32* dst, u32 masterBrightness)
+{
+    FinishLineImpl<u32x8, u16x16>(dst, masterBrightness);
+}
+#endif
+
+#endif
+
+}
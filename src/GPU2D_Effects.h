@@ -0,0 +1,56 @@
+/*
+    Copyright 2016-2022 melonDS team
+
+    This file is part of melonDS.
+
+    melonDS is free software: you can redistribute it and/or modify it under
+    the terms of the GNU General Public License as published by the Free
+    Software Foundation, either version 3 of the License, or (at your option)
+    any later version.
+
+    melonDS is distributed in the hope that it will be useful, but WITHOUT ANY
+    WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+    FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with melonDS. If not, see http://www.gnu.org/licenses/.
+*/
+
+#ifndef GPU2D_EFFECTS_H
+#define GPU2D_EFFECTS_H
+
+#include "types.h"
+
+#if defined(__GNUC__)
+#define GPU2D_SIMD
+#endif
+
+namespace GPU2D
+{
+
+u32 ColorBlend4(u32 val1, u32 val2, u32 eva, u32 evb);
+u32 ColorBlend5(u32 val1, u32 val2);
+u32 ColorBrightnessUp(u32 val, u32 factor, u32 bias);
+u32 ColorBrightnessDown(u32 val, u32 factor, u32 bias);
+// the color special effect for one pixel, val1 is the topmost pixel and val2 the one below
+u32 ColorComposite(u32 val1, u32 val2, u8 windowMask, u32 blendCnt, u32 eva, u32 evb, u32 evy);
+
+// applies the color special effects to a scanline, the topmost pixels are
+// in line[0..255] and the ones below them in line[256..511]
+void CompositeLine_Scalar(u32* line, const u8* windowMask, u32 blendCnt, u32 eva, u32 evb, u32 evy);
+// applies the master brightness to a finished scanline and converts it to 32-bit BGRA
+void FinishLine_Scalar(u32* dst, u32 masterBrightness);
+
+#ifdef GPU2D_SIMD
+void CompositeLine_Base(u32* line, const u8* windowMask, u32 blendCnt, u32 eva, u32 evb, u32 evy);
+void FinishLine_Base(u32* dst, u32 masterBrightness);
+#if defined(__x86_64__) || defined(__i386__)
+// only to be used if the CPU supports AVX2
+void CompositeLine_AVX2(u32* line, const u8* windowMask, u32 blendCnt, u32 eva, u32 evb, u32 evy);
+void FinishLine_AVX2(u32* dst, u32 masterBrightness);
+#endif
+#endif
+
+}
+
+#endif
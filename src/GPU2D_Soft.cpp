@@ -16,7 +16,9 @@
     with melonDS. If not, see http://www.gnu.org/licenses/.
 */
 
+#include <string.h>
 #include "GPU2D_Soft.h"
+#include "GPU2D_Effects.h"
 #include "GPU.h"
 
 namespace GPU2D
@@ -34,161 +36,277 @@ SoftRenderer::SoftRenderer()
             MosaicTable[m][x] = offset;
         }
     }
+
+#ifdef GPU2D_SIMD
+    CompositeLine = CompositeLine_Base;
+    FinishLine = FinishLine_Base;
+#if defined(__x86_64__) || defined(__i386__)
+    if (__builtin_cpu_supports("avx2"))
+    {
+        CompositeLine = CompositeLine_AVX2;
+        FinishLine = FinishLine_AVX2;
+    }
+#endif
+#else
+    CompositeLine = CompositeLine_Scalar;
+    FinishLine = FinishLine_Scalar;
+#endif
+
+    Threaded = false;
+    LineThreadRunning = false;
+    Sema_LineStart = Platform::Semaphore_Create();
+    Sema_LineDone = Platform::Semaphore_Create();
+
+    NumDeferredLines = 0;
+    CurDeferredLine = 0;
+    DeferredUnitValid[0] = false;
+    DeferredUnitValid[1] = false;
+}
+
+SoftRenderer::~SoftRenderer()
+{
+    SyncScanlines();
+    StopLineThread();
+
+    Platform::Semaphore_Free(Sema_LineStart);
+    Platform::Semaphore_Free(Sema_LineDone);
 }
 
-u32 SoftRenderer::ColorBlend4(u32 val1, u32 val2, u32 eva, u32 evb)
+void SoftRenderer::SetThreaded(bool threaded)
 {
-    u32 r =  (((val1 & 0x00003F) * eva) + ((val2 & 0x00003F) * evb) + 0x000008) >> 4;
-    u32 g = ((((val1 & 0x003F00) * eva) + ((val2 & 0x003F00) * evb) + 0x000800) >> 4) & 0x007F00;
-    u32 b = ((((val1 & 0x3F0000) * eva) + ((val2 & 0x3F0000) * evb) + 0x080000) >> 4) & 0x7F0000;
+    SyncScanlines();
 
-    if (r > 0x00003F) r = 0x00003F;
-    if (g > 0x003F00) g = 0x003F00;
-    if (b > 0x3F0000) b = 0x3F0000;
+    if (!IsEngineB)
+    {
+        if (threaded)
+        {
+            if (!EngineB)
+            {
+                EngineB = std::make_unique<SoftRenderer>();
+                EngineB->IsEngineB = true;
+            }
+            EngineB->SetThreaded(true);
+        }
+        else
+        {
+            EngineB.reset();
+        }
+    }
 
-    return r | g | b | 0xFF000000;
+    if (threaded)
+    {
+        if (!DeferredLines)
+            DeferredLines = std::make_unique<DeferredLine[]>(MaxDeferredLines);
+
+        if (!LineThreadRunning.load(std::memory_order_relaxed))
+        {
+            LineThreadRunning = true;
+            LineThread = Platform::Thread_Create(std::bind(&SoftRenderer::LineThreadFunc, this));
+        }
+    }
+    else
+    {
+        StopLineThread();
+    }
+
+    Threaded = threaded;
 }
 
-u32 SoftRenderer::ColorBlend5(u32 val1, u32 val2)
+void SoftRenderer::StopLineThread()
 {
-    u32 eva = ((val1 >> 24) & 0x1F) + 1;
-    u32 evb = 32 - eva;
+    if (LineThreadRunning.load(std::memory_order_relaxed))
+    {
+        LineThreadRunning = false;
+        Platform::Semaphore_Post(Sema_LineStart);
+        Platform::Thread_Wait(LineThread);
+        Platform::Thread_Free(LineThread);
+    }
+}
+
+void SoftRenderer::LineThreadFunc()
+{
+    for (;;)
+    {
+        Platform::Semaphore_Wait(Sema_LineStart);
+        if (!LineThreadRunning) return;
 
-    if (eva == 32) return val1;
+        DeferredLine& job = DeferredLines[CurDeferredLine++];
+        Unit& prev = DeferredUnits[job.State.Num];
 
-    u32 r =  (((val1 & 0x00003F) * eva) + ((val2 & 0x00003F) * evb) + 0x000010) >> 5;
-    u32 g = ((((val1 & 0x003F00) * eva) + ((val2 & 0x003F00) * evb) + 0x001000) >> 5) & 0x007F00;
-    u32 b = ((((val1 & 0x3F0000) * eva) + ((val2 & 0x3F0000) * evb) + 0x100000) >> 5) & 0x7F0000;
+        // carry over the state from the previous scanline of this unit
+        // unless it was reset in between
+        if (!job.Resync)
+            job.State.CopyInternalState(prev, (~job.State.BGRefReload & 0xF) | (1<<4));
+
+        job.VRAMLog.Apply();
+
+        CurUnit = &job.State;
+        CurPalette = job.Palette;
+        CurOAM = job.OAM;
+
+        if (job.Sprites)
+            RenderSprites(job.Line);
+        else
+            RenderScanline(job.Line, job.VCount, job.RenderXPos);
 
-    if (r > 0x00003F) r = 0x00003F;
-    if (g > 0x003F00) g = 0x003F00;
-    if (b > 0x3F0000) b = 0x3F0000;
+        prev.CopyInternalState(job.State, 0x1F);
 
-    return r | g | b | 0xFF000000;
+        Platform::Semaphore_Post(Sema_LineDone);
+    }
 }
 
-u32 SoftRenderer::ColorBrightnessUp(u32 val, u32 factor, u32 bias)
+void SoftRenderer::SyncScanlines()
 {
-    u32 rb = val & 0x3F003F;
-    u32 g = val & 0x003F00;
+    if (EngineB)
+        EngineB->SyncScanlines();
+
+    for (int i = 0; i < NumDeferredLines; i++)
+        Platform::Semaphore_Wait(Sema_LineDone);
 
-    rb += (((((0x3F003F - rb) * factor) + (bias*0x010001)) >> 4) & 0x3F003F);
-    g +=  (((((0x003F00 - g ) * factor) + (bias*0x000100)) >> 4) & 0x003F00);
+    NumDeferredLines = 0;
+    CurDeferredLine = 0;
 
-    return rb | g | 0xFF000000;
+    for (int i = 0; i < 2; i++)
+    {
+        if (!DeferredUnitValid[i]) continue;
+
+        // don't overwrite reference points that were reloaded after the last submission
+        Unit* unit = DeferredUnitSource[i];
+        unit->CopyInternalState(DeferredUnits[i], (~unit->BGRefReload & 0xF) | (1<<4));
+        DeferredUnitValid[i] = false;
+    }
 }
 
-u32 SoftRenderer::ColorBrightnessDown(u32 val, u32 factor, u32 bias)
+bool SoftRenderer::CanDeferScanline(Unit* unit)
 {
-    u32 rb = val & 0x3F003F;
-    u32 g = val & 0x003F00;
+    if (NumDeferredLines >= MaxDeferredLines)
+        return false;
 
-    rb -= ((((rb * factor) + (bias*0x010001)) >> 4) & 0x3F003F);
-    g -=  ((((g  * factor) + (bias*0x000100)) >> 4) & 0x003F00);
+    // display capture and VRAM display access VRAM directly
+    // they're not common, so they're just drawn on the emulator thread
+    if (unit->CaptureLatch)
+        return false;
+    if (GPU::VCount == 0 && (unit->CaptureCnt & (1<<31)))
+        return false;
 
-    return rb | g | 0xFF000000;
+    u32 dispmode = (unit->DispCnt >> 16) & (unit->Num ? 0x1 : 0x3);
+    if (dispmode == 2)
+        return false;
+
+    return true;
 }
 
-u32 SoftRenderer::ColorComposite(int i, u32 val1, u32 val2)
+void SoftRenderer::DeferLine(u32 line, Unit* unit, bool sprites)
 {
-    u32 coloreffect = 0;
-    u32 eva, evb;
+    DeferredLine& job = DeferredLines[NumDeferredLines++];
+    u32 num = unit->Num;
 
-    u32 flag1 = val1 >> 24;
-    u32 flag2 = val2 >> 24;
+    job.Sprites = sprites;
+    job.Resync = !DeferredUnitValid[num];
+    job.Line = line;
+    job.VCount = GPU::VCount;
+    job.RenderXPos = GPU3D::RenderXPos;
 
-    u32 blendCnt = CurUnit->BlendCnt;
+    job.State.Num = num;
+    job.State.CopyRegisters(*unit);
+    unit->BGRefReload = 0;
 
-    u32 target2;
-    if      (flag2 & 0x80) target2 = 0x1000;
-    else if (flag2 & 0x40) target2 = 0x0100;
-    else                   target2 = flag2 << 8;
+    if (!sprites && (((unit->DispCnt >> 16) & 0x3) == 3))
+        memcpy(job.State.DispFIFOBuffer, unit->DispFIFOBuffer, 256*2);
 
-    if ((flag1 & 0x80) && (blendCnt & target2))
-    {
-        // sprite blending
+    u32 offset = num ? 0x400 : 0;
+    memcpy(&job.Palette[offset], &GPU::Palette[offset], 1024);
+    memcpy(&job.OAM[offset], &GPU::OAM[offset], 1024);
 
-        coloreffect = 1;
+    job.VRAMLog.Clear();
+    if (sprites)
+        MakeOBJVRAMCoherent(num, &job.VRAMLog);
+    else
+        MakeBGVRAMCoherent(num, &job.VRAMLog);
 
-        if (flag1 & 0x40)
-        {
-            eva = flag1 & 0x1F;
-            evb = 16 - eva;
-        }
-        else
-        {
-            eva = CurUnit->EVA;
-            evb = CurUnit->EVB;
-        }
+    DeferredUnitSource[num] = unit;
+    DeferredUnitValid[num] = true;
+
+    Platform::Semaphore_Post(Sema_LineStart);
+}
+
+void SoftRenderer::MakeBGVRAMCoherent(u32 num, GPU::VRAMFlatLog* log)
+{
+    if (num == 0)
+    {
+        auto bgDirty = GPU::VRAMDirty_ABG.DeriveState(GPU::VRAMMap_ABG);
+        GPU::MakeVRAMFlat_ABGCoherent(bgDirty, log);
+        auto bgExtPalDirty = GPU::VRAMDirty_ABGExtPal.DeriveState(GPU::VRAMMap_ABGExtPal);
+        GPU::MakeVRAMFlat_ABGExtPalCoherent(bgExtPalDirty, log);
+        auto objExtPalDirty = GPU::VRAMDirty_AOBJExtPal.DeriveState(&GPU::VRAMMap_AOBJExtPal);
+        GPU::MakeVRAMFlat_AOBJExtPalCoherent(objExtPalDirty, log);
     }
-    else if ((flag1 & 0x40) && (blendCnt & target2))
+    else
     {
-        // 3D layer blending
+        auto bgDirty = GPU::VRAMDirty_BBG.DeriveState(GPU::VRAMMap_BBG);
+        GPU::MakeVRAMFlat_BBGCoherent(bgDirty, log);
+        auto bgExtPalDirty = GPU::VRAMDirty_BBGExtPal.DeriveState(GPU::VRAMMap_BBGExtPal);
+        GPU::MakeVRAMFlat_BBGExtPalCoherent(bgExtPalDirty, log);
+        auto objExtPalDirty = GPU::VRAMDirty_BOBJExtPal.DeriveState(&GPU::VRAMMap_BOBJExtPal);
+        GPU::MakeVRAMFlat_BOBJExtPalCoherent(objExtPalDirty, log);
+    }
+}
 
-        coloreffect = 4;
+void SoftRenderer::MakeOBJVRAMCoherent(u32 num, GPU::VRAMFlatLog* log)
+{
+    if (num == 0)
+    {
+        auto objDirty = GPU::VRAMDirty_AOBJ.DeriveState(GPU::VRAMMap_AOBJ);
+        GPU::MakeVRAMFlat_AOBJCoherent(objDirty, log);
     }
     else
     {
-        if      (flag1 & 0x80) flag1 = 0x10;
-        else if (flag1 & 0x40) flag1 = 0x01;
+        auto objDirty = GPU::VRAMDirty_BOBJ.DeriveState(GPU::VRAMMap_BOBJ);
+        GPU::MakeVRAMFlat_BOBJCoherent(objDirty, log);
+    }
+}
 
-        if ((blendCnt & flag1) && (WindowMask[i] & 0x20))
-        {
-            coloreffect = (blendCnt >> 6) & 0x3;
+u32 SoftRenderer::ColorComposite(int i, u32 val1, u32 val2)
+{
+    return GPU2D::ColorComposite(val1, val2, WindowMask[i], CurUnit->BlendCnt, CurUnit->EVA, CurUnit->EVB, CurUnit->EVY);
+}
 
-            if (coloreffect == 1)
-            {
-                if (blendCnt & target2)
-                {
-                    eva = CurUnit->EVA;
-                    evb = CurUnit->EVB;
-                }
-                else
-                    coloreffect = 0;
-            }
-        }
+void SoftRenderer::DrawScanline(u32 line, Unit* unit)
+{
+    if (EngineB && unit->Num == 1)
+    {
+        EngineB->SetFramebuffer(Framebuffer[0], Framebuffer[1]);
+        EngineB->DrawScanline(line, unit);
+        return;
     }
 
-    switch (coloreffect)
+    if (Threaded)
     {
-    case 0: return val1;
-    case 1: return ColorBlend4(val1, val2, eva, evb);
-    case 2: return ColorBrightnessUp(val1, CurUnit->EVY, 0x8);
-    case 3: return ColorBrightnessDown(val1, CurUnit->EVY, 0x7);
-    case 4: return ColorBlend5(val1, val2);
+        if (CanDeferScanline(unit))
+        {
+            DeferLine(line, unit, false);
+            return;
+        }
+
+        SyncScanlines();
     }
 
-    return val1;
+    CurUnit = unit;
+    CurPalette = GPU::Palette;
+    CurOAM = GPU::OAM;
+
+    MakeBGVRAMCoherent(CurUnit->Num, nullptr);
+
+    RenderScanline(line, GPU::VCount, GPU3D::RenderXPos);
 }
 
-void SoftRenderer::DrawScanline(u32 line, Unit* unit)
+void SoftRenderer::RenderScanline(u32 line, u32 vcount, u16 renderXPos)
 {
-    CurUnit = unit;
-
     int stride = GPU3D::CurrentRenderer->Accelerated ? (256*3 + 1) : 256;
     u32* dst = &Framebuffer[CurUnit->Num][stride * line];
 
     int n3dline = line;
-    line = GPU::VCount;
-
-    if (CurUnit->Num == 0)
-    {
-        auto bgDirty = GPU::VRAMDirty_ABG.DeriveState(GPU::VRAMMap_ABG);
-        GPU::MakeVRAMFlat_ABGCoherent(bgDirty);
-        auto bgExtPalDirty = GPU::VRAMDirty_ABGExtPal.DeriveState(GPU::VRAMMap_ABGExtPal);
-        GPU::MakeVRAMFlat_ABGExtPalCoherent(bgExtPalDirty);
-        auto objExtPalDirty = GPU::VRAMDirty_AOBJExtPal.DeriveState(&GPU::VRAMMap_AOBJExtPal);
-        GPU::MakeVRAMFlat_AOBJExtPalCoherent(objExtPalDirty);
-    }
-    else
-    {
-        auto bgDirty = GPU::VRAMDirty_BBG.DeriveState(GPU::VRAMMap_BBG);
-        GPU::MakeVRAMFlat_BBGCoherent(bgDirty);
-        auto bgExtPalDirty = GPU::VRAMDirty_BBGExtPal.DeriveState(GPU::VRAMMap_BBGExtPal);
-        GPU::MakeVRAMFlat_BBGExtPalCoherent(bgExtPalDirty);
-        auto objExtPalDirty = GPU::VRAMDirty_BOBJExtPal.DeriveState(&GPU::VRAMMap_BOBJExtPal);
-        GPU::MakeVRAMFlat_BOBJExtPalCoherent(objExtPalDirty);
-    }
+    line = vcount;
 
     bool forceblank = false;
 
@@ -206,10 +324,10 @@ void SoftRenderer::DrawScanline(u32 line, Unit* unit)
     if (CurUnit->Num == 0)
     {
         if (!GPU3D::CurrentRenderer->Accelerated)
-            _3DLine = GPU3D::GetLine(n3dline);
+            _3DLine = GPU3D::GetLine(n3dline, renderXPos);
         else if (CurUnit->CaptureLatch && (((CurUnit->CaptureCnt >> 29) & 0x3) != 1))
         {
-            _3DLine = GPU3D::GetLine(n3dline);
+            _3DLine = GPU3D::GetLine(n3dline, renderXPos);
             //GPU3D::GLRenderer::PrepareCaptureFrame();
         }
     }
@@ -317,47 +435,8 @@ void SoftRenderer::DrawScanline(u32 line, Unit* unit)
         return;
     }
 
-    // master brightness
-    if (dispmode != 0)
-    {
-        if ((masterBrightness >> 14) == 1)
-        {
-            // up
-            u32 factor = masterBrightness & 0x1F;
-            if (factor > 16) factor = 16;
-
-            for (int i = 0; i < 256; i++)
-            {
-                dst[i] = ColorBrightnessUp(dst[i], factor, 0x0);
-            }
-        }
-        else if ((masterBrightness >> 14) == 2)
-        {
-            // down
-            u32 factor = masterBrightness & 0x1F;
-            if (factor > 16) factor = 16;
-
-            for (int i = 0; i < 256; i++)
-            {
-                dst[i] = ColorBrightnessDown(dst[i], factor, 0xF);
-            }
-        }
-    }
-
-    // convert to 32-bit BGRA
-    // note: 32-bit RGBA would be more straightforward, but
-    // BGRA seems to be more compatible (Direct2D soft, cairo...)
-    for (int i = 0; i < 256; i+=2)
-    {
-        u64 c = *(u64*)&dst[i];
-
-        u64 r = (c << 18) & 0xFC000000FC0000;
-        u64 g = (c << 2) & 0xFC000000FC00;
-        u64 b = (c >> 14) & 0xFC000000FC;
-        c = r | g | b;
-
-        *(u64*)&dst[i] = c | ((c & 0x00C0C0C000C0C0C0) >> 6) | 0xFF000000FF000000;
-    }
+    // master brightness, not applied for a disabled display
+    FinishLine(dst, dispmode != 0 ? masterBrightness : 0);
 }
 
 void SoftRenderer::VBlankEnd(Unit* unitA, Unit* unitB)
@@ -756,8 +835,8 @@ void SoftRenderer::DrawScanline_BGOBJ(u32 line)
     }
 
     u64 backdrop;
-    if (CurUnit->Num) backdrop = *(u16*)&GPU::Palette[0x400];
-    else     backdrop = *(u16*)&GPU::Palette[0];
+    if (CurUnit->Num) backdrop = *(u16*)&CurPalette[0x400];
+    else     backdrop = *(u16*)&CurPalette[0];
 
     {
         u8 r = (backdrop & 0x001F) << 1;
@@ -796,13 +875,7 @@ void SoftRenderer::DrawScanline_BGOBJ(u32 line)
 
     if (!GPU3D::CurrentRenderer->Accelerated)
     {
-        for (int i = 0; i < 256; i++)
-        {
-            u32 val1 = BGOBJLine[i];
-            u32 val2 = BGOBJLine[256+i];
-
-            BGOBJLine[i] = ColorComposite(i, val1, val2);
-        }
+        CompositeLine(BGOBJLine, WindowMask, CurUnit->BlendCnt, CurUnit->EVA, CurUnit->EVB, CurUnit->EVY);
     }
     else
     {
@@ -997,14 +1070,14 @@ void SoftRenderer::DrawBG_Text(u32 line, u32 bgnum)
         tilesetaddr = ((bgcnt & 0x003C) << 12);
         tilemapaddr = ((bgcnt & 0x1F00) << 3);
 
-        pal = (u16*)&GPU::Palette[0x400];
+        pal = (u16*)&CurPalette[0x400];
     }
     else
     {
         tilesetaddr = ((CurUnit->DispCnt & 0x07000000) >> 8) + ((bgcnt & 0x003C) << 12);
         tilemapaddr = ((CurUnit->DispCnt & 0x38000000) >> 11) + ((bgcnt & 0x1F00) << 3);
 
-        pal = (u16*)&GPU::Palette[0];
+        pal = (u16*)&CurPalette[0];
     }
 
     // adjust Y position in tilemap
@@ -1176,14 +1249,14 @@ void SoftRenderer::DrawBG_Affine(u32 line, u32 bgnum)
         tilesetaddr = ((bgcnt & 0x003C) << 12);
         tilemapaddr = ((bgcnt & 0x1F00) << 3);
 
-        pal = (u16*)&GPU::Palette[0x400];
+        pal = (u16*)&CurPalette[0x400];
     }
     else
     {
         tilesetaddr = ((CurUnit->DispCnt & 0x07000000) >> 8) + ((bgcnt & 0x003C) << 12);
         tilemapaddr = ((CurUnit->DispCnt & 0x38000000) >> 11) + ((bgcnt & 0x1F00) << 3);
 
-        pal = (u16*)&GPU::Palette[0];
+        pal = (u16*)&CurPalette[0];
     }
 
     u16 curtile;
@@ -1330,8 +1403,8 @@ void SoftRenderer::DrawBG_Extended(u32 line, u32 bgnum)
         {
             // 256-color bitmap
 
-            if (CurUnit->Num) pal = (u16*)&GPU::Palette[0x400];
-            else              pal = (u16*)&GPU::Palette[0];
+            if (CurUnit->Num) pal = (u16*)&CurPalette[0x400];
+            else              pal = (u16*)&CurPalette[0];
 
             u8 color;
 
@@ -1389,14 +1462,14 @@ void SoftRenderer::DrawBG_Extended(u32 line, u32 bgnum)
             tilesetaddr = ((bgcnt & 0x003C) << 12);
             tilemapaddr = ((bgcnt & 0x1F00) << 3);
 
-            pal = (u16*)&GPU::Palette[0x400];
+            pal = (u16*)&CurPalette[0x400];
         }
         else
         {
             tilesetaddr = ((CurUnit->DispCnt & 0x07000000) >> 8) + ((bgcnt & 0x003C) << 12);
             tilemapaddr = ((CurUnit->DispCnt & 0x38000000) >> 11) + ((bgcnt & 0x1F00) << 3);
 
-            pal = (u16*)&GPU::Palette[0];
+            pal = (u16*)&CurPalette[0];
         }
 
         u16 curtile;
@@ -1507,8 +1580,8 @@ void SoftRenderer::DrawBG_Large(u32 line) // BG is always BG2
 
     // 256-color bitmap
 
-    if (CurUnit->Num) pal = (u16*)&GPU::Palette[0x400];
-    else     pal = (u16*)&GPU::Palette[0];
+    if (CurUnit->Num) pal = (u16*)&CurPalette[0x400];
+    else     pal = (u16*)&CurPalette[0];
 
     u8 color;
 
@@ -1586,7 +1659,7 @@ template <SoftRenderer::DrawPixel drawPixel>
 void SoftRenderer::InterleaveSprites(u32 prio)
 {
     u32* objLine = OBJLine[CurUnit->Num];
-    u16* pal = (u16*)&GPU::Palette[CurUnit->Num ? 0x600 : 0x200];
+    u16* pal = (u16*)&CurPalette[CurUnit->Num ? 0x600 : 0x200];
 
     if (CurUnit->DispCnt & 0x80000000)
     {
@@ -1644,8 +1717,34 @@ void SoftRenderer::InterleaveSprites(u32 prio)
 
 void SoftRenderer::DrawSprites(u32 line, Unit* unit)
 {
+    if (EngineB && unit->Num == 1)
+    {
+        EngineB->DrawSprites(line, unit);
+        return;
+    }
+
+    if (Threaded)
+    {
+        if (NumDeferredLines < MaxDeferredLines)
+        {
+            DeferLine(line, unit, true);
+            return;
+        }
+
+        SyncScanlines();
+    }
+
     CurUnit = unit;
+    CurPalette = GPU::Palette;
+    CurOAM = GPU::OAM;
+
+    MakeOBJVRAMCoherent(CurUnit->Num, nullptr);
 
+    RenderSprites(line);
+}
+
+void SoftRenderer::RenderSprites(u32 line)
+{
     if (line == 0)
     {
         // reset those counters here
@@ -1658,17 +1757,6 @@ void SoftRenderer::DrawSprites(u32 line, Unit* unit)
         CurUnit->OBJMosaicYCount = 0;
     }
 
-    if (CurUnit->Num == 0)
-    {
-        auto objDirty = GPU::VRAMDirty_AOBJ.DeriveState(GPU::VRAMMap_AOBJ);
-        GPU::MakeVRAMFlat_AOBJCoherent(objDirty);
-    }
-    else
-    {
-        auto objDirty = GPU::VRAMDirty_BOBJ.DeriveState(GPU::VRAMMap_BOBJ);
-        GPU::MakeVRAMFlat_BOBJCoherent(objDirty);
-    }
-
     NumSprites[CurUnit->Num] = 0;
     memset(OBJLine[CurUnit->Num], 0, 256*4);
     memset(OBJWindow[CurUnit->Num], 0, 256);
@@ -1676,7 +1764,7 @@ void SoftRenderer::DrawSprites(u32 line, Unit* unit)
 
     memset(OBJIndex, 0xFF, 256);
 
-    u16* oam = (u16*)&GPU::OAM[CurUnit->Num ? 0x400 : 0];
+    u16* oam = (u16*)&CurOAM[CurUnit->Num ? 0x400 : 0];
 
     const s32 spritewidth[16] =
     {
@@ -1771,7 +1859,7 @@ void SoftRenderer::DrawSprites(u32 line, Unit* unit)
 template<bool window>
 void SoftRenderer::DrawSprite_Rotscale(u32 num, u32 boundwidth, u32 boundheight, u32 width, u32 height, s32 xpos, s32 ypos)
 {
-    u16* oam = (u16*)&GPU::OAM[CurUnit->Num ? 0x400 : 0];
+    u16* oam = (u16*)&CurOAM[CurUnit->Num ? 0x400 : 0];
     u16* attrib = &oam[num * 4];
     u16* rotparams = &oam[(((attrib[1] >> 9) & 0x1F) * 16) + 3];
 
@@ -1993,7 +2081,7 @@ void SoftRenderer::DrawSprite_Rotscale(u32 num, u32 boundwidth, u32 boundheight,
 template<bool window>
 void SoftRenderer::DrawSprite_Normal(u32 num, u32 width, u32 height, s32 xpos, s32 ypos)
 {
-    u16* oam = (u16*)&GPU::OAM[CurUnit->Num ? 0x400 : 0];
+    u16* oam = (u16*)&CurOAM[CurUnit->Num ? 0x400 : 0];
     u16* attrib = &oam[num * 4];
 
     u32 pixelattr = ((attrib[2] & 0x0C00) << 6) | 0xC0000;
@@ -19,6 +19,11 @@
 #pragma once
 
 #include "GPU2D.h"
+#include "GPU.h"
+#include "Platform.h"
+
+#include <atomic>
+#include <memory>
 
 namespace GPU2D
 {
@@ -27,12 +32,77 @@ class SoftRenderer : public Renderer2D
 {
 public:
     SoftRenderer();
-    ~SoftRenderer() override {}
+    ~SoftRenderer() override;
 
     void DrawScanline(u32 line, Unit* unit) override;
     void DrawSprites(u32 line, Unit* unit) override;
     void VBlankEnd(Unit* unitA, Unit* unitB) override;
+
+    void SetThreaded(bool threaded) override;
+    void SyncScanlines() override;
 private:
+    // in threaded mode, the emulator thread takes a copy of everything
+    // a scanline depends on, and the scanline is drawn on a separate thread
+    // scanlines are drawn in the order they were submitted, so the state
+    // that evolves from one scanline to the next stays the same
+    struct DeferredLine
+    {
+        bool Sprites;
+        bool Resync;
+        u32 Line;
+        u32 VCount;
+        u16 RenderXPos;
+
+        Unit State{0};
+
+        // only the half belonging to the unit is copied
+        alignas(8) u8 Palette[2*1024];
+        alignas(8) u8 OAM[2*1024];
+
+        GPU::VRAMFlatLog VRAMLog;
+    };
+
+    static constexpr int MaxDeferredLines = 192*4;
+
+    bool Threaded;
+    // in threaded mode, the scanlines of engine B are handed to a second
+    // renderer with its own thread, so both engines are drawn at the same time
+    // the engines don't share anything while drawing, but every scanline
+    // depends on the one before it, so there's no use for more threads
+    std::unique_ptr<SoftRenderer> EngineB;
+    bool IsEngineB = false;
+    Platform::Thread* LineThread;
+    std::atomic_bool LineThreadRunning;
+    Platform::Semaphore* Sema_LineStart;
+    Platform::Semaphore* Sema_LineDone;
+
+    std::unique_ptr<DeferredLine[]> DeferredLines;
+    int NumDeferredLines;
+    int CurDeferredLine;
+
+    // the state of each unit as left by the last scanline drawn on the thread
+    Unit DeferredUnits[2] = {Unit(0), Unit(1)};
+    Unit* DeferredUnitSource[2];
+    bool DeferredUnitValid[2];
+
+    void StopLineThread();
+    void LineThreadFunc();
+    bool CanDeferScanline(Unit* unit);
+    void DeferLine(u32 line, Unit* unit, bool sprites);
+
+    void MakeBGVRAMCoherent(u32 num, GPU::VRAMFlatLog* log);
+    void MakeOBJVRAMCoherent(u32 num, GPU::VRAMFlatLog* log);
+
+    void RenderScanline(u32 line, u32 vcount, u16 renderXPos);
+    void RenderSprites(u32 line);
+
+    u8* CurPalette;
+    u8* CurOAM;
+
+    // picked at startup depending on what the CPU supports
+    void (*CompositeLine)(u32* line, const u8* windowMask, u32 blendCnt, u32 eva, u32 evb, u32 evy);
+    void (*FinishLine)(u32* dst, u32 masterBrightness);
+
     alignas(8) u32 BGOBJLine[256*3];
     u32* _3DLine;
 
@@ -47,10 +117,6 @@ private:
     u8* CurBGXMosaicTable;
     u8 MosaicTable[16][256];
 
-    u32 ColorBlend4(u32 val1, u32 val2, u32 eva, u32 evb);
-    u32 ColorBlend5(u32 val1, u32 val2);
-    u32 ColorBrightnessUp(u32 val, u32 factor, u32 bias);
-    u32 ColorBrightnessDown(u32 val, u32 factor, u32 bias);
     u32 ColorComposite(int i, u32 val1, u32 val2);
 
     template<u32 bgmode> void DrawScanlineBGMode(u32 line);
@@ -23,6 +23,7 @@
 #include "GPU.h"
 #include "FIFO.h"
 #include "Platform.h"
+#include "Profiler.h"
 
 using Platform::Log;
 using Platform::LogLevel;
@@ -1833,6 +1834,8 @@ inline void VertexPipelineCmdDelayed4()
 
 void ExecuteCommand()
 {
+    PROFILE_COUNT(Counter_GXCommands);
+
     CmdFIFOEntry entry = CmdFIFORead();
 
     //printf("FIFO: processing %02X %08X. Levels: FIFO=%d, PIPE=%d\n", entry.Command, entry.Param, CmdFIFO->Level(), CmdPIPE->Level());
@@ -2464,6 +2467,8 @@ void Run()
 
     if (CycleCount <= 0)
     {
+        PROFILE_SCOPE(Section_GPU3D);
+
         while (CycleCount <= 0 && !CmdPIPE.IsEmpty())
         {
             if (NumPushPopCommands == 0) GXStat &= ~(1<<14);
@@ -2618,18 +2623,23 @@ void SetRenderXPos(u16 xpos)
 u32 ScrolledLine[256];
 
 u32* GetLine(int line)
+{
+    return GetLine(line, RenderXPos);
+}
+
+u32* GetLine(int line, u16 xpos)
 {
     if (!AbortFrame)
     {
         u32* rawline = CurrentRenderer->GetLine(line);
 
-        if (RenderXPos == 0) return rawline;
+        if (xpos == 0) return rawline;
 
         // apply X scroll
 
-        if (RenderXPos & 0x100)
+        if (xpos & 0x100)
         {
-            int i = 0, j = RenderXPos;
+            int i = 0, j = xpos;
             for (; j < 512; i++, j++)
                 ScrolledLine[i] = 0;
             for (j = 0; i < 256; i++, j++)
@@ -2637,7 +2647,7 @@ u32* GetLine(int line)
         }
         else
         {
-            int i = 0, j = RenderXPos;
+            int i = 0, j = xpos;
             for (; j < 256; i++, j++)
                 ScrolledLine[i] = rawline[j];
             for (; i < 256; i++)
@@ -124,6 +124,8 @@ void RestartFrame();
 
 void SetRenderXPos(u16 xpos);
 u32* GetLine(int line);
+// same, with the X scroll value that was latched for the scanline
+u32* GetLine(int line, u16 xpos);
 
 void WriteToGXFIFO(u32 val);
 
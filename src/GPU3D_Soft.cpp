@@ -23,6 +23,13 @@
 #include <string.h>
 #include "NDS.h"
 #include "GPU.h"
+#include "Profiler.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
 
 
 namespace GPU3D
@@ -40,6 +47,8 @@ void SoftRenderer::StopRenderThread()
         Platform::Thread_Wait(RenderThread);
         Platform::Thread_Free(RenderThread);
     }
+
+    StopRasterThreads();
 }
 
 void SoftRenderer::SetupRenderThread()
@@ -62,6 +71,8 @@ void SoftRenderer::SetupRenderThread()
         Platform::Semaphore_Reset(Sema_RenderStart);
         Platform::Semaphore_Reset(Sema_ScanlineCount);
 
+        SetupRasterThreads();
+
         Platform::Semaphore_Post(Sema_RenderStart);
     }
     else
@@ -70,11 +81,72 @@ void SoftRenderer::SetupRenderThread()
     }
 }
 
+void SoftRenderer::StopRasterThreads()
+{
+    if (!RasterThreadsRunning.load(std::memory_order_relaxed))
+        return;
+
+    RasterThreadsRunning = false;
+
+    for (int i = 0; i < NumRasterThreadsRunning; i++)
+        Platform::Semaphore_Post(Sema_RasterStart[i]);
+
+    for (int i = 0; i < NumRasterThreadsRunning; i++)
+    {
+        Platform::Thread_Wait(RasterThreads[i]);
+        Platform::Thread_Free(RasterThreads[i]);
+
+        Platform::Semaphore_Free(Sema_RasterStart[i]);
+        Platform::Semaphore_Free(Sema_RasterLine[i]);
+        delete RasterContexts[i];
+    }
+
+    NumRasterThreadsRunning = 0;
+}
+
+void SoftRenderer::SetupRasterThreads()
+{
+    // only called while the render thread is idle
+
+    if (NumRasterThreadsRunning == NumRasterThreads)
+        return;
+
+    StopRasterThreads();
+
+    if (NumRasterThreads < 2)
+        return;
+
+    RasterThreadsRunning = true;
+
+    for (int i = 0; i < NumRasterThreads; i++)
+    {
+        Sema_RasterStart[i] = Platform::Semaphore_Create();
+        Sema_RasterLine[i] = Platform::Semaphore_Create();
+        RasterContexts[i] = new RasterContext;
+        RasterThreads[i] = Platform::Thread_Create(std::bind(&SoftRenderer::RasterThreadFunc, this, i));
+    }
+
+    NumRasterThreadsRunning = NumRasterThreads;
+}
+
 
 SoftRenderer::SoftRenderer()
     : Renderer3D(false)
 {
-
+#ifdef GPU3D_SIMD
+    InterpolateSpan = InterpolateSpan_Base;
+    ShadeSpan = ShadeSpan_Base;
+#if defined(__x86_64__) || defined(__i386__)
+    if (__builtin_cpu_supports("avx2"))
+    {
+        InterpolateSpan = InterpolateSpan_AVX2;
+        ShadeSpan = ShadeSpan_AVX2;
+    }
+#endif
+#else
+    InterpolateSpan = InterpolateSpan_Scalar;
+    ShadeSpan = ShadeSpan_Scalar;
+#endif
 }
 
 bool SoftRenderer::Init()
@@ -87,6 +159,12 @@ bool SoftRenderer::Init()
     RenderThreadRunning = false;
     RenderThreadRendering = false;
 
+    TexCacheTexels = 0;
+
+    NumRasterThreads = 1;
+    NumRasterThreadsRunning = 0;
+    RasterThreadsRunning = false;
+
     return true;
 }
 
@@ -105,7 +183,10 @@ void SoftRenderer::Reset()
     memset(DepthBuffer, 0, BufferSize * 2 * 4);
     memset(AttrBuffer, 0, BufferSize * 2 * 4);
 
-    PrevIsShadowMask = false;
+    MainContext.PrevIsShadowMask = false;
+
+    TexCache.clear();
+    TexCacheTexels = 0;
 
     SetupRenderThread();
 }
@@ -113,19 +194,12 @@ void SoftRenderer::Reset()
 void SoftRenderer::SetRenderSettings(GPU::RenderSettings& settings)
 {
     Threaded = settings.Soft_Threaded;
+    NumRasterThreads = std::clamp(settings.Soft_NumThreads, 1, MaxRasterThreads);
     SetupRenderThread();
 }
 
-void SoftRenderer::TextureLookup(u32 texparam, u32 texpal, s16 s, s16 t, u16* color, u8* alpha)
+inline void WrapTexCoords(u32 texparam, s32 width, s32 height, s16& s, s16& t)
 {
-    u32 vramaddr = (texparam & 0xFFFF) << 3;
-
-    s32 width = 8 << ((texparam >> 20) & 0x7);
-    s32 height = 8 << ((texparam >> 23) & 0x7);
-
-    s >>= 4;
-    t >>= 4;
-
     // texture wrapping
     // TODO: optimize this somehow
     // testing shows that it's hardly worth optimizing, actually
@@ -161,6 +235,19 @@ void SoftRenderer::TextureLookup(u32 texparam, u32 texpal, s16 s, s16 t, u16* co
         if (t < 0) t = 0;
         else if (t >= height) t = height-1;
     }
+}
+
+void SoftRenderer::TextureLookup(u32 texparam, u32 texpal, s16 s, s16 t, u16* color, u8* alpha)
+{
+    u32 vramaddr = (texparam & 0xFFFF) << 3;
+
+    s32 width = 8 << ((texparam >> 20) & 0x7);
+    s32 height = 8 << ((texparam >> 23) & 0x7);
+
+    s >>= 4;
+    t >>= 4;
+
+    WrapTexCoords(texparam, width, height, s, t);
 
     u8 alpha0;
     if (texparam & (1<<29)) alpha0 = 0;
@@ -342,6 +429,170 @@ void SoftRenderer::TextureLookup(u32 texparam, u32 texpal, s16 s, s16 t, u16* co
     }
 }
 
+void SoftRenderer::CachedTextureLookup(const u32* texels, u32 texparam, s16 s, s16 t, u16* color, u8* alpha)
+{
+    s32 width = 8 << ((texparam >> 20) & 0x7);
+    s32 height = 8 << ((texparam >> 23) & 0x7);
+
+    s >>= 4;
+    t >>= 4;
+
+    WrapTexCoords(texparam, width, height, s, t);
+
+    u32 texel = texels[(t * width) + s];
+    *color = texel & 0xFFFF;
+    *alpha = texel >> 16;
+}
+
+u64 SoftRenderer::TexCacheKey(u32 texparam, u32 texpal)
+{
+    // repeat/flip and texcoord transform bits don't affect decoding
+    texparam &= 0x3FF0FFFF;
+
+    // direct color textures don't use a palette
+    if (((texparam >> 26) & 0x7) == 7)
+        texpal = 0;
+
+    return (u64)texparam | ((u64)texpal << 32);
+}
+
+const u32* SoftRenderer::GetCachedTexture(u32 texparam, u32 texpal)
+{
+    auto it = TexCache.find(TexCacheKey(texparam, texpal));
+    if (it == TexCache.end())
+        return nullptr;
+
+    return it->second.Texels.data();
+}
+
+void SoftRenderer::CacheTextures(Polygon** polygons, int npolys)
+{
+    // all textures used in the frame are decoded ahead of rendering,
+    // so that the rasterizer threads only ever read from the cache
+
+    if (!(RenderDispCnt & (1<<0)))
+        return;
+
+    for (int i = 0; i < npolys; i++)
+    {
+        Polygon* polygon = polygons[i];
+        if (polygon->Degenerate) continue;
+
+        u32 texparam = polygon->TexParam;
+        u32 texpal = polygon->TexPalette;
+        u32 fmt = (texparam >> 26) & 0x7;
+        if (fmt == 0) continue;
+
+        u64 key = TexCacheKey(texparam, texpal);
+        if (TexCache.find(key) != TexCache.end())
+            continue;
+
+        s32 width = 8 << ((texparam >> 20) & 0x7);
+        s32 height = 8 << ((texparam >> 23) & 0x7);
+
+        if (TexCacheTexels + (width * height) > TexCacheMaxTexels)
+        {
+            TexCache.clear();
+            TexCacheTexels = 0;
+        }
+
+        CachedTexture& tex = TexCache[key];
+        tex.Texels.resize(width * height);
+        TexCacheTexels += width * height;
+
+        // decoding goes through the regular lookup function
+        // to guarantee identical results
+        u32* dst = tex.Texels.data();
+        for (s32 t = 0; t < height; t++)
+        {
+            for (s32 s = 0; s < width; s++)
+            {
+                u16 color; u8 alpha;
+                TextureLookup(texparam, texpal, s << 4, t << 4, &color, &alpha);
+                *dst++ = color | (alpha << 16);
+            }
+        }
+
+        // keep track of the VRAM ranges the texture depends on
+
+        static const u8 texbits[8] = {0, 8, 2, 4, 8, 2, 8, 16};
+        static const u16 palsizes[8] = {0, 32*2, 4*2, 16*2, 256*2, 0, 8*2, 0};
+
+        u32 vramaddr = (texparam & 0xFFFF) << 3;
+        u32 texlen = (width * height * texbits[fmt]) >> 3;
+
+        tex.TexStart[0] = vramaddr;
+        tex.TexLen[0] = texlen;
+        tex.TexStart[1] = 0;
+        tex.TexLen[1] = 0;
+
+        if (fmt == 5)
+        {
+            // compressed: palette index data lives in slot 1
+            u32 slot1addr = 0x20000 + ((vramaddr & 0x1FFFC) >> 1);
+            if (vramaddr >= 0x40000)
+                slot1addr += 0x10000;
+
+            tex.TexStart[1] = slot1addr;
+            tex.TexLen[1] = texlen >> 1;
+
+            // palette offsets are per-block, assume the whole addressable range
+            tex.PalStart = texpal << 4;
+            tex.PalLen = 0x10000 + 8;
+        }
+        else if (fmt == 7)
+        {
+            tex.PalStart = 0;
+            tex.PalLen = 0;
+        }
+        else
+        {
+            tex.PalStart = texpal << ((fmt == 2) ? 3 : 4);
+            tex.PalLen = palsizes[fmt];
+        }
+    }
+}
+
+template <u32 Size>
+bool RangeDirty(NonStupidBitField<Size>& dirty, u32 start, u32 len)
+{
+    if (len == 0)
+        return false;
+
+    // ranges wrap around like VRAM accesses do
+    u32 first = start / GPU::VRAMDirtyGranularity;
+    u32 last = (start + len - 1) / GPU::VRAMDirtyGranularity;
+    if (last - first >= Size)
+        last = first + Size - 1;
+
+    for (u32 i = first; i <= last; i++)
+    {
+        if (dirty[i % Size])
+            return true;
+    }
+
+    return false;
+}
+
+void SoftRenderer::InvalidateTexCache(NonStupidBitField<512*1024/GPU::VRAMDirtyGranularity>& texdirty,
+                                      NonStupidBitField<128*1024/GPU::VRAMDirtyGranularity>& paldirty)
+{
+    for (auto it = TexCache.begin(); it != TexCache.end(); )
+    {
+        CachedTexture& tex = it->second;
+
+        if (RangeDirty(texdirty, tex.TexStart[0], tex.TexLen[0]) ||
+            RangeDirty(texdirty, tex.TexStart[1], tex.TexLen[1]) ||
+            RangeDirty(paldirty, tex.PalStart, tex.PalLen))
+        {
+            TexCacheTexels -= tex.Texels.size();
+            it = TexCache.erase(it);
+        }
+        else
+            it++;
+    }
+}
+
 // depth test is 'less or equal' instead of 'less than' under the following conditions:
 // * when drawing a front-facing pixel over an opaque back-facing pixel
 // * when drawing wireframe edges, under certain conditions (TODO)
@@ -392,6 +643,80 @@ bool DepthTest_LessThan_FrontFacing(s32 dstz, s32 z, u32 dstattr)
     return false;
 }
 
+// span version of the 'less than' depth tests, processing 4 pixels at once
+// sets mask[x] for every pixel in [xs, xe) which passes the depth test, or
+// which fails it but has to be tested against the pixel underneath
+// (antialiased edges). other pixels can be skipped without further work.
+
+void DepthTestSpan_LessThan(const u32* depth, const u32* attr, const s32* z, s32 xs, s32 xe, bool frontfacing, u8* mask)
+{
+    s32 x = xs;
+
+#if defined(__SSE2__)
+    const __m128i bfmask = _mm_set1_epi32(0x00400010);
+    const __m128i bfval = _mm_set1_epi32(0x00000010);
+    const __m128i edgemask = _mm_set1_epi32(0x3);
+    const __m128i zero = _mm_setzero_si128();
+
+    for (; x+4 <= xe; x += 4)
+    {
+        __m128i dstz = _mm_loadu_si128((const __m128i*)&depth[x]);
+        __m128i dstattr = _mm_loadu_si128((const __m128i*)&attr[x]);
+        __m128i srcz = _mm_loadu_si128((const __m128i*)&z[x]);
+
+        __m128i pass = _mm_cmplt_epi32(srcz, dstz);
+        if (frontfacing)
+        {
+            __m128i backfacing = _mm_cmpeq_epi32(_mm_and_si128(dstattr, bfmask), bfval);
+            pass = _mm_or_si128(pass, _mm_and_si128(backfacing, _mm_cmpeq_epi32(srcz, dstz)));
+        }
+
+        __m128i noedge = _mm_cmpeq_epi32(_mm_and_si128(dstattr, edgemask), zero);
+        pass = _mm_or_si128(pass, _mm_andnot_si128(noedge, _mm_set1_epi32(-1)));
+
+        pass = _mm_packs_epi32(pass, pass);
+        pass = _mm_packs_epi16(pass, pass);
+        u32 res = _mm_cvtsi128_si32(pass);
+        memcpy(&mask[x], &res, 4);
+    }
+#elif defined(__ARM_NEON)
+    const uint32x4_t bfmask = vdupq_n_u32(0x00400010);
+    const uint32x4_t bfval = vdupq_n_u32(0x00000010);
+    const uint32x4_t edgemask = vdupq_n_u32(0x3);
+
+    for (; x+4 <= xe; x += 4)
+    {
+        int32x4_t dstz = vreinterpretq_s32_u32(vld1q_u32(&depth[x]));
+        uint32x4_t dstattr = vld1q_u32(&attr[x]);
+        int32x4_t srcz = vld1q_s32(&z[x]);
+
+        uint32x4_t pass = vcltq_s32(srcz, dstz);
+        if (frontfacing)
+        {
+            uint32x4_t backfacing = vceqq_u32(vandq_u32(dstattr, bfmask), bfval);
+            pass = vorrq_u32(pass, vandq_u32(backfacing, vceqq_s32(srcz, dstz)));
+        }
+
+        pass = vorrq_u32(pass, vtstq_u32(dstattr, edgemask));
+
+        uint16x4_t pass16 = vmovn_u32(pass);
+        uint8x8_t pass8 = vmovn_u16(vcombine_u16(pass16, pass16));
+        vst1_lane_u32((uint32_t*)&mask[x], vreinterpret_u32_u8(pass8), 0);
+    }
+#endif
+
+    for (; x < xe; x++)
+    {
+        bool pass;
+        if (frontfacing)
+            pass = DepthTest_LessThan_FrontFacing(depth[x], z[x], attr[x]);
+        else
+            pass = DepthTest_LessThan(depth[x], z[x], attr[x]);
+
+        mask[x] = (pass || (attr[x] & 0x3)) ? 0xFF : 0;
+    }
+}
+
 u32 AlphaBlend(u32 srccolor, u32 dstcolor, u32 alpha)
 {
     u32 dstalpha = dstcolor >> 24;
@@ -422,7 +747,7 @@ u32 AlphaBlend(u32 srccolor, u32 dstcolor, u32 alpha)
     return srcR | (srcG << 8) | (srcB << 16) | (dstalpha << 24);
 }
 
-u32 SoftRenderer::RenderPixel(Polygon* polygon, u8 vr, u8 vg, u8 vb, s16 s, s16 t)
+u32 SoftRenderer::RenderPixel(Polygon* polygon, const u32* texels, u8 vr, u8 vg, u8 vb, s16 s, s16 t)
 {
     u8 r, g, b, a;
 
@@ -459,7 +784,10 @@ u32 SoftRenderer::RenderPixel(Polygon* polygon, u8 vr, u8 vg, u8 vb, s16 s, s16
         u8 tr, tg, tb;
 
         u16 tcolor; u8 talpha;
-        TextureLookup(polygon->TexParam, polygon->TexPalette, s, t, &tcolor, &talpha);
+        if (texels)
+            CachedTextureLookup(texels, polygon->TexParam, s, t, &tcolor, &talpha);
+        else
+            TextureLookup(polygon->TexParam, polygon->TexPalette, s, t, &tcolor, &talpha);
 
         tr = (tcolor << 1) & 0x3E; if (tr) tr++;
         tg = (tcolor >> 4) & 0x3E; if (tg) tg++;
@@ -631,6 +959,7 @@ void SoftRenderer::SetupPolygon(SoftRenderer::RendererPolygon* rp, Polygon* poly
     s32 ytop = polygon->YTop, ybot = polygon->YBottom;
 
     rp->PolyData = polygon;
+    rp->Texels = GetCachedTexture(polygon->TexParam, polygon->TexPalette);
 
     rp->CurVL = vtop;
     rp->CurVR = vtop;
@@ -676,7 +1005,7 @@ void SoftRenderer::SetupPolygon(SoftRenderer::RendererPolygon* rp, Polygon* poly
     }
 }
 
-void SoftRenderer::RenderShadowMaskScanline(RendererPolygon* rp, s32 y)
+void SoftRenderer::RenderShadowMaskScanline(RasterContext& ctx, RendererPolygon* rp, s32 y)
 {
     Polygon* polygon = rp->PolyData;
 
@@ -694,10 +1023,10 @@ void SoftRenderer::RenderShadowMaskScanline(RendererPolygon* rp, s32 y)
     else
         fnDepthTest = DepthTest_LessThan;
 
-    if (!PrevIsShadowMask)
-        memset(&StencilBuffer[256 * (y&0x1)], 0, 256);
+    if (!ctx.PrevIsShadowMask)
+        memset(&ctx.StencilBuffer[256 * (y&0x1)], 0, 256);
 
-    PrevIsShadowMask = true;
+    ctx.PrevIsShadowMask = true;
 
     if (polygon->YTop != polygon->YBottom)
     {
@@ -819,13 +1148,13 @@ void SoftRenderer::RenderShadowMaskScanline(RendererPolygon* rp, s32 y)
             continue;
 
         if (!fnDepthTest(DepthBuffer[pixeladdr], z, dstattr))
-            StencilBuffer[256*(y&0x1) + x] = 1;
+            ctx.StencilBuffer[256*(y&0x1) + x] = 1;
 
         if (dstattr & 0x3)
         {
             pixeladdr += BufferSize;
             if (!fnDepthTest(DepthBuffer[pixeladdr], z, AttrBuffer[pixeladdr]))
-                StencilBuffer[256*(y&0x1) + x] |= 0x2;
+                ctx.StencilBuffer[256*(y&0x1) + x] |= 0x2;
         }
     }
 
@@ -845,13 +1174,13 @@ void SoftRenderer::RenderShadowMaskScanline(RendererPolygon* rp, s32 y)
         u32 dstattr = AttrBuffer[pixeladdr];
 
         if (!fnDepthTest(DepthBuffer[pixeladdr], z, dstattr))
-            StencilBuffer[256*(y&0x1) + x] = 1;
+            ctx.StencilBuffer[256*(y&0x1) + x] = 1;
 
         if (dstattr & 0x3)
         {
             pixeladdr += BufferSize;
             if (!fnDepthTest(DepthBuffer[pixeladdr], z, AttrBuffer[pixeladdr]))
-                StencilBuffer[256*(y&0x1) + x] |= 0x2;
+                ctx.StencilBuffer[256*(y&0x1) + x] |= 0x2;
         }
     }
 
@@ -874,13 +1203,13 @@ void SoftRenderer::RenderShadowMaskScanline(RendererPolygon* rp, s32 y)
             continue;
 
         if (!fnDepthTest(DepthBuffer[pixeladdr], z, dstattr))
-            StencilBuffer[256*(y&0x1) + x] = 1;
+            ctx.StencilBuffer[256*(y&0x1) + x] = 1;
 
         if (dstattr & 0x3)
         {
             pixeladdr += BufferSize;
             if (!fnDepthTest(DepthBuffer[pixeladdr], z, AttrBuffer[pixeladdr]))
-                StencilBuffer[256*(y&0x1) + x] |= 0x2;
+                ctx.StencilBuffer[256*(y&0x1) + x] |= 0x2;
         }
     }
 
@@ -888,7 +1217,7 @@ void SoftRenderer::RenderShadowMaskScanline(RendererPolygon* rp, s32 y)
     rp->XR = rp->SlopeR.Step();
 }
 
-void SoftRenderer::RenderPolygonScanline(RendererPolygon* rp, s32 y)
+void SoftRenderer::RenderPolygonScanline(RasterContext& ctx, RendererPolygon* rp, s32 y)
 {
     Polygon* polygon = rp->PolyData;
 
@@ -906,7 +1235,7 @@ void SoftRenderer::RenderPolygonScanline(RendererPolygon* rp, s32 y)
     else
         fnDepthTest = DepthTest_LessThan;
 
-    PrevIsShadowMask = false;
+    ctx.PrevIsShadowMask = false;
 
     if (polygon->YTop != polygon->YBottom)
     {
@@ -1047,7 +1376,7 @@ void SoftRenderer::RenderPolygonScanline(RendererPolygon* rp, s32 y)
         // check stencil buffer for shadows
         if (polygon->IsShadow)
         {
-            u8 stencil = StencilBuffer[256*(y&0x1) + x];
+            u8 stencil = ctx.StencilBuffer[256*(y&0x1) + x];
             if (!stencil)
                 continue;
             if (!(stencil & 0x1))
@@ -1079,7 +1408,7 @@ void SoftRenderer::RenderPolygonScanline(RendererPolygon* rp, s32 y)
         s16 s = interpX.Interpolate(sl, sr);
         s16 t = interpX.Interpolate(tl, tr);
 
-        u32 color = RenderPixel(polygon, vr>>3, vg>>3, vb>>3, s, t);
+        u32 color = RenderPixel(polygon, rp->Texels, vr>>3, vg>>3, vb>>3, s, t);
         u8 alpha = color >> 24;
 
         // alpha test
@@ -1133,17 +1462,77 @@ void SoftRenderer::RenderPolygonScanline(RendererPolygon* rp, s32 y)
     if (xlimit > xend+1) xlimit = xend+1;
     if (xlimit > 256) xlimit = 256;
 
+    // for the common case (no shadow, Z-buffering, no equal depth test),
+    // the span is processed in passes: depth is calculated and tested for
+    // the whole span first, so that hidden pixels can be skipped later on.
+    // then the vertex attributes are interpolated for the whole span, and
+    // the colors are calculated at once for untextured and modulated polygons.
+    // only the texture lookups and plotting the pixels are done one by one.
+    bool spanpasses = !polygon->IsShadow && !polygon->WBuffer && !(polygon->Attr & (1<<14));
+    bool spancolors = false;
+    alignas(16) s32 spanz[256];
+    alignas(16) u8 spanmask[256];
+    alignas(16) s32 spanattr[SpanAttr_Count][256];
+    alignas(16) u32 spancolor[256];
+
+    if (spanpasses && !(wireframe && !edge) && x < xlimit)
+    {
+        u32 lineaddr = FirstPixelOffset + (y*ScanlineWidth);
+
+        interpX.InterpolateZSpan(zl, zr, x, xlimit, spanz);
+        DepthTestSpan_LessThan(&DepthBuffer[lineaddr], &AttrBuffer[lineaddr], spanz, x, xlimit,
+                               fnDepthTest == DepthTest_LessThan_FrontFacing, spanmask);
+
+        const s32 ends[SpanAttr_Count][2] = {{rl, rr}, {gl, gr}, {bl, br}, {sl, sr}, {tl, tr}};
+        InterpolateSpan(interpX.GetSpanInterp(), ends, x, xlimit, spanattr);
+
+        u32 blendmode = (polygon->Attr >> 4) & 0x3;
+        bool textured = (RenderDispCnt & (1<<0)) && (((polygon->TexParam >> 26) & 0x7) != 0);
+
+        if (!textured && blendmode != 2)
+        {
+            ShadeSpan(spanattr, nullptr, nullptr, x, xlimit, polyalpha, wireframe, spancolor);
+            spancolors = true;
+        }
+        else if (textured && blendmode == 0)
+        {
+            alignas(16) u16 spantexcolor[256];
+            alignas(16) u8 spantexalpha[256];
+
+            for (s32 i = x; i < xlimit; i++)
+            {
+                if (!spanmask[i])
+                {
+                    spantexcolor[i] = 0;
+                    spantexalpha[i] = 0;
+                }
+                else if (rp->Texels)
+                    CachedTextureLookup(rp->Texels, polygon->TexParam, spanattr[SpanAttr_S][i], spanattr[SpanAttr_T][i],
+                                        &spantexcolor[i], &spantexalpha[i]);
+                else
+                    TextureLookup(polygon->TexParam, polygon->TexPalette, spanattr[SpanAttr_S][i], spanattr[SpanAttr_T][i],
+                                  &spantexcolor[i], &spantexalpha[i]);
+            }
+
+            ShadeSpan(spanattr, spantexcolor, spantexalpha, x, xlimit, polyalpha, wireframe, spancolor);
+            spancolors = true;
+        }
+    }
+
     if (wireframe && !edge) x = xlimit;
     else
     for (; x < xlimit; x++)
     {
+        if (spanpasses && !spanmask[x])
+            continue;
+
         u32 pixeladdr = FirstPixelOffset + (y*ScanlineWidth) + x;
         u32 dstattr = AttrBuffer[pixeladdr];
 
         // check stencil buffer for shadows
         if (polygon->IsShadow)
         {
-            u8 stencil = StencilBuffer[256*(y&0x1) + x];
+            u8 stencil = ctx.StencilBuffer[256*(y&0x1) + x];
             if (!stencil)
                 continue;
             if (!(stencil & 0x1))
@@ -1152,9 +1541,16 @@ void SoftRenderer::RenderPolygonScanline(RendererPolygon* rp, s32 y)
                 dstattr &= ~0x3; // quick way to prevent drawing the shadow under antialiased edges
         }
 
-        interpX.SetX(x);
-
-        s32 z = interpX.InterpolateZ(zl, zr, polygon->WBuffer);
+        s32 z;
+        if (spanpasses)
+        {
+            z = spanz[x];
+        }
+        else
+        {
+            interpX.SetX(x);
+            z = interpX.InterpolateZ(zl, zr, polygon->WBuffer);
+        }
 
         // if depth test against the topmost pixel fails, test
         // against the pixel underneath
@@ -1168,14 +1564,30 @@ void SoftRenderer::RenderPolygonScanline(RendererPolygon* rp, s32 y)
                 continue;
         }
 
-        u32 vr = interpX.Interpolate(rl, rr);
-        u32 vg = interpX.Interpolate(gl, gr);
-        u32 vb = interpX.Interpolate(bl, br);
+        u32 color;
+        if (spancolors)
+        {
+            color = spancolor[x];
+        }
+        else if (spanpasses)
+        {
+            u32 vr = spanattr[SpanAttr_R][x];
+            u32 vg = spanattr[SpanAttr_G][x];
+            u32 vb = spanattr[SpanAttr_B][x];
 
-        s16 s = interpX.Interpolate(sl, sr);
-        s16 t = interpX.Interpolate(tl, tr);
+            color = RenderPixel(polygon, rp->Texels, vr>>3, vg>>3, vb>>3, spanattr[SpanAttr_S][x], spanattr[SpanAttr_T][x]);
+        }
+        else
+        {
+            u32 vr = interpX.Interpolate(rl, rr);
+            u32 vg = interpX.Interpolate(gl, gr);
+            u32 vb = interpX.Interpolate(bl, br);
+
+            s16 s = interpX.Interpolate(sl, sr);
+            s16 t = interpX.Interpolate(tl, tr);
 
-        u32 color = RenderPixel(polygon, vr>>3, vg>>3, vb>>3, s, t);
+            color = RenderPixel(polygon, rp->Texels, vr>>3, vg>>3, vb>>3, s, t);
+        }
         u8 alpha = color >> 24;
 
         // alpha test
@@ -1218,7 +1630,7 @@ void SoftRenderer::RenderPolygonScanline(RendererPolygon* rp, s32 y)
         // check stencil buffer for shadows
         if (polygon->IsShadow)
         {
-            u8 stencil = StencilBuffer[256*(y&0x1) + x];
+            u8 stencil = ctx.StencilBuffer[256*(y&0x1) + x];
             if (!stencil)
                 continue;
             if (!(stencil & 0x1))
@@ -1250,7 +1662,7 @@ void SoftRenderer::RenderPolygonScanline(RendererPolygon* rp, s32 y)
         s16 s = interpX.Interpolate(sl, sr);
         s16 t = interpX.Interpolate(tl, tr);
 
-        u32 color = RenderPixel(polygon, vr>>3, vg>>3, vb>>3, s, t);
+        u32 color = RenderPixel(polygon, rp->Texels, vr>>3, vg>>3, vb>>3, s, t);
         u8 alpha = color >> 24;
 
         // alpha test
@@ -1302,19 +1714,28 @@ void SoftRenderer::RenderPolygonScanline(RendererPolygon* rp, s32 y)
     rp->XR = rp->SlopeR.Step();
 }
 
-void SoftRenderer::RenderScanline(s32 y, int npolys)
+void SoftRenderer::RenderScanline(RasterContext& ctx, s32 y, int npolys, bool resync)
 {
     for (int i = 0; i < npolys; i++)
     {
-        RendererPolygon* rp = &PolygonList[i];
+        RendererPolygon* rp = &ctx.PolygonList[i];
         Polygon* polygon = rp->PolyData;
 
         if (y >= polygon->YTop && (y < polygon->YBottom || (y == polygon->YTop && polygon->YBottom == polygon->YTop)))
         {
+            // when scanlines are interleaved between threads, the edges were
+            // last stepped for an earlier scanline, so set them up again
+            // setting up a slope at a given Y yields the same state as stepping to it
+            if (resync && y != polygon->YTop)
+            {
+                SetupPolygonLeftEdge(rp, y);
+                SetupPolygonRightEdge(rp, y);
+            }
+
             if (polygon->IsShadowMask)
-                RenderShadowMaskScanline(rp, y);
+                RenderShadowMaskScanline(ctx, rp, y);
             else
-                RenderPolygonScanline(rp, y);
+                RenderPolygonScanline(ctx, rp, y);
         }
     }
 }
@@ -1618,18 +2039,20 @@ void SoftRenderer::ClearBuffers()
 
 void SoftRenderer::RenderPolygons(bool threaded, Polygon** polygons, int npolys)
 {
+    CacheTextures(polygons, npolys);
+
     int j = 0;
     for (int i = 0; i < npolys; i++)
     {
         if (polygons[i]->Degenerate) continue;
-        SetupPolygon(&PolygonList[j++], polygons[i]);
+        SetupPolygon(&MainContext.PolygonList[j++], polygons[i]);
     }
 
-    RenderScanline(0, j);
+    RenderScanline(MainContext, 0, j, false);
 
     for (s32 y = 1; y < 192; y++)
     {
-        RenderScanline(y, j);
+        RenderScanline(MainContext, y, j, false);
         ScanlineFinalPass(y-1);
 
         if (threaded)
@@ -1642,6 +2065,50 @@ void SoftRenderer::RenderPolygons(bool threaded, Polygon** polygons, int npolys)
         Platform::Semaphore_Post(Sema_ScanlineCount);
 }
 
+bool SoftRenderer::CanRenderPolygonsInterleaved(Polygon** polygons, int npolys)
+{
+    // shadow polygons depend on stencil state left over from previous
+    // scanlines, which can't be reproduced when scanlines are rendered
+    // out of order. render those frames on a single thread.
+    for (int i = 0; i < npolys; i++)
+    {
+        if (polygons[i]->IsShadowMask || polygons[i]->IsShadow)
+            return false;
+    }
+
+    return true;
+}
+
+void SoftRenderer::RenderPolygonsInterleaved(Polygon** polygons, int npolys)
+{
+    CacheTextures(polygons, npolys);
+
+    RasterPolygons = polygons;
+    RasterNumPolygons = npolys;
+
+    int nthreads = NumRasterThreadsRunning;
+    for (int i = 0; i < nthreads; i++)
+        Platform::Semaphore_Post(Sema_RasterStart[i]);
+
+    // the final pass needs the neighboring scanlines for edge marking
+    // every raster thread finishes its scanlines in order, so waiting
+    // on the thread owning a scanline once per scanline is enough
+
+    Platform::Semaphore_Wait(Sema_RasterLine[0]);
+
+    for (s32 y = 1; y < 192; y++)
+    {
+        Platform::Semaphore_Wait(Sema_RasterLine[y % nthreads]);
+        ScanlineFinalPass(y-1);
+
+        Platform::Semaphore_Post(Sema_ScanlineCount);
+    }
+
+    ScanlineFinalPass(191);
+
+    Platform::Semaphore_Post(Sema_ScanlineCount);
+}
+
 void SoftRenderer::VCount144()
 {
     if (RenderThreadRunning.load(std::memory_order_relaxed) && !GPU3D::AbortFrame)
@@ -1656,6 +2123,9 @@ void SoftRenderer::RenderFrame()
     bool textureChanged = GPU::MakeVRAMFlat_TextureCoherent(textureDirty);
     bool texPalChanged = GPU::MakeVRAMFlat_TexPalCoherent(texPalDirty);
 
+    if (textureChanged || texPalChanged)
+        InvalidateTexCache(textureDirty, texPalDirty);
+
     FrameIdentical = !(textureChanged || texPalChanged) && RenderFrameIdentical;
 
     if (RenderThreadRunning.load(std::memory_order_relaxed))
@@ -1664,6 +2134,8 @@ void SoftRenderer::RenderFrame()
     }
     else if (!FrameIdentical)
     {
+        PROFILE_SCOPE(Section_GPU3DRender);
+
         ClearBuffers();
         RenderPolygons(false, &RenderPolygonRAM[0], RenderNumPolygons);
     }
@@ -1688,8 +2160,14 @@ void SoftRenderer::RenderThreadFunc()
         }
         else
         {
+            PROFILE_SCOPE(Section_GPU3DRender);
+
             ClearBuffers();
-            RenderPolygons(true, &RenderPolygonRAM[0], RenderNumPolygons);
+
+            if (NumRasterThreadsRunning > 1 && CanRenderPolygonsInterleaved(&RenderPolygonRAM[0], RenderNumPolygons))
+                RenderPolygonsInterleaved(&RenderPolygonRAM[0], RenderNumPolygons);
+            else
+                RenderPolygons(true, &RenderPolygonRAM[0], RenderNumPolygons);
         }
 
         Platform::Semaphore_Post(Sema_RenderDone);
@@ -1697,6 +2175,30 @@ void SoftRenderer::RenderThreadFunc()
     }
 }
 
+void SoftRenderer::RasterThreadFunc(int num)
+{
+    RasterContext& ctx = *RasterContexts[num];
+
+    for (;;)
+    {
+        Platform::Semaphore_Wait(Sema_RasterStart[num]);
+        if (!RasterThreadsRunning) return;
+
+        int j = 0;
+        for (int i = 0; i < RasterNumPolygons; i++)
+        {
+            if (RasterPolygons[i]->Degenerate) continue;
+            SetupPolygon(&ctx.PolygonList[j++], RasterPolygons[i]);
+        }
+
+        for (s32 y = num; y < 192; y += NumRasterThreadsRunning)
+        {
+            RenderScanline(ctx, y, j, true);
+            Platform::Semaphore_Post(Sema_RasterLine[num]);
+        }
+    }
+}
+
 u32* SoftRenderer::GetLine(int line)
 {
     if (RenderThreadRunning.load(std::memory_order_relaxed))
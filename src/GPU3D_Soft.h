@@ -19,9 +19,13 @@
 #pragma once
 
 #include "GPU3D.h"
+#include "GPU.h"
+#include "GPU3D_SoftSpan.h"
 #include "Platform.h"
 #include <thread>
 #include <atomic>
+#include <unordered_map>
+#include <vector>
 
 namespace GPU3D
 {
@@ -214,6 +218,53 @@ private:
             }
         }
 
+        // Z-buffering along X: calculates the depth of every pixel in [xs, xe)
+        // the result doesn't depend on the perspective factor, so this
+        // doesn't need SetX() and produces the same values as InterpolateZ()
+        void InterpolateZSpan(s32 z0, s32 z1, s32 xs, s32 xe, s32* out)
+        {
+            if (xdiff == 0 || z0 == z1)
+            {
+                for (s32 i = xs; i < xe; i++)
+                    out[i] = z0;
+                return;
+            }
+
+            s32 base, disp, factor, incr;
+
+            if (z0 < z1)
+            {
+                base = z0;
+                disp = z1 - z0;
+                factor = xs - x0;
+                incr = 1;
+            }
+            else
+            {
+                base = z1;
+                disp = z0 - z1;
+                factor = xdiff - (xs - x0);
+                incr = -1;
+            }
+
+            disp >>= 9;
+            s64 step = (s64)disp * xrecip_z;
+            s64 acc = step * factor;
+            if (incr < 0) step = -step;
+
+            for (s32 i = xs; i < xe; i++)
+            {
+                out[i] = base + (acc >> 13);
+                acc += step;
+            }
+        }
+
+        // the parameters for interpolating the vertex attributes of a whole span at once
+        SpanInterp GetSpanInterp() const
+        {
+            return {x0, xdiff, xrecip, w0n, w0d, w1d, linear};
+        }
+
     private:
         s32 x0, x1, xdiff, x;
 
@@ -446,6 +497,7 @@ private:
     struct RendererPolygon
     {
         Polygon* PolyData;
+        const u32* Texels;
 
         Slope<0> SlopeL;
         Slope<1> SlopeR;
@@ -455,22 +507,68 @@ private:
 
     };
 
-    RendererPolygon PolygonList[2048];
+    // per-thread rasterizer state
+    // each rasterizer thread steps its own copy of the polygon edges
+    // and keeps its own stencil buffer
+    struct RasterContext
+    {
+        RendererPolygon PolygonList[2048];
+
+        u8 StencilBuffer[256*2];
+        bool PrevIsShadowMask;
+    };
+
+    RasterContext MainContext;
+
+    // decoded texture cache
+    // textures are decoded to 16-bit color + 5-bit alpha once, and kept
+    // until the VRAM they were decoded from is modified
+
+    struct CachedTexture
+    {
+        std::vector<u32> Texels; // bit0-15: color, bit16-20: alpha
+
+        // source VRAM ranges, in bytes
+        // [0]: texel data, [1]: palette indices for compressed textures
+        u32 TexStart[2], TexLen[2];
+        u32 PalStart, PalLen;
+    };
+
+    // amount of texels after which the cache is flushed (16MB)
+    static constexpr u32 TexCacheMaxTexels = 4*1024*1024;
+
+    std::unordered_map<u64, CachedTexture> TexCache;
+    u32 TexCacheTexels;
+
+    static u64 TexCacheKey(u32 texparam, u32 texpal);
+    void CacheTextures(Polygon** polygons, int npolys);
+    const u32* GetCachedTexture(u32 texparam, u32 texpal);
+    void InvalidateTexCache(NonStupidBitField<512*1024/GPU::VRAMDirtyGranularity>& texdirty,
+                            NonStupidBitField<128*1024/GPU::VRAMDirtyGranularity>& paldirty);
+
     void TextureLookup(u32 texparam, u32 texpal, s16 s, s16 t, u16* color, u8* alpha);
-    u32 RenderPixel(Polygon* polygon, u8 vr, u8 vg, u8 vb, s16 s, s16 t);
+    void CachedTextureLookup(const u32* texels, u32 texparam, s16 s, s16 t, u16* color, u8* alpha);
+    u32 RenderPixel(Polygon* polygon, const u32* texels, u8 vr, u8 vg, u8 vb, s16 s, s16 t);
+    void (*InterpolateSpan)(const SpanInterp& interp, const s32 (*ends)[2], s32 xs, s32 xe, s32 (*out)[256]);
+    void (*ShadeSpan)(const s32 (*attr)[256], const u16* texcolor, const u8* texalpha, s32 xs, s32 xe, u32 polyalpha, bool wireframe, u32* out);
     void PlotTranslucentPixel(u32 pixeladdr, u32 color, u32 z, u32 polyattr, u32 shadow);
     void SetupPolygonLeftEdge(RendererPolygon* rp, s32 y);
     void SetupPolygonRightEdge(RendererPolygon* rp, s32 y);
     void SetupPolygon(RendererPolygon* rp, Polygon* polygon);
-    void RenderShadowMaskScanline(RendererPolygon* rp, s32 y);
-    void RenderPolygonScanline(RendererPolygon* rp, s32 y);
-    void RenderScanline(s32 y, int npolys);
+    void RenderShadowMaskScanline(RasterContext& ctx, RendererPolygon* rp, s32 y);
+    void RenderPolygonScanline(RasterContext& ctx, RendererPolygon* rp, s32 y);
+    void RenderScanline(RasterContext& ctx, s32 y, int npolys, bool resync);
     u32 CalculateFogDensity(u32 pixeladdr);
     void ScanlineFinalPass(s32 y);
     void ClearBuffers();
     void RenderPolygons(bool threaded, Polygon** polygons, int npolys);
+    bool CanRenderPolygonsInterleaved(Polygon** polygons, int npolys);
+    void RenderPolygonsInterleaved(Polygon** polygons, int npolys);
 
     void RenderThreadFunc();
+    void RasterThreadFunc(int num);
+    void SetupRasterThreads();
+    void StopRasterThreads();
 
     // buffer dimensions are 258x194 to add a offscreen 1px border
     // which simplifies edge marking tests
@@ -496,9 +594,6 @@ private:
     // bit22: translucent flag
     // bit24-29: polygon ID for opaque pixels
 
-    u8 StencilBuffer[256*2];
-    bool PrevIsShadowMask;
-
     bool Enabled;
 
     bool FrameIdentical;
@@ -512,5 +607,21 @@ private:
     Platform::Semaphore* Sema_RenderStart;
     Platform::Semaphore* Sema_RenderDone;
     Platform::Semaphore* Sema_ScanlineCount;
+
+    // additional rasterizer threads
+    // scanlines are interleaved between them (thread N renders every Nth
+    // scanline), the render thread then runs the final pass in order
+
+    static constexpr int MaxRasterThreads = 16;
+
+    int NumRasterThreads;
+    int NumRasterThreadsRunning;
+    Platform::Thread* RasterThreads[MaxRasterThreads];
+    std::atomic_bool RasterThreadsRunning;
+    Platform::Semaphore* Sema_RasterStart[MaxRasterThreads];
+    Platform::Semaphore* Sema_RasterLine[MaxRasterThreads];
+    RasterContext* RasterContexts[MaxRasterThreads];
+    Polygon** RasterPolygons;
+    int RasterNumPolygons;
 };
 }
\ No newline at end of file
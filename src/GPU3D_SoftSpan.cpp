@@ -0,0 +1,302 @@
+/*
+    Copyright 2016-2022 melonDS team
+
+    This file is part of melonDS.
+
+    melonDS is free software: you can redistribute it and/or modify it under
+    the terms of the GNU General Public License as published by the Free
+    Software Foundation, either version 3 of the License, or (at your option)
+    any later version.
+
+    melonDS is distributed in the hope that it will be useful, but WITHOUT ANY
+    WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+    FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with melonDS. If not, see http://www.gnu.org/licenses/.
+*/
+
+#include <string.h>
+#include "GPU3D_SoftSpan.h"
+
+namespace GPU3D
+{
+
+s32 InterpolateSpanPixel(const SpanInterp& interp, s32 y0, s32 y1, s32 x, u32 yfactor)
+{
+    if (interp.XDiff == 0 || y0 == y1) return y0;
+
+    if (!interp.Linear)
+    {
+        if (y0 < y1)
+            return y0 + (((y1-y0) * yfactor) >> 8);
+        else
+            return y1 + (((y0-y1) * ((1<<8)-yfactor)) >> 8);
+    }
+    else
+    {
+        if (y0 < y1)
+            return y0 + ((((s64)(y1-y0) * x * interp.XRecip) + (3<<24)) >> 30);
+        else
+            return y1 + ((((s64)(y0-y1) * (interp.XDiff-x) * interp.XRecip) + (3<<24)) >> 30);
+    }
+}
+
+void InterpolateSpan_Scalar(const SpanInterp& interp, const s32 (*ends)[2], s32 xs, s32 xe, s32 (*out)[256])
+{
+    for (s32 i = xs; i < xe; i++)
+    {
+        s32 x = i - interp.X0;
+        u32 yfactor = 0;
+        if (interp.XDiff != 0 && !interp.Linear)
+        {
+            s64 num = ((s64)x * interp.W0n) << 8;
+            s32 den = (x * interp.W0d) + ((interp.XDiff-x) * interp.W1d);
+
+            if (den == 0) yfactor = 0;
+            else          yfactor = (s32)(num / den);
+        }
+
+        for (int a = 0; a < SpanAttr_Count; a++)
+            out[a][i] = InterpolateSpanPixel(interp, ends[a][0], ends[a][1], x, yfactor);
+    }
+}
+
+void ShadeSpan_Scalar(const s32 (*attr)[256], const u16* texcolor, const u8* texalpha, s32 xs, s32 xe, u32 polyalpha, bool wireframe, u32* out)
+{
+    for (s32 i = xs; i < xe; i++)
+    {
+        u8 vr = (u32)attr[SpanAttr_R][i] >> 3;
+        u8 vg = (u32)attr[SpanAttr_G][i] >> 3;
+        u8 vb = (u32)attr[SpanAttr_B][i] >> 3;
+        u8 r, g, b, a;
+
+        if (texcolor)
+        {
+            u16 tcolor = texcolor[i];
+            u8 talpha = texalpha[i];
+
+            u8 tr = (tcolor << 1) & 0x3E; if (tr) tr++;
+            u8 tg = (tcolor >> 4) & 0x3E; if (tg) tg++;
+            u8 tb = (tcolor >> 9) & 0x3E; if (tb) tb++;
+
+            r = ((tr+1) * (vr+1) - 1) >> 6;
+            g = ((tg+1) * (vg+1) - 1) >> 6;
+            b = ((tb+1) * (vb+1) - 1) >> 6;
+            a = ((talpha+1) * (polyalpha+1) - 1) >> 5;
+        }
+        else
+        {
+            r = vr;
+            g = vg;
+            b = vb;
+            a = polyalpha;
+        }
+
+        if (wireframe) a = 31;
+
+        out[i] = r | (g << 8) | (b << 16) | (a << 24);
+    }
+}
+
+#ifdef GPU3D_SIMD
+
+// vectorised versions of InterpolateSpan_Scalar and ShadeSpan_Scalar
+// written with GCC vector extensions like the 2D color effects, so the same
+// code is compiled for SSE2/NEON (4 pixels) and AVX2 (8 pixels)
+//
+// the perspective division is done in double precision: as long as the
+// numerator fits within 53 bits and the denominator is exact, truncating
+// the quotient gives the same result as the integer division. with the
+// 16-bit normalized W values, the numerator is at most 38 bits wide.
+// spans with other W values are left to the scalar version.
+
+#define VSEL(m, a, b) (((a) & (m)) | ((b) & ~(m)))
+
+typedef s32 s32x4 __attribute__((vector_size(16)));
+typedef u32 u32x4 __attribute__((vector_size(16)));
+typedef s64 s64x4 __attribute__((vector_size(32)));
+typedef double f64x4 __attribute__((vector_size(32)));
+typedef u16 u16x4 __attribute__((vector_size(8)));
+typedef u8 u8x4 __attribute__((vector_size(4)));
+
+typedef s32 s32x8 __attribute__((vector_size(32)));
+typedef u32 u32x8 __attribute__((vector_size(32)));
+typedef s64 s64x8 __attribute__((vector_size(64)));
+typedef double f64x8 __attribute__((vector_size(64)));
+typedef u16 u16x8 __attribute__((vector_size(16)));
+typedef u8 u8x8 __attribute__((vector_size(8)));
+
+// spans are processed a full vector at a time, except for the last pixels
+template <typename V, typename T>
+__attribute__((always_inline)) inline void LoadLanes(V& dst, const T* src, int count)
+{
+    if (count == sizeof(V) / sizeof(T))
+        memcpy(&dst, src, sizeof(V));
+    else
+        memcpy(&dst, src, count * sizeof(T));
+}
+
+template <typename V, typename T>
+__attribute__((always_inline)) inline void StoreLanes(T* dst, const V& src, int count)
+{
+    if (count == sizeof(V) / sizeof(T))
+        memcpy(dst, &src, sizeof(V));
+    else
+        memcpy(dst, &src, count * sizeof(T));
+}
+
+template <typename S32, typename U32, typename S64, typename F64>
+__attribute__((always_inline)) inline void InterpolateSpanImpl(const SpanInterp& interp, const s32 (*ends)[2], s32 xs, s32 xe, s32 (*out)[256])
+{
+    constexpr int N = sizeof(S32) / 4;
+
+    if (interp.XDiff != 0 && !interp.Linear)
+    {
+        if ((u32)interp.XDiff >= 0x1000 || xs < interp.X0 || xe > interp.X0 + interp.XDiff ||
+            (u32)interp.W0d >= 0x40000 || (u32)interp.W1d >= 0x40000 || (u32)interp.W0n > (u32)interp.W0d)
+        {
+            InterpolateSpan_Scalar(interp, ends, xs, xe, out);
+            return;
+        }
+    }
+
+    S32 lane;
+    for (int i = 0; i < N; i++)
+        lane[i] = i;
+
+    for (s32 i = xs; i < xe; i += N)
+    {
+        int count = (xe - i) < N ? (xe - i) : N;
+        S32 x = lane + (i - interp.X0);
+
+        U32 yfactor = {};
+        if (interp.XDiff != 0 && !interp.Linear)
+        {
+            F64 num = __builtin_convertvector(x, F64) * (double)(interp.W0n << 8);
+            S32 den = (x * interp.W0d) + ((interp.XDiff - x) * interp.W1d);
+
+            S32 zero = (den == 0);
+            F64 quot = num / __builtin_convertvector(VSEL(zero, 1, den), F64);
+            yfactor = (U32)(__builtin_convertvector(quot, S32) & ~zero);
+        }
+
+        for (int a = 0; a < SpanAttr_Count; a++)
+        {
+            s32 y0 = ends[a][0], y1 = ends[a][1];
+            S32 res;
+
+            if (interp.XDiff == 0 || y0 == y1)
+            {
+                res = (S32){} + y0;
+            }
+            else if (!interp.Linear)
+            {
+                if (y0 < y1)
+                    res = (S32)((u32)y0 + (((u32)(y1-y0) * yfactor) >> 8));
+                else
+                    res = (S32)((u32)y1 + (((u32)(y0-y1) * ((1<<8) - yfactor)) >> 8));
+            }
+            else
+            {
+                S64 factor;
+                s64 step;
+                if (y0 < y1)
+                {
+                    factor = __builtin_convertvector(x, S64);
+                    step = (s64)(y1-y0) * interp.XRecip;
+                }
+                else
+                {
+                    factor = __builtin_convertvector(interp.XDiff - x, S64);
+                    step = (s64)(y0-y1) * interp.XRecip;
+                }
+
+                S32 disp = __builtin_convertvector(((factor * step) + (3<<24)) >> 30, S32);
+                res = (y0 < y1 ? y0 : y1) + disp;
+            }
+
+            StoreLanes(&out[a][i], res, count);
+        }
+    }
+}
+
+template <typename U32, typename U16, typename U8>
+__attribute__((always_inline)) inline void ShadeSpanImpl(const s32 (*attr)[256], const u16* texcolor, const u8* texalpha, s32 xs, s32 xe, u32 polyalpha, bool wireframe, u32* out)
+{
+    constexpr int N = sizeof(U32) / 4;
+
+    for (s32 i = xs; i < xe; i += N)
+    {
+        int count = (xe - i) < N ? (xe - i) : N;
+
+        U32 vr = {}, vg = {}, vb = {};
+        LoadLanes(vr, (const u32*)&attr[SpanAttr_R][i], count);
+        LoadLanes(vg, (const u32*)&attr[SpanAttr_G][i], count);
+        LoadLanes(vb, (const u32*)&attr[SpanAttr_B][i], count);
+        vr = (vr >> 3) & 0xFF;
+        vg = (vg >> 3) & 0xFF;
+        vb = (vb >> 3) & 0xFF;
+
+        U32 r, g, b, a;
+        if (texcolor)
+        {
+            U16 tc16 = {};
+            U8 ta8 = {};
+            LoadLanes(tc16, &texcolor[i], count);
+            LoadLanes(ta8, &texalpha[i], count);
+            U32 tcolor = __builtin_convertvector(tc16, U32);
+            U32 talpha = __builtin_convertvector(ta8, U32);
+
+            // the comparisons give -1 for true, so this adds 1 to nonzero components
+            U32 tr = (tcolor << 1) & 0x3E; tr -= (U32)(tr != 0);
+            U32 tg = (tcolor >> 4) & 0x3E; tg -= (U32)(tg != 0);
+            U32 tb = (tcolor >> 9) & 0x3E; tb -= (U32)(tb != 0);
+
+            r = ((tr+1) * (vr+1) - 1) >> 6;
+            g = ((tg+1) * (vg+1) - 1) >> 6;
+            b = ((tb+1) * (vb+1) - 1) >> 6;
+            a = ((talpha+1) * (polyalpha+1) - 1) >> 5;
+        }
+        else
+        {
+            r = vr;
+            g = vg;
+            b = vb;
+            a = (U32){} + polyalpha;
+        }
+
+        if (wireframe) a = (U32){} + 31;
+
+        U32 res = r | (g << 8) | (b << 16) | (a << 24);
+        StoreLanes(&out[i], res, count);
+    }
+}
+
+#undef VSEL
+
+void InterpolateSpan_Base(const SpanInterp& interp, const s32 (*ends)[2], s32 xs, s32 xe, s32 (*out)[256])
+{
+    InterpolateSpanImpl<s32x4, u32x4, s64x4, f64x4>(interp, ends, xs, xe, out);
+}
+
+void ShadeSpan_Base(const s32 (*attr)[256], const u16* texcolor, const u8* texalpha, s32 xs, s32 xe, u32 polyalpha, bool wireframe, u32* out)
+{
+    ShadeSpanImpl<u32x4, u16x4, u8x4>(attr, texcolor, texalpha, xs, xe, polyalpha, wireframe, out);
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+__attribute__((target("avx2"))) void InterpolateSpan_AVX2(const SpanInterp& interp, const s32 (*ends)[2], s32 xs, s32 xe, s32 (*out)[256])
+{
+    InterpolateSpanImpl<s32x8, u32x8, s64x8, f64x8>(interp, ends, xs, xe, out);
+}
+
+__attribute__((target("avx2"))) void ShadeSpan_AVX2(const s32 (*attr)[256], const u16* texcolor, const u8* texalpha, s32 xs, s32 xe, u32 polyalpha, bool wireframe, u32* out)
+{
+    ShadeSpanImpl<u32x8, u16x8, u8x8>(attr, texcolor, texalpha, xs, xe, polyalpha, wireframe, out);
+}
+#endif
+
+#endif
+
+}
@@ -0,0 +1,74 @@
+/*
+    Copyright 2016-2022 melonDS team
+
+    This file is part of melonDS.
+
+    melonDS is free software: you can redistribute it and/or modify it under
+    the terms of the GNU General Public License as published by the Free
+    Software Foundation, either version 3 of the License, or (at your option)
+    any later version.
+
+    melonDS is distributed in the hope that it will be useful, but WITHOUT ANY
+    WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+    FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with melonDS. If not, see http://www.gnu.org/licenses/.
+*/
+
+#ifndef GPU3D_SOFTSPAN_H
+#define GPU3D_SOFTSPAN_H
+
+#include "types.h"
+
+#if defined(__GNUC__)
+#define GPU3D_SIMD
+#endif
+
+namespace GPU3D
+{
+
+// the parameters of the soft renderer's interpolator along X
+// (see the notes on the interpolator in GPU3D_Soft.h)
+struct SpanInterp
+{
+    s32 X0, XDiff;
+    s32 XRecip;
+    s32 W0n, W0d, W1d;
+    bool Linear;
+};
+
+// vertex attributes which are interpolated along a scanline
+enum
+{
+    SpanAttr_R = 0,
+    SpanAttr_G,
+    SpanAttr_B,
+    SpanAttr_S,
+    SpanAttr_T,
+
+    SpanAttr_Count
+};
+
+// interpolates the vertex attributes for the pixels [xs, xe) of a scanline,
+// giving the same results as SetX() and Interpolate() for every pixel
+// ends[i] holds the value of attribute i on the left and right end of the scanline
+void InterpolateSpan_Scalar(const SpanInterp& interp, const s32 (*ends)[2], s32 xs, s32 xe, s32 (*out)[256]);
+// calculates the colors of the pixels [xs, xe) like RenderPixel() does for
+// untextured polygons (texcolor == nullptr) in any blend mode but toon/highlight,
+// and for textured polygons in modulation mode, with the texels already looked up
+void ShadeSpan_Scalar(const s32 (*attr)[256], const u16* texcolor, const u8* texalpha, s32 xs, s32 xe, u32 polyalpha, bool wireframe, u32* out);
+
+#ifdef GPU3D_SIMD
+void InterpolateSpan_Base(const SpanInterp& interp, const s32 (*ends)[2], s32 xs, s32 xe, s32 (*out)[256]);
+void ShadeSpan_Base(const s32 (*attr)[256], const u16* texcolor, const u8* texalpha, s32 xs, s32 xe, u32 polyalpha, bool wireframe, u32* out);
+#if defined(__x86_64__) || defined(__i386__)
+// only to be used if the CPU supports AVX2
+void InterpolateSpan_AVX2(const SpanInterp& interp, const s32 (*ends)[2], s32 xs, s32 xe, s32 (*out)[256]);
+void ShadeSpan_AVX2(const s32 (*attr)[256], const u16* texcolor, const u8* texalpha, s32 xs, s32 xe, u32 polyalpha, bool wireframe, u32* out);
+#endif
+#endif
+
+}
+
+#endif
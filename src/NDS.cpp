@@ -44,6 +44,7 @@
 #include "DSi_NWifi.h"
 #include "DSi_Camera.h"
 #include "DSi_DSP.h"
+#include "Profiler.h"
 
 using Platform::Log;
 using Platform::LogLevel;
@@ -89,6 +90,7 @@ bool EnableJIT;
 
 u32 NumFrames;
 u32 NumLagFrames;
+u64 NumSchedEvents;
 bool LagFrameFlag;
 u64 LastSysClockCycles;
 u64 FrameStartTimestamp;
@@ -108,6 +110,11 @@ u64 SysTimestamp;
 SchedEvent SchedList[Event_MAX];
 u32 SchedListMask;
 
+// timestamp of the earliest scheduled event
+// only recalculated when the earliest event is removed
+u64 SchedListNext;
+bool SchedListNextDirty;
+
 u32 CPUStop;
 
 u8 ARM9BIOS[0x1000];
@@ -651,6 +658,7 @@ void Reset()
 
     memset(SchedList, 0, sizeof(SchedList));
     SchedListMask = 0;
+    SchedListNextDirty = true;
 
     KeyInput = 0x007F03FF;
     KeyCnt = 0;
@@ -883,6 +891,7 @@ bool DoSavestate(Savestate* file)
         return false;
     }
     file->Var32(&SchedListMask);
+    SchedListNextDirty = true;
     file->Var64(&ARM9Timestamp);
     file->Var64(&ARM9Target);
     file->Var64(&ARM7Timestamp);
@@ -1012,23 +1021,36 @@ void LoadBIOS()
 }
 
 
-u64 NextTarget()
+u64 NextEventTimestamp()
 {
-    u64 minEvent = UINT64_MAX;
-
-    u32 mask = SchedListMask;
-    for (int i = 0; i < Event_MAX; i++)
+    if (SchedListNextDirty)
     {
-        if (!mask) break;
-        if (mask & 0x1)
+        u64 minEvent = UINT64_MAX;
+
+        u32 mask = SchedListMask;
+        for (int i = 0; i < Event_MAX; i++)
         {
-            if (SchedList[i].Timestamp < minEvent)
-                minEvent = SchedList[i].Timestamp;
+            if (!mask) break;
+            if (mask & 0x1)
+            {
+                if (SchedList[i].Timestamp < minEvent)
+                    minEvent = SchedList[i].Timestamp;
+            }
+
+            mask >>= 1;
         }
 
-        mask >>= 1;
+        SchedListNext = minEvent;
+        SchedListNextDirty = false;
     }
 
+    return SchedListNext;
+}
+
+u64 NextTarget()
+{
+    u64 minEvent = NextEventTimestamp();
+
     u64 max = SysTimestamp + kMaxIterationCycles;
 
     if (minEvent < max + kIterationCycleMargin)
@@ -1041,6 +1063,12 @@ void RunSystem(u64 timestamp)
 {
     SysTimestamp = timestamp;
 
+    // most of the time, nothing is due yet
+    if (NextEventTimestamp() > SysTimestamp)
+        return;
+
+    SchedListNextDirty = true;
+
     u32 mask = SchedListMask;
     for (int i = 0; i < Event_MAX; i++)
     {
@@ -1051,6 +1079,7 @@ void RunSystem(u64 timestamp)
             {
                 SchedListMask &= ~(1<<i);
                 SchedList[i].Func(SchedList[i].Param);
+                NumSchedEvents++;
             }
         }
 
@@ -1067,6 +1096,8 @@ u32 RunFrame()
     bool runFrame = Running && !(CPUStop & 0x40000000);
     if (runFrame)
     {
+        PROFILE_SCOPE(Section_Frame);
+
         GPU::StartFrame();
 
         while (Running && GPU::TotalScanlines==0)
@@ -1092,6 +1123,8 @@ u32 RunFrame()
             }
             else
             {
+                PROFILE_SCOPE(Section_ARM9);
+
 #ifdef JIT_ENABLED
                 if (EnableJIT)
                     ARM9->ExecuteJIT();
@@ -1120,6 +1153,8 @@ u32 RunFrame()
                 }
                 else
                 {
+                    PROFILE_SCOPE(Section_ARM7);
+
 #ifdef JIT_ENABLED
                     if (EnableJIT)
                         ARM7->ExecuteJIT();
@@ -1158,6 +1193,8 @@ u32 RunFrame()
     if (LagFrameFlag)
         NumLagFrames++;
 
+    Profiler::EndFrame();
+
     if (runFrame)
         return GPU::TotalScanlines;
     else
@@ -1216,6 +1253,8 @@ void ScheduleEvent(u32 id, bool periodic, s32 delay, void (*func)(u32), u32 para
     evt->Param = param;
 
     SchedListMask |= (1<<id);
+    if (evt->Timestamp < SchedListNext)
+        SchedListNext = evt->Timestamp;
 
     Reschedule(evt->Timestamp);
 }
@@ -1235,12 +1274,17 @@ void ScheduleEvent(u32 id, u64 timestamp, void (*func)(u32), u32 param)
     evt->Param = param;
 
     SchedListMask |= (1<<id);
+    if (evt->Timestamp < SchedListNext)
+        SchedListNext = evt->Timestamp;
 
     Reschedule(evt->Timestamp);
 }
 
 void CancelEvent(u32 id)
 {
+    if ((SchedListMask & (1<<id)) && (SchedList[id].Timestamp == SchedListNext))
+        SchedListNextDirty = true;
+
     SchedListMask &= ~(1<<id);
 }
 
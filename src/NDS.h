@@ -181,8 +181,10 @@ extern u32 ARM7Regions[0x20000];
 
 extern u32 NumFrames;
 extern u32 NumLagFrames;
+extern u64 NumSchedEvents; // not savestated, only for measurements
 extern bool LagFrameFlag;
 
+extern u64 SysTimestamp;
 extern u64 ARM9Timestamp, ARM9Target;
 extern u64 ARM7Timestamp, ARM7Target;
 extern u32 ARM9ClockShift;
@@ -267,6 +269,10 @@ void ScheduleEvent(u32 id, bool periodic, s32 delay, void (*func)(u32), u32 para
 void ScheduleEvent(u32 id, u64 timestamp, void (*func)(u32), u32 param);
 void CancelEvent(u32 id);
 
+// the main loop's scheduler steps, only called from outside for benchmarking it
+u64 NextTarget();
+void RunSystem(u64 timestamp);
+
 void debug(u32 p);
 
 void Halt();
@@ -46,6 +46,11 @@ enum ConfigEntry
     JIT_LiteralOptimizations,
     JIT_BranchOptimizations,
     JIT_FastMemory,
+    JIT_CodeCacheSize,
+    JIT_DiskCache,
+    JIT_AsyncCompile,
+    JIT_Profiler,
+    JIT_PerfMap,
 #endif
 
     ExternalBIOSEnable,
@@ -84,7 +89,9 @@ enum ConfigEntry
 
     AudioBitDepth,
 
-    DSi_FullBIOSBoot
+    DSi_FullBIOSBoot,
+    DSi_DSPThreaded,
+    DSi_DSPSyncWindow
 };
 
 int GetConfigInt(ConfigEntry entry);
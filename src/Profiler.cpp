@@ -0,0 +1,132 @@
+/*
+    Copyright 2016-2022 melonDS team
+
+    This file is part of melonDS.
+
+    melonDS is free software: you can redistribute it and/or modify it under
+    the terms of the GNU General Public License as published by the Free
+    Software Foundation, either version 3 of the License, or (at your option)
+    any later version.
+
+    melonDS is distributed in the hope that it will be useful, but WITHOUT ANY
+    WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+    FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with melonDS. If not, see http://www.gnu.org/licenses/.
+*/
+
+#include <string.h>
+#include "Profiler.h"
+
+namespace Profiler
+{
+
+const char* SectionNames[Section_MAX] =
+{
+    "Frame",
+    "ARM9",
+    "ARM7",
+    "DMA",
+    "GPU2D",
+    "GPU3D",
+    "GPU3D render",
+    "SPU",
+    "JIT compile",
+    "JIT invalidate",
+};
+
+const char* CounterNames[Counter_MAX] =
+{
+    "DMA runs",
+    "GX commands",
+    "JIT blocks",
+    "JIT invalidations",
+    "JIT blocks evicted",
+    "JIT cache evictions",
+    "JIT cache flushes",
+    "JIT blocks from disk",
+};
+
+#ifdef PROFILING_ENABLED
+std::atomic<u64> SectionTime[Section_MAX];
+std::atomic<u64> CounterValue[Counter_MAX];
+
+u64 LastSectionTime[Section_MAX];
+u64 LastCounterValue[Counter_MAX];
+#endif
+
+u64 FrameTime[Section_MAX];
+u64 FrameCount[Counter_MAX];
+
+
+void Reset()
+{
+#ifdef PROFILING_ENABLED
+    for (int i = 0; i < Section_MAX; i++)
+        SectionTime[i].store(0, std::memory_order_relaxed);
+    for (int i = 0; i < Counter_MAX; i++)
+        CounterValue[i].store(0, std::memory_order_relaxed);
+
+    memset(LastSectionTime, 0, sizeof(LastSectionTime));
+    memset(LastCounterValue, 0, sizeof(LastCounterValue));
+#endif
+
+    memset(FrameTime, 0, sizeof(FrameTime));
+    memset(FrameCount, 0, sizeof(FrameCount));
+}
+
+void EndFrame()
+{
+#ifdef PROFILING_ENABLED
+    for (int i = 0; i < Section_MAX; i++)
+    {
+        u64 val = SectionTime[i].load(std::memory_order_relaxed);
+        FrameTime[i] = val - LastSectionTime[i];
+        LastSectionTime[i] = val;
+    }
+
+    for (int i = 0; i < Counter_MAX; i++)
+    {
+        u64 val = CounterValue[i].load(std::memory_order_relaxed);
+        FrameCount[i] = val - LastCounterValue[i];
+        LastCounterValue[i] = val;
+    }
+#endif
+}
+
+void GetTimes(u64* times)
+{
+    for (int i = 0; i < Section_MAX; i++)
+    {
+#ifdef PROFILING_ENABLED
+        times[i] = SectionTime[i].load(std::memory_order_relaxed);
+#else
+        times[i] = 0;
+#endif
+    }
+}
+
+void GetCounts(u64* counts)
+{
+    for (int i = 0; i < Counter_MAX; i++)
+    {
+#ifdef PROFILING_ENABLED
+        counts[i] = CounterValue[i].load(std::memory_order_relaxed);
+#else
+        counts[i] = 0;
+#endif
+    }
+}
+
+void GetFrameTimes(u64* times)
+{
+    memcpy(times, FrameTime, sizeof(FrameTime));
+}
+
+void GetFrameCounts(u64* counts)
+{
+    memcpy(counts, FrameCount, sizeof(FrameCount));
+}
+
+}
@@ -0,0 +1,126 @@
+/*
+    Copyright 2016-2022 melonDS team
+
+    This file is part of melonDS.
+
+    melonDS is free software: you can redistribute it and/or modify it under
+    the terms of the GNU General Public License as published by the Free
+    Software Foundation, either version 3 of the License, or (at your option)
+    any later version.
+
+    melonDS is distributed in the hope that it will be useful, but WITHOUT ANY
+    WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+    FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with melonDS. If not, see http://www.gnu.org/licenses/.
+*/
+
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include "types.h"
+
+#ifdef PROFILING_ENABLED
+#include <atomic>
+#include <chrono>
+#endif
+
+// coarse wall clock time spent per subsystem, and event counters
+// everything here compiles to nothing unless built with ENABLE_PROFILING
+
+namespace Profiler
+{
+
+enum Section
+{
+    Section_Frame = 0, // all of RunFrame(), the others overlap with it
+    Section_ARM9,
+    Section_ARM7,
+    Section_DMA,
+    Section_GPU2D,
+    Section_GPU3D,
+    Section_GPU3DRender, // might run on its own thread
+    Section_SPU,
+    Section_JITCompile, // the JIT sections are part of ARM9/ARM7 time
+    Section_JITInvalidate,
+
+    Section_MAX
+};
+
+enum Counter
+{
+    Counter_DMARuns = 0,
+    Counter_GXCommands,
+    Counter_JITBlocksCompiled,
+    Counter_JITInvalidations,
+    Counter_JITBlocksEvicted,
+    Counter_JITCacheEvictions, // a code region was recycled
+    Counter_JITCacheFlushes, // the whole block cache was thrown away
+    Counter_JITBlocksFromDisk, // compiled without analysis thanks to the disk cache
+
+    Counter_MAX
+};
+
+extern const char* SectionNames[Section_MAX];
+extern const char* CounterNames[Counter_MAX];
+
+#ifdef PROFILING_ENABLED
+
+constexpr bool Enabled = true;
+
+extern std::atomic<u64> SectionTime[Section_MAX];
+extern std::atomic<u64> CounterValue[Counter_MAX];
+
+inline u64 Now()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+class Scope
+{
+public:
+    Scope(Section section) : Sect(section), Start(Now()) {}
+    ~Scope()
+    {
+        SectionTime[Sect].fetch_add(Now() - Start, std::memory_order_relaxed);
+    }
+
+private:
+    Section Sect;
+    u64 Start;
+};
+
+#define PROFILE_CONCAT_(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_(a, b)
+#define PROFILE_SCOPE(section) Profiler::Scope PROFILE_CONCAT(profileScope, __LINE__)(Profiler::section)
+#define PROFILE_COUNT(counter) PROFILE_ADD(counter, 1)
+#define PROFILE_ADD(counter, n) Profiler::CounterValue[Profiler::counter].fetch_add(n, std::memory_order_relaxed)
+
+#else
+
+constexpr bool Enabled = false;
+
+#define PROFILE_SCOPE(section)
+#define PROFILE_COUNT(counter)
+#define PROFILE_ADD(counter, n)
+
+#endif
+
+void Reset();
+
+// called by RunFrame() once it's done, latches the values for the last frame
+void EndFrame();
+
+// accumulated since the last Reset(), time in nanoseconds
+void GetTimes(u64* times);
+void GetCounts(u64* counts);
+
+// over the last frame
+void GetFrameTimes(u64* times);
+void GetFrameCounts(u64* counts);
+
+}
+
+#endif // PROFILER_H
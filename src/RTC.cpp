@@ -21,6 +21,7 @@
 
 #include <string.h>
 #include <time.h>
+#include "NDS.h"
 #include "RTC.h"
 #include "Platform.h"
 
@@ -52,6 +53,8 @@ u8 Alarm2[3];
 u8 ClockAdjust;
 u8 FreeReg;
 
+s64 FixedTime = -1;
+
 
 bool Init()
 {
@@ -111,6 +114,26 @@ u8 BCD(u8 val)
     return (val % 10) | ((val / 10) << 4);
 }
 
+void SetFixedTime(s64 timestamp)
+{
+    FixedTime = timestamp;
+}
+
+void GetTime(struct tm* timedata)
+{
+    if (FixedTime >= 0)
+    {
+        // the system clock runs at 33513982 Hz
+        time_t timestamp = (time_t)(FixedTime + (s64)(NDS::SysTimestamp / 33513982));
+        gmtime_r(&timestamp, timedata);
+    }
+    else
+    {
+        time_t timestamp = time(NULL);
+        localtime_r(&timestamp, timedata);
+    }
+}
+
 
 void ByteIn(u8 val)
 {
@@ -133,9 +156,8 @@ void ByteIn(u8 val)
 
             case 0x20:
                 {
-                    time_t timestamp = time(NULL);
                     struct tm timedata;
-                    localtime_r(&timestamp, &timedata);
+                    GetTime(&timedata);
 
                     Output[0] = BCD(timedata.tm_year - 100);
                     Output[1] = BCD(timedata.tm_mon + 1);
@@ -149,9 +171,8 @@ void ByteIn(u8 val)
 
             case 0x60:
                 {
-                    time_t timestamp = time(NULL);
                     struct tm timedata;
-                    localtime_r(&timestamp, &timedata);
+                    GetTime(&timedata);
 
                     Output[0] = BCD(timedata.tm_hour);
                     Output[1] = BCD(timedata.tm_min);
@@ -33,6 +33,10 @@ void DoSavestate(Savestate* file);
 u16 Read();
 void Write(u16 val, bool byte);
 
+// makes the clock start at the given UNIX time at reset and advance with
+// emulated time instead of following the host clock. negative to disable
+void SetFixedTime(s64 timestamp);
+
 }
 
 #endif
@@ -0,0 +1,286 @@
+/*
+    Copyright 2016-2022 melonDS team
+
+    This file is part of melonDS.
+
+    melonDS is free software: you can redistribute it and/or modify it under
+    the terms of the GNU General Public License as published by the Free
+    Software Foundation, either version 3 of the License, or (at your option)
+    any later version.
+
+    melonDS is distributed in the hope that it will be useful, but WITHOUT ANY
+    WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+    FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with melonDS. If not, see http://www.gnu.org/licenses/.
+*/
+
+#include <string.h>
+#include <algorithm>
+#ifdef ZSTD_SUPPORT_ENABLED
+#include <zstd.h>
+#endif
+#include "Rewind.h"
+#include "NDS.h"
+#include "Platform.h"
+
+using Platform::Log;
+using Platform::LogLevel;
+
+/*
+    Delta format
+
+    a list of records, each one being
+    00 - offset in the state
+    04 - length (at most one page)
+    06 - XOR of the old and new bytes
+
+    states of different lengths are compared as if the shorter one
+    was padded with zeroes.
+*/
+
+const u32 RecordHeaderSize = 6;
+
+// a snapshot is taken every frame by default, so favor speed.
+// the deltas are mostly zeroes and short runs, which compress well anyway
+const int CompressionLevel = 1;
+
+
+RewindBuffer::RewindBuffer(u64 maxmemory) :
+    Scratch(),
+    CompressContext(nullptr),
+    DecompressContext(nullptr),
+    DeltaMemory(0),
+    MaxMemory(maxmemory)
+{
+#ifdef ZSTD_SUPPORT_ENABLED
+    CompressContext = ZSTD_createCCtx();
+    DecompressContext = ZSTD_createDCtx();
+#endif
+}
+
+RewindBuffer::~RewindBuffer()
+{
+#ifdef ZSTD_SUPPORT_ENABLED
+    ZSTD_freeCCtx(CompressContext);
+    ZSTD_freeDCtx(DecompressContext);
+#endif
+}
+
+void RewindBuffer::Clear()
+{
+    Snapshots.clear();
+    Current.clear();
+    Current.shrink_to_fit();
+    ScratchDelta.clear();
+    ScratchDelta.shrink_to_fit();
+    DeltaMemory = 0;
+}
+
+void RewindBuffer::SetMaxMemory(u64 maxmemory)
+{
+    MaxMemory = maxmemory;
+    Trim();
+}
+
+bool RewindBuffer::Push()
+{
+    Scratch.Rewind(true);
+    if (!NDS::DoSavestate(&Scratch) || Scratch.Error)
+    {
+        Log(LogLevel::Error, "rewind: failed to take a snapshot\n");
+        return false;
+    }
+
+    u8* newstate = (u8*)Scratch.Buffer();
+    u32 newlen = Scratch.Length();
+
+    if (Snapshots.empty())
+    {
+        Current.assign(newstate, newstate + newlen);
+    }
+    else
+    {
+        Snapshot& prev = Snapshots.back();
+        EncodeDelta(newstate, newlen, ScratchDelta);
+        CompressDelta(prev);
+        DeltaMemory += prev.Delta.size();
+    }
+
+    Snapshots.push_back({newlen, {}, 0});
+
+    Trim();
+    return true;
+}
+
+bool RewindBuffer::Pop()
+{
+    if (Snapshots.empty())
+        return false;
+
+    Savestate state(Current.data(), Snapshots.back().Length, false);
+    bool res = NDS::DoSavestate(&state) && !state.Error;
+
+    Snapshots.pop_back();
+
+    if (!Snapshots.empty())
+    {
+        Snapshot& prev = Snapshots.back();
+        ApplyDelta(DecompressDelta(prev), prev.Length);
+
+        DeltaMemory -= prev.Delta.size();
+        prev.Delta.clear();
+        prev.Delta.shrink_to_fit();
+    }
+    else
+        Clear();
+
+    if (!res)
+        Log(LogLevel::Error, "rewind: failed to load a snapshot\n");
+
+    return res;
+}
+
+void RewindBuffer::EncodeDelta(u8* newstate, u32 newlen, std::vector<u8>& delta)
+{
+    u32 oldlen = (u32)Current.size();
+    u32 len = std::max(oldlen, newlen);
+
+    // the scratch buffer only ever grows, so it has room for the padding
+    if (newlen < len)
+        memset(newstate + newlen, 0, len - newlen);
+    Current.resize(len, 0);
+
+    delta.clear();
+
+    for (u32 page = 0; page < len; page += PageSize)
+    {
+        u32 pagelen = std::min(PageSize, len - page);
+        u8* oldp = &Current[page];
+        u8* newp = &newstate[page];
+
+        if (!memcmp(oldp, newp, pagelen))
+            continue;
+
+        u32 i = 0;
+        for (;;)
+        {
+            while (i < pagelen && oldp[i] == newp[i]) i++;
+            if (i >= pagelen) break;
+
+            // keep going over short stretches of unchanged bytes,
+            // they're cheaper than the header of a new record
+            u32 start = i;
+            u32 end = i;
+            u32 same = 0;
+            while (i < pagelen)
+            {
+                if (oldp[i] != newp[i])
+                {
+                    same = 0;
+                    end = i + 1;
+                }
+                else if (++same >= RecordHeaderSize)
+                    break;
+
+                i++;
+            }
+
+            u32 runlen = end - start;
+            size_t pos = delta.size();
+            delta.resize(pos + RecordHeaderSize + runlen);
+
+            u8* rec = &delta[pos];
+            u32 offset = page + start;
+            u16 len16 = (u16)runlen;
+            memcpy(&rec[0], &offset, 4);
+            memcpy(&rec[4], &len16, 2);
+            for (u32 j = 0; j < runlen; j++)
+                rec[RecordHeaderSize + j] = oldp[start + j] ^ newp[start + j];
+        }
+
+        memcpy(oldp, newp, pagelen);
+    }
+
+    Current.resize(newlen);
+}
+
+void RewindBuffer::CompressDelta(Snapshot& snapshot)
+{
+#ifdef ZSTD_SUPPORT_ENABLED
+    size_t bound = ZSTD_compressBound(ScratchDelta.size());
+    snapshot.Delta.resize(bound);
+
+    size_t len = ZSTD_compressCCtx(CompressContext,
+                                   snapshot.Delta.data(), bound,
+                                   ScratchDelta.data(), ScratchDelta.size(),
+                                   CompressionLevel);
+    if (!ZSTD_isError(len) && len < ScratchDelta.size())
+    {
+        snapshot.Delta.resize(len);
+        snapshot.Delta.shrink_to_fit();
+        snapshot.DeltaLength = (u32)ScratchDelta.size();
+        return;
+    }
+#endif
+
+    // keep it as is if it doesn't get any smaller
+    snapshot.Delta.assign(ScratchDelta.begin(), ScratchDelta.end());
+    snapshot.Delta.shrink_to_fit();
+    snapshot.DeltaLength = 0;
+}
+
+const std::vector<u8>& RewindBuffer::DecompressDelta(const Snapshot& snapshot)
+{
+    if (snapshot.DeltaLength == 0)
+        return snapshot.Delta;
+
+    ScratchDelta.resize(snapshot.DeltaLength);
+
+#ifdef ZSTD_SUPPORT_ENABLED
+    size_t len = ZSTD_decompressDCtx(DecompressContext,
+                                     ScratchDelta.data(), ScratchDelta.size(),
+                                     snapshot.Delta.data(), snapshot.Delta.size());
+    if (ZSTD_isError(len) || len != snapshot.DeltaLength)
+    {
+        Log(LogLevel::Error, "rewind: failed to decompress a snapshot\n");
+        ScratchDelta.clear();
+    }
+#endif
+
+    return ScratchDelta;
+}
+
+void RewindBuffer::ApplyDelta(const std::vector<u8>& delta, u32 len)
+{
+    if (Current.size() < len)
+        Current.resize(len, 0);
+
+    size_t pos = 0;
+    while (pos < delta.size())
+    {
+        u32 offset;
+        u16 runlen;
+        memcpy(&offset, &delta[pos], 4);
+        memcpy(&runlen, &delta[pos + 4], 2);
+        pos += RecordHeaderSize;
+
+        u8* dst = &Current[offset];
+        for (u32 j = 0; j < runlen; j++)
+            dst[j] ^= delta[pos + j];
+        pos += runlen;
+    }
+
+    Current.resize(len);
+}
+
+void RewindBuffer::Trim()
+{
+    // always keep the newest snapshot
+    while (Snapshots.size() > 1 && MemoryUsage() > MaxMemory)
+    {
+        DeltaMemory -= Snapshots.front().Delta.size();
+        Snapshots.pop_front();
+    }
+}
@@ -0,0 +1,89 @@
+/*
+    Copyright 2016-2022 melonDS team
+
+    This file is part of melonDS.
+
+    melonDS is free software: you can redistribute it and/or modify it under
+    the terms of the GNU General Public License as published by the Free
+    Software Foundation, either version 3 of the License, or (at your option)
+    any later version.
+
+    melonDS is distributed in the hope that it will be useful, but WITHOUT ANY
+    WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+    FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with melonDS. If not, see http://www.gnu.org/licenses/.
+*/
+
+#ifndef REWIND_H
+#define REWIND_H
+
+#include <deque>
+#include <vector>
+#include "types.h"
+#include "Savestate.h"
+
+// ring buffer of savestates for rewinding
+//
+// only the newest snapshot is kept in full. every older one is stored as
+// the XOR of the pages which changed between it and the next snapshot,
+// with the unchanged bytes left out. going back one snapshot means
+// applying one delta, and the oldest snapshots can be dropped whenever
+// the memory limit is reached.
+//
+// if melonDS is built with zstd, the deltas are compressed as well.
+
+struct ZSTD_CCtx_s;
+struct ZSTD_DCtx_s;
+
+class RewindBuffer
+{
+public:
+    RewindBuffer(u64 maxmemory);
+    ~RewindBuffer();
+
+    void Clear();
+    void SetMaxMemory(u64 maxmemory);
+
+    // takes a snapshot of the current machine state
+    bool Push();
+
+    // restores the newest snapshot and removes it
+    // returns false if there's none left or it couldn't be loaded
+    bool Pop();
+
+    u32 NumSnapshots() const { return (u32)Snapshots.size(); }
+    u64 MemoryUsage() const { return DeltaMemory + Current.size(); }
+
+private:
+    static constexpr u32 PageSize = 4096;
+
+    struct Snapshot
+    {
+        u32 Length;
+        // turns the next snapshot back into this one, empty for the newest
+        std::vector<u8> Delta;
+        // size of the delta before compression, 0 if it's stored as is
+        u32 DeltaLength;
+    };
+
+    std::deque<Snapshot> Snapshots;
+    std::vector<u8> Current;
+    Savestate Scratch;
+    std::vector<u8> ScratchDelta;
+
+    ZSTD_CCtx_s* CompressContext;
+    ZSTD_DCtx_s* DecompressContext;
+
+    u64 DeltaMemory;
+    u64 MaxMemory;
+
+    void EncodeDelta(u8* newstate, u32 newlen, std::vector<u8>& delta);
+    void ApplyDelta(const std::vector<u8>& delta, u32 len);
+    void CompressDelta(Snapshot& snapshot);
+    const std::vector<u8>& DecompressDelta(const Snapshot& snapshot);
+    void Trim();
+};
+
+#endif // REWIND_H
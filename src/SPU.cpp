@@ -19,10 +19,13 @@
 #include <stdio.h>
 #include <string.h>
 #include <cmath>
+#include <algorithm>
 #include "Platform.h"
 #include "NDS.h"
 #include "DSi.h"
 #include "SPU.h"
+#include "SPU_Mixer.h"
+#include "Profiler.h"
 
 using Platform::Log;
 using Platform::LogLevel;
@@ -68,8 +71,6 @@ const s16 PSGTable[8][8] =
 // audio interpolation is an improvement upon the original hardware
 // (which performs no interpolation)
 int InterpType;
-s16 InterpCos[0x100];
-s16 InterpCubic[0x100][4];
 
 const u32 OutputBufferSize = 2*2048;
 s16 OutputBackbuffer[2 * OutputBufferSize];
@@ -90,6 +91,23 @@ bool Degrade10Bit;
 Channel* Channels[16];
 CaptureUnit* Capture[2];
 
+// samples are mixed in batches of MixBatchSize instead of running one scheduler
+// event per sample. register accesses catch up on the samples that are due first.
+// see MixBatchLimit() for when the batches are cut short
+u64 MixTimestamp;       // system timestamp of the next sample to be mixed
+u64 MixEventTimestamp;  // system timestamp of the scheduled mix event
+
+void ScheduleMix();
+void RescheduleMix();
+void CatchUp();
+
+
+// picked at startup depending on what the CPU supports
+void (*FilterBlock)(s32* out, const s32 (*taps)[MixBatchSize], const s32 (*coefs)[MixBatchSize], int shift, u32 volshift, s32 volume, u32 count);
+void (*VolumeBlock)(s32* out, const s32* in, u32 volshift, s32 volume, u32 count);
+void (*PanBlock)(s32* dst, const s32* in, s32 pan, u32 count);
+void (*OutputBlock)(s16* out, const s32* left, const s32* right, s32 mastervol, s32 bias, s32 mask, u32 count);
+
 
 bool Init()
 {
@@ -105,29 +123,28 @@ bool Init()
     ApplyBias = true;
     Degrade10Bit = false;
 
-    // generate interpolation tables
-    // values are 1:1:14 fixed-point
-
-    float m_pi = std::acos(-1.0f);
-    for (int i = 0; i < 0x100; i++)
+#ifdef SPU_SIMD
+    FilterBlock = FilterBlock_Base;
+    VolumeBlock = VolumeBlock_Base;
+    PanBlock = PanBlock_Base;
+    OutputBlock = OutputBlock_Base;
+#if defined(__x86_64__) || defined(__i386__)
+    if (__builtin_cpu_supports("avx2"))
     {
-        float ratio = (i * m_pi) / 255.0f;
-        ratio = 1.0f - std::cos(ratio);
-
-        InterpCos[i] = (s16)(ratio * 0x2000);
+        FilterBlock = FilterBlock_AVX2;
+        VolumeBlock = VolumeBlock_AVX2;
+        PanBlock = PanBlock_AVX2;
+        OutputBlock = OutputBlock_AVX2;
     }
+#endif
+#else
+    FilterBlock = FilterBlock_Scalar;
+    VolumeBlock = VolumeBlock_Scalar;
+    PanBlock = PanBlock_Scalar;
+    OutputBlock = OutputBlock_Scalar;
+#endif
 
-    for (int i = 0; i < 0x100; i++)
-    {
-        s32 i1 = i << 6;
-        s32 i2 = (i * i) >> 2;
-        s32 i3 = (i * i * i) >> 10;
-
-        InterpCubic[i][0] = -i3 + 2*i2 - i1;
-        InterpCubic[i][1] = i3 - 2*i2 + 0x4000;
-        InterpCubic[i][2] = -i3 + i2 + i1;
-        InterpCubic[i][3] = i3 - i2;
-    }
+    InitInterpTables();
 
     return true;
 }
@@ -157,7 +174,8 @@ void Reset()
     Capture[0]->Reset();
     Capture[1]->Reset();
 
-    NDS::ScheduleEvent(NDS::Event_SPU, true, 1024, Mix, 0);
+    MixTimestamp = NDS::SysTimestamp + 1024;
+    ScheduleMix();
 }
 
 void Stop()
@@ -175,6 +193,9 @@ void DoSavestate(Savestate* file)
 {
     file->Section("SPU.");
 
+    if (file->Saving)
+        CatchUp();
+
     file->Var16(&Cnt);
     file->Var8(&MasterVolume);
     file->Var16(&Bias);
@@ -184,6 +205,18 @@ void DoSavestate(Savestate* file)
 
     Capture[0]->DoSavestate(file);
     Capture[1]->DoSavestate(file);
+
+    if (file->IsAtLeastVersion(10, 2))
+    {
+        file->Var64(&MixTimestamp);
+        file->Var64(&MixEventTimestamp);
+    }
+    else
+    {
+        // older states mixed every sample from its own event, which is due soon
+        MixTimestamp = NDS::SysTimestamp + 1;
+        MixEventTimestamp = MixTimestamp;
+    }
 }
 
 
@@ -504,82 +537,108 @@ void Channel::NextSample_Noise()
 }
 
 template<u32 type>
-s32 Channel::Run()
+void Channel::RunBlock(s32* out, u32 samples)
 {
-    if (!(Cnt & (1<<31))) return 0;
+    // the channel state is stepped sample by sample, the interpolation
+    // and volume are then applied to the whole block at once
+    bool interp = (type < 3) && (InterpType != 0);
 
-    if ((type < 3) && ((Length+LoopPos) < 16)) return 0;
+    alignas(32) s32 taps[4][MixBatchSize];
+    alignas(32) s32 coefs[4][MixBatchSize];
 
-    if (KeyOn)
+    u32 count = PadBlock(samples);
+    for (u32 s = 0; s < count; s++)
     {
-        Start();
-        KeyOn = false;
-    }
+        taps[0][s] = 0; taps[1][s] = 0; taps[2][s] = 0; taps[3][s] = 0;
+        coefs[0][s] = 0; coefs[1][s] = 0; coefs[2][s] = 0; coefs[3][s] = 0;
 
-    Timer += 512; // 1 sample = 512 cycles at 16MHz
-
-    while (Timer >> 16)
-    {
-        Timer = TimerReload + (Timer - 0x10000);
+        if (s >= samples) continue;
+        if (!(Cnt & (1<<31))) continue;
+        if ((type < 3) && ((Length+LoopPos) < 16)) continue;
 
-        // for optional interpolation: save previous samples
-        // the interpolated audio will be delayed by a couple samples,
-        // but it's easier to deal with this way
-        if ((type < 3) && (InterpType != 0))
+        if (KeyOn)
         {
-            PrevSample[2] = PrevSample[1];
-            PrevSample[1] = PrevSample[0];
-            PrevSample[0] = CurSample;
+            Start();
+            KeyOn = false;
         }
 
-        switch (type)
+        Timer += 512; // 1 sample = 512 cycles at 16MHz
+
+        while (Timer >> 16)
         {
-        case 0: NextSample_PCM8(); break;
-        case 1: NextSample_PCM16(); break;
-        case 2: NextSample_ADPCM(); break;
-        case 3: NextSample_PSG(); break;
-        case 4: NextSample_Noise(); break;
-        }
-    }
+            Timer = TimerReload + (Timer - 0x10000);
 
-    s32 val = (s32)CurSample;
+            // for optional interpolation: save previous samples
+            // the interpolated audio will be delayed by a couple samples,
+            // but it's easier to deal with this way
+            if (interp)
+            {
+                PrevSample[2] = PrevSample[1];
+                PrevSample[1] = PrevSample[0];
+                PrevSample[0] = CurSample;
+            }
 
-    // interpolation (emulation improvement, not a hardware feature)
-    if ((type < 3) && (InterpType != 0))
-    {
-        s32 samplepos = ((Timer - TimerReload) * 0x100) / (0x10000 - TimerReload);
-        if (samplepos > 0xFF) samplepos = 0xFF;
+            switch (type)
+            {
+            case 0: NextSample_PCM8(); break;
+            case 1: NextSample_PCM16(); break;
+            case 2: NextSample_ADPCM(); break;
+            case 3: NextSample_PSG(); break;
+            case 4: NextSample_Noise(); break;
+            }
+        }
+
+        taps[3][s] = CurSample;
 
-        switch (InterpType)
+        // interpolation (emulation improvement, not a hardware feature)
+        if (interp)
         {
-        case 1: // linear
-            val = ((val           * samplepos) +
-                   (PrevSample[0] * (0xFF-samplepos))) >> 8;
-            break;
+            s32 samplepos = ((Timer - TimerReload) * 0x100) / (0x10000 - TimerReload);
+            if (samplepos > 0xFF) samplepos = 0xFF;
 
-        case 2: // cosine
-            val = ((val           * InterpCos[samplepos]) +
-                   (PrevSample[0] * InterpCos[0xFF-samplepos])) >> 14;
-            break;
+            taps[0][s] = PrevSample[2];
+            taps[1][s] = PrevSample[1];
+            taps[2][s] = PrevSample[0];
 
-        case 3: // cubic
-            val = ((PrevSample[2] * InterpCubic[samplepos][0]) +
-                   (PrevSample[1] * InterpCubic[samplepos][1]) +
-                   (PrevSample[0] * InterpCubic[samplepos][2]) +
-                   (val           * InterpCubic[samplepos][3])) >> 14;
-            break;
+            SetInterpCoefs(coefs, s, InterpType, samplepos);
         }
     }
 
-    val <<= VolumeShift;
-    val *= Volume;
-    return val;
+    if (interp)
+        FilterBlock(out, taps, coefs, (InterpType == 1) ? 8 : 14, VolumeShift, Volume, count);
+    else
+        VolumeBlock(out, taps[3], VolumeShift, Volume, count);
 }
 
-void Channel::PanOutput(s32 in, s32& left, s32& right)
+void Channel::DoRunBlock(s32* out, u32 samples)
 {
-    left += ((s64)in * (128-Pan)) >> 10;
-    right += ((s64)in * Pan) >> 10;
+    if (!(Cnt & (1<<31)))
+    {
+        memset(out, 0, PadBlock(samples) * sizeof(s32));
+        return;
+    }
+
+    switch ((Cnt >> 29) & 0x3)
+    {
+    case 0: RunBlock<0>(out, samples); return;
+    case 1: RunBlock<1>(out, samples); return;
+    case 2: RunBlock<2>(out, samples); return;
+    case 3:
+        if (Num >= 14)
+        {
+            RunBlock<4>(out, samples);
+            return;
+        }
+        else if (Num >= 8)
+        {
+            RunBlock<3>(out, samples);
+            return;
+        }
+        [[fallthrough]];
+    default:
+        memset(out, 0, PadBlock(samples) * sizeof(s32));
+        return;
+    }
 }
 
 
@@ -715,150 +774,180 @@ void CaptureUnit::Run(s32 sample)
 }
 
 
-void Mix(u32 dummy)
+void MixSamples(u32 samples)
 {
-    s32 left = 0, right = 0;
-    s32 leftoutput = 0, rightoutput = 0;
+    PROFILE_SCOPE(Section_SPU);
 
-    if (Cnt & (1<<15))
-    {
-        s32 ch0 = Channels[0]->DoRun();
-        s32 ch1 = Channels[1]->DoRun();
-        s32 ch2 = Channels[2]->DoRun();
-        s32 ch3 = Channels[3]->DoRun();
+    u32 count = PadBlock(samples);
 
-        // TODO: addition from capture registers
-        Channels[0]->PanOutput(ch0, left, right);
-        Channels[2]->PanOutput(ch2, left, right);
+    alignas(32) s32 leftoutput[MixBatchSize] = {};
+    alignas(32) s32 rightoutput[MixBatchSize] = {};
 
-        if (!(Cnt & (1<<12))) Channels[1]->PanOutput(ch1, left, right);
-        if (!(Cnt & (1<<13))) Channels[3]->PanOutput(ch3, left, right);
+    if (Cnt & (1<<15))
+    {
+        alignas(32) s32 chanbuf[16][MixBatchSize];
+        alignas(32) s32 left[MixBatchSize] = {};
+        alignas(32) s32 right[MixBatchSize] = {};
 
-        for (int i = 4; i < 16; i++)
+        for (int i = 0; i < 16; i++)
         {
             Channel* chan = Channels[i];
+            bool active = chan->Cnt & (1<<31);
+
+            chan->DoRunBlock(chanbuf[i], samples);
 
-            s32 channel = chan->DoRun();
-            chan->PanOutput(channel, left, right);
+            // TODO: addition from capture registers
+            if (!active) continue;
+            if ((i == 1) && (Cnt & (1<<12))) continue;
+            if ((i == 3) && (Cnt & (1<<13))) continue;
+
+            PanBlock(left, chanbuf[i], 128 - chan->Pan, count);
+            PanBlock(right, chanbuf[i], chan->Pan, count);
         }
 
         // sound capture
         // TODO: other sound capture sources, along with their bugs
 
-        if (Capture[0]->Cnt & (1<<7))
+        for (u32 s = 0; s < samples; s++)
         {
-            s32 val = left;
+            if (Capture[0]->Cnt & (1<<7))
+            {
+                s32 val = left[s];
 
-            val >>= 8;
-            if      (val < -0x8000) val = -0x8000;
-            else if (val > 0x7FFF)  val = 0x7FFF;
+                val >>= 8;
+                if      (val < -0x8000) val = -0x8000;
+                else if (val > 0x7FFF)  val = 0x7FFF;
 
-            Capture[0]->Run(val);
-        }
+                Capture[0]->Run(val);
+            }
 
-        if (Capture[1]->Cnt & (1<<7))
-        {
-            s32 val = right;
+            if (Capture[1]->Cnt & (1<<7))
+            {
+                s32 val = right[s];
 
-            val >>= 8;
-            if      (val < -0x8000) val = -0x8000;
-            else if (val > 0x7FFF)  val = 0x7FFF;
+                val >>= 8;
+                if      (val < -0x8000) val = -0x8000;
+                else if (val > 0x7FFF)  val = 0x7FFF;
 
-            Capture[1]->Run(val);
+                Capture[1]->Run(val);
+            }
         }
 
         // final output
 
+        s32* ch1 = chanbuf[1];
+        s32* ch3 = chanbuf[3];
+
         switch (Cnt & 0x0300)
         {
         case 0x0000: // left mixer
-            leftoutput = left;
+            memcpy(leftoutput, left, count * sizeof(s32));
             break;
         case 0x0100: // channel 1
-            {
-                s32 pan = 128 - Channels[1]->Pan;
-                leftoutput = ((s64)ch1 * pan) >> 10;
-            }
+            PanBlock(leftoutput, ch1, 128 - Channels[1]->Pan, count);
             break;
         case 0x0200: // channel 3
-            {
-                s32 pan = 128 - Channels[3]->Pan;
-                leftoutput = ((s64)ch3 * pan) >> 10;
-            }
+            PanBlock(leftoutput, ch3, 128 - Channels[3]->Pan, count);
             break;
         case 0x0300: // channel 1+3
-            {
-                s32 pan1 = 128 - Channels[1]->Pan;
-                s32 pan3 = 128 - Channels[3]->Pan;
-                leftoutput = (((s64)ch1 * pan1) >> 10) + (((s64)ch3 * pan3) >> 10);
-            }
+            PanBlock(leftoutput, ch1, 128 - Channels[1]->Pan, count);
+            PanBlock(leftoutput, ch3, 128 - Channels[3]->Pan, count);
             break;
         }
 
         switch (Cnt & 0x0C00)
         {
         case 0x0000: // right mixer
-            rightoutput = right;
+            memcpy(rightoutput, right, count * sizeof(s32));
             break;
         case 0x0400: // channel 1
-            {
-                s32 pan = Channels[1]->Pan;
-                rightoutput = ((s64)ch1 * pan) >> 10;
-            }
+            PanBlock(rightoutput, ch1, Channels[1]->Pan, count);
             break;
         case 0x0800: // channel 3
-            {
-                s32 pan = Channels[3]->Pan;
-                rightoutput = ((s64)ch3 * pan) >> 10;
-            }
+            PanBlock(rightoutput, ch3, Channels[3]->Pan, count);
             break;
         case 0x0C00: // channel 1+3
-            {
-                s32 pan1 = Channels[1]->Pan;
-                s32 pan3 = Channels[3]->Pan;
-                rightoutput = (((s64)ch1 * pan1) >> 10) + (((s64)ch3 * pan3) >> 10);
-            }
+            PanBlock(rightoutput, ch1, Channels[1]->Pan, count);
+            PanBlock(rightoutput, ch3, Channels[3]->Pan, count);
             break;
         }
     }
 
-    leftoutput = ((s64)leftoutput * MasterVolume) >> 7;
-    rightoutput = ((s64)rightoutput * MasterVolume) >> 7;
-
-    leftoutput >>= 8;
-    rightoutput >>= 8;
-
     // Add SOUNDBIAS value
     // The value used by all commercial games is 0x200, so we subtract that so it won't offset the final sound output.
-    if (ApplyBias)
-    {
-        leftoutput += (Bias << 6) - 0x8000;
-        rightoutput += (Bias << 6) - 0x8000;
-    }
-
-    if      (leftoutput < -0x8000) leftoutput = -0x8000;
-    else if (leftoutput > 0x7FFF)  leftoutput = 0x7FFF;
-    if      (rightoutput < -0x8000) rightoutput = -0x8000;
-    else if (rightoutput > 0x7FFF)  rightoutput = 0x7FFF;
+    s32 bias = ApplyBias ? ((Bias << 6) - 0x8000) : 0;
 
     // The original DS and DS lite degrade the output from 16 to 10 bit before output
-    if (Degrade10Bit)
-    {
-        leftoutput &= 0xFFFFFFC0;
-        rightoutput &= 0xFFFFFFC0;
-    }
+    s32 mask = Degrade10Bit ? 0xFFFFFFC0 : 0xFFFFFFFF;
 
     // OutputBufferFrame can never get full because it's
     // transfered to OutputBuffer at the end of the frame
-    OutputBackbuffer[OutputBackbufferWritePosition    ] = leftoutput >> 1;
-    OutputBackbuffer[OutputBackbufferWritePosition + 1] = rightoutput >> 1;
-    OutputBackbufferWritePosition += 2;
+    OutputBlock(&OutputBackbuffer[OutputBackbufferWritePosition], leftoutput, rightoutput, MasterVolume, bias, mask, samples);
+    OutputBackbufferWritePosition += samples * 2;
+}
 
-    NDS::ScheduleEvent(NDS::Event_SPU, true, 1024, Mix, 0);
+// sound capture writes the mixer output to memory, which the channels or the
+// CPU may read back right away (ie. for echo effects). a batch generates all
+// of its channel samples before capturing any of them, and is only mixed once
+// its last sample is due. so while capture is running, the mixer goes back to
+// one sample per event
+u32 MixBatchLimit()
+{
+    if ((Capture[0]->Cnt | Capture[1]->Cnt) & (1<<7))
+        return 1;
+
+    return MixBatchSize;
+}
+
+// mixes all samples due at or before the given timestamp
+void MixUntil(u64 timestamp)
+{
+    if (timestamp < MixTimestamp)
+        return;
+
+    u32 samples = ((timestamp - MixTimestamp) >> 10) + 1;
+    MixTimestamp += (u64)samples << 10;
+
+    while (samples > 0)
+    {
+        // capture can stop in the middle of this, so check every batch
+        u32 batch = std::min(samples, MixBatchLimit());
+        MixSamples(batch);
+        samples -= batch;
+    }
+}
+
+void CatchUp()
+{
+    // the CPU slice can span a whole batch, so mix up to where the CPU is
+    // rather than to the start of the slice. this way a register access
+    // lands on the same sample as it would with one event per sample
+    MixUntil(NDS::GetSysClockCycles(0));
+}
+
+void ScheduleMix()
+{
+    MixEventTimestamp = MixTimestamp + ((MixBatchLimit() - 1) << 10);
+    NDS::ScheduleEvent(NDS::Event_SPU, MixEventTimestamp, Mix, 0);
+}
+
+// called when capture is started or stopped, the pending event may be a whole batch away
+void RescheduleMix()
+{
+    NDS::CancelEvent(NDS::Event_SPU);
+    ScheduleMix();
+}
+
+void Mix(u32 dummy)
+{
+    MixUntil(MixEventTimestamp);
+    ScheduleMix();
 }
 
 void TransferOutput()
 {
+    CatchUp();
+
     Platform::Mutex_Lock(AudioLock);
     for (u32 i = 0; i < OutputBackbufferWritePosition; i += 2)
     {
@@ -985,6 +1074,8 @@ int ReadOutput(s16* data, int samples)
 
 u8 Read8(u32 addr)
 {
+    CatchUp();
+
     if (addr < 0x04000500)
     {
         Channel* chan = Channels[(addr >> 4) & 0xF];
@@ -1015,6 +1106,8 @@ u8 Read8(u32 addr)
 
 u16 Read16(u32 addr)
 {
+    CatchUp();
+
     if (addr < 0x04000500)
     {
         Channel* chan = Channels[(addr >> 4) & 0xF];
@@ -1042,6 +1135,8 @@ u16 Read16(u32 addr)
 
 u32 Read32(u32 addr)
 {
+    CatchUp();
+
     if (addr < 0x04000500)
     {
         Channel* chan = Channels[(addr >> 4) & 0xF];
@@ -1071,6 +1166,8 @@ u32 Read32(u32 addr)
 
 void Write8(u32 addr, u8 val)
 {
+    CatchUp();
+
     if (addr < 0x04000500)
     {
         Channel* chan = Channels[(addr >> 4) & 0xF];
@@ -1098,10 +1195,12 @@ void Write8(u32 addr, u8 val)
 
         case 0x04000508:
             Capture[0]->SetCnt(val);
+            RescheduleMix();
             if (val & 0x03) Log(LogLevel::Warn, "!! UNSUPPORTED SPU CAPTURE MODE %02X\n", val);
             return;
         case 0x04000509:
             Capture[1]->SetCnt(val);
+            RescheduleMix();
             if (val & 0x03) Log(LogLevel::Warn, "!! UNSUPPORTED SPU CAPTURE MODE %02X\n", val);
             return;
         }
@@ -1112,6 +1211,8 @@ void Write8(u32 addr, u8 val)
 
 void Write16(u32 addr, u16 val)
 {
+    CatchUp();
+
     if (addr < 0x04000500)
     {
         Channel* chan = Channels[(addr >> 4) & 0xF];
@@ -1148,6 +1249,7 @@ void Write16(u32 addr, u16 val)
         case 0x04000508:
             Capture[0]->SetCnt(val & 0xFF);
             Capture[1]->SetCnt(val >> 8);
+            RescheduleMix();
             if (val & 0x0303) Log(LogLevel::Warn, "!! UNSUPPORTED SPU CAPTURE MODE %04X\n", val);
             return;
 
@@ -1161,6 +1263,8 @@ void Write16(u32 addr, u16 val)
 
 void Write32(u32 addr, u32 val)
 {
+    CatchUp();
+
     if (addr < 0x04000500)
     {
         Channel* chan = Channels[(addr >> 4) & 0xF];
@@ -1196,6 +1300,7 @@ void Write32(u32 addr, u32 val)
         case 0x04000508:
             Capture[0]->SetCnt(val & 0xFF);
             Capture[1]->SetCnt(val >> 8);
+            RescheduleMix();
             if (val & 0x0303) Log(LogLevel::Warn, "!! UNSUPPORTED SPU CAPTURE MODE %04X\n", val);
             return;
 
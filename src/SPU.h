@@ -36,6 +36,10 @@ void SetPowerCnt(u32 val);
 // 0=none 1=linear 2=cosine 3=cubic
 void SetInterpolation(int type);
 
+// 1:1:14 fixed-point interpolation weights, indexed by the position between two samples
+extern s16 InterpCos[0x100];
+extern s16 InterpCubic[0x100][4];
+
 void SetBias(u16 bias);
 void SetDegrade10Bit(bool enable);
 void SetApplyBias(bool enable);
@@ -132,33 +136,10 @@ public:
     void NextSample_PSG();
     void NextSample_Noise();
 
-    template<u32 type> s32 Run();
-
-    s32 DoRun()
-    {
-        switch ((Cnt >> 29) & 0x3)
-        {
-        case 0: return Run<0>(); break;
-        case 1: return Run<1>(); break;
-        case 2: return Run<2>(); break;
-        case 3:
-            if (Num >= 14)
-            {
-                return Run<4>();
-                break;
-            }
-            else if (Num >= 8)
-            {
-                return Run<3>();
-                break;
-            }
-            [[fallthrough]];
-        default:
-            return 0;
-        }
-    }
+    template<u32 type> void RunBlock(s32* out, u32 samples);
 
-    void PanOutput(s32 in, s32& left, s32& right);
+    // generates a run of samples at once
+    void DoRunBlock(s32* out, u32 samples);
 
 private:
     u32 (*BusRead32)(u32 addr);
@@ -0,0 +1,267 @@
+/*
+    Copyright 2016-2022 melonDS team
+
+    This file is part of melonDS.
+
+    melonDS is free software: you can redistribute it and/or modify it under
+    the terms of the GNU General Public License as published by the Free
+    Software Foundation, either version 3 of the License, or (at your option)
+    any later version.
+
+    melonDS is distributed in the hope that it will be useful, but WITHOUT ANY
+    WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+    FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with melonDS. If not, see http://www.gnu.org/licenses/.
+*/
+
+#include <string.h>
+#include <cmath>
+#include "SPU.h"
+#include "SPU_Mixer.h"
+
+namespace SPU
+{
+
+// audio interpolation is an improvement upon the original hardware
+// (which performs no interpolation)
+s16 InterpCos[0x100];
+s16 InterpCubic[0x100][4];
+
+void InitInterpTables()
+{
+    // values are 1:1:14 fixed-point
+
+    float m_pi = std::acos(-1.0f);
+    for (int i = 0; i < 0x100; i++)
+    {
+        float ratio = (i * m_pi) / 255.0f;
+        ratio = 1.0f - std::cos(ratio);
+
+        InterpCos[i] = (s16)(ratio * 0x2000);
+    }
+
+    for (int i = 0; i < 0x100; i++)
+    {
+        s32 i1 = i << 6;
+        s32 i2 = (i * i) >> 2;
+        s32 i3 = (i * i * i) >> 10;
+
+        InterpCubic[i][0] = -i3 + 2*i2 - i1;
+        InterpCubic[i][1] = i3 - 2*i2 + 0x4000;
+        InterpCubic[i][2] = -i3 + i2 + i1;
+        InterpCubic[i][3] = i3 - i2;
+    }
+}
+
+void SetInterpCoefs(s32 (*coefs)[MixBatchSize], u32 s, int interpType, s32 samplepos)
+{
+    switch (interpType)
+    {
+    case 1: // linear
+        coefs[2][s] = 0xFF-samplepos;
+        coefs[3][s] = samplepos;
+        break;
+
+    case 2: // cosine
+        coefs[2][s] = InterpCos[0xFF-samplepos];
+        coefs[3][s] = InterpCos[samplepos];
+        break;
+
+    case 3: // cubic
+        coefs[0][s] = InterpCubic[samplepos][0];
+        coefs[1][s] = InterpCubic[samplepos][1];
+        coefs[2][s] = InterpCubic[samplepos][2];
+        coefs[3][s] = InterpCubic[samplepos][3];
+        break;
+    }
+}
+
+void FilterBlock_Scalar(s32* out, const s32 (*taps)[MixBatchSize], const s32 (*coefs)[MixBatchSize], int shift, u32 volshift, s32 volume, u32 count)
+{
+    for (u32 i = 0; i < count; i++)
+    {
+        s32 val = ((taps[0][i] * coefs[0][i]) +
+                   (taps[1][i] * coefs[1][i]) +
+                   (taps[2][i] * coefs[2][i]) +
+                   (taps[3][i] * coefs[3][i])) >> shift;
+        out[i] = (val << volshift) * volume;
+    }
+}
+
+void VolumeBlock_Scalar(s32* out, const s32* in, u32 volshift, s32 volume, u32 count)
+{
+    for (u32 i = 0; i < count; i++)
+        out[i] = (in[i] << volshift) * volume;
+}
+
+void PanBlock_Scalar(s32* dst, const s32* in, s32 pan, u32 count)
+{
+    for (u32 i = 0; i < count; i++)
+        dst[i] += ((s64)in[i] * pan) >> 10;
+}
+
+void OutputBlock_Scalar(s16* out, const s32* left, const s32* right, s32 mastervol, s32 bias, s32 mask, u32 count)
+{
+    for (u32 i = 0; i < count; i++)
+    {
+        s32 l = (((s64)left[i] * mastervol) >> 7) >> 8;
+        s32 r = (((s64)right[i] * mastervol) >> 7) >> 8;
+
+        l += bias;
+        r += bias;
+
+        if      (l < -0x8000) l = -0x8000;
+        else if (l > 0x7FFF)  l = 0x7FFF;
+        if      (r < -0x8000) r = -0x8000;
+        else if (r > 0x7FFF)  r = 0x7FFF;
+
+        out[i*2    ] = (l & mask) >> 1;
+        out[i*2 + 1] = (r & mask) >> 1;
+    }
+}
+
+#ifdef SPU_SIMD
+
+// the 64-bit multiplies of the scalar mixer are split into two 32-bit ones:
+// (x * m) >> n == ((x >> n) * m) + (((x & ((1<<n)-1)) * m) >> n)
+
+#define VSEL(m, a, b) (((a) & (m)) | ((b) & ~(m)))
+
+typedef s32 s32x4 __attribute__((vector_size(16)));
+typedef s32 s32x8 __attribute__((vector_size(32)));
+
+template <typename S32>
+__attribute__((always_inline)) inline void FilterBlockImpl(s32* out, const s32 (*taps)[MixBatchSize], const s32 (*coefs)[MixBatchSize], int shift, u32 volshift, s32 volume, u32 count)
+{
+    constexpr u32 N = sizeof(S32) / 4;
+
+    for (u32 i = 0; i < count; i += N)
+    {
+        S32 t0, t1, t2, t3, c0, c1, c2, c3;
+        memcpy(&t0, &taps[0][i], sizeof(S32));
+        memcpy(&t1, &taps[1][i], sizeof(S32));
+        memcpy(&t2, &taps[2][i], sizeof(S32));
+        memcpy(&t3, &taps[3][i], sizeof(S32));
+        memcpy(&c0, &coefs[0][i], sizeof(S32));
+        memcpy(&c1, &coefs[1][i], sizeof(S32));
+        memcpy(&c2, &coefs[2][i], sizeof(S32));
+        memcpy(&c3, &coefs[3][i], sizeof(S32));
+
+        S32 val = ((t0 * c0) + (t1 * c1) + (t2 * c2) + (t3 * c3)) >> shift;
+        val = (val << volshift) * volume;
+        memcpy(&out[i], &val, sizeof(S32));
+    }
+}
+
+template <typename S32>
+__attribute__((always_inline)) inline void VolumeBlockImpl(s32* out, const s32* in, u32 volshift, s32 volume, u32 count)
+{
+    constexpr u32 N = sizeof(S32) / 4;
+
+    for (u32 i = 0; i < count; i += N)
+    {
+        S32 val;
+        memcpy(&val, &in[i], sizeof(S32));
+        val = (val << volshift) * volume;
+        memcpy(&out[i], &val, sizeof(S32));
+    }
+}
+
+template <typename S32>
+__attribute__((always_inline)) inline void PanBlockImpl(s32* dst, const s32* in, s32 pan, u32 count)
+{
+    constexpr u32 N = sizeof(S32) / 4;
+
+    for (u32 i = 0; i < count; i += N)
+    {
+        S32 val, acc;
+        memcpy(&val, &in[i], sizeof(S32));
+        memcpy(&acc, &dst[i], sizeof(S32));
+        acc += ((val >> 10) * pan) + (((val & 0x3FF) * pan) >> 10);
+        memcpy(&dst[i], &acc, sizeof(S32));
+    }
+}
+
+template <typename S32>
+__attribute__((always_inline)) inline void OutputBlockImpl(s16* out, const s32* left, const s32* right, s32 mastervol, s32 bias, s32 mask, u32 count)
+{
+    constexpr u32 N = sizeof(S32) / 4;
+
+    const S32 minval = (S32){} - 0x8000;
+    const S32 maxval = (S32){} + 0x7FFF;
+
+    for (u32 i = 0; i < count; i += N)
+    {
+        S32 l, r;
+        memcpy(&l, &left[i], sizeof(S32));
+        memcpy(&r, &right[i], sizeof(S32));
+
+        l = ((l >> 7) * mastervol) + (((l & 0x7F) * mastervol) >> 7);
+        r = ((r >> 7) * mastervol) + (((r & 0x7F) * mastervol) >> 7);
+
+        l = (l >> 8) + bias;
+        r = (r >> 8) + bias;
+
+        l = VSEL((S32)(l < minval), minval, VSEL((S32)(l > maxval), maxval, l));
+        r = VSEL((S32)(r < minval), minval, VSEL((S32)(r > maxval), maxval, r));
+
+        l = (l & mask) >> 1;
+        r = (r & mask) >> 1;
+
+        for (u32 j = 0; j < N && (i+j) < count; j++)
+        {
+            out[(i+j)*2    ] = l[j];
+            out[(i+j)*2 + 1] = r[j];
+        }
+    }
+}
+
+#undef VSEL
+
+void FilterBlock_Base(s32* out, const s32 (*taps)[MixBatchSize], const s32 (*coefs)[MixBatchSize], int shift, u32 volshift, s32 volume, u32 count)
+{
+    FilterBlockImpl<s32x4>(out, taps, coefs, shift, volshift, volume, count);
+}
+
+void VolumeBlock_Base(s32* out, const s32* in, u32 volshift, s32 volume, u32 count)
+{
+    VolumeBlockImpl<s32x4>(out, in, volshift, volume, count);
+}
+
+void PanBlock_Base(s32* dst, const s32* in, s32 pan, u32 count)
+{
+    PanBlockImpl<s32x4>(dst, in, pan, count);
+}
+
+void OutputBlock_Base(s16* out, const s32* left, const s32* right, s32 mastervol, s32 bias, s32 mask, u32 count)
+{
+    OutputBlockImpl<s32x4>(out, left, right, mastervol, bias, mask, count);
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+__attribute__((target("avx2"))) void FilterBlock_AVX2(s32* out, const s32 (*taps)[MixBatchSize], const s32 (*coefs)[MixBatchSize], int shift, u32 volshift, s32 volume, u32 count)
+{
+    FilterBlockImpl<s32x8>(out, taps, coefs, shift, volshift, volume, count);
+}
+
+__attribute__((target("avx2"))) void VolumeBlock_AVX2(s32* out, const s32* in, u32 volshift, s32 volume, u32 count)
+{
+    VolumeBlockImpl<s32x8>(out, in, volshift, volume, count);
+}
+
+__attribute__((target("avx2"))) void PanBlock_AVX2(s32* dst, const s32* in, s32 pan, u32 count)
+{
+    PanBlockImpl<s32x8>(dst, in, pan, count);
+}
+
+__attribute__((target("avx2"))) void OutputBlock_AVX2(s16* out, const s32* left, const s32* right, s32 mastervol, s32 bias, s32 mask, u32 count)
+{
+    OutputBlockImpl<s32x8>(out, left, right, mastervol, bias, mask, count);
+}
+#endif
+
+#endif
+
+}
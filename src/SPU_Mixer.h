@@ -0,0 +1,72 @@
+/*
+    Copyright 2016-2022 melonDS team
+
+    This file is part of melonDS.
+
+    melonDS is free software: you can redistribute it and/or modify it under
+    the terms of the GNU General Public License as published by the Free
+    Software Foundation, either version 3 of the License, or (at your option)
+    any later version.
+
+    melonDS is distributed in the hope that it will be useful, but WITHOUT ANY
+    WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+    FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with melonDS. If not, see http://www.gnu.org/licenses/.
+*/
+
+#ifndef SPU_MIXER_H
+#define SPU_MIXER_H
+
+#include "types.h"
+
+#if defined(__GNUC__)
+#define SPU_SIMD
+#endif
+
+namespace SPU
+{
+
+// samples are mixed in batches of up to this many samples
+const u32 MixBatchSize = 32;
+
+// the blocks are always padded to a multiple of 8 samples, so the vector
+// versions of the kernels don't have to deal with partial vectors
+inline u32 PadBlock(u32 samples)
+{
+    return (samples + 7) & ~7;
+}
+
+void InitInterpTables();
+// fills the filter coefficients of sample s for the given interpolation type
+// the taps they apply to are PrevSample[2], PrevSample[1], PrevSample[0] and the current sample
+void SetInterpCoefs(s32 (*coefs)[MixBatchSize], u32 s, int interpType, s32 samplepos);
+
+// block kernels for the mixer
+// FilterBlock: interpolates the samples and applies the channel volume, shift is 8 for linear and 14 otherwise
+// VolumeBlock: applies the channel volume to samples that aren't interpolated
+// PanBlock: adds the panned samples to dst
+// OutputBlock: applies the master volume and bias and writes interleaved stereo samples
+void FilterBlock_Scalar(s32* out, const s32 (*taps)[MixBatchSize], const s32 (*coefs)[MixBatchSize], int shift, u32 volshift, s32 volume, u32 count);
+void VolumeBlock_Scalar(s32* out, const s32* in, u32 volshift, s32 volume, u32 count);
+void PanBlock_Scalar(s32* dst, const s32* in, s32 pan, u32 count);
+void OutputBlock_Scalar(s16* out, const s32* left, const s32* right, s32 mastervol, s32 bias, s32 mask, u32 count);
+
+#ifdef SPU_SIMD
+void FilterBlock_Base(s32* out, const s32 (*taps)[MixBatchSize], const s32 (*coefs)[MixBatchSize], int shift, u32 volshift, s32 volume, u32 count);
+void VolumeBlock_Base(s32* out, const s32* in, u32 volshift, s32 volume, u32 count);
+void PanBlock_Base(s32* dst, const s32* in, s32 pan, u32 count);
+void OutputBlock_Base(s16* out, const s32* left, const s32* right, s32 mastervol, s32 bias, s32 mask, u32 count);
+#if defined(__x86_64__) || defined(__i386__)
+// only to be used if the CPU supports AVX2
+void FilterBlock_AVX2(s32* out, const s32 (*taps)[MixBatchSize], const s32 (*coefs)[MixBatchSize], int shift, u32 volshift, s32 volume, u32 count);
+void VolumeBlock_AVX2(s32* out, const s32* in, u32 volshift, s32 volume, u32 count);
+void PanBlock_AVX2(s32* dst, const s32* in, s32 pan, u32 count);
+void OutputBlock_AVX2(s16* out, const s32* left, const s32* right, s32 mastervol, s32 bias, s32 mask, u32 count);
+#endif
+#endif
+
+}
+
+#endif
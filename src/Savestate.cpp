@@ -264,6 +264,9 @@ void Savestate::Rewind(bool save)
 
     buffer_offset = 0;
     finished = false;
+
+    if (Saving)
+        WriteSavestateHeader();
 }
 
 void Savestate::CloseCurrentSection()
@@ -25,7 +25,7 @@
 #include "types.h"
 
 #define SAVESTATE_MAJOR 10
-#define SAVESTATE_MINOR 0
+#define SAVESTATE_MINOR 2
 
 class Savestate
 {
@@ -70,7 +70,7 @@ public:
 
     void Finish();
 
-    // TODO rewinds the stream
+    // rewinds the stream, so the buffer can be reused for another state
     void Rewind(bool save);
 
     bool IsAtLeastVersion(u32 major, u32 minor)
@@ -56,6 +56,11 @@ bool PowerOn;
 
 s32 TimerError;
 
+// the timer event only fires on ticks where something can happen (see
+// NextTimerDeadline()), the idle ticks in between are accounted for lazily
+u64 TimerTimestamp;     // system timestamp of the last processed tick
+u32 TimerPendingTicks;  // ticks until the scheduled timer event
+
 u16 Random;
 
 // general, always-on microsecond counter
@@ -240,6 +245,8 @@ void Reset()
     IOPORT(W_PowerUS) = 0x0001;
 
     USTimestamp = 0;
+    TimerTimestamp = 0;
+    TimerPendingTicks = 1;
 
     USCounter = 0;
     USCompare = 0;
@@ -309,6 +316,18 @@ void DoSavestate(Savestate* file)
 
     file->Var64(&USTimestamp);
 
+    if (file->IsAtLeastVersion(10, 1))
+    {
+        file->Var64(&TimerTimestamp);
+        file->Var32(&TimerPendingTicks);
+    }
+    else
+    {
+        // older states always had the timer event scheduled for the next tick
+        TimerTimestamp = NDS::ARM7Timestamp;
+        TimerPendingTicks = 1;
+    }
+
     for (int i = 0; i < 6; i++)
     {
         TXSlot* slot = &TXSlots[i];
@@ -351,16 +370,133 @@ void DoSavestate(Savestate* file)
 }
 
 
+u64 CurrentTimestamp()
+{
+    if (NDS::CurCPU == 0)
+        return NDS::ARM9Timestamp >> NDS::ARM9ClockShift;
+    else
+        return NDS::ARM7Timestamp;
+}
+
+// system cycles spanned by the given amount of timer ticks, starting with the given rounding error
+u64 TimerDelay(u32 ticks, s32 error, s32* newerror)
+{
+    s64 cycles = (s64)33513982 * kTimerInterval * ticks;
+    cycles -= error;
+    s64 delay = (cycles + 999999) / 1000000;
+    if (newerror) *newerror = (s32)((delay * 1000000) - cycles);
+
+    return delay;
+}
+
+// number of ticks until the timer has anything to do besides counting
+u32 NextTimerDeadline()
+{
+    // TX/RX in progress or MP client sync: every tick matters
+    if (ComStatus || IOPORT(W_TXBusy) || IsMPClient)
+        return 1;
+
+    u32 deadline;
+
+    if (USUntilPowerOn < 0)
+        deadline = (-USUntilPowerOn + kTimerInterval - 1) / kTimerInterval;
+    else if (IOPORT(W_PowerState) & 0x0002)
+        return 1;
+    else
+        deadline = 0xFFFFFFFF;
+
+    // millisecond boundaries: WifiAP beacons, beacon count, USCOMPARE
+    deadline = std::min(deadline, (u32)(0x400 - (USTimestamp & 0x3FF & kTimeCheckMask)) / kTimerInterval);
+    if (IOPORT(W_USCountCnt))
+    {
+        deadline = std::min(deadline, (u32)(0x400 - (USCounter & 0x3FF & kTimeCheckMask)) / kTimerInterval);
+
+        // pre-beacon IRQ15 can only match during this millisecond
+        if (IOPORT(W_USCompareCnt) && (IOPORT(W_BeaconCount1) == (IOPORT(W_PreBeacon) >> 10)))
+            return 1;
+    }
+
+    // RX polling happens when RXCounter is on a 512us boundary
+    deadline = std::min(deadline, (((0x200 - (RXCounter & 0x1FF & kTimeCheckMask)) & 0x1FF) / kTimerInterval) + 1);
+
+    return deadline;
+}
+
+// advances the counters over ticks where nothing else happens
+void AdvanceIdleTicks(u32 ticks)
+{
+    if (!ticks) return;
+
+    u32 us = ticks * kTimerInterval;
+
+    USTimestamp += us;
+
+    if (USUntilPowerOn < 0)
+        USUntilPowerOn += us;
+
+    if (IOPORT(W_USCountCnt))
+        USCounter += us;
+
+    if (IOPORT(W_CmdCountCnt) & 0x0001)
+        CmdCounter = (CmdCounter > us) ? (CmdCounter - us) : 0;
+
+    if (IOPORT(W_ContentFree) > us)
+        IOPORT(W_ContentFree) -= us;
+    else
+        IOPORT(W_ContentFree) = 0;
+
+    RXCounter += us;
+}
+
 void ScheduleTimer(bool first)
 {
-    if (first) TimerError = 0;
+    if (first)
+    {
+        TimerError = 0;
+        TimerTimestamp = CurrentTimestamp();
+    }
+
+    TimerPendingTicks = NextTimerDeadline();
+    u64 delay = TimerDelay(TimerPendingTicks, TimerError, nullptr);
+
+    NDS::ScheduleEvent(NDS::Event_Wifi, TimerTimestamp + delay, USTimer, 0);
+}
+
+// brings the counters up to date before they are accessed
+void CatchUpTimer()
+{
+    if (!PowerOn || TimerPendingTicks <= 1)
+        return;
 
-    s32 cycles = 33513982 * kTimerInterval;
-    cycles -= TimerError;
-    s32 delay = (cycles + 999999) / 1000000;
-    TimerError = (delay * 1000000) - cycles;
+    u64 now = CurrentTimestamp();
+    if (now <= TimerTimestamp)
+        return;
 
-    NDS::ScheduleEvent(NDS::Event_Wifi, !first, delay, USTimer, 0);
+    u64 elapsed = std::min(now - TimerTimestamp, (u64)1 << 32);
+    u64 ticks = ((elapsed * 1000000) + TimerError) / ((u64)33513982 * kTimerInterval);
+    if (ticks == 0)
+        return;
+
+    // the pending tick itself is handled by the timer event
+    if (ticks >= TimerPendingTicks)
+        ticks = TimerPendingTicks - 1;
+
+    AdvanceIdleTicks(ticks);
+    TimerTimestamp += TimerDelay(ticks, TimerError, &TimerError);
+    TimerPendingTicks -= ticks;
+}
+
+// moves the timer event closer if something needs handling sooner
+void UpdateTimerDeadline()
+{
+    if (!PowerOn)
+        return;
+
+    if (NextTimerDeadline() >= TimerPendingTicks)
+        return;
+
+    NDS::CancelEvent(NDS::Event_Wifi);
+    ScheduleTimer(false);
 }
 
 void UpdatePowerOn()
@@ -403,6 +539,8 @@ void UpdatePowerOn()
 
 void SetPowerCnt(u32 val)
 {
+    CatchUpTimer();
+
     Enabled = val & (1<<1);
     UpdatePowerOn();
 }
@@ -1654,6 +1792,9 @@ void MSTimer()
 
 void USTimer(u32 param)
 {
+    AdvanceIdleTicks(TimerPendingTicks - 1);
+    TimerTimestamp += TimerDelay(TimerPendingTicks, TimerError, &TimerError);
+
     USTimestamp += kTimerInterval;
 
     if (IsMPClient && (!ComStatus))
@@ -1883,6 +2024,8 @@ u16 Read(u32 addr)
     if (addr >= 0x2000 && addr < 0x4000)
         return 0xFFFF;
 
+    CatchUpTimer();
+
     bool activeread = (addr < 0x1000);
 
     switch (addr)
@@ -1972,21 +2115,8 @@ u16 Read(u32 addr)
     return IOPORT(addr&0xFFF);
 }
 
-void Write(u32 addr, u16 val)
+void WriteIO(u32 addr, u16 val)
 {
-    if (addr >= 0x04810000)
-        return;
-
-    addr &= 0x7FFE;
-
-    if (addr >= 0x4000 && addr < 0x6000)
-    {
-        *(u16*)&RAM[addr & 0x1FFE] = val;
-        return;
-    }
-    if (addr >= 0x2000 && addr < 0x4000)
-        return;
-
     switch (addr)
     {
     case W_ModeReset:
@@ -2327,6 +2457,28 @@ void Write(u32 addr, u16 val)
 }
 
 
+void Write(u32 addr, u16 val)
+{
+    if (addr >= 0x04810000)
+        return;
+
+    addr &= 0x7FFE;
+
+    if (addr >= 0x4000 && addr < 0x6000)
+    {
+        *(u16*)&RAM[addr & 0x1FFE] = val;
+        return;
+    }
+    if (addr >= 0x2000 && addr < 0x4000)
+        return;
+
+    CatchUpTimer();
+    WriteIO(addr, val);
+
+    // the write may have started something the timer needs to handle
+    UpdateTimerDeadline();
+}
+
 u8* GetMAC()
 {
     return (u8*)&IOPORT(W_MACAddr0);
@@ -354,6 +354,11 @@ u8* ARM64XEmitter::GetRXBase()
   return m_rxbase;
 }
 
+u8* ARM64XEmitter::GetRWBase()
+{
+  return m_rwbase;
+}
+
 void ARM64XEmitter::ReserveCodeSpace(u32 bytes)
 {
   for (u32 i = 0; i < bytes / 4; i++)
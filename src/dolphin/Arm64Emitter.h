@@ -560,6 +560,7 @@ public:
   u8* GetWriteableRWPtr();
   void* GetRXPtr();
   u8* GetRXBase();
+  u8* GetRWBase();
   void FlushIcache();
   void FlushIcacheSection(u8* start, u8* end);
 
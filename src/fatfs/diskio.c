@@ -13,6 +13,7 @@
 
 static ff_disk_read_cb ReadCb;
 static ff_disk_write_cb WriteCb;
+static ff_disk_sync_cb SyncCb;
 static LBA_t SectorCount;
 static DSTATUS Status = STA_NOINIT | STA_NODISK;
 
@@ -23,6 +24,7 @@ void ff_disk_open(ff_disk_read_cb readcb, ff_disk_write_cb writecb, LBA_t seccnt
 
     ReadCb = readcb;
     WriteCb = writecb;
+    SyncCb = (void*)0;
     SectorCount = seccnt;
 
     Status &= ~STA_NODISK;
@@ -30,10 +32,17 @@ void ff_disk_open(ff_disk_read_cb readcb, ff_disk_write_cb writecb, LBA_t seccnt
     else          Status &= ~STA_PROTECT;
 }
 
+void ff_disk_sync_callback(ff_disk_sync_cb synccb)
+{
+    // optional, to write back whatever the disk is caching. set after ff_disk_open()
+    SyncCb = synccb;
+}
+
 void ff_disk_close(void)
 {
     ReadCb = (void*)0;
     WriteCb = (void*)0;
+    SyncCb = (void*)0;
     SectorCount = 0;
 
     Status &= ~STA_PROTECT;
@@ -127,7 +136,7 @@ DRESULT disk_ioctl (
     switch (cmd)
     {
     case CTRL_SYNC:
-        // TODO: fflush?
+        if (SyncCb && !SyncCb()) return RES_ERROR;
         return RES_OK;
 
     case GET_SECTOR_COUNT:
@@ -21,6 +21,10 @@
 
 #include "types.h"
 
+#if defined(__GNUC__)
+#define AUDIO_SIMD
+#endif
+
 #include <string>
 #include <vector>
 
@@ -101,7 +105,21 @@ int AudioOut_GetNumSamples(int outlen);
 // resample audio from the core audio output to match the frontend's
 // output frequency, and apply specified volume
 // note: this assumes the output buffer is interleaved stereo
-void AudioOut_Resample(s16* inbuf, int inlen, s16* outbuf, int outlen, int volume);
+void AudioOut_Resample(s16* inbuf, int inlen, s16* outbuf, int outlen, int volume, int interp);
+
+// the resampler behind AudioOut_Resample, prev holds the last stereo sample
+// of the previous call and is updated
+void Resample(s16* prev, s16* inbuf, int inlen, s16* outbuf, int outlen, int volume, int interp);
+
+// the resampler works on chunks of output samples: the input samples and
+// interpolation weights are gathered first, then filtered in one go
+const int ResampleChunk = 64;
+
+// applies the interpolation weights and volume to a chunk, count is a multiple of 4
+void FilterChunk_Scalar(s32* out, const s32 (*taps)[ResampleChunk], const s32 (*coefs)[ResampleChunk], int shift, int volume, int count);
+#ifdef AUDIO_SIMD
+void FilterChunk_Base(s32* out, const s32 (*taps)[ResampleChunk], const s32 (*coefs)[ResampleChunk], int shift, int volume, int count);
+#endif
 
 // feed silence to the microphone input
 void Mic_FeedSilence();
@@ -21,18 +21,21 @@
 #include <string.h>
 #include <math.h>
 
+#include <algorithm>
+
 #include "FrontendUtil.h"
 
 #include "NDS.h"
+#include "SPU.h"
 
 #include "mic_blow.h"
 
-
 namespace Frontend
 {
 
 int AudioOut_Freq;
 float AudioOut_SampleFrac;
+s16 AudioOut_Prev[2];
 
 s16* MicBuffer;
 u32 MicBufferLength;
@@ -43,6 +46,8 @@ void Init_Audio(int outputfreq)
 {
     AudioOut_Freq = outputfreq;
     AudioOut_SampleFrac = 0;
+    AudioOut_Prev[0] = 0;
+    AudioOut_Prev[1] = 0;
 
     MicBuffer = nullptr;
     MicBufferLength = 0;
@@ -60,27 +65,11 @@ int AudioOut_GetNumSamples(int outlen)
     return len_in;
 }
 
-void AudioOut_Resample(s16* inbuf, int inlen, s16* outbuf, int outlen, int volume)
+void AudioOut_Resample(s16* inbuf, int inlen, s16* outbuf, int outlen, int volume, int interp)
 {
-    float res_incr = inlen / (float)outlen;
-    float res_timer = 0;
-    int res_pos = 0;
-
-    for (int i = 0; i < outlen; i++)
-    {
-        outbuf[i*2  ] = (inbuf[res_pos*2  ] * volume) >> 8;
-        outbuf[i*2+1] = (inbuf[res_pos*2+1] * volume) >> 8;
-
-        res_timer += res_incr;
-        while (res_timer >= 1.0)
-        {
-            res_timer -= 1.0;
-            res_pos++;
-        }
-    }
+    Resample(AudioOut_Prev, inbuf, inlen, outbuf, outlen, volume, interp);
 }
 
-
 void Mic_FeedSilence()
 {
     MicBufferReadPos = 0;
@@ -0,0 +1,184 @@
+/*
+    Copyright 2016-2022 melonDS team
+
+    This file is part of melonDS.
+
+    melonDS is free software: you can redistribute it and/or modify it under
+    the terms of the GNU General Public License as published by the Free
+    Software Foundation, either version 3 of the License, or (at your option)
+    any later version.
+
+    melonDS is distributed in the hope that it will be useful, but WITHOUT ANY
+    WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+    FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with melonDS. If not, see http://www.gnu.org/licenses/.
+*/
+
+#include <string.h>
+
+#include <algorithm>
+
+#include "FrontendUtil.h"
+
+#include "SPU.h"
+
+
+namespace Frontend
+{
+
+void FilterChunk_Scalar(s32* out, const s32 (*taps)[ResampleChunk], const s32 (*coefs)[ResampleChunk], int shift, int volume, int count)
+{
+    for (int i = 0; i < count; i++)
+    {
+        s32 val = ((taps[0][i] * coefs[0][i]) +
+                   (taps[1][i] * coefs[1][i]) +
+                   (taps[2][i] * coefs[2][i]) +
+                   (taps[3][i] * coefs[3][i])) >> shift;
+        val = (val * volume) >> 8;
+
+        if      (val < -0x8000) val = -0x8000;
+        else if (val > 0x7FFF)  val = 0x7FFF;
+        out[i] = val;
+    }
+}
+
+#ifdef AUDIO_SIMD
+
+#define VSEL(m, a, b) (((a) & (m)) | ((b) & ~(m)))
+
+typedef s32 s32x4 __attribute__((vector_size(16)));
+
+void FilterChunk_Base(s32* out, const s32 (*taps)[ResampleChunk], const s32 (*coefs)[ResampleChunk], int shift, int volume, int count)
+{
+    const s32x4 minval = (s32x4){} - 0x8000;
+    const s32x4 maxval = (s32x4){} + 0x7FFF;
+
+    for (int i = 0; i < count; i += 4)
+    {
+        s32x4 t0, t1, t2, t3, c0, c1, c2, c3;
+        memcpy(&t0, &taps[0][i], sizeof(s32x4));
+        memcpy(&t1, &taps[1][i], sizeof(s32x4));
+        memcpy(&t2, &taps[2][i], sizeof(s32x4));
+        memcpy(&t3, &taps[3][i], sizeof(s32x4));
+        memcpy(&c0, &coefs[0][i], sizeof(s32x4));
+        memcpy(&c1, &coefs[1][i], sizeof(s32x4));
+        memcpy(&c2, &coefs[2][i], sizeof(s32x4));
+        memcpy(&c3, &coefs[3][i], sizeof(s32x4));
+
+        s32x4 val = ((t0 * c0) + (t1 * c1) + (t2 * c2) + (t3 * c3)) >> shift;
+        val = (val * volume) >> 8;
+        val = VSEL((s32x4)(val < minval), minval, VSEL((s32x4)(val > maxval), maxval, val));
+        memcpy(&out[i], &val, sizeof(s32x4));
+    }
+}
+
+#undef VSEL
+
+#endif
+
+void Resample(s16* prev, s16* inbuf, int inlen, s16* outbuf, int outlen, int volume, int interp)
+{
+    if (inlen < 1 || outlen < 1) return;
+
+    // 16.16 fixed-point position in the input
+    // each output sample is interpolated between input samples pos and pos+1,
+    // cubic interpolation also uses pos-1 and pos+2
+    u32 res_incr = ((u64)inlen << 16) / outlen;
+    u32 res_pos = 0;
+
+    int shift;
+    switch (interp)
+    {
+    case 1: shift = 8; break;
+    case 2:
+    case 3: shift = 14; break;
+    default: shift = 0; break;
+    }
+
+    alignas(16) s32 taps[2][4][ResampleChunk];
+    alignas(16) s32 coefs[4][ResampleChunk];
+    alignas(16) s32 out[2][ResampleChunk];
+
+    for (int i = 0; i < outlen; i += ResampleChunk)
+    {
+        int num = std::min(ResampleChunk, outlen - i);
+        int count = (num + 3) & ~3;
+
+        for (int j = 0; j < count; j++)
+        {
+            for (int k = 0; k < 4; k++)
+            {
+                taps[0][k][j] = 0;
+                taps[1][k][j] = 0;
+                coefs[k][j] = 0;
+            }
+
+            if (j >= num) continue;
+
+            int pos = res_pos >> 16;
+            int frac = (res_pos >> 8) & 0xFF;
+            res_pos += res_incr;
+
+            for (int k = 0; k < 4; k++)
+            {
+                int p = pos - 1 + k;
+                if (p < 0)
+                {
+                    taps[0][k][j] = prev[0];
+                    taps[1][k][j] = prev[1];
+                }
+                else
+                {
+                    if (p >= inlen) p = inlen - 1;
+                    taps[0][k][j] = inbuf[p*2  ];
+                    taps[1][k][j] = inbuf[p*2+1];
+                }
+            }
+
+            switch (interp)
+            {
+            case 1: // linear
+                coefs[1][j] = 0xFF - frac;
+                coefs[2][j] = frac;
+                break;
+
+            case 2: // cosine
+                coefs[1][j] = SPU::InterpCos[0xFF - frac];
+                coefs[2][j] = SPU::InterpCos[frac];
+                break;
+
+            case 3: // cubic
+                coefs[0][j] = SPU::InterpCubic[frac][0];
+                coefs[1][j] = SPU::InterpCubic[frac][1];
+                coefs[2][j] = SPU::InterpCubic[frac][2];
+                coefs[3][j] = SPU::InterpCubic[frac][3];
+                break;
+
+            default: // nearest
+                coefs[1][j] = 1;
+                break;
+            }
+        }
+
+#ifdef AUDIO_SIMD
+        FilterChunk_Base(out[0], taps[0], coefs, shift, volume, count);
+        FilterChunk_Base(out[1], taps[1], coefs, shift, volume, count);
+#else
+        FilterChunk_Scalar(out[0], taps[0], coefs, shift, volume, count);
+        FilterChunk_Scalar(out[1], taps[1], coefs, shift, volume, count);
+#endif
+
+        for (int j = 0; j < num; j++)
+        {
+            outbuf[(i+j)*2  ] = out[0][j];
+            outbuf[(i+j)*2+1] = out[1][j];
+        }
+    }
+
+    prev[0] = inbuf[(inlen-1)*2  ];
+    prev[1] = inbuf[(inlen-1)*2+1];
+}
+
+}
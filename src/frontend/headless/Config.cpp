@@ -0,0 +1,62 @@
+/*
+    Copyright 2016-2022 melonDS team
+
+    This file is part of melonDS.
+
+    melonDS is free software: you can redistribute it and/or modify it under
+    the terms of the GNU General Public License as published by the Free
+    Software Foundation, either version 3 of the License, or (at your option)
+    any later version.
+
+    melonDS is distributed in the hope that it will be useful, but WITHOUT ANY
+    WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+    FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with melonDS. If not, see http://www.gnu.org/licenses/.
+*/
+
+#include "Config.h"
+#include "Platform.h"
+
+namespace Config
+{
+
+int ConsoleType = 0;
+bool DirectBoot = true;
+
+bool JIT_Enable = false;
+int JIT_MaxBlockSize = 32;
+bool JIT_LiteralOptimisations = true;
+bool JIT_BranchOptimisations = true;
+bool JIT_FastMemory = true;
+int JIT_CodeCacheSize = 32;
+bool JIT_DiskCache = false;
+bool JIT_AsyncCompile = false;
+bool JIT_Profiler = false;
+bool JIT_PerfMap = false;
+
+bool ExternalBIOSEnable = false;
+
+std::string BIOS9Path;
+std::string BIOS7Path;
+std::string FirmwarePath;
+
+std::string DSiBIOS9Path;
+std::string DSiBIOS7Path;
+std::string DSiFirmwarePath;
+std::string DSiNANDPath;
+bool DSiFullBIOSBoot = false;
+bool DSiDSPThreaded = false;
+int DSiDSPSyncWindow = 16384;
+
+bool Threaded3D = true;
+int Threads3D = 1;
+bool Threaded2D = false;
+
+int AudioInterp = 0;
+int AudioBitDepth = 0;
+
+int LogLevel = Platform::Warn;
+
+}
@@ -0,0 +1,69 @@
+/*
+    Copyright 2016-2022 melonDS team
+
+    This file is part of melonDS.
+
+    melonDS is free software: you can redistribute it and/or modify it under
+    the terms of the GNU General Public License as published by the Free
+    Software Foundation, either version 3 of the License, or (at your option)
+    any later version.
+
+    melonDS is distributed in the hope that it will be useful, but WITHOUT ANY
+    WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+    FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with melonDS. If not, see http://www.gnu.org/licenses/.
+*/
+
+#ifndef HEADLESS_CONFIG_H
+#define HEADLESS_CONFIG_H
+
+#include <string>
+
+// the headless runner has no ini file, everything here
+// comes from the command line (see main.cpp)
+
+namespace Config
+{
+
+extern int ConsoleType;
+extern bool DirectBoot;
+
+extern bool JIT_Enable;
+extern int JIT_MaxBlockSize;
+extern bool JIT_LiteralOptimisations;
+extern bool JIT_BranchOptimisations;
+extern bool JIT_FastMemory;
+extern int JIT_CodeCacheSize;
+extern bool JIT_DiskCache;
+extern bool JIT_AsyncCompile;
+extern bool JIT_Profiler;
+extern bool JIT_PerfMap;
+
+extern bool ExternalBIOSEnable;
+
+extern std::string BIOS9Path;
+extern std::string BIOS7Path;
+extern std::string FirmwarePath;
+
+extern std::string DSiBIOS9Path;
+extern std::string DSiBIOS7Path;
+extern std::string DSiFirmwarePath;
+extern std::string DSiNANDPath;
+extern bool DSiFullBIOSBoot;
+extern bool DSiDSPThreaded;
+extern int DSiDSPSyncWindow;
+
+extern bool Threaded3D;
+extern int Threads3D;
+extern bool Threaded2D;
+
+extern int AudioInterp;
+extern int AudioBitDepth;
+
+extern int LogLevel;
+
+}
+
+#endif // HEADLESS_CONFIG_H
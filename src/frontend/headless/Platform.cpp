@@ -0,0 +1,365 @@
+/*
+    Copyright 2016-2022 melonDS team
+
+    This file is part of melonDS.
+
+    melonDS is free software: you can redistribute it and/or modify it under
+    the terms of the GNU General Public License as published by the Free
+    Software Foundation, either version 3 of the License, or (at your option)
+    any later version.
+
+    melonDS is distributed in the hope that it will be useful, but WITHOUT ANY
+    WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+    FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with melonDS. If not, see http://www.gnu.org/licenses/.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+
+#include <string>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+
+#include "Platform.h"
+#include "Config.h"
+
+
+void emuStop();
+
+
+namespace Platform
+{
+
+// no windowing toolkit here, so the threading primitives are plain std:: ones
+
+struct HeadlessSemaphore
+{
+    std::mutex Lock;
+    std::condition_variable Cond;
+    int Count = 0;
+};
+
+
+void Init(int argc, char** argv)
+{
+}
+
+void DeInit()
+{
+}
+
+
+void StopEmu()
+{
+    emuStop();
+}
+
+
+int InstanceID()
+{
+    return 0;
+}
+
+std::string InstanceFileSuffix()
+{
+    return "";
+}
+
+
+int GetConfigInt(ConfigEntry entry)
+{
+    switch (entry)
+    {
+#ifdef JIT_ENABLED
+    case JIT_MaxBlockSize: return Config::JIT_MaxBlockSize;
+    case JIT_CodeCacheSize: return Config::JIT_CodeCacheSize;
+#endif
+
+    case AudioBitDepth: return Config::AudioBitDepth;
+
+    case DSi_DSPSyncWindow: return Config::DSiDSPSyncWindow;
+    }
+
+    return 0;
+}
+
+bool GetConfigBool(ConfigEntry entry)
+{
+    switch (entry)
+    {
+#ifdef JIT_ENABLED
+    case JIT_Enable: return Config::JIT_Enable;
+    case JIT_LiteralOptimizations: return Config::JIT_LiteralOptimisations;
+    case JIT_BranchOptimizations: return Config::JIT_BranchOptimisations;
+    case JIT_FastMemory: return Config::JIT_FastMemory;
+    case JIT_DiskCache: return Config::JIT_DiskCache;
+    case JIT_AsyncCompile: return Config::JIT_AsyncCompile;
+    case JIT_Profiler: return Config::JIT_Profiler;
+    case JIT_PerfMap: return Config::JIT_PerfMap;
+#endif
+
+    case ExternalBIOSEnable: return Config::ExternalBIOSEnable;
+
+    case DSi_FullBIOSBoot: return Config::DSiFullBIOSBoot;
+    case DSi_DSPThreaded: return Config::DSiDSPThreaded;
+    }
+
+    return false;
+}
+
+std::string GetConfigString(ConfigEntry entry)
+{
+    switch (entry)
+    {
+    case BIOS9Path: return Config::BIOS9Path;
+    case BIOS7Path: return Config::BIOS7Path;
+    case FirmwarePath: return Config::FirmwarePath;
+
+    case DSi_BIOS9Path: return Config::DSiBIOS9Path;
+    case DSi_BIOS7Path: return Config::DSiBIOS7Path;
+    case DSi_FirmwarePath: return Config::DSiFirmwarePath;
+    case DSi_NANDPath: return Config::DSiNANDPath;
+    }
+
+    return "";
+}
+
+bool GetConfigArray(ConfigEntry entry, void* data)
+{
+    return false;
+}
+
+
+FILE* OpenFile(const std::string& path, const std::string& mode, bool mustexist)
+{
+    if (mustexist)
+    {
+        FILE* f = fopen(path.c_str(), "rb");
+        if (!f) return nullptr;
+        fclose(f);
+    }
+
+    return fopen(path.c_str(), mode.c_str());
+}
+
+FILE* OpenLocalFile(const std::string& path, const std::string& mode)
+{
+    // paths are taken as given on the command line
+    return OpenFile(path, mode, mode[0] != 'w');
+}
+
+FILE* OpenDataFile(const std::string& path)
+{
+    return OpenFile(path, "rb", true);
+}
+
+void Log(LogLevel level, const char* fmt, ...)
+{
+    if (fmt == nullptr)
+        return;
+    if (level < Config::LogLevel)
+        return;
+
+    va_list args;
+    va_start(args, fmt);
+    vfprintf(stderr, fmt, args);
+    va_end(args);
+}
+
+Thread* Thread_Create(std::function<void()> func)
+{
+    return (Thread*)new std::thread(func);
+}
+
+void Thread_Free(Thread* thread)
+{
+    std::thread* t = (std::thread*) thread;
+    if (t->joinable()) t->detach();
+    delete t;
+}
+
+void Thread_Wait(Thread* thread)
+{
+    std::thread* t = (std::thread*) thread;
+    if (t->joinable()) t->join();
+}
+
+Semaphore* Semaphore_Create()
+{
+    return (Semaphore*)new HeadlessSemaphore();
+}
+
+void Semaphore_Free(Semaphore* sema)
+{
+    delete (HeadlessSemaphore*) sema;
+}
+
+void Semaphore_Reset(Semaphore* sema)
+{
+    HeadlessSemaphore* s = (HeadlessSemaphore*) sema;
+
+    std::lock_guard<std::mutex> lock(s->Lock);
+    s->Count = 0;
+}
+
+void Semaphore_Wait(Semaphore* sema)
+{
+    HeadlessSemaphore* s = (HeadlessSemaphore*) sema;
+
+    std::unique_lock<std::mutex> lock(s->Lock);
+    s->Cond.wait(lock, [s]() { return s->Count > 0; });
+    s->Count--;
+}
+
+void Semaphore_Post(Semaphore* sema, int count)
+{
+    HeadlessSemaphore* s = (HeadlessSemaphore*) sema;
+
+    {
+        std::lock_guard<std::mutex> lock(s->Lock);
+        s->Count += count;
+    }
+    if (count > 1)
+        s->Cond.notify_all();
+    else
+        s->Cond.notify_one();
+}
+
+Mutex* Mutex_Create()
+{
+    return (Mutex*)new std::mutex();
+}
+
+void Mutex_Free(Mutex* mutex)
+{
+    delete (std::mutex*) mutex;
+}
+
+void Mutex_Lock(Mutex* mutex)
+{
+    ((std::mutex*) mutex)->lock();
+}
+
+void Mutex_Unlock(Mutex* mutex)
+{
+    ((std::mutex*) mutex)->unlock();
+}
+
+bool Mutex_TryLock(Mutex* mutex)
+{
+    return ((std::mutex*) mutex)->try_lock();
+}
+
+void Sleep(u64 usecs)
+{
+    std::this_thread::sleep_for(std::chrono::microseconds(usecs));
+}
+
+
+void WriteNDSSave(const u8* savedata, u32 savelen, u32 writeoffset, u32 writelen)
+{
+    // runs are meant to be repeatable, so saves are never written back
+}
+
+void WriteGBASave(const u8* savedata, u32 savelen, u32 writeoffset, u32 writelen)
+{
+}
+
+
+bool MP_Init()
+{
+    return false;
+}
+
+void MP_DeInit()
+{
+}
+
+void MP_Begin()
+{
+}
+
+void MP_End()
+{
+}
+
+int MP_SendPacket(u8* data, int len, u64 timestamp)
+{
+    return 0;
+}
+
+int MP_RecvPacket(u8* data, u64* timestamp)
+{
+    return 0;
+}
+
+int MP_SendCmd(u8* data, int len, u64 timestamp)
+{
+    return 0;
+}
+
+int MP_SendReply(u8* data, int len, u64 timestamp, u16 aid)
+{
+    return 0;
+}
+
+int MP_SendAck(u8* data, int len, u64 timestamp)
+{
+    return 0;
+}
+
+int MP_RecvHostPacket(u8* data, u64* timestamp)
+{
+    return 0;
+}
+
+u16 MP_RecvReplies(u8* data, u64 timestamp, u16 aidmask)
+{
+    return 0;
+}
+
+bool LAN_Init()
+{
+    return false;
+}
+
+void LAN_DeInit()
+{
+}
+
+int LAN_SendPacket(u8* data, int len)
+{
+    return 0;
+}
+
+int LAN_RecvPacket(u8* data)
+{
+    return 0;
+}
+
+
+void Camera_Start(int num)
+{
+}
+
+void Camera_Stop(int num)
+{
+}
+
+void Camera_CaptureFrame(int num, u32* frame, int width, int height, bool yuv)
+{
+    // black frame
+    u32 fill = yuv ? 0x80008000 : 0xFF000000;
+    int len = yuv ? (width*height)/2 : width*height;
+    for (int i = 0; i < len; i++)
+        frame[i] = fill;
+}
+
+}
@@ -0,0 +1,889 @@
+/*
+    Copyright 2016-2022 melonDS team
+
+    This file is part of melonDS.
+
+    melonDS is free software: you can redistribute it and/or modify it under
+    the terms of the GNU General Public License as published by the Free
+    Software Foundation, either version 3 of the License, or (at your option)
+    any later version.
+
+    melonDS is distributed in the hope that it will be useful, but WITHOUT ANY
+    WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+    FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with melonDS. If not, see http://www.gnu.org/licenses/.
+*/
+
+// headless batch runner
+// runs a ROM for a given amount of frames as fast as possible, without
+// any window or audio device, and reports how fast it went.
+// framebuffer hashes can be printed to check that a change didn't
+// alter the output, and the audio output can be dumped to a WAV file.
+//
+// in benchmark mode, every ROM of a suite is run once per CPU core
+// configuration (interpreter, JIT, JIT with fastmem), optionally replaying
+// an input movie, and the time spent in each subsystem is reported when
+// built with ENABLE_PROFILING.
+//
+// with --boot-menu, the DSi is booted without a cart to see how long it takes
+// to get to the system menu, the time spent reading the NAND is reported apart.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "Config.h"
+#include "Platform.h"
+#include "NDS.h"
+#include "GPU.h"
+#include "SPU.h"
+#include "RTC.h"
+#include "Profiler.h"
+#include "xxhash/xxhash.h"
+
+#ifdef JIT_ENABLED
+#include "ARMJIT.h"
+#include "ARMJIT_Profiler.h"
+#endif
+
+
+bool StopRequested = false;
+
+void emuStop()
+{
+    StopRequested = true;
+}
+
+
+// input movie: a text file with one line per input change
+//   <frame> <keys> [<touch x> <touch y>]
+// keys being '-' for none or a list of key names joined with '+'
+// (A, B, Select, Start, Right, Left, Up, Down, R, L, X, Y).
+// inputs are held until the next line, lines starting with '#' are ignored.
+
+struct MovieEvent
+{
+    u32 Frame;
+    u32 KeyMask;
+    bool Touch;
+    u16 TouchX, TouchY;
+};
+
+const char* KeyNames[12] = {"A", "B", "Select", "Start", "Right", "Left", "Up", "Down", "R", "L", "X", "Y"};
+
+bool LoadMovie(const std::string& path, std::vector<MovieEvent>& movie)
+{
+    FILE* f = Platform::OpenFile(path, "r", true);
+    if (!f) return false;
+
+    char line[256];
+    int linenum = 0;
+    while (fgets(line, sizeof(line), f))
+    {
+        linenum++;
+        if (line[0] == '#' || line[0] == '\n' || line[0] == '\r')
+            continue;
+
+        MovieEvent evt;
+        char keys[128];
+        int x, y;
+        int num = sscanf(line, "%u %127s %d %d", &evt.Frame, keys, &x, &y);
+        if (num < 2)
+        {
+            fprintf(stderr, "%s:%d: invalid movie line\n", path.c_str(), linenum);
+            fclose(f);
+            return false;
+        }
+
+        evt.KeyMask = 0xFFF;
+        if (strcmp(keys, "-"))
+        {
+            char* tok = strtok(keys, "+");
+            while (tok)
+            {
+                int key;
+                for (key = 0; key < 12; key++)
+                {
+                    if (!strcmp(tok, KeyNames[key])) break;
+                }
+                if (key == 12)
+                {
+                    fprintf(stderr, "%s:%d: unknown key %s\n", path.c_str(), linenum, tok);
+                    fclose(f);
+                    return false;
+                }
+
+                evt.KeyMask &= ~(1 << key);
+                tok = strtok(nullptr, "+");
+            }
+        }
+
+        evt.Touch = (num == 4);
+        evt.TouchX = evt.Touch ? x : 0;
+        evt.TouchY = evt.Touch ? y : 0;
+
+        if (!movie.empty() && evt.Frame < movie.back().Frame)
+        {
+            fprintf(stderr, "%s:%d: frames must be in order\n", path.c_str(), linenum);
+            fclose(f);
+            return false;
+        }
+
+        movie.push_back(evt);
+    }
+
+    fclose(f);
+    return true;
+}
+
+
+struct RunParams
+{
+    // empty to boot without a cart
+    std::string ROMPath;
+    std::string MoviePath;
+    u32 NumFrames = 3600;
+    u32 HashEvery = 0;
+    std::string AudioPath;
+};
+
+struct RunResult
+{
+    u32 Frames;
+    double Seconds;
+    // resetting and loading the cart, which includes the DSi NAND setup
+    double ResetSeconds;
+    u64 Events;
+    u64 Hash;
+    u64 SectionTime[Profiler::Section_MAX];
+    u64 CounterValue[Profiler::Counter_MAX];
+    u32 JITCodeUsed = 0;
+    u32 JITCodeSize = 0;
+};
+
+struct BenchMode
+{
+    const char* Name;
+    bool JIT;
+    bool FastMemory;
+};
+
+const BenchMode BenchModes[] =
+{
+    {"interpreter", false, false},
+#ifdef JIT_ENABLED
+    {"jit", true, false},
+    {"jit+fastmem", true, true},
+#endif
+};
+
+
+void PrintUsage(const char* argv0)
+{
+    printf("usage: %s [options] <rom.nds>\n", argv0);
+    printf("       %s [options] --suite <suite.txt>\n", argv0);
+    printf("       %s [options] --boot-menu\n", argv0);
+    printf("\n");
+    printf("  --frames <n>           number of frames to run (default: 3600)\n");
+    printf("  --hash-every <n>       print a framebuffer hash every n frames (default: 0, only the last frame)\n");
+    printf("  --audio-out <file>     dump the audio output to a WAV file\n");
+    printf("  --movie <file>         replay an input movie\n");
+    printf("  --rtc-time <time>      UNIX time the RTC starts at (default: 946684800, 2000-01-01)\n");
+    printf("  --rtc-host             use the host clock for the RTC, runs won't be repeatable\n");
+    printf("\n");
+    printf("  --bench                run once per CPU configuration and compare\n");
+    printf("  --bench-scheduler      measure the event scheduler on its own with a synthetic load\n");
+    printf("  --suite <file>         benchmark every ROM listed in a file, one per line as\n");
+    printf("                         <rom> [<frames> [<movie>]], paths relative to the file\n");
+    printf("\n");
+    printf("  --dsi                  emulate a DSi instead of a DS\n");
+    printf("  --bios9 <file>         DS ARM9 BIOS (enables external BIOS/firmware)\n");
+    printf("  --bios7 <file>         DS ARM7 BIOS\n");
+    printf("  --firmware <file>      DS firmware\n");
+    printf("  --dsi-bios9 <file>     DSi ARM9 BIOS\n");
+    printf("  --dsi-bios7 <file>     DSi ARM7 BIOS\n");
+    printf("  --dsi-firmware <file>  DSi firmware\n");
+    printf("  --dsi-nand <file>      DSi NAND image\n");
+    printf("  --firmware-boot        boot through the firmware instead of booting the game directly\n");
+    printf("  --boot-menu            boot the DSi to its system menu without a cart, --frames\n");
+    printf("                         should cover the boot. needs the DSi BIOS, firmware and NAND\n");
+    printf("  --dsp-thread           run the DSi DSP on a separate thread, runs won't be repeatable\n");
+    printf("  --dsp-sync-window <n>  how many cycles the DSP thread may run ahead (default: 16384)\n");
+    printf("\n");
+#ifdef JIT_ENABLED
+    printf("  --jit                  enable the JIT recompiler\n");
+    printf("  --jit-block-size <n>   maximum JIT block size (default: 32)\n");
+    printf("  --no-fastmem           disable JIT fast memory\n");
+    printf("  --jit-cache-size <n>   JIT code cache size in MB, 4-32 (default: 32)\n");
+    printf("  --jit-disk-cache       keep analysed JIT blocks in a file per game\n");
+    printf("  --jit-async            compile JIT blocks on a separate thread, runs won't be repeatable\n");
+    printf("  --jit-profile          count how often each JIT block runs and list the hottest ones\n");
+    printf("  --jit-perf-map         write /tmp/perf-<pid>.map so perf can tell the JIT blocks apart\n");
+    printf("\n");
+#endif
+    printf("  --threads3d <n>        number of 3D rasterizer threads, 0 to render on the emu thread (default: 1)\n");
+    printf("  --threaded2d           render 2D scanlines on a separate thread\n");
+    printf("  --interp <n>           audio interpolation (0-3)\n");
+    printf("  --verbose              print core log messages\n");
+}
+
+bool ParseArgs(int argc, char** argv, RunParams& params, bool& bench, bool& benchScheduler, std::string& suitePath, s64& rtcTime)
+{
+    bool bootMenu = false;
+
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+
+        // options which take a value
+        const char* val = nullptr;
+        if (arg == "--frames" || arg == "--hash-every" || arg == "--audio-out" ||
+            arg == "--movie" || arg == "--rtc-time" || arg == "--suite" ||
+            arg == "--bios9" || arg == "--bios7" || arg == "--firmware" ||
+            arg == "--dsi-bios9" || arg == "--dsi-bios7" || arg == "--dsi-firmware" || arg == "--dsi-nand" ||
+            arg == "--jit-block-size" || arg == "--jit-cache-size" || arg == "--threads3d" || arg == "--interp" ||
+            arg == "--dsp-sync-window")
+        {
+            if (i+1 >= argc)
+            {
+                fprintf(stderr, "%s needs a value\n", arg.c_str());
+                return false;
+            }
+            val = argv[++i];
+        }
+
+        if      (arg == "--frames")       params.NumFrames = strtoul(val, nullptr, 0);
+        else if (arg == "--hash-every")   params.HashEvery = strtoul(val, nullptr, 0);
+        else if (arg == "--audio-out")    params.AudioPath = val;
+        else if (arg == "--movie")        params.MoviePath = val;
+        else if (arg == "--rtc-time")     rtcTime = strtoll(val, nullptr, 0);
+        else if (arg == "--rtc-host")     rtcTime = -1;
+        else if (arg == "--bench")        bench = true;
+        else if (arg == "--bench-scheduler") benchScheduler = true;
+        else if (arg == "--suite")        { suitePath = val; bench = true; }
+        else if (arg == "--dsi")          Config::ConsoleType = 1;
+        else if (arg == "--bios9")        { Config::BIOS9Path = val; Config::ExternalBIOSEnable = true; }
+        else if (arg == "--bios7")        { Config::BIOS7Path = val; Config::ExternalBIOSEnable = true; }
+        else if (arg == "--firmware")     { Config::FirmwarePath = val; Config::ExternalBIOSEnable = true; }
+        else if (arg == "--dsi-bios9")    Config::DSiBIOS9Path = val;
+        else if (arg == "--dsi-bios7")    Config::DSiBIOS7Path = val;
+        else if (arg == "--dsi-firmware") Config::DSiFirmwarePath = val;
+        else if (arg == "--dsi-nand")     Config::DSiNANDPath = val;
+        else if (arg == "--firmware-boot") Config::DirectBoot = false;
+        else if (arg == "--boot-menu")    { bootMenu = true; Config::ConsoleType = 1; Config::DirectBoot = false; }
+        else if (arg == "--dsp-thread")   Config::DSiDSPThreaded = true;
+        else if (arg == "--dsp-sync-window") Config::DSiDSPSyncWindow = atoi(val);
+#ifdef JIT_ENABLED
+        else if (arg == "--jit")          Config::JIT_Enable = true;
+        else if (arg == "--jit-block-size") Config::JIT_MaxBlockSize = atoi(val);
+        else if (arg == "--no-fastmem")   Config::JIT_FastMemory = false;
+        else if (arg == "--jit-cache-size") Config::JIT_CodeCacheSize = atoi(val);
+        else if (arg == "--jit-disk-cache") Config::JIT_DiskCache = true;
+        else if (arg == "--jit-async")    Config::JIT_AsyncCompile = true;
+        else if (arg == "--jit-profile")  Config::JIT_Profiler = true;
+        else if (arg == "--jit-perf-map") Config::JIT_PerfMap = true;
+#endif
+        else if (arg == "--threads3d")
+        {
+            Config::Threads3D = atoi(val);
+            Config::Threaded3D = Config::Threads3D > 0;
+        }
+        else if (arg == "--threaded2d")   Config::Threaded2D = true;
+        else if (arg == "--interp")       Config::AudioInterp = atoi(val);
+        else if (arg == "--verbose")      Config::LogLevel = Platform::Debug;
+        else if (arg == "--help" || arg == "-h") return false;
+        else if (arg[0] == '-')
+        {
+            fprintf(stderr, "unknown option %s\n", arg.c_str());
+            return false;
+        }
+        else
+            params.ROMPath = arg;
+    }
+
+    if (bootMenu && (!params.ROMPath.empty() || !suitePath.empty()))
+    {
+        fprintf(stderr, "--boot-menu doesn't take a ROM\n");
+        return false;
+    }
+
+    if (params.ROMPath.empty() && suitePath.empty() && !bootMenu && !benchScheduler)
+    {
+        fprintf(stderr, "no ROM given\n");
+        return false;
+    }
+
+    return true;
+}
+
+bool LoadSuite(const std::string& path, const RunParams& defaults, std::vector<RunParams>& suite)
+{
+    FILE* f = Platform::OpenFile(path, "r", true);
+    if (!f)
+    {
+        fprintf(stderr, "failed to open suite %s\n", path.c_str());
+        return false;
+    }
+
+    std::string basedir;
+    size_t sep = path.find_last_of("/\\");
+    if (sep != std::string::npos)
+        basedir = path.substr(0, sep + 1);
+
+    auto makePath = [&](const char* p) -> std::string
+    {
+        if (p[0] == '/' || p[0] == '\\' || (p[0] && p[1] == ':'))
+            return p;
+        return basedir + p;
+    };
+
+    char line[1024];
+    while (fgets(line, sizeof(line), f))
+    {
+        if (line[0] == '#') continue;
+
+        char rom[512], movie[512];
+        u32 frames;
+        int num = sscanf(line, "%511s %u %511s", rom, &frames, movie);
+        if (num < 1) continue;
+
+        RunParams params;
+        params.ROMPath = makePath(rom);
+        params.NumFrames = (num >= 2) ? frames : defaults.NumFrames;
+        if (num >= 3) params.MoviePath = makePath(movie);
+        params.HashEvery = defaults.HashEvery;
+
+        suite.push_back(params);
+    }
+
+    fclose(f);
+    return true;
+}
+
+u8* LoadFile(const std::string& path, u32& len)
+{
+    FILE* f = Platform::OpenFile(path, "rb", true);
+    if (!f) return nullptr;
+
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    if (size <= 0)
+    {
+        fclose(f);
+        return nullptr;
+    }
+
+    u8* data = new u8[size];
+    len = (u32)fread(data, 1, size, f);
+    fclose(f);
+
+    return data;
+}
+
+u64 HashFramebuffer()
+{
+    // both screens, top then bottom
+    XXH64_state_t* state = XXH64_createState();
+    XXH64_reset(state, 0);
+    XXH64_update(state, GPU::Framebuffer[GPU::FrontBuffer][0], 256*192*4);
+    XXH64_update(state, GPU::Framebuffer[GPU::FrontBuffer][1], 256*192*4);
+    u64 hash = XXH64_digest(state);
+    XXH64_freeState(state);
+
+    return hash;
+}
+
+
+// minimal 16-bit stereo WAV writer, the header is completed on close
+
+FILE* WAVOpen(const std::string& path)
+{
+    FILE* f = fopen(path.c_str(), "wb");
+    if (!f) return nullptr;
+
+    u8 header[44] = {0};
+    fwrite(header, sizeof(header), 1, f);
+    return f;
+}
+
+void WAVClose(FILE* f, u32 numSamples)
+{
+    const u32 rate = 32824; // 1024 ARM7 cycles per sample
+    u32 datalen = numSamples * 4;
+
+    u8 header[44];
+    auto put16 = [&](int pos, u16 v) { header[pos] = v & 0xFF; header[pos+1] = v >> 8; };
+    auto put32 = [&](int pos, u32 v) { put16(pos, v & 0xFFFF); put16(pos+2, v >> 16); };
+
+    memcpy(&header[0], "RIFF", 4);
+    put32(4, 36 + datalen);
+    memcpy(&header[8], "WAVEfmt ", 8);
+    put32(16, 16);
+    put16(20, 1);
+    put16(22, 2);
+    put32(24, rate);
+    put32(28, rate * 4);
+    put16(32, 4);
+    put16(34, 16);
+    memcpy(&header[36], "data", 4);
+    put32(40, datalen);
+
+    fseek(f, 0, SEEK_SET);
+    fwrite(header, sizeof(header), 1, f);
+    fclose(f);
+}
+
+
+bool RunROM(const RunParams& params, RunResult& result)
+{
+    std::vector<MovieEvent> movie;
+    if (!params.MoviePath.empty() && !LoadMovie(params.MoviePath, movie))
+    {
+        fprintf(stderr, "failed to load movie %s\n", params.MoviePath.c_str());
+        return false;
+    }
+
+    bool hasCart = !params.ROMPath.empty();
+
+    u32 romLen = 0;
+    u8* romData = nullptr;
+    if (hasCart)
+        romData = LoadFile(params.ROMPath, romLen);
+    if (hasCart && !romData)
+    {
+        fprintf(stderr, "failed to load ROM %s\n", params.ROMPath.c_str());
+        return false;
+    }
+
+    std::string romName = params.ROMPath.substr(params.ROMPath.find_last_of("/\\") + 1);
+
+    auto resetStartTime = std::chrono::steady_clock::now();
+
+    NDS::SetConsoleType(Config::ConsoleType);
+    NDS::EjectCart();
+    NDS::Reset();
+
+    if (hasCart)
+    {
+        bool res = NDS::LoadCart(romData, romLen, nullptr, 0);
+        delete[] romData;
+        if (!res)
+        {
+            fprintf(stderr, "failed to load ROM %s\n", params.ROMPath.c_str());
+            return false;
+        }
+
+        if (Config::DirectBoot || NDS::NeedsDirectBoot())
+            NDS::SetupDirectBoot(romName);
+    }
+
+    result.ResetSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - resetStartTime).count();
+
+    NDS::SetKeyMask(0xFFF);
+    NDS::ReleaseScreen();
+
+    SPU::InitOutput();
+
+    StopRequested = false;
+    NDS::Start();
+
+    FILE* audioFile = nullptr;
+    u32 numSamples = 0;
+    if (!params.AudioPath.empty())
+    {
+        audioFile = WAVOpen(params.AudioPath);
+        if (!audioFile)
+            fprintf(stderr, "failed to open %s, audio will not be dumped\n", params.AudioPath.c_str());
+    }
+
+    size_t movieEvent = 0;
+
+    Profiler::Reset();
+    u64 startEvents = NDS::NumSchedEvents;
+    auto startTime = std::chrono::steady_clock::now();
+
+    u32 frame;
+    for (frame = 0; frame < params.NumFrames && !StopRequested; frame++)
+    {
+        while (movieEvent < movie.size() && movie[movieEvent].Frame <= frame)
+        {
+            const MovieEvent& evt = movie[movieEvent++];
+
+            NDS::SetKeyMask(evt.KeyMask);
+            if (evt.Touch)
+                NDS::TouchScreen(evt.TouchX, evt.TouchY);
+            else
+                NDS::ReleaseScreen();
+        }
+
+        NDS::RunFrame();
+
+        if (params.HashEvery && ((frame+1) % params.HashEvery) == 0)
+            printf("frame %u: %016llx\n", frame+1, (unsigned long long)HashFramebuffer());
+
+        if (audioFile)
+        {
+            s16 buf[1024 * 2];
+            int num;
+            while ((num = SPU::ReadOutput(buf, 1024)) > 0)
+            {
+                fwrite(buf, num * 4, 1, audioFile);
+                numSamples += num;
+            }
+        }
+        else
+        {
+            // keep the output buffer from filling up
+            SPU::InitOutput();
+        }
+    }
+
+    auto endTime = std::chrono::steady_clock::now();
+
+    result.Frames = frame;
+    result.Seconds = std::chrono::duration<double>(endTime - startTime).count();
+    result.Events = NDS::NumSchedEvents - startEvents;
+    result.Hash = HashFramebuffer();
+    Profiler::GetTimes(result.SectionTime);
+    Profiler::GetCounts(result.CounterValue);
+#ifdef JIT_ENABLED
+    if (Config::JIT_Enable)
+        ARMJIT::GetCodeCacheUsage(result.JITCodeUsed, result.JITCodeSize);
+#endif
+
+    if (audioFile)
+        WAVClose(audioFile, numSamples);
+
+    NDS::Stop();
+    return true;
+}
+
+void PrintSectionTimes(const RunResult& result)
+{
+    if (!Profiler::Enabled || !result.Frames)
+        return;
+
+    printf("time per frame:");
+    for (int i = 0; i < Profiler::Section_MAX; i++)
+        printf("  %s %.3f ms", Profiler::SectionNames[i], result.SectionTime[i] / (1000000.0 * result.Frames));
+    printf("\n");
+
+    printf("per frame:");
+    for (int i = 0; i < Profiler::Counter_MAX; i++)
+        printf("  %s %.1f", Profiler::CounterNames[i], result.CounterValue[i] / (double)result.Frames);
+    printf("\n");
+}
+
+#ifdef JIT_ENABLED
+void PrintJITProfile()
+{
+    std::vector<ARMJIT_Profiler::BlockStats> blocks;
+    ARMJIT_Profiler::GetBlockStats(blocks);
+
+    u64 totalExecutions = 0, totalCompileTime = 0;
+    u32 totalCompiles = 0;
+    for (const auto& block : blocks)
+    {
+        totalExecutions += block.Executions;
+        totalCompiles += block.Compiles;
+        totalCompileTime += block.CompileTime;
+    }
+    printf("JIT blocks: %u addresses, %llu executions, %u compiles taking %.3f ms\n",
+           (u32)blocks.size(), (unsigned long long)totalExecutions, totalCompiles, totalCompileTime / 1000000.0);
+
+    for (size_t i = 0; i < blocks.size() && i < 20; i++)
+    {
+        const auto& block = blocks[i];
+        printf("  ARM%d %08X %-5s %2u instrs %12llu runs (%5.2f%%) %4u compiles %8.1f us %5u bytes\n",
+               block.Num == 0 ? 9 : 7, block.Addr, block.Thumb ? "Thumb" : "ARM", block.NumInstrs,
+               (unsigned long long)block.Executions, block.Executions * 100.0 / std::max<u64>(totalExecutions, 1),
+               block.Compiles, block.CompileTime / 1000.0, block.CodeSize);
+    }
+
+    std::vector<ARMJIT_Profiler::RangeStats> ranges;
+    ARMJIT_Profiler::GetRangeStats(ranges);
+    if (ranges.empty())
+        return;
+
+    printf("most invalidated code ranges:\n");
+    for (size_t i = 0; i < ranges.size() && i < 10; i++)
+    {
+        printf("  %s+%07X %u invalidations\n",
+               ARMJIT_Profiler::RegionName(ranges[i].LocalAddr >> 27), ranges[i].LocalAddr & 0x7FFFFFF,
+               ranges[i].Invalidations);
+    }
+}
+#endif
+
+bool RunBenchmark(const std::vector<RunParams>& suite)
+{
+    bool ok = true;
+
+    if (!Profiler::Enabled)
+        printf("built without ENABLE_PROFILING, only reporting FPS\n");
+
+    for (const RunParams& params : suite)
+    {
+        printf("\n%s, %u frames", params.ROMPath.empty() ? "system menu boot" : params.ROMPath.c_str(), params.NumFrames);
+        if (!params.MoviePath.empty())
+            printf(", movie %s", params.MoviePath.c_str());
+        printf("\n");
+
+        printf("%-12s %9s %17s", "mode", "FPS", "hash");
+        if (Profiler::Enabled)
+        {
+            for (int i = 0; i < Profiler::Section_MAX; i++)
+                printf(" %12s", Profiler::SectionNames[i]);
+        }
+        printf("\n");
+
+        for (const BenchMode& mode : BenchModes)
+        {
+            Config::JIT_Enable = mode.JIT;
+            Config::JIT_FastMemory = mode.FastMemory;
+
+            RunResult result;
+            if (!RunROM(params, result))
+            {
+                ok = false;
+                break;
+            }
+
+            printf("%-12s %9.2f  %016llx", mode.Name,
+                   result.Frames / result.Seconds, (unsigned long long)result.Hash);
+            if (Profiler::Enabled)
+            {
+                // milliseconds per frame
+                for (int i = 0; i < Profiler::Section_MAX; i++)
+                    printf(" %12.3f", result.SectionTime[i] / (1000000.0 * result.Frames));
+            }
+            printf("\n");
+        }
+    }
+
+    return ok;
+}
+
+// a synthetic load for the event scheduler, roughly what a game keeps it
+// busy with: the LCD, the SPU and timers firing regularly, the divider,
+// square root unit and ROM transfers started every so often, and timers
+// which get reprogrammed
+struct SchedBenchEventInfo
+{
+    u32 Period;
+    bool Periodic;
+};
+
+const SchedBenchEventInfo SchedBenchEvents[] =
+{
+    {1065, true},   // LCD, HBlank start and end
+    {1024, true},   // SPU
+    {2048, true},
+    {256, true},    // timers
+    {4096, true},
+    {34, false},    // divider
+    {13, false},    // square root
+    {512, false},   // ROM transfer
+};
+constexpr u32 NumSchedBenchEvents = sizeof(SchedBenchEvents) / sizeof(SchedBenchEvents[0]);
+constexpr u32 NumSchedBenchPeriodic = 5;
+
+u64 SchedBenchTimestamps[NumSchedBenchEvents];
+u32 SchedBenchRandom;
+
+u32 SchedBenchNextRandom()
+{
+    // xorshift32, so every run does the same
+    SchedBenchRandom ^= SchedBenchRandom << 13;
+    SchedBenchRandom ^= SchedBenchRandom >> 17;
+    SchedBenchRandom ^= SchedBenchRandom << 5;
+    return SchedBenchRandom;
+}
+
+void SchedBenchEvent(u32 id);
+
+void SchedBenchStart(u32 id, u64 timestamp)
+{
+    SchedBenchTimestamps[id] = timestamp;
+    NDS::ScheduleEvent(id, timestamp, SchedBenchEvent, id);
+}
+
+void SchedBenchEvent(u32 id)
+{
+    u64 now = SchedBenchTimestamps[id];
+    if (SchedBenchEvents[id].Periodic)
+        SchedBenchStart(id, now + SchedBenchEvents[id].Period);
+
+    u32 random = SchedBenchNextRandom();
+    if ((random & 0x7) == 0)
+    {
+        // the game starts something
+        u32 other = NumSchedBenchPeriodic + (random >> 8) % (NumSchedBenchEvents - NumSchedBenchPeriodic);
+        NDS::CancelEvent(other);
+        SchedBenchStart(other, now + SchedBenchEvents[other].Period);
+    }
+    else if ((random & 0x3F) == 1)
+    {
+        // or reprograms a timer
+        u32 other = (random >> 8) % NumSchedBenchPeriodic;
+        NDS::CancelEvent(other);
+        SchedBenchStart(other, now + 1 + (random >> 16) % SchedBenchEvents[other].Period);
+    }
+}
+
+bool RunSchedulerBenchmark()
+{
+    static_assert(NumSchedBenchEvents <= NDS::Event_MAX, "too many events for the scheduler");
+    static_assert(NumSchedBenchPeriodic <= NumSchedBenchEvents, "the periodic events come first");
+
+    NDS::SetConsoleType(Config::ConsoleType);
+    NDS::Reset();
+
+    // take over the scheduler, the system isn't run
+    for (u32 i = 0; i < NDS::Event_MAX; i++)
+        NDS::CancelEvent(i);
+    for (u32 i = 0; i < NumSchedBenchPeriodic; i++)
+        SchedBenchStart(i, SchedBenchEvents[i].Period);
+    SchedBenchRandom = 0x12345678;
+
+    // about a minute of emulated time
+    const u64 numCycles = 33513982ULL * 60;
+
+    u64 steps = 0;
+    u64 startEvents = NDS::NumSchedEvents;
+    auto startTime = std::chrono::steady_clock::now();
+
+    u64 timestamp = 0;
+    while (timestamp < numCycles)
+    {
+        // the CPUs often stop short of the target, on a halt or an IRQ
+        u64 target = NDS::NextTarget();
+        if ((SchedBenchNextRandom() & 0x1) && target > timestamp + 1)
+            timestamp += 1 + SchedBenchNextRandom() % (target - timestamp - 1);
+        else
+            timestamp = std::max(target, timestamp);
+
+        NDS::RunSystem(timestamp);
+        steps++;
+    }
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+    u64 events = NDS::NumSchedEvents - startEvents;
+
+    printf("%llu scheduler steps, %llu events in %.3f s\n",
+           (unsigned long long)steps, (unsigned long long)events, seconds);
+    printf("%.1f ns per step, %.0f events/s\n", seconds * 1e9 / steps, events / seconds);
+
+    return true;
+}
+
+// how long NDS::Init() took, which is most of the startup time
+double InitSeconds = 0;
+
+bool InitCore(s64 rtcTime)
+{
+    auto startTime = std::chrono::steady_clock::now();
+    if (!NDS::Init())
+    {
+        fprintf(stderr, "failed to initialize the emulator core\n");
+        return false;
+    }
+    InitSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+
+    GPU::RenderSettings videoSettings;
+    videoSettings.Soft_Threaded = Config::Threaded3D;
+    videoSettings.Soft_NumThreads = Config::Threads3D;
+    videoSettings.Threaded2D = Config::Threaded2D;
+    videoSettings.GL_ScaleFactor = 1;
+    videoSettings.GL_BetterPolygons = false;
+
+    GPU::InitRenderer(0);
+    GPU::SetRenderSettings(0, videoSettings);
+
+    SPU::SetInterpolation(Config::AudioInterp);
+    RTC::SetFixedTime(rtcTime);
+
+    return true;
+}
+
+void DeInitCore()
+{
+    GPU::DeInitRenderer();
+    NDS::DeInit();
+}
+
+
+
+int main(int argc, char** argv)
+{
+    RunParams params;
+    bool bench = false;
+    bool benchScheduler = false;
+    std::string suitePath;
+    s64 rtcTime = 946684800;
+
+    if (!ParseArgs(argc, argv, params, bench, benchScheduler, suitePath, rtcTime))
+    {
+        PrintUsage(argv[0]);
+        return 1;
+    }
+
+    std::vector<RunParams> suite;
+    if (!suitePath.empty())
+    {
+        if (!LoadSuite(suitePath, params, suite))
+            return 1;
+    }
+    else
+        suite.push_back(params);
+
+    Platform::Init(argc, argv);
+
+    if (!InitCore(rtcTime))
+        return 1;
+
+    bool ok;
+    if (benchScheduler)
+    {
+        ok = RunSchedulerBenchmark();
+    }
+    else if (bench)
+    {
+        ok = RunBenchmark(suite);
+    }
+    else
+    {
+        RunResult result;
+        ok = RunROM(params, result);
+        if (ok)
+        {
+            printf("final frame hash: %016llx\n", (unsigned long long)result.Hash);
+            printf("%u frames in %.3f s: %.2f FPS (%.1f%% of realtime)\n",
+                   result.Frames, result.Seconds, result.Frames / result.Seconds,
+                   (result.Frames / result.Seconds) * 100.0 / 59.8261);
+            printf("%llu scheduler events: %.0f events/s\n",
+                   (unsigned long long)result.Events, result.Events / result.Seconds);
+            printf("core initialized in %.1f ms, reset in %.1f ms\n", InitSeconds * 1000.0, result.ResetSeconds * 1000.0);
+            PrintSectionTimes(result);
+            if (result.JITCodeSize)
+                printf("JIT code cache: %u of %u KB used\n", result.JITCodeUsed / 1024, result.JITCodeSize / 1024);
+#ifdef JIT_ENABLED
+            if (Config::JIT_Enable && Config::JIT_Profiler)
+                PrintJITProfile();
+#endif
+        }
+    }
+
+    DeInitCore();
+    Platform::DeInit();
+
+    return ok ? 0 : 1;
+}
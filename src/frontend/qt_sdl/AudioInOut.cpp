@@ -75,7 +75,7 @@ void AudioCallback(void* data, Uint8* stream, int len)
         num_in = len_in-margin;
     }
 
-    Frontend::AudioOut_Resample(buf_in, num_in, (s16*)stream, len, Config::AudioVolume);
+    Frontend::AudioOut_Resample(buf_in, num_in, (s16*)stream, len, Config::AudioVolume, Config::AudioInterp);
 }
 
 void MicCallback(void* data, Uint8* stream, int len)
@@ -54,13 +54,22 @@ int ScreenVSyncInterval;
 
 int _3DRenderer;
 bool Threaded3D;
+int Threads3D;
+bool Threaded2D;
 
 int GL_ScaleFactor;
 bool GL_BetterPolygons;
 
 bool LimitFPS;
 bool AudioSync;
+
+bool RewindEnable;
+int RewindInterval;
+int RewindBufferSize;
+
 bool ShowOSD;
+bool ShowProfiler;
+std::string ProfilerDumpPath;
 
 int ConsoleType;
 bool DirectBoot;
@@ -71,6 +80,11 @@ int JIT_MaxBlockSize = 32;
 bool JIT_BranchOptimisations = true;
 bool JIT_LiteralOptimisations = true;
 bool JIT_FastMemory = true;
+int JIT_CodeCacheSize = 32;
+bool JIT_DiskCache = false;
+bool JIT_AsyncCompile = false;
+bool JIT_Profiler = false;
+bool JIT_PerfMap = false;
 #endif
 
 bool ExternalBIOSEnable;
@@ -144,6 +158,8 @@ int DSiBatteryLevel;
 bool DSiBatteryCharging;
 
 bool DSiFullBIOSBoot;
+bool DSiDSPThreaded;
+int DSiDSPSyncWindow;
 
 CameraConfig Camera[2];
 
@@ -194,6 +210,7 @@ ConfigEntry ConfigFile[] =
     {"HKKey_PowerButton",         0, &HKKeyMapping[HK_PowerButton],         -1, true},
     {"HKKey_VolumeUp",            0, &HKKeyMapping[HK_VolumeUp],            -1, true},
     {"HKKey_VolumeDown",          0, &HKKeyMapping[HK_VolumeDown],          -1, true},
+    {"HKKey_Rewind",              0, &HKKeyMapping[HK_Rewind],              -1, true},
 
     {"HKJoy_Lid",                 0, &HKJoyMapping[HK_Lid],                 -1, true},
     {"HKJoy_Mic",                 0, &HKJoyMapping[HK_Mic],                 -1, true},
@@ -210,6 +227,7 @@ ConfigEntry ConfigFile[] =
     {"HKJoy_PowerButton",         0, &HKJoyMapping[HK_PowerButton],         -1, true},
     {"HKJoy_VolumeUp",            0, &HKJoyMapping[HK_VolumeUp],            -1, true},
     {"HKJoy_VolumeDown",          0, &HKJoyMapping[HK_VolumeDown],          -1, true},
+    {"HKJoy_Rewind",              0, &HKJoyMapping[HK_Rewind],              -1, true},
 
     {"JoystickID", 0, &JoystickID, 0, true},
 
@@ -233,13 +251,22 @@ ConfigEntry ConfigFile[] =
 
     {"3DRenderer", 0, &_3DRenderer, 0, false},
     {"Threaded3D", 1, &Threaded3D, true, false},
+    {"Threads3D", 0, &Threads3D, 1, false},
+    {"Threaded2D", 1, &Threaded2D, false, false},
 
     {"GL_ScaleFactor", 0, &GL_ScaleFactor, 1, false},
     {"GL_BetterPolygons", 1, &GL_BetterPolygons, false, false},
 
     {"LimitFPS", 1, &LimitFPS, true, false},
     {"AudioSync", 1, &AudioSync, false},
+
+    {"RewindEnable", 1, &RewindEnable, false, false},
+    {"RewindInterval", 0, &RewindInterval, 1, false},
+    {"RewindBufferSize", 0, &RewindBufferSize, 64, false},
+
     {"ShowOSD", 1, &ShowOSD, true, false},
+    {"ShowProfiler", 1, &ShowProfiler, false, false},
+    {"ProfilerDumpPath", 2, &ProfilerDumpPath, (std::string)"", false},
 
     {"ConsoleType", 0, &ConsoleType, 0, false},
     {"DirectBoot", 1, &DirectBoot, true, false},
@@ -254,6 +281,11 @@ ConfigEntry ConfigFile[] =
     #else
         {"JIT_FastMemory", 1, &JIT_FastMemory, true, false},
     #endif
+    {"JIT_CodeCacheSize", 0, &JIT_CodeCacheSize, 32, false},
+    {"JIT_DiskCache", 1, &JIT_DiskCache, false, false},
+    {"JIT_AsyncCompile", 1, &JIT_AsyncCompile, false, false},
+    {"JIT_Profiler", 1, &JIT_Profiler, false, false},
+    {"JIT_PerfMap", 1, &JIT_PerfMap, false, false},
 #endif
 
     {"ExternalBIOSEnable", 1, &ExternalBIOSEnable, false, false},
@@ -335,6 +367,8 @@ ConfigEntry ConfigFile[] =
     {"DSiBatteryCharging", 1, &DSiBatteryCharging, true, true},
 
     {"DSiFullBIOSBoot", 1, &DSiFullBIOSBoot, false, true},
+    {"DSiDSPThreaded",   1, &DSiDSPThreaded,   false, false},
+    {"DSiDSPSyncWindow", 0, &DSiDSPSyncWindow, 16384, false},
 
     // TODO!!
     // we need a more elegant way to deal with this
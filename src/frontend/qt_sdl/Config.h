@@ -39,6 +39,7 @@ enum
     HK_PowerButton,
     HK_VolumeUp,
     HK_VolumeDown,
+    HK_Rewind,
     HK_MAX
 };
 
@@ -100,13 +101,22 @@ extern int ScreenVSyncInterval;
 
 extern int _3DRenderer;
 extern bool Threaded3D;
+extern int Threads3D;
+extern bool Threaded2D;
 
 extern int GL_ScaleFactor;
 extern bool GL_BetterPolygons;
 
 extern bool LimitFPS;
 extern bool AudioSync;
+
+extern bool RewindEnable;
+extern int RewindInterval;
+extern int RewindBufferSize;
+
 extern bool ShowOSD;
+extern bool ShowProfiler;
+extern std::string ProfilerDumpPath;
 
 extern int ConsoleType;
 extern bool DirectBoot;
@@ -117,6 +127,11 @@ extern int JIT_MaxBlockSize;
 extern bool JIT_BranchOptimisations;
 extern bool JIT_LiteralOptimisations;
 extern bool JIT_FastMemory;
+extern int JIT_CodeCacheSize;
+extern bool JIT_DiskCache;
+extern bool JIT_AsyncCompile;
+extern bool JIT_Profiler;
+extern bool JIT_PerfMap;
 #endif
 
 extern bool ExternalBIOSEnable;
@@ -189,6 +204,8 @@ extern int DSiBatteryLevel;
 extern bool DSiBatteryCharging;
 
 extern bool DSiFullBIOSBoot;
+extern bool DSiDSPThreaded;
+extern int DSiDSPSyncWindow;
 
 extern CameraConfig Camera[2];
 
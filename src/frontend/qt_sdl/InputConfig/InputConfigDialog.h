@@ -47,6 +47,7 @@ static constexpr std::initializer_list<int> hk_general =
     HK_Reset,
     HK_FrameStep,
     HK_FastForward,
+    HK_Rewind,
     HK_FastForwardToggle,
     HK_FullscreenToggle,
     HK_Lid,
@@ -64,6 +65,7 @@ static constexpr std::initializer_list<const char*> hk_general_labels =
     "Reset",
     "Frame step",
     "Fast forward",
+    "Rewind",
     "Toggle FPS limit",
     "Toggle fullscreen",
     "Close/open lid",
@@ -45,6 +45,9 @@ struct Item
     char Text[256];
     u32 Color;
 
+    bool Pinned;  // doesn't expire
+    bool Discard; // to be removed on the next update
+
     u32 Width, Height;
     u32* Bitmap;
 
@@ -330,6 +333,8 @@ void AddMessage(u32 color, const char* text)
     item.Timestamp = SDL_GetTicks();
     strncpy(item.Text, text, 255); item.Text[255] = '\0';
     item.Color = color;
+    item.Pinned = false;
+    item.Discard = false;
     item.Bitmap = nullptr;
 
     item.NativeBitmapLoaded = false;
@@ -340,6 +345,40 @@ void AddMessage(u32 color, const char* text)
     Rendering.unlock();
 }
 
+void SetStats(u32 color, const char* const* lines, int numLines)
+{
+    Rendering.lock();
+
+    // textures can only be freed from Update(), so just flag the old ones
+    for (Item& item : ItemQueue)
+    {
+        if (item.Pinned) item.Discard = true;
+    }
+
+    // new items go in front, so add the lines from the last one
+    for (int i = numLines-1; i >= 0 && Config::ShowOSD; i--)
+    {
+        const char* text = lines[i];
+        if (text[0] == '\0') continue;
+
+        Item item;
+
+        item.Timestamp = SDL_GetTicks();
+        strncpy(item.Text, text, 255); item.Text[255] = '\0';
+        item.Color = color;
+        item.Pinned = true;
+        item.Discard = false;
+        item.Bitmap = nullptr;
+
+        item.NativeBitmapLoaded = false;
+        item.GLTextureLoaded = false;
+
+        ItemQueue.push_front(item);
+    }
+
+    Rendering.unlock();
+}
+
 void Update()
 {
     if (!Config::ShowOSD)
@@ -367,7 +406,7 @@ void Update()
     {
         Item& item = *it;
 
-        if (item.Timestamp < tick_min)
+        if (item.Discard || (!item.Pinned && item.Timestamp < tick_min))
         {
             if (item.GLTextureLoaded) glDeleteTextures(1, &item.GLTexture);
             if (item.Bitmap) delete[] item.Bitmap;
@@ -401,6 +440,12 @@ void DrawNative(QPainter& painter)
     {
         Item& item = *it;
 
+        if (item.Discard || !item.Bitmap)
+        {
+            it++;
+            continue;
+        }
+
         if (!item.NativeBitmapLoaded)
         {
             item.NativeBitmap = QImage((const uchar*)item.Bitmap, item.Width, item.Height, QImage::Format_ARGB32_Premultiplied);
@@ -442,6 +487,12 @@ void DrawGL(float w, float h)
     {
         Item& item = *it;
 
+        if (item.Discard || !item.Bitmap)
+        {
+            it++;
+            continue;
+        }
+
         if (!item.GLTextureLoaded)
         {
             glGenTextures(1, &item.GLTexture);
@@ -27,6 +27,10 @@ void DeInit();
 
 void AddMessage(u32 color, const char* text);
 
+// persistent lines of text shown above the messages, replaced on every call
+// passing no lines removes them
+void SetStats(u32 color, const char* const* lines, int numLines);
+
 void Update();
 void DrawNative(QPainter& painter);
 void DrawGL(float w, float h);
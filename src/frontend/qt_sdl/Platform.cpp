@@ -180,6 +180,7 @@ int GetConfigInt(ConfigEntry entry)
     {
 #ifdef JIT_ENABLED
     case JIT_MaxBlockSize: return Config::JIT_MaxBlockSize;
+    case JIT_CodeCacheSize: return Config::JIT_CodeCacheSize;
 #endif
 
     case DLDI_ImageSize: return imgsizes[Config::DLDISize];
@@ -192,6 +193,8 @@ int GetConfigInt(ConfigEntry entry)
     case Firm_Color: return Config::FirmwareFavouriteColour;
 
     case AudioBitDepth: return Config::AudioBitDepth;
+
+    case DSi_DSPSyncWindow: return Config::DSiDSPSyncWindow;
     }
 
     return 0;
@@ -206,6 +209,10 @@ bool GetConfigBool(ConfigEntry entry)
     case JIT_LiteralOptimizations: return Config::JIT_LiteralOptimisations != 0;
     case JIT_BranchOptimizations: return Config::JIT_BranchOptimisations != 0;
     case JIT_FastMemory: return Config::JIT_FastMemory != 0;
+    case JIT_DiskCache: return Config::JIT_DiskCache != 0;
+    case JIT_AsyncCompile: return Config::JIT_AsyncCompile != 0;
+    case JIT_Profiler: return Config::JIT_Profiler != 0;
+    case JIT_PerfMap: return Config::JIT_PerfMap != 0;
 #endif
 
     case ExternalBIOSEnable: return Config::ExternalBIOSEnable != 0;
@@ -220,6 +227,7 @@ bool GetConfigBool(ConfigEntry entry)
 
     case Firm_OverrideSettings: return Config::FirmwareOverrideSettings != 0;
     case DSi_FullBIOSBoot: return Config::DSiFullBIOSBoot != 0;
+    case DSi_DSPThreaded: return Config::DSiDSPThreaded != 0;
     }
 
     return false;
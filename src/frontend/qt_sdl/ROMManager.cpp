@@ -21,6 +21,7 @@
 
 #include <string>
 #include <utility>
+#include <algorithm>
 #include <fstream>
 
 #include <zstd.h>
@@ -32,6 +33,7 @@
 #include "Platform.h"
 
 #include "NDS.h"
+#include "Rewind.h"
 #include "DSi.h"
 #include "SPI.h"
 #include "DSi_I2C.h"
@@ -57,6 +59,9 @@ std::unique_ptr<Savestate> BackupState = nullptr;
 bool SavestateLoaded = false;
 std::string PreviousSaveFile = "";
 
+std::unique_ptr<RewindBuffer> Rewind = nullptr;
+int RewindFrameCount = 0;
+
 ARCodeFile* CheatFile = nullptr;
 bool CheatsOn = false;
 
@@ -359,6 +364,8 @@ bool LoadState(const std::string& filename)
         return false;
     }
 
+    ClearRewind();
+
     // The backup was made and the state was loaded, so we can store the backup now.
     BackupState = std::move(backup); // This will clean up any existing backup
     assert(backup == nullptr);
@@ -442,6 +449,44 @@ void UndoStateLoad()
     {
         NDSSave->SetPath(PreviousSaveFile, true);
     }
+
+    ClearRewind();
+}
+
+
+void RewindFrame()
+{
+    if (!Config::RewindEnable)
+    {
+        Rewind = nullptr;
+        return;
+    }
+
+    u64 maxmemory = (u64)Config::RewindBufferSize << 20;
+    if (!Rewind)
+        Rewind = std::make_unique<RewindBuffer>(maxmemory);
+    else
+        Rewind->SetMaxMemory(maxmemory);
+
+    if (++RewindFrameCount < std::max(Config::RewindInterval, 1))
+        return;
+
+    RewindFrameCount = 0;
+    Rewind->Push();
+}
+
+bool RewindStep()
+{
+    if (!Rewind) return false;
+
+    RewindFrameCount = 0;
+    return Rewind->Pop();
+}
+
+void ClearRewind()
+{
+    if (Rewind) Rewind->Clear();
+    RewindFrameCount = 0;
 }
 
 
@@ -494,6 +539,8 @@ void SetBatteryLevels()
 
 void Reset()
 {
+    ClearRewind();
+
     NDS::SetConsoleType(Config::ConsoleType);
     if (Config::ConsoleType == 1) EjectGBACart();
     NDS::Reset();
@@ -542,6 +589,8 @@ bool LoadBIOS()
     BaseROMName = "";
     BaseAssetName = "";*/
 
+    ClearRewind();
+
     NDS::Reset();
     SetBatteryLevels();
     return true;
@@ -734,6 +783,8 @@ bool LoadROM(QStringList filepath, bool reset)
     if (NDSSave) delete NDSSave;
     NDSSave = nullptr;
 
+    ClearRewind();
+
     BaseROMDir = basepath;
     BaseROMName = romname;
     BaseAssetName = romname.substr(0, romname.rfind('.'));
@@ -793,6 +844,8 @@ void EjectCart()
     if (NDSSave) delete NDSSave;
     NDSSave = nullptr;
 
+    ClearRewind();
+
     UnloadCheats();
 
     NDS::EjectCart();
@@ -54,6 +54,12 @@ bool LoadState(const std::string& filename);
 bool SaveState(const std::string& filename);
 void UndoStateLoad();
 
+// called after every emulated frame, takes rewind snapshots as configured
+void RewindFrame();
+// goes back to the last rewind snapshot
+bool RewindStep();
+void ClearRewind();
+
 void EnableCheats(bool enable);
 ARCodeFile* GetCheatFile();
 
@@ -46,6 +46,8 @@ VideoSettingsDialog::VideoSettingsDialog(QWidget* parent) : QDialog(parent), ui(
     oldVSync = Config::ScreenVSync;
     oldVSyncInterval = Config::ScreenVSyncInterval;
     oldSoftThreaded = Config::Threaded3D;
+    oldSoftThreads = Config::Threads3D;
+    oldThreaded2D = Config::Threaded2D;
     oldGLScale = Config::GL_ScaleFactor;
     oldGLBetterPolygons = Config::GL_BetterPolygons;
 
@@ -69,6 +71,8 @@ VideoSettingsDialog::VideoSettingsDialog(QWidget* parent) : QDialog(parent), ui(
     ui->sbVSyncInterval->setValue(Config::ScreenVSyncInterval);
 
     ui->cbSoftwareThreaded->setChecked(Config::Threaded3D != 0);
+    ui->sbSoftwareThreads->setValue(Config::Threads3D);
+    ui->cbThreaded2D->setChecked(Config::Threaded2D != 0);
 
     for (int i = 1; i <= 16; i++)
         ui->cbxGLResolution->addItem(QString("%1x native (%2x%3)").arg(i).arg(256*i).arg(192*i));
@@ -84,6 +88,8 @@ VideoSettingsDialog::VideoSettingsDialog(QWidget* parent) : QDialog(parent), ui(
     {
         ui->cbGLDisplay->setEnabled(true);
         ui->cbSoftwareThreaded->setEnabled(true);
+        ui->sbSoftwareThreads->setEnabled(Config::Threaded3D != 0);
+        ui->cbThreaded2D->setEnabled(true);
         ui->cbxGLResolution->setEnabled(false);
         ui->cbBetterPolygons->setEnabled(false);
     }
@@ -91,6 +97,8 @@ VideoSettingsDialog::VideoSettingsDialog(QWidget* parent) : QDialog(parent), ui(
     {
         ui->cbGLDisplay->setEnabled(false);
         ui->cbSoftwareThreaded->setEnabled(false);
+        ui->sbSoftwareThreads->setEnabled(false);
+        ui->cbThreaded2D->setEnabled(false);
         ui->cbxGLResolution->setEnabled(true);
         ui->cbBetterPolygons->setEnabled(true);
     }
@@ -117,6 +125,8 @@ void VideoSettingsDialog::on_VideoSettingsDialog_rejected()
     Config::ScreenVSync = oldVSync;
     Config::ScreenVSyncInterval = oldVSyncInterval;
     Config::Threaded3D = oldSoftThreaded;
+    Config::Threads3D = oldSoftThreads;
+    Config::Threaded2D = oldThreaded2D;
     Config::GL_ScaleFactor = oldGLScale;
     Config::GL_BetterPolygons = oldGLBetterPolygons;
 
@@ -141,6 +151,8 @@ void VideoSettingsDialog::onChange3DRenderer(int renderer)
     {
         ui->cbGLDisplay->setEnabled(true);
         ui->cbSoftwareThreaded->setEnabled(true);
+        ui->sbSoftwareThreads->setEnabled(Config::Threaded3D != 0);
+        ui->cbThreaded2D->setEnabled(true);
         ui->cbxGLResolution->setEnabled(false);
         ui->cbBetterPolygons->setEnabled(false);
     }
@@ -148,6 +160,8 @@ void VideoSettingsDialog::onChange3DRenderer(int renderer)
     {
         ui->cbGLDisplay->setEnabled(false);
         ui->cbSoftwareThreaded->setEnabled(false);
+        ui->sbSoftwareThreads->setEnabled(false);
+        ui->cbThreaded2D->setEnabled(false);
         ui->cbxGLResolution->setEnabled(true);
         ui->cbBetterPolygons->setEnabled(true);
     }
@@ -183,6 +197,21 @@ void VideoSettingsDialog::on_sbVSyncInterval_valueChanged(int val)
 void VideoSettingsDialog::on_cbSoftwareThreaded_stateChanged(int state)
 {
     Config::Threaded3D = (state != 0);
+    ui->sbSoftwareThreads->setEnabled(Config::Threaded3D != 0);
+
+    emit updateVideoSettings(false);
+}
+
+void VideoSettingsDialog::on_sbSoftwareThreads_valueChanged(int val)
+{
+    Config::Threads3D = val;
+
+    emit updateVideoSettings(false);
+}
+
+void VideoSettingsDialog::on_cbThreaded2D_stateChanged(int state)
+{
+    Config::Threaded2D = (state != 0);
 
     emit updateVideoSettings(false);
 }
@@ -67,6 +67,8 @@ private slots:
     void on_cbBetterPolygons_stateChanged(int state);
 
     void on_cbSoftwareThreaded_stateChanged(int state);
+    void on_sbSoftwareThreads_valueChanged(int val);
+    void on_cbThreaded2D_stateChanged(int state);
 private:
     void setVsyncControlEnable(bool hasOGL);
 
@@ -79,6 +81,8 @@ private:
     int oldVSync;
     int oldVSyncInterval;
     int oldSoftThreaded;
+    int oldSoftThreads;
+    int oldThreaded2D;
     int oldGLScale;
     int oldGLBetterPolygons;
 };
@@ -87,6 +87,7 @@
 #include "SPU.h"
 #include "Wifi.h"
 #include "Platform.h"
+#include "Profiler.h"
 #include "LocalMP.h"
 #include "Config.h"
 #include "DSi_I2C.h"
@@ -310,6 +311,95 @@ void EmuThread::deinitOpenGL()
     lastScreenWidth = lastScreenHeight = -1;
 }
 
+#ifdef PROFILING_ENABLED
+u64 ProfilerTimes[Profiler::Section_MAX];
+u64 ProfilerCounts[Profiler::Counter_MAX];
+u32 ProfilerFrames = 0;
+FILE* ProfilerDump = nullptr;
+
+void profilerFrame()
+{
+    u64 times[Profiler::Section_MAX];
+    u64 counts[Profiler::Counter_MAX];
+    Profiler::GetFrameTimes(times);
+    Profiler::GetFrameCounts(counts);
+
+    for (int i = 0; i < Profiler::Section_MAX; i++)
+        ProfilerTimes[i] += times[i];
+    for (int i = 0; i < Profiler::Counter_MAX; i++)
+        ProfilerCounts[i] += counts[i];
+    ProfilerFrames++;
+
+    // one CSV line per frame, times in nanoseconds
+    if (Config::ProfilerDumpPath.empty())
+    {
+        if (ProfilerDump)
+        {
+            fclose(ProfilerDump);
+            ProfilerDump = nullptr;
+        }
+        return;
+    }
+
+    if (!ProfilerDump)
+    {
+        ProfilerDump = Platform::OpenFile(Config::ProfilerDumpPath, "w");
+        if (!ProfilerDump)
+        {
+            Config::ProfilerDumpPath = "";
+            return;
+        }
+
+        fprintf(ProfilerDump, "frame");
+        for (int i = 0; i < Profiler::Section_MAX; i++)
+            fprintf(ProfilerDump, ",%s", Profiler::SectionNames[i]);
+        for (int i = 0; i < Profiler::Counter_MAX; i++)
+            fprintf(ProfilerDump, ",%s", Profiler::CounterNames[i]);
+        fprintf(ProfilerDump, "\n");
+    }
+
+    fprintf(ProfilerDump, "%u", NDS::NumFrames);
+    for (int i = 0; i < Profiler::Section_MAX; i++)
+        fprintf(ProfilerDump, ",%llu", (unsigned long long)times[i]);
+    for (int i = 0; i < Profiler::Counter_MAX; i++)
+        fprintf(ProfilerDump, ",%llu", (unsigned long long)counts[i]);
+    fprintf(ProfilerDump, "\n");
+}
+
+void profilerUpdateOSD()
+{
+    if (!ProfilerFrames) return;
+
+    if (Config::ShowProfiler)
+    {
+        // averages since the last update, in milliseconds per frame
+        // and events per frame
+        char times[256], counts[256];
+        int len = 0;
+        for (int i = 0; i < Profiler::Section_MAX && len < (int)sizeof(times); i++)
+        {
+            double ms = ProfilerTimes[i] / (1000000.0 * ProfilerFrames);
+            len += snprintf(&times[len], sizeof(times)-len, "%s%s %.2f", i ? " | " : "", Profiler::SectionNames[i], ms);
+        }
+        len = 0;
+        for (int i = 0; i < Profiler::Counter_MAX && len < (int)sizeof(counts); i++)
+        {
+            double n = (double)ProfilerCounts[i] / ProfilerFrames;
+            len += snprintf(&counts[len], sizeof(counts)-len, "%s%s %.1f", i ? " | " : "", Profiler::CounterNames[i], n);
+        }
+
+        const char* lines[] = {times, counts};
+        OSD::SetStats(0xFFFFFF, lines, 2);
+    }
+    else
+        OSD::SetStats(0, nullptr, 0);
+
+    memset(ProfilerTimes, 0, sizeof(ProfilerTimes));
+    memset(ProfilerCounts, 0, sizeof(ProfilerCounts));
+    ProfilerFrames = 0;
+}
+#endif
+
 void EmuThread::run()
 {
     u32 mainScreenPos[3];
@@ -323,6 +413,8 @@ void EmuThread::run()
 
     videoSettingsDirty = false;
     videoSettings.Soft_Threaded = Config::Threaded3D != 0;
+    videoSettings.Soft_NumThreads = Config::Threads3D;
+    videoSettings.Threaded2D = Config::Threaded2D != 0;
     videoSettings.GL_ScaleFactor = Config::GL_ScaleFactor;
     videoSettings.GL_BetterPolygons = Config::GL_BetterPolygons;
 
@@ -454,6 +546,9 @@ void EmuThread::run()
                 videoSettingsDirty = false;
 
                 videoSettings.Soft_Threaded = Config::Threaded3D != 0;
+                videoSettings.Soft_NumThreads = Config::Threads3D;
+                videoSettings.Threaded2D = Config::Threaded2D != 0;
+    videoSettings.Threaded2D = Config::Threaded2D != 0;
                 videoSettings.GL_ScaleFactor = Config::GL_ScaleFactor;
                 videoSettings.GL_BetterPolygons = Config::GL_BetterPolygons;
 
@@ -504,9 +599,21 @@ void EmuThread::run()
             }
 
 
+            // rewind goes back one snapshot per frame while the key is held
+            bool rewinding = Config::RewindEnable && Input::HotkeyDown(HK_Rewind);
+            if (rewinding)
+                ROMManager::RewindStep();
+
             // emulate
             u32 nlines = NDS::RunFrame();
 
+            if (!rewinding)
+                ROMManager::RewindFrame();
+
+#ifdef PROFILING_ENABLED
+            profilerFrame();
+#endif
+
             if (ROMManager::NDSSave)
                 ROMManager::NDSSave->CheckFlush();
 
@@ -596,6 +703,10 @@ void EmuThread::run()
                 u32 fps = round(nframes / dt);
                 nframes = 0;
 
+#ifdef PROFILING_ENABLED
+                profilerUpdateOSD();
+#endif
+
                 float fpstarget = 1.0/frametimeStep;
 
                 winUpdateFreq = fps / (u32)round(fpstarget);
@@ -649,6 +760,11 @@ void EmuThread::run()
 
     EmuStatus = emuStatus_Exit;
 
+#ifdef PROFILING_ENABLED
+    if (ProfilerDump) fclose(ProfilerDump);
+    ProfilerDump = nullptr;
+#endif
+
     GPU::DeInitRenderer();
     NDS::DeInit();
     //Platform::LAN_DeInit();
@@ -1726,6 +1842,12 @@ MainWindow::MainWindow(QWidget* parent) : QMainWindow(parent)
         actShowOSD->setCheckable(true);
         connect(actShowOSD, &QAction::triggered, this, &MainWindow::onChangeShowOSD);
 
+#ifdef PROFILING_ENABLED
+        actShowProfiler = menu->addAction("Show profiler");
+        actShowProfiler->setCheckable(true);
+        connect(actShowProfiler, &QAction::triggered, this, &MainWindow::onChangeShowProfiler);
+#endif
+
         menu->addSeparator();
 
         actLimitFramerate = menu->addAction("Limit framerate");
@@ -1735,6 +1857,10 @@ MainWindow::MainWindow(QWidget* parent) : QMainWindow(parent)
         actAudioSync = menu->addAction("Audio sync");
         actAudioSync->setCheckable(true);
         connect(actAudioSync, &QAction::triggered, this, &MainWindow::onChangeAudioSync);
+
+        actEnableRewind = menu->addAction("Enable rewind");
+        actEnableRewind->setCheckable(true);
+        connect(actEnableRewind, &QAction::triggered, this, &MainWindow::onChangeEnableRewind);
     }
     setMenuBar(menubar);
 
@@ -1819,9 +1945,13 @@ MainWindow::MainWindow(QWidget* parent) : QMainWindow(parent)
 
     actScreenFiltering->setChecked(Config::ScreenFilter);
     actShowOSD->setChecked(Config::ShowOSD);
+#ifdef PROFILING_ENABLED
+    actShowProfiler->setChecked(Config::ShowProfiler);
+#endif
 
     actLimitFramerate->setChecked(Config::LimitFPS);
     actAudioSync->setChecked(Config::AudioSync);
+    actEnableRewind->setChecked(Config::RewindEnable);
 
     if (inst > 0)
     {
@@ -3075,6 +3205,10 @@ void MainWindow::onChangeShowOSD(bool checked)
 {
     Config::ShowOSD = checked?1:0;
 }
+void MainWindow::onChangeShowProfiler(bool checked)
+{
+    Config::ShowProfiler = checked?1:0;
+}
 void MainWindow::onChangeLimitFramerate(bool checked)
 {
     Config::LimitFPS = checked?1:0;
@@ -3085,6 +3219,11 @@ void MainWindow::onChangeAudioSync(bool checked)
     Config::AudioSync = checked?1:0;
 }
 
+void MainWindow::onChangeEnableRewind(bool checked)
+{
+    Config::RewindEnable = checked?1:0;
+}
+
 
 void MainWindow::onTitleUpdate(QString title)
 {
@@ -340,8 +340,10 @@ private slots:
     void onChangeIntegerScaling(bool checked);
     void onChangeScreenFiltering(bool checked);
     void onChangeShowOSD(bool checked);
+    void onChangeShowProfiler(bool checked);
     void onChangeLimitFramerate(bool checked);
     void onChangeAudioSync(bool checked);
+    void onChangeEnableRewind(bool checked);
 
     void onTitleUpdate(QString title);
 
@@ -436,8 +438,10 @@ public:
     QAction** actScreenAspectBot;
     QAction* actScreenFiltering;
     QAction* actShowOSD;
+    QAction* actShowProfiler;
     QAction* actLimitFramerate;
     QAction* actAudioSync;
+    QAction* actEnableRewind;
 };
 
 #endif // MAIN_H
@@ -71,6 +71,9 @@ public:
 
     // core
     void Run(unsigned cycle);
+    // the decoded program is cached, this has to be called when program memory
+    // was changed without going through ProgramWrite (e.g. by remapping it)
+    void InvalidateProgramCache();
 
     void SetSharedMemoryCallback(const SharedMemoryCallback& callback);
     void SetAHBMCallback(const AHBMCallback& callback);
@@ -65,6 +65,7 @@ void Teakra_AHBMWrite32(TeakraContext* context, uint32_t addr, uint32_t value);
 
 
 void Teakra_Run(TeakraContext* context, unsigned cycle);
+void Teakra_InvalidateProgramCache(TeakraContext* context);
 
 void Teakra_SetAHBMCallback(TeakraContext* context,
                             Teakra_AHBMReadCallback8  read8 , Teakra_AHBMWriteCallback8  write8 ,
@@ -1,4 +1,5 @@
 #pragma once
+#include <array>
 #include <type_traits>
 #include <vector>
 #include "crash.h"
@@ -693,30 +694,53 @@ std::vector<Matcher<V>> GetDecodeTable() {
 
 // clang-format on
 
+// The matcher for every one of the 65536 opcodes. Instead of searching the
+// decode table for every opcode, each matcher only visits the opcodes which
+// have its expected bits. The table holds indices into the matchers, not
+// copies of them; a matcher has a std::function and a vector in it.
 template <typename V>
-Matcher<V> Decode(u16 instruction) {
-    static const auto table = GetDecodeTable<V>();
-
-    const auto matches_instruction = [instruction](const auto& matcher) {
-        return matcher.Matches(instruction);
-    };
+class DecoderTable {
+public:
+    DecoderTable() : matchers(GetDecodeTable<V>()) {
+        matchers.push_back(
+            Matcher<V>::AllMatcher([](V& v, u16 opcode, u16) { return v.undefined(opcode); }));
+        const u16 undefined_index = (u16)(matchers.size() - 1);
+        index.fill(undefined_index);
+
+        for (u16 i = 0; i < undefined_index; ++i) {
+            const Matcher<V>& matcher = matchers[i];
+            const u16 free_bits = ~matcher.GetMask();
+            // go through every combination of the bits which aren't fixed
+            u16 bits = 0;
+            do {
+                u16 opcode = matcher.GetExpected() | bits;
+                if (matcher.Matches(opcode)) {
+                    // every opcode may only be matched once
+                    ASSERT(index[opcode] == undefined_index);
+                    index[opcode] = i;
+                }
+                bits = (u16)((bits - free_bits) & free_bits);
+            } while (bits != 0);
+        }
+    }
 
-    auto iter = std::find_if(table.begin(), table.end(), matches_instruction);
-    if (iter == table.end()) {
-        return Matcher<V>::AllMatcher([](V& v, u16 opcode, u16) { return v.undefined(opcode); });
-    } else {
-        auto other = std::find_if(iter + 1, table.end(), matches_instruction);
-        ASSERT(other == table.end());
-        return *iter;
+    const Matcher<V>& operator[](u16 opcode) const {
+        return matchers[index[opcode]];
     }
-}
 
+private:
+    std::vector<Matcher<V>> matchers;
+    std::array<u16, 0x10000> index;
+};
+
+// built on first use and shared by everything which decodes for V
 template <typename V>
-std::vector<Matcher<V>> GetDecoderTable() {
-    std::vector<Matcher<V>> table;
-    table.reserve(0x10000);
-    for (u32 i = 0; i < 0x10000; ++i) {
-        table.push_back(Decode<V>((u16)i));
-    }
+const DecoderTable<V>& GetDecoderTable() {
+    static const DecoderTable<V> table;
     return table;
 }
+
+template <typename V>
+Matcher<V> Decode(u16 instruction) {
+    return GetDecoderTable<V>()[instruction];
+}
@@ -1,6 +1,7 @@
 #pragma once
 #include <utility>
 #include <atomic>
+#include <memory>
 #include <stdexcept>
 #include <tuple>
 #include <type_traits>
@@ -25,7 +26,9 @@ public:
 class Interpreter {
 public:
     Interpreter(CoreTiming& core_timing, RegisterState& regs, MemoryInterface& mem)
-        : core_timing(core_timing), regs(regs), mem(mem) {}
+        : core_timing(core_timing), regs(regs), mem(mem) {
+        mem.SetProgramWriteHandler([this](u32 address) { InvalidateProgramCache(address); });
+    }
 
     void PushPC() {
         u16 l = (u16)(regs.pc & 0xFFFF);
@@ -74,22 +77,20 @@ public:
                 }
             }
 
+            // checking first is a lot cheaper than an exchange every cycle
             for (std::size_t i = 0; i < 3; ++i) {
-                if (interrupt_pending[i].exchange(false)) {
+                if (interrupt_pending[i].load(std::memory_order_relaxed) &&
+                    interrupt_pending[i].exchange(false)) {
                     regs.ip[i] = 1;
                 }
             }
 
-            if (vinterrupt_pending.exchange(false)) {
+            if (vinterrupt_pending.load(std::memory_order_relaxed) &&
+                vinterrupt_pending.exchange(false)) {
                 regs.ipv = 1;
             }
 
-            u16 opcode = mem.ProgramRead((regs.pc++) | (regs.prpage << 18));
-            auto& decoder = decoders[opcode];
-            u16 expand_value = 0;
-            if (decoder.NeedExpansion()) {
-                expand_value = mem.ProgramRead((regs.pc++) | (regs.prpage << 18));
-            }
+            const DecodedInstruction instr = FetchInstruction();
 
             if (regs.rep) {
                 if (regs.repc == 0) {
@@ -110,7 +111,7 @@ public:
                 }
             }
 
-            decoder.call(*this, opcode, expand_value);
+            instr.decoder->call_unchecked(*this, instr.opcode, instr.expansion);
 
             // I am not sure if a single-instruction loop is interruptable and how it is handled,
             // so just disable interrupt for it for now.
@@ -146,6 +147,20 @@ public:
         }
     }
 
+    // program memory was changed without going through ProgramWrite
+    void InvalidateProgramCache() {
+        for (auto& page : decoded_pages) {
+            if (page)
+                page->valid = false;
+        }
+    }
+
+    void InvalidateProgramCache(u32 address) {
+        // the word before might be an instruction which uses this one as its expansion
+        InvalidateDecodedPage(address);
+        InvalidateDecodedPage(address - 1);
+    }
+
     void SignalInterrupt(u32 i) {
         interrupt_pending[i] = true;
     }
@@ -1185,14 +1200,8 @@ public:
         // retd is supposed to kick in after 2 cycles
 
         for (int i = 0; i < 2; i++) {
-            u16 opcode = mem.ProgramRead((regs.pc++) | (regs.prpage << 18));
-            auto& decoder = decoders[opcode];
-            u16 expand_value = 0;
-            if (decoder.NeedExpansion()) {
-                expand_value = mem.ProgramRead((regs.pc++) | (regs.prpage << 18));
-            }
-
-            decoder.call(*this, opcode, expand_value);
+            const DecodedInstruction instr = FetchInstruction();
+            instr.decoder->call_unchecked(*this, instr.opcode, instr.expansion);
         }
 
         PopPC();
@@ -2957,6 +2966,73 @@ private:
 
     bool idle = false;
 
+    // Fetching every instruction through the shared memory callback and looking it up
+    // again is most of what running DSP code costs, while the code itself hardly ever
+    // changes. So program memory is decoded a page at a time and kept like that until
+    // it's written to. Only the program RAM of page 0 is cached: from 0x20000 up, fetches
+    // reach data memory on the DSi, which DMA and data writes change behind our back.
+    struct DecodedInstruction {
+        const Matcher<Interpreter>* decoder;
+        u16 opcode;
+        u16 expansion;
+    };
+
+    static constexpr u32 DecodedPageBits = 10;
+    static constexpr u32 DecodedPageSize = 1 << DecodedPageBits;
+    static constexpr u32 DecodedProgramSize = 0x20000;
+
+    struct DecodedPage {
+        bool valid = false;
+        std::array<DecodedInstruction, DecodedPageSize> instructions;
+    };
+
+    std::array<std::unique_ptr<DecodedPage>, DecodedProgramSize / DecodedPageSize> decoded_pages;
+
+    DecodedPage& DecodePage(u32 index) {
+        std::unique_ptr<DecodedPage>& page = decoded_pages[index];
+        if (!page)
+            page = std::make_unique<DecodedPage>();
+
+        u32 base = index << DecodedPageBits;
+        for (u32 i = 0; i < DecodedPageSize; ++i) {
+            DecodedInstruction& instr = page->instructions[i];
+            instr.opcode = mem.ProgramRead(base + i);
+            instr.decoder = &decoders[instr.opcode];
+            instr.expansion = instr.decoder->NeedExpansion() ? mem.ProgramRead(base + i + 1) : 0;
+        }
+        page->valid = true;
+        return *page;
+    }
+
+    void InvalidateDecodedPage(u32 address) {
+        if (address < DecodedProgramSize) {
+            std::unique_ptr<DecodedPage>& page = decoded_pages[address >> DecodedPageBits];
+            if (page)
+                page->valid = false;
+        }
+    }
+
+    // reads the instruction at pc and moves pc past it
+    DecodedInstruction FetchInstruction() {
+        DecodedInstruction instr;
+        // the last word could take its expansion from past the cached range
+        if (regs.prpage == 0 && regs.pc < DecodedProgramSize - 1) {
+            DecodedPage* page = decoded_pages[regs.pc >> DecodedPageBits].get();
+            if (!page || !page->valid)
+                page = &DecodePage(regs.pc >> DecodedPageBits);
+            instr = page->instructions[regs.pc & (DecodedPageSize - 1)];
+            regs.pc += instr.decoder->NeedExpansion() ? 2 : 1;
+        } else {
+            instr.opcode = mem.ProgramRead((regs.pc++) | (regs.prpage << 18));
+            instr.decoder = &decoders[instr.opcode];
+            instr.expansion = 0;
+            if (instr.decoder->NeedExpansion()) {
+                instr.expansion = mem.ProgramRead((regs.pc++) | (regs.prpage << 18));
+            }
+        }
+        return instr;
+    }
+
     u64 GetAcc(RegName name) const {
         switch (name) {
         case RegName::a0:
@@ -3642,7 +3718,7 @@ private:
         return map.at(in);
     }
 
-    const std::vector<Matcher<Interpreter>> decoders = GetDecoderTable<Interpreter>();
+    const DecoderTable<Interpreter>& decoders = GetDecoderTable<Interpreter>();
 };
 
 } // namespace Teakra
@@ -36,6 +36,14 @@ public:
         return expanded;
     }
 
+    u16 GetMask() const {
+        return mask;
+    }
+
+    u16 GetExpected() const {
+        return expected;
+    }
+
     bool Matches(u16 instruction) const {
         return (instruction & mask) == expected &&
                std::none_of(rejectors.begin(), rejectors.end(),
@@ -55,6 +63,12 @@ public:
         return fn(v, instruction, instruction_expansion);
     }
 
+    // for instructions which are known to match, e.g. because they were looked up in a decoder table
+    handler_return_type call_unchecked(Visitor& v, u16 instruction,
+                                       u16 instruction_expansion = 0) const {
+        return fn(v, instruction, instruction_expansion);
+    }
+
 private:
     const char* name;
     u16 mask;
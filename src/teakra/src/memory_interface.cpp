@@ -11,11 +11,17 @@ void MemoryInterface::SetMMIO(MMIORegion& mmio) {
     this->mmio = &mmio;
 }
 
+void MemoryInterface::SetProgramWriteHandler(std::function<void(u32)> handler) {
+    program_write_handler = std::move(handler);
+}
+
 u16 MemoryInterface::ProgramRead(u32 address) const {
     return shared_memory.ReadWord(address);
 }
 void MemoryInterface::ProgramWrite(u32 address, u16 value) {
     shared_memory.WriteWord(address, value);
+    if (program_write_handler)
+        program_write_handler(address);
 }
 u16 MemoryInterface::DataRead(u16 address, bool bypass_mmio) {
     if (memory_interface_unit.InMMIO(address) && !bypass_mmio) {
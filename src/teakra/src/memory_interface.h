@@ -1,6 +1,7 @@
 #pragma once
 
 #include <array>
+#include <functional>
 #include "common_types.h"
 #include "crash.h"
 
@@ -55,6 +56,7 @@ class MemoryInterface {
 public:
     MemoryInterface(SharedMemory& shared_memory, MemoryInterfaceUnit& memory_interface_unit);
     void SetMMIO(MMIORegion& mmio);
+    void SetProgramWriteHandler(std::function<void(u32)> handler);
     u16 ProgramRead(u32 address) const;
     void ProgramWrite(u32 address, u16 value);
     u16 DataRead(u16 address, bool bypass_mmio = false); // not const because it can be a FIFO register
@@ -68,6 +70,7 @@ private:
     SharedMemory& shared_memory;
     MemoryInterfaceUnit& memory_interface_unit;
     MMIORegion* mmio;
+    std::function<void(u32)> program_write_handler;
 };
 
 } // namespace Teakra
@@ -18,12 +18,17 @@ Processor::~Processor() = default;
 
 void Processor::Reset() {
     impl->regs = RegisterState();
+    impl->interpreter.InvalidateProgramCache();
 }
 
 void Processor::Run(unsigned cycles) {
     impl->interpreter.Run(cycles);
 }
 
+void Processor::InvalidateProgramCache() {
+    impl->interpreter.InvalidateProgramCache();
+}
+
 void Processor::SignalInterrupt(u32 i) {
     impl->interpreter.SignalInterrupt(i);
 }
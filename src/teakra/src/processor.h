@@ -14,6 +14,7 @@ public:
     ~Processor();
     void Reset();
     void Run(unsigned cycles);
+    void InvalidateProgramCache();
     void SignalInterrupt(u32 i);
     void SignalVectoredInterrupt(u32 address, bool context_switch);
 
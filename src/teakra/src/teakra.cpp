@@ -74,6 +74,10 @@ void Teakra::Run(unsigned cycle) {
     impl->processor.Run(cycle);
 }
 
+void Teakra::InvalidateProgramCache() {
+    impl->processor.InvalidateProgramCache();
+}
+
 bool Teakra::SendDataIsEmpty(std::uint8_t index) const {
     return !impl->apbp_from_cpu.IsDataReady(index);
 }
@@ -125,6 +125,10 @@ void Teakra_Run(TeakraContext* context, unsigned cycle) {
     context->teakra.Run(cycle);
 }
 
+void Teakra_InvalidateProgramCache(TeakraContext* context) {
+    context->teakra.InvalidateProgramCache();
+}
+
 void Teakra_SetAHBMCallback(TeakraContext* context,
                             Teakra_AHBMReadCallback8  read8 , Teakra_AHBMWriteCallback8  write8 ,
                             Teakra_AHBMReadCallback16 read16, Teakra_AHBMWriteCallback16 write16,
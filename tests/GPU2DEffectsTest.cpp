@@ -0,0 +1,159 @@
+/*
+    Copyright 2016-2022 melonDS team
+
+    This file is part of melonDS.
+
+    melonDS is free software: you can redistribute it and/or modify it under
+    the terms of the GNU General Public License as published by the Free
+    Software Foundation, either version 3 of the License, or (at your option)
+    any later version.
+
+    melonDS is distributed in the hope that it will be useful, but WITHOUT ANY
+    WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+    FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with melonDS. If not, see http://www.gnu.org/licenses/.
+*/
+
+// checks that the vectorised 2D color effect and master brightness passes
+// give the same results as the scalar ones, for every EVA/EVB/EVY and
+// brightness factor with random scanlines
+
+#include <stdio.h>
+#include <string.h>
+
+#include "GPU2D_Effects.h"
+
+using namespace GPU2D;
+
+typedef void (*CompositeLineFunc)(u32* line, const u8* windowMask, u32 blendCnt, u32 eva, u32 evb, u32 evy);
+typedef void (*FinishLineFunc)(u32* dst, u32 masterBrightness);
+
+struct Variant
+{
+    const char* Name;
+    CompositeLineFunc CompositeLine;
+    FinishLineFunc FinishLine;
+};
+
+u32 RandomState = 0x12345678;
+
+u32 Random()
+{
+    // xorshift32, so the test does the same on every run
+    RandomState ^= RandomState << 13;
+    RandomState ^= RandomState >> 17;
+    RandomState ^= RandomState << 5;
+    return RandomState;
+}
+
+// a pixel like the ones the BG/OBJ passes leave in BGOBJLine
+u32 RandomPixel()
+{
+    u32 color = Random() & 0x3F3F3F;
+    u32 flags;
+    switch (Random() % 6)
+    {
+    case 0: flags = 1 << (Random() % 6); break;         // BG0-3, OBJ or backdrop
+    case 1: flags = 0x80; break;                        // semi-transparent sprite
+    case 2: flags = 0xC0 | (1 + Random() % 16); break;  // bitmap sprite
+    case 3: flags = 0x40 | (Random() & 0x1F); break;    // 3D layer
+    default: flags = 1 << (Random() % 4); break;
+    }
+    return color | (flags << 24);
+}
+
+int CheckCompositeLine(const Variant& variant)
+{
+    int failures = 0;
+    for (u32 effect = 0; effect < 4; effect++)
+    for (u32 eva = 0; eva <= 16; eva++)
+    for (u32 evb = 0; evb <= 16; evb++)
+    for (u32 evy = 0; evy <= 16; evy++)
+    {
+        u32 blendCnt = (effect << 6) | (Random() & 0x3F3F);
+
+        u32 expected[256*2], actual[256*2];
+        u8 windowMask[256];
+        for (int i = 0; i < 256*2; i++)
+            expected[i] = RandomPixel();
+        for (int i = 0; i < 256; i++)
+            windowMask[i] = Random() & 0x3F;
+        memcpy(actual, expected, sizeof(expected));
+
+        CompositeLine_Scalar(expected, windowMask, blendCnt, eva, evb, evy);
+        variant.CompositeLine(actual, windowMask, blendCnt, eva, evb, evy);
+
+        for (int i = 0; i < 256; i++)
+        {
+            if (expected[i] != actual[i])
+            {
+                if (failures++ < 10)
+                    printf("%s: CompositeLine mismatch, BLDCNT=%04X EVA=%u EVB=%u EVY=%u pixel %d: %08X, expected %08X\n",
+                        variant.Name, blendCnt, eva, evb, evy, i, actual[i], expected[i]);
+                break;
+            }
+        }
+    }
+    return failures;
+}
+
+int CheckFinishLine(const Variant& variant)
+{
+    int failures = 0;
+    for (u32 mode = 0; mode < 4; mode++)
+    for (u32 factor = 0; factor < 32; factor++)
+    for (int n = 0; n < 16; n++)
+    {
+        u32 masterBrightness = (mode << 14) | factor;
+
+        u32 expected[256], actual[256];
+        for (int i = 0; i < 256; i++)
+            expected[i] = Random() & 0xFF3F3F3F;
+        memcpy(actual, expected, sizeof(expected));
+
+        FinishLine_Scalar(expected, masterBrightness);
+        variant.FinishLine(actual, masterBrightness);
+
+        for (int i = 0; i < 256; i++)
+        {
+            if (expected[i] != actual[i])
+            {
+                if (failures++ < 10)
+                    printf("%s: FinishLine mismatch, MASTER_BRIGHT=%04X pixel %d: %08X, expected %08X\n",
+                        variant.Name, masterBrightness, i, actual[i], expected[i]);
+                break;
+            }
+        }
+    }
+    return failures;
+}
+
+int main()
+{
+#ifdef GPU2D_SIMD
+    Variant variants[2];
+    int numVariants = 0;
+    variants[numVariants++] = {"base", CompositeLine_Base, FinishLine_Base};
+#if defined(__x86_64__) || defined(__i386__)
+    if (__builtin_cpu_supports("avx2"))
+        variants[numVariants++] = {"AVX2", CompositeLine_AVX2, FinishLine_AVX2};
+    else
+        printf("AVX2 isn't supported, skipping it\n");
+#endif
+
+    int failures = 0;
+    for (int i = 0; i < numVariants; i++)
+    {
+        int variantFailures = CheckCompositeLine(variants[i]) + CheckFinishLine(variants[i]);
+        printf("%s: %s\n", variants[i].Name, variantFailures ? "FAILED" : "ok");
+        failures += variantFailures;
+    }
+
+    return failures ? 1 : 0;
+#else
+    printf("built without the vectorised passes, nothing to compare\n");
+    return 0;
+#endif
+}
@@ -0,0 +1,192 @@
+/*
+    Copyright 2016-2022 melonDS team
+
+    This file is part of melonDS.
+
+    melonDS is free software: you can redistribute it and/or modify it under
+    the terms of the GNU General Public License as published by the Free
+    Software Foundation, either version 3 of the License, or (at your option)
+    any later version.
+
+    melonDS is distributed in the hope that it will be useful, but WITHOUT ANY
+    WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+    FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with melonDS. If not, see http://www.gnu.org/licenses/.
+*/
+
+// checks that the vectorised span interpolation and shading passes of the
+// software 3D renderer give the same results as the scalar ones, with
+// random scanlines in both perspective-correct and linear mode
+
+#include <stdio.h>
+#include <string.h>
+
+#include "GPU3D_SoftSpan.h"
+
+using namespace GPU3D;
+
+typedef void (*InterpolateSpanFunc)(const SpanInterp& interp, const s32 (*ends)[2], s32 xs, s32 xe, s32 (*out)[256]);
+typedef void (*ShadeSpanFunc)(const s32 (*attr)[256], const u16* texcolor, const u8* texalpha, s32 xs, s32 xe, u32 polyalpha, bool wireframe, u32* out);
+
+struct Variant
+{
+    const char* Name;
+    InterpolateSpanFunc InterpolateSpan;
+    ShadeSpanFunc ShadeSpan;
+};
+
+u32 RandomState = 0x12345678;
+
+u32 Random()
+{
+    // xorshift32, so the test does the same on every run
+    RandomState ^= RandomState << 13;
+    RandomState ^= RandomState >> 17;
+    RandomState ^= RandomState << 5;
+    return RandomState;
+}
+
+s32 RandomRange(s32 min, s32 max)
+{
+    return min + (s32)(Random() % (u32)(max - min + 1));
+}
+
+// a scanline like the ones Interpolator<0> gets set up for
+SpanInterp RandomSpan(s32* xs, s32* xe)
+{
+    SpanInterp interp;
+    interp.X0 = RandomRange(-64, 255);
+    interp.XDiff = (Random() % 8) ? RandomRange(1, 320) : 0;
+    interp.XRecip = interp.XDiff ? (1<<30) / interp.XDiff : 0;
+
+    s32 w0 = (Random() % 16) ? RandomRange(1, 0xFFFF) : 0;
+    s32 w1 = (Random() % 4) ? RandomRange(1, 0xFFFF) : w0;
+    if (Random() % 8 == 0)
+    {
+        // W values outside of the usual 16 bits
+        w0 = RandomRange(0x10000, 0x7FFFFF);
+        w1 = RandomRange(0x10000, 0x7FFFFF);
+    }
+    interp.Linear = (w0 == w1) && !(w0 & 0x7F);
+    interp.W0n = w0;
+    interp.W0d = w0;
+    interp.W1d = w1;
+
+    s32 start = interp.X0 < 0 ? 0 : interp.X0;
+    s32 end = interp.X0 + interp.XDiff;
+    if (end > 256) end = 256;
+    if (end < start) end = start;
+    *xs = RandomRange(start, end);
+    *xe = RandomRange(*xs, end);
+    return interp;
+}
+
+int CheckInterpolateSpan(const Variant& variant)
+{
+    int failures = 0;
+    for (int n = 0; n < 200000; n++)
+    {
+        s32 xs, xe;
+        SpanInterp interp = RandomSpan(&xs, &xe);
+
+        s32 ends[SpanAttr_Count][2];
+        for (int a = SpanAttr_R; a <= SpanAttr_B; a++)
+        {
+            ends[a][0] = Random() & 0x1FF;
+            ends[a][1] = (Random() % 4) ? (Random() & 0x1FF) : ends[a][0];
+        }
+        for (int a = SpanAttr_S; a <= SpanAttr_T; a++)
+        {
+            ends[a][0] = (s16)Random();
+            ends[a][1] = (Random() % 4) ? (s16)Random() : ends[a][0];
+        }
+
+        s32 expected[SpanAttr_Count][256], actual[SpanAttr_Count][256];
+        memset(expected, 0, sizeof(expected));
+        memset(actual, 0, sizeof(actual));
+
+        InterpolateSpan_Scalar(interp, ends, xs, xe, expected);
+        variant.InterpolateSpan(interp, ends, xs, xe, actual);
+
+        if (memcmp(expected, actual, sizeof(expected)))
+        {
+            if (failures++ < 10)
+                printf("%s: InterpolateSpan mismatch, X0=%d XDiff=%d W=%d/%d linear=%d span %d-%d\n",
+                    variant.Name, interp.X0, interp.XDiff, interp.W0d, interp.W1d, interp.Linear, xs, xe);
+        }
+    }
+    return failures;
+}
+
+int CheckShadeSpan(const Variant& variant)
+{
+    int failures = 0;
+    for (int n = 0; n < 20000; n++)
+    {
+        s32 xs = RandomRange(0, 256);
+        s32 xe = RandomRange(xs, 256);
+        bool textured = Random() & 1;
+        u32 polyalpha = Random() & 0x1F;
+        bool wireframe = (Random() % 8) == 0;
+
+        s32 attr[SpanAttr_Count][256];
+        u16 texcolor[256];
+        u8 texalpha[256];
+        for (int i = 0; i < 256; i++)
+        {
+            for (int a = 0; a < SpanAttr_Count; a++)
+                attr[a][i] = Random() & 0x7FF;
+            texcolor[i] = Random();
+            texalpha[i] = Random() & 0x1F;
+        }
+
+        u32 expected[256], actual[256];
+        memset(expected, 0, sizeof(expected));
+        memset(actual, 0, sizeof(actual));
+
+        ShadeSpan_Scalar(attr, textured ? texcolor : nullptr, texalpha, xs, xe, polyalpha, wireframe, expected);
+        variant.ShadeSpan(attr, textured ? texcolor : nullptr, texalpha, xs, xe, polyalpha, wireframe, actual);
+
+        for (int i = 0; i < 256; i++)
+        {
+            if (expected[i] != actual[i])
+            {
+                if (failures++ < 10)
+                    printf("%s: ShadeSpan mismatch, textured=%d alpha=%u pixel %d: %08X, expected %08X\n",
+                        variant.Name, textured, polyalpha, i, actual[i], expected[i]);
+                break;
+            }
+        }
+    }
+    return failures;
+}
+
+int main()
+{
+#ifdef GPU3D_SIMD
+    Variant variants[2];
+    int numVariants = 0;
+    variants[numVariants++] = {"base", InterpolateSpan_Base, ShadeSpan_Base};
+#if defined(__x86_64__) || defined(__i386__)
+    if (__builtin_cpu_supports("avx2"))
+        variants[numVariants++] = {"AVX2", InterpolateSpan_AVX2, ShadeSpan_AVX2};
+    else
+        printf("AVX2 isn't supported, skipping it\n");
+#endif
+
+    int failures = 0;
+    for (int i = 0; i < numVariants; i++)
+    {
+        int variantFailures = CheckInterpolateSpan(variants[i]) + CheckShadeSpan(variants[i]);
+        printf("%s: %s\n", variants[i].Name, variantFailures ? "FAILED" : "ok");
+        failures += variantFailures;
+    }
+
+    return failures ? 1 : 0;
+#else
+    printf("built without the vectorised passes, nothing to compare\n");
+    return 0;
+#endif
+}
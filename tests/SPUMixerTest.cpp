@@ -0,0 +1,413 @@
+/*
+    Copyright 2016-2022 melonDS team
+
+    This file is part of melonDS.
+
+    melonDS is free software: you can redistribute it and/or modify it under
+    the terms of the GNU General Public License as published by the Free
+    Software Foundation, either version 3 of the License, or (at your option)
+    any later version.
+
+    melonDS is distributed in the hope that it will be useful, but WITHOUT ANY
+    WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+    FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with melonDS. If not, see http://www.gnu.org/licenses/.
+*/
+
+// checks the SPU mixer block kernels and the frontend resampler:
+// * the scalar interpolation filter against the per-sample formulas the
+//   mixer used before it worked on blocks, for every interpolation position
+// * the vectorised kernels against the scalar ones, including the extreme
+//   values where splitting the 64-bit multiplies could go wrong
+// * the resampler against a per-sample reference
+
+#include <stdio.h>
+#include <string.h>
+
+#include "SPU.h"
+#include "SPU_Mixer.h"
+#include "frontend/FrontendUtil.h"
+
+using namespace SPU;
+
+typedef void (*FilterBlockFunc)(s32* out, const s32 (*taps)[MixBatchSize], const s32 (*coefs)[MixBatchSize], int shift, u32 volshift, s32 volume, u32 count);
+typedef void (*VolumeBlockFunc)(s32* out, const s32* in, u32 volshift, s32 volume, u32 count);
+typedef void (*PanBlockFunc)(s32* dst, const s32* in, s32 pan, u32 count);
+typedef void (*OutputBlockFunc)(s16* out, const s32* left, const s32* right, s32 mastervol, s32 bias, s32 mask, u32 count);
+
+struct Variant
+{
+    const char* Name;
+    FilterBlockFunc FilterBlock;
+    VolumeBlockFunc VolumeBlock;
+    PanBlockFunc PanBlock;
+    OutputBlockFunc OutputBlock;
+};
+
+const u32 VolumeShifts[4] = {0, 1, 2, 4};
+
+u32 RandomState = 0x12345678;
+
+u32 Random()
+{
+    // xorshift32, so the test does the same on every run
+    RandomState ^= RandomState << 13;
+    RandomState ^= RandomState >> 17;
+    RandomState ^= RandomState << 5;
+    return RandomState;
+}
+
+s16 RandomSample()
+{
+    // full scale samples are the ones most likely to overflow
+    switch (Random() % 4)
+    {
+    case 0: return 0x7FFF;
+    case 1: return -0x8000;
+    default: return (s16)Random();
+    }
+}
+
+// what a channel sample looks like after the volume is applied
+s32 RandomChannelSample()
+{
+    return ((s32)RandomSample() << VolumeShifts[Random() % 4]) * (s32)(Random() % 128);
+}
+
+// anything the mixer could sum up, including the s32 extremes
+s32 RandomMixedSample()
+{
+    switch (Random() % 8)
+    {
+    case 0: return 0x7FFFFFFF;
+    case 1: return -0x7FFFFFFF - 1;
+    case 2: return (s32)Random();
+    default: return RandomChannelSample() * (s32)(1 + Random() % 16);
+    }
+}
+
+// the interpolation as the mixer did it one sample at a time, with prev[0]
+// being the sample right before val
+s32 InterpolateSample(int interp, const s32* prev, s32 val, s32 pos)
+{
+    switch (interp)
+    {
+    case 1: return ((val * pos) + (prev[0] * (0xFF - pos))) >> 8;
+    case 2: return ((val * InterpCos[pos]) + (prev[0] * InterpCos[0xFF - pos])) >> 14;
+    case 3: return ((prev[2] * InterpCubic[pos][0]) +
+                    (prev[1] * InterpCubic[pos][1]) +
+                    (prev[0] * InterpCubic[pos][2]) +
+                    (val * InterpCubic[pos][3])) >> 14;
+    }
+    return val;
+}
+
+// fills a block the way Channel::RunBlock does
+u32 FillFilterBlock(s32 (*taps)[MixBatchSize], s32 (*coefs)[MixBatchSize], int interp, s32* prev, s32* vals, s32* pos)
+{
+    u32 samples = 1 + Random() % MixBatchSize;
+    u32 count = PadBlock(samples);
+    for (u32 s = 0; s < count; s++)
+    {
+        for (int k = 0; k < 4; k++)
+        {
+            taps[k][s] = 0;
+            coefs[k][s] = 0;
+        }
+        if (s >= samples) continue;
+
+        prev[s*3 + 0] = RandomSample();
+        prev[s*3 + 1] = RandomSample();
+        prev[s*3 + 2] = RandomSample();
+        vals[s] = RandomSample();
+        pos[s] = Random() & 0xFF;
+
+        taps[0][s] = prev[s*3 + 2];
+        taps[1][s] = prev[s*3 + 1];
+        taps[2][s] = prev[s*3 + 0];
+        taps[3][s] = vals[s];
+        SetInterpCoefs(coefs, s, interp, pos[s]);
+    }
+    return samples;
+}
+
+int CheckInterpolation()
+{
+    int failures = 0;
+    for (int interp = 1; interp <= 3; interp++)
+    for (int n = 0; n < 4096; n++)
+    {
+        alignas(32) s32 taps[4][MixBatchSize];
+        alignas(32) s32 coefs[4][MixBatchSize];
+        alignas(32) s32 out[MixBatchSize];
+        s32 prev[MixBatchSize*3], vals[MixBatchSize], pos[MixBatchSize];
+
+        u32 samples = FillFilterBlock(taps, coefs, interp, prev, vals, pos);
+        // go through every position at least once
+        pos[0] = n & 0xFF;
+        SetInterpCoefs(coefs, 0, interp, pos[0]);
+
+        u32 volshift = VolumeShifts[Random() % 4];
+        s32 volume = Random() % 128;
+        FilterBlock_Scalar(out, taps, coefs, (interp == 1) ? 8 : 14, volshift, volume, PadBlock(samples));
+
+        for (u32 s = 0; s < samples; s++)
+        {
+            s32 expected = (InterpolateSample(interp, &prev[s*3], vals[s], pos[s]) << volshift) * volume;
+            if (out[s] != expected)
+            {
+                if (failures++ < 10)
+                    printf("scalar: interpolation %d mismatch at position %d: %d, expected %d\n",
+                        interp, pos[s], out[s], expected);
+                break;
+            }
+        }
+    }
+    return failures;
+}
+
+template <typename T>
+int CompareBlocks(const Variant& variant, const char* kernel, const T* actual, const T* expected, u32 count)
+{
+    for (u32 i = 0; i < count; i++)
+    {
+        if (actual[i] != expected[i])
+        {
+            printf("%s: %s mismatch at sample %u: %d, expected %d\n",
+                variant.Name, kernel, i, actual[i], expected[i]);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+int CheckKernels(const Variant& variant)
+{
+    int failures = 0;
+    for (int n = 0; n < 20000 && failures < 10; n++)
+    {
+        alignas(32) s32 taps[4][MixBatchSize];
+        alignas(32) s32 coefs[4][MixBatchSize];
+        alignas(32) s32 expected[MixBatchSize], actual[MixBatchSize];
+        alignas(32) s32 in[MixBatchSize], right[MixBatchSize];
+        alignas(32) s16 expected16[MixBatchSize*2], actual16[MixBatchSize*2];
+        s32 prev[MixBatchSize*3], vals[MixBatchSize], pos[MixBatchSize];
+
+        int interp = 1 + Random() % 3;
+        u32 count = PadBlock(FillFilterBlock(taps, coefs, interp, prev, vals, pos));
+        u32 volshift = VolumeShifts[Random() % 4];
+        s32 volume = Random() % 128;
+
+        FilterBlock_Scalar(expected, taps, coefs, (interp == 1) ? 8 : 14, volshift, volume, count);
+        variant.FilterBlock(actual, taps, coefs, (interp == 1) ? 8 : 14, volshift, volume, count);
+        failures += CompareBlocks(variant, "FilterBlock", actual, expected, count);
+
+        VolumeBlock_Scalar(expected, taps[3], volshift, volume, count);
+        variant.VolumeBlock(actual, taps[3], volshift, volume, count);
+        failures += CompareBlocks(variant, "VolumeBlock", actual, expected, count);
+
+        s32 pan = Random() % 129;
+        for (u32 i = 0; i < count; i++)
+        {
+            in[i] = (Random() & 1) ? RandomMixedSample() : RandomChannelSample();
+            expected[i] = RandomChannelSample();
+            actual[i] = expected[i];
+        }
+        PanBlock_Scalar(expected, in, pan, count);
+        variant.PanBlock(actual, in, pan, count);
+        failures += CompareBlocks(variant, "PanBlock", actual, expected, count);
+
+        // the master volume is 0-126 or 128
+        s32 mastervol = Random() % 128;
+        if (mastervol == 127) mastervol = 128;
+        s32 bias = (Random() & 1) ? 0x200 : 0;
+        s32 mask = (Random() & 1) ? 0xFFFFFFC0 : 0xFFFFFFFF;
+        for (u32 i = 0; i < count; i++)
+        {
+            in[i] = RandomMixedSample();
+            right[i] = RandomMixedSample();
+        }
+        // the output isn't padded, so let the count be anything
+        u32 outcount = 1 + Random() % count;
+        memset(expected16, 0x55, sizeof(expected16));
+        memset(actual16, 0x55, sizeof(actual16));
+        OutputBlock_Scalar(expected16, in, right, mastervol, bias, mask, outcount);
+        variant.OutputBlock(actual16, in, right, mastervol, bias, mask, outcount);
+        failures += CompareBlocks(variant, "OutputBlock", actual16, expected16, MixBatchSize*2);
+    }
+    return failures;
+}
+
+// the resampler one output sample at a time
+void ResampleReference(s16* prev, const s16* inbuf, int inlen, s16* outbuf, int outlen, int volume, int interp)
+{
+    u32 res_incr = ((u64)inlen << 16) / outlen;
+
+    for (int i = 0; i < outlen; i++)
+    {
+        u32 res_pos = res_incr * i;
+        int pos = res_pos >> 16;
+        int frac = (res_pos >> 8) & 0xFF;
+
+        for (int c = 0; c < 2; c++)
+        {
+            s32 in[4];
+            for (int k = 0; k < 4; k++)
+            {
+                int p = pos - 1 + k;
+                if (p >= inlen) p = inlen - 1;
+                in[k] = (p < 0) ? prev[c] : inbuf[p*2 + c];
+            }
+
+            s32 val;
+            switch (interp)
+            {
+            case 1: val = ((in[1] * (0xFF - frac)) + (in[2] * frac)) >> 8; break;
+            case 2: val = ((in[1] * InterpCos[0xFF - frac]) + (in[2] * InterpCos[frac])) >> 14; break;
+            case 3: val = ((in[0] * InterpCubic[frac][0]) +
+                           (in[1] * InterpCubic[frac][1]) +
+                           (in[2] * InterpCubic[frac][2]) +
+                           (in[3] * InterpCubic[frac][3])) >> 14; break;
+            default: val = in[1]; break;
+            }
+
+            val = (val * volume) >> 8;
+            if      (val < -0x8000) val = -0x8000;
+            else if (val > 0x7FFF)  val = 0x7FFF;
+            outbuf[i*2 + c] = val;
+        }
+    }
+
+    prev[0] = inbuf[(inlen-1)*2];
+    prev[1] = inbuf[(inlen-1)*2 + 1];
+}
+
+int CheckResample()
+{
+    const int maxlen = 1024;
+    int failures = 0;
+    for (int interp = 0; interp <= 3; interp++)
+    for (int n = 0; n < 256; n++)
+    {
+        s16 inbuf[maxlen*2], expected[maxlen*2], actual[maxlen*2];
+        s16 expectedPrev[2], actualPrev[2];
+
+        // the core runs at about 32.8kHz, the frontend usually at 44.1 or 48kHz
+        // but the lengths vary when the audio is synced to the emulation
+        int outlen = 1 + Random() % maxlen;
+        int inlen = 1 + Random() % maxlen;
+        int volume = Random() % 257;
+        for (int i = 0; i < inlen*2; i++)
+            inbuf[i] = RandomSample();
+        expectedPrev[0] = actualPrev[0] = RandomSample();
+        expectedPrev[1] = actualPrev[1] = RandomSample();
+
+        ResampleReference(expectedPrev, inbuf, inlen, expected, outlen, volume, interp);
+        Frontend::Resample(actualPrev, inbuf, inlen, actual, outlen, volume, interp);
+
+        for (int i = 0; i < outlen*2; i++)
+        {
+            if (expected[i] != actual[i])
+            {
+                if (failures++ < 10)
+                    printf("resampler: interpolation %d mismatch, %d -> %d samples, output %d: %d, expected %d\n",
+                        interp, inlen, outlen, i, actual[i], expected[i]);
+                break;
+            }
+        }
+        if (expectedPrev[0] != actualPrev[0] || expectedPrev[1] != actualPrev[1])
+        {
+            if (failures++ < 10)
+                printf("resampler: previous sample not kept, %d -> %d samples\n", inlen, outlen);
+        }
+    }
+    return failures;
+}
+
+int CheckResampleFilter()
+{
+#ifdef AUDIO_SIMD
+    using namespace Frontend;
+
+    int failures = 0;
+    for (int n = 0; n < 4096; n++)
+    {
+        alignas(16) s32 taps[4][ResampleChunk];
+        alignas(16) s32 coefs[4][ResampleChunk];
+        alignas(16) s32 expected[ResampleChunk], actual[ResampleChunk];
+
+        int interp = 1 + Random() % 3;
+        for (int i = 0; i < ResampleChunk; i++)
+        {
+            int frac = Random() & 0xFF;
+            for (int k = 0; k < 4; k++)
+            {
+                taps[k][i] = RandomSample();
+                coefs[k][i] = 0;
+            }
+            switch (interp)
+            {
+            case 1: coefs[1][i] = 0xFF - frac; coefs[2][i] = frac; break;
+            case 2: coefs[1][i] = InterpCos[0xFF - frac]; coefs[2][i] = InterpCos[frac]; break;
+            case 3: for (int k = 0; k < 4; k++) coefs[k][i] = InterpCubic[frac][k]; break;
+            }
+        }
+        int shift = (interp == 1) ? 8 : 14;
+        int volume = Random() % 257;
+        int count = 4 * (1 + Random() % (ResampleChunk / 4));
+
+        FilterChunk_Scalar(expected, taps, coefs, shift, volume, count);
+        FilterChunk_Base(actual, taps, coefs, shift, volume, count);
+
+        for (int i = 0; i < count; i++)
+        {
+            if (expected[i] != actual[i])
+            {
+                if (failures++ < 10)
+                    printf("base: FilterChunk mismatch at sample %d: %d, expected %d\n", i, actual[i], expected[i]);
+                break;
+            }
+        }
+    }
+    return failures;
+#else
+    return 0;
+#endif
+}
+
+int main()
+{
+    InitInterpTables();
+
+    int failures = CheckInterpolation();
+    printf("scalar interpolation: %s\n", failures ? "FAILED" : "ok");
+
+    int resampleFailures = CheckResample() + CheckResampleFilter();
+    printf("resampler: %s\n", resampleFailures ? "FAILED" : "ok");
+    failures += resampleFailures;
+
+#ifdef SPU_SIMD
+    Variant variants[2];
+    int numVariants = 0;
+    variants[numVariants++] = {"base", FilterBlock_Base, VolumeBlock_Base, PanBlock_Base, OutputBlock_Base};
+#if defined(__x86_64__) || defined(__i386__)
+    if (__builtin_cpu_supports("avx2"))
+        variants[numVariants++] = {"AVX2", FilterBlock_AVX2, VolumeBlock_AVX2, PanBlock_AVX2, OutputBlock_AVX2};
+    else
+        printf("AVX2 isn't supported, skipping it\n");
+#endif
+
+    for (int i = 0; i < numVariants; i++)
+    {
+        int variantFailures = CheckKernels(variants[i]);
+        printf("%s: %s\n", variants[i].Name, variantFailures ? "FAILED" : "ok");
+        failures += variantFailures;
+    }
+#else
+    printf("built without the vectorised kernels, only checked the scalar ones\n");
+#endif
+
+    return failures ? 1 : 0;
+}